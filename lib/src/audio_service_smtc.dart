@@ -14,9 +14,26 @@ class AudioServiceSmtcImpl implements AudioServicePlatform {
   /// {@macro audio_service_smtc}
   AudioServiceSmtcImpl();
 
+  /// How long a seek may take before the next pending one is sent anyway.
+  static const _seekSettleTimeout = Duration(milliseconds: 250);
+
   SmtcPlugin? _smtcPlugin;
   AudioHandlerCallbacks? _handlerCallbacks;
   bool _isPlaying = false;
+  Duration? _duration;
+
+  bool _positionPending = false;
+  bool _drainingSeeks = false;
+  Completer<void>? _seekSettled;
+
+  String? _pendingStatus;
+  SmtcMetadata? _pendingMetadata;
+  Duration? _pendingPosition;
+  Future<void>? _pendingFlush;
+
+  List<MediaItem> _queue = const [];
+  String? _currentItemId;
+  String? _prefetchedArtUrl;
 
   /// Register this implementation as the default instance
   static void registerWith() {
@@ -29,7 +46,11 @@ class AudioServiceSmtcImpl implements AudioServicePlatform {
     if (_smtcPlugin == null) return;
 
     _smtcPlugin!.controlStream.listen((event) {
-      log('Requested from SMTC: $event', name: 'audio_service_smtc');
+      log(
+        'Requested from SMTC: $event '
+        '(latency: ${_smtcPlugin?.lastControlLatency?.inMicroseconds} us)',
+        name: 'audio_service_smtc',
+      );
       if (_handlerCallbacks == null) return;
 
       switch (event) {
@@ -50,12 +71,38 @@ class AudioServiceSmtcImpl implements AudioServicePlatform {
   void _listenToPositionStream() {
     if (_smtcPlugin == null) return;
 
-    _smtcPlugin!.positionStream.listen((position) {
-      if (_handlerCallbacks == null) return;
-      _handlerCallbacks!.seek(SeekRequest(position: position));
+    _smtcPlugin!.positionPendingStream.listen((_) {
+      _positionPending = true;
+      _drainSeeks();
     });
   }
 
+  /// Forwards seek requests one at a time. While a seek is in flight newer
+  /// requests replace each other natively, so only the newest is sent next.
+  Future<void> _drainSeeks() async {
+    if (_drainingSeeks) return;
+    _drainingSeeks = true;
+
+    try {
+      while (_positionPending && _smtcPlugin != null) {
+        _positionPending = false;
+
+        Duration? position;
+        while ((position = await _smtcPlugin!.takePendingPosition()) != null) {
+          if (_handlerCallbacks == null) return;
+
+          final settled = _seekSettled = Completer<void>();
+          _handlerCallbacks!.seek(SeekRequest(position: position!));
+          // The player acknowledges the seek with its next state update
+          await settled.future.timeout(_seekSettleTimeout, onTimeout: () {});
+        }
+      }
+    } finally {
+      _seekSettled = null;
+      _drainingSeeks = false;
+    }
+  }
+
   @override
   Future<void> configure(ConfigureRequest request) async {
     if (!Platform.isWindows) {
@@ -77,9 +124,35 @@ class AudioServiceSmtcImpl implements AudioServicePlatform {
   Future<void> setState(SetStateRequest request) async {
     if (_smtcPlugin == null) return;
 
+    final settled = _seekSettled;
+    if (settled != null && !settled.isCompleted) settled.complete();
+
     _isPlaying = request.state.playing;
-    final status = _isPlaying ? 'Playing' : 'Paused';
-    await _smtcPlugin!.updatePlaybackStatus(status);
+    _pendingStatus = _isPlaying ? 'Playing' : 'Paused';
+    _pendingPosition = request.state.updatePosition;
+    await _scheduleFlush();
+  }
+
+  /// Coalesces everything set during the current event-loop turn into a
+  /// single applyState call, so a track change that sets the media item and
+  /// the state back to back reaches SMTC as one update.
+  Future<void> _scheduleFlush() {
+    return _pendingFlush ??= Future(() async {
+      _pendingFlush = null;
+      final status = _pendingStatus;
+      final metadata = _pendingMetadata;
+      final position = _pendingPosition;
+      _pendingStatus = null;
+      _pendingMetadata = null;
+      _pendingPosition = null;
+
+      await _smtcPlugin?.applyState(
+        status: status,
+        metadata: metadata,
+        position: position,
+        duration: _duration,
+      );
+    });
   }
 
   @override
@@ -92,7 +165,9 @@ class AudioServiceSmtcImpl implements AudioServicePlatform {
     List<String>? genre;
     if (request.mediaItem.genre != null) genre = [request.mediaItem.genre!];
 
-    final metadata = SmtcMetadata(
+    _duration = request.mediaItem.duration;
+
+    _pendingMetadata = SmtcMetadata(
       title: request.mediaItem.title,
       artist: artist,
       album: request.mediaItem.album,
@@ -100,17 +175,30 @@ class AudioServiceSmtcImpl implements AudioServicePlatform {
       albumArtUrl: request.mediaItem.artUri?.toString(),
       genre: genre,
     );
-
-    await _smtcPlugin!.updateMetadata(metadata);
+    _currentItemId = request.mediaItem.id;
+    await _scheduleFlush();
+    await _prefetchNextArtwork();
   }
 
   @override
   Future<void> setQueue(SetQueueRequest request) async {
-    // SMTC doesn't support queue management
-    log(
-      'setQueue() has not been implemented for SMTC',
-      name: 'audio_service_smtc',
-    );
+    // SMTC shows no queue; it is only used to prefetch the next artwork
+    _queue = request.queue;
+    await _prefetchNextArtwork();
+  }
+
+  /// Asks the native side to load the artwork of the item after the current
+  /// one, so it is cached by the time that item plays.
+  Future<void> _prefetchNextArtwork() async {
+    if (_smtcPlugin == null || _currentItemId == null) return;
+
+    final index = _queue.indexWhere((item) => item.id == _currentItemId);
+    if (index < 0 || index + 1 >= _queue.length) return;
+
+    final url = _queue[index + 1].artUri?.toString();
+    if (url == null || url == _prefetchedArtUrl) return;
+    _prefetchedArtUrl = url;
+    await _smtcPlugin!.prefetchArtwork(url);
   }
 
   @override
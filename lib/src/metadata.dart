@@ -1,3 +1,23 @@
+/// Transport buttons that can be enabled in SMTC.
+///
+/// The order matches the `SMTC_BUTTON_*` bits of the native C ABI.
+enum SmtcButton {
+  /// Play button
+  play,
+
+  /// Pause button
+  pause,
+
+  /// Next button
+  next,
+
+  /// Previous button
+  previous,
+
+  /// Stop button
+  stop,
+}
+
 /// Metadata class for System Media Transport Controls
 class SmtcMetadata {
   /// Creates a new instance of SmtcMetadata
@@ -59,3 +79,149 @@ class SmtcMetadata {
     );
   }
 }
+
+/// Counters of the native pipeline that commits state updates to SMTC.
+///
+/// Updates are committed on a background thread. While it is busy, newer
+/// updates are merged into the one waiting, so only the latest state lands.
+/// A watchdog rebuilds the controls when a commit fails or stalls.
+class SmtcUpdateStats {
+  /// Creates update pipeline counters
+  const SmtcUpdateStats({
+    required this.depth,
+    required this.highWater,
+    required this.submitted,
+    required this.committed,
+    required this.collapsed,
+    required this.busy,
+    this.healthy = true,
+    this.stalls = 0,
+    this.failures = 0,
+    this.recoveries = 0,
+    this.lastRecovery = Duration.zero,
+  });
+
+  /// Creates counters from the map returned by the native `getStats` call
+  factory SmtcUpdateStats.fromMap(Map<String, Object?> map) {
+    int read(String key) => (map[key] as int?) ?? 0;
+    return SmtcUpdateStats(
+      depth: read('depth'),
+      highWater: read('highWater'),
+      submitted: read('submitted'),
+      committed: read('committed'),
+      collapsed: read('collapsed'),
+      busy: map['busy'] == true,
+      healthy: map['healthy'] != false,
+      stalls: read('stalls'),
+      failures: read('failures'),
+      recoveries: read('recoveries'),
+      lastRecovery: Duration(microseconds: read('lastRecoveryMicros')),
+    );
+  }
+
+  /// Updates waiting for the backend
+  final int depth;
+
+  /// Largest number of updates that were waiting at once
+  final int highWater;
+
+  /// Updates received from Dart
+  final int submitted;
+
+  /// Commits made to SMTC
+  final int committed;
+
+  /// Updates merged into a newer one instead of being committed on their own
+  final int collapsed;
+
+  /// Whether a commit is running right now
+  final bool busy;
+
+  /// False from a failed or stalled commit until the controls are rebuilt
+  final bool healthy;
+
+  /// Commits that overran the watchdog deadline
+  final int stalls;
+
+  /// Commits rejected by SMTC
+  final int failures;
+
+  /// Times the controls were rebuilt and the last state replayed
+  final int recoveries;
+
+  /// How long the latest recovery took, from failure to replayed state
+  final Duration lastRecovery;
+}
+
+/// Native memory held by the plugin, in bytes.
+///
+/// Caches are trimmed when [used] goes over [limit], and a session that sits
+/// stopped long enough drops its cached artwork altogether.
+class SmtcMemoryStats {
+  /// Creates memory counters
+  const SmtcMemoryStats({
+    required this.limit,
+    required this.used,
+    required this.peak,
+    this.artwork = 0,
+    this.caches = 0,
+    this.strings = 0,
+    this.queues = 0,
+    this.log = 0,
+    this.reclaims = 0,
+    this.reclaimedBytes = 0,
+    this.idleReleases = 0,
+  });
+
+  /// Creates counters from the map returned by the native `getMemoryStats`
+  /// call
+  factory SmtcMemoryStats.fromMap(Map<String, Object?> map) {
+    int read(String key) => (map[key] as int?) ?? 0;
+    return SmtcMemoryStats(
+      limit: read('limit'),
+      used: read('used'),
+      peak: read('peak'),
+      artwork: read('artwork'),
+      caches: read('caches'),
+      strings: read('strings'),
+      queues: read('queues'),
+      log: read('log'),
+      reclaims: read('reclaims'),
+      reclaimedBytes: read('reclaimedBytes'),
+      idleReleases: read('idleReleases'),
+    );
+  }
+
+  /// Budget for all native memory; 0 if unlimited
+  final int limit;
+
+  /// Bytes held right now
+  final int used;
+
+  /// Most bytes held at once
+  final int peak;
+
+  /// Encoded artwork images
+  final int artwork;
+
+  /// Cache bookkeeping and strings converted for SMTC
+  final int caches;
+
+  /// Interned artist and album names
+  final int strings;
+
+  /// Button presses waiting for Dart
+  final int queues;
+
+  /// Native log and span trace buffers
+  final int log;
+
+  /// Times caches were trimmed to get back under [limit]
+  final int reclaims;
+
+  /// Bytes freed by trimming
+  final int reclaimedBytes;
+
+  /// Times a stopped session released its caches and idle threads
+  final int idleReleases;
+}
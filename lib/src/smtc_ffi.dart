@@ -0,0 +1,326 @@
+import 'dart:convert';
+import 'dart:ffi';
+import 'dart:isolate';
+
+import 'package:audio_service_smtc/src/metadata.dart';
+import 'package:ffi/ffi.dart';
+
+/// Opaque handle to a native SMTC session.
+final class SmtcSession extends Opaque {}
+
+typedef _UpdateStatusNative = Int32 Function(Pointer<SmtcSession>, Int32);
+typedef _UpdateStatus = int Function(Pointer<SmtcSession>, int);
+
+typedef _UpdateMetadataNative = Int32 Function(
+  Pointer<SmtcSession>,
+  Pointer<Uint8>,
+  Size,
+  Pointer<Uint8>,
+  Size,
+  Pointer<Uint8>,
+  Size,
+  Int64,
+  Pointer<Uint8>,
+  Size,
+);
+typedef _UpdateMetadata = int Function(
+  Pointer<SmtcSession>,
+  Pointer<Uint8>,
+  int,
+  Pointer<Uint8>,
+  int,
+  Pointer<Uint8>,
+  int,
+  int,
+  Pointer<Uint8>,
+  int,
+);
+
+typedef _UpdateTimelineNative = Int32 Function(
+  Pointer<SmtcSession>,
+  Int64,
+  Int64,
+  Double,
+);
+typedef _UpdateTimeline = int Function(Pointer<SmtcSession>, int, int, double);
+
+/// Mirror of `SmtcStatePatch` in `smtc_c_api.h`.
+final class _SmtcStatePatch extends Struct {
+  @Uint32()
+  external int fields;
+
+  @Int32()
+  external int status;
+
+  external Pointer<Uint8> title;
+
+  @Size()
+  external int titleLength;
+
+  external Pointer<Uint8> artist;
+
+  @Size()
+  external int artistLength;
+
+  external Pointer<Uint8> album;
+
+  @Size()
+  external int albumLength;
+
+  external Pointer<Uint8> artUrl;
+
+  @Size()
+  external int artUrlLength;
+
+  @Int64()
+  external int duration;
+
+  @Int64()
+  external int position;
+
+  @Double()
+  external double rate;
+
+  @Uint32()
+  external int enabledButtons;
+}
+
+typedef _ApplyStateNative = Int32 Function(
+  Pointer<SmtcSession>,
+  Pointer<_SmtcStatePatch>,
+);
+typedef _ApplyState = int Function(
+  Pointer<SmtcSession>,
+  Pointer<_SmtcStatePatch>,
+);
+
+typedef _SetEventPortNative = Void Function(
+  Pointer<SmtcSession>,
+  Pointer<Void>,
+  Int64,
+);
+typedef _SetEventPort = void Function(Pointer<SmtcSession>, Pointer<Void>, int);
+
+typedef _TakePositionNative = Int32 Function(
+  Pointer<SmtcSession>,
+  Pointer<Int64>,
+);
+typedef _TakePosition = int Function(Pointer<SmtcSession>, Pointer<Int64>);
+
+/// Event codes posted by the native side (`SMTC_EVENT_*`).
+abstract final class SmtcEventCode {
+  /// Play button.
+  static const play = 1;
+
+  /// Pause button.
+  static const pause = 2;
+
+  /// Next button.
+  static const next = 3;
+
+  /// Previous button.
+  static const previous = 4;
+
+  /// Stop button.
+  static const stop = 5;
+
+  /// A position request is waiting; take it with
+  /// [SmtcNativeBindings.takePosition].
+  static const positionPending = 17;
+
+  /// Splits a port message into its event code and argument.
+  static (int, int) decode(int message) =>
+      (message >> 56, message & ((1 << 56) - 1));
+}
+
+/// Synchronous bindings to the plugin's C ABI (`smtc_c_api.h`).
+///
+/// Calls go straight to the native session instead of through the method
+/// channel, so they cost microseconds and need no codec round trip.
+class SmtcNativeBindings {
+  SmtcNativeBindings._(DynamicLibrary library)
+      : _updateStatus = library
+            .lookupFunction<_UpdateStatusNative, _UpdateStatus>(
+          'smtc_update_status',
+        ),
+        _updateMetadata = library
+            .lookupFunction<_UpdateMetadataNative, _UpdateMetadata>(
+          'smtc_update_metadata',
+        ),
+        _updateTimeline = library
+            .lookupFunction<_UpdateTimelineNative, _UpdateTimeline>(
+          'smtc_update_timeline',
+        ),
+        _applyState = library.lookupFunction<_ApplyStateNative, _ApplyState>(
+          'smtc_apply_state',
+        ),
+        _setEventPort =
+            library.lookupFunction<_SetEventPortNative, _SetEventPort>(
+          'smtc_set_event_port',
+        ),
+        _takePosition =
+            library.lookupFunction<_TakePositionNative, _TakePosition>(
+          'smtc_take_position',
+        );
+
+  /// Loads the plugin library, or returns null if it does not export the
+  /// C ABI.
+  static SmtcNativeBindings? tryLoad() {
+    try {
+      return SmtcNativeBindings._(
+        DynamicLibrary.open('audio_service_smtc_plugin.dll'),
+      );
+    } on Object {
+      return null;
+    }
+  }
+
+  final _UpdateStatus _updateStatus;
+  final _UpdateMetadata _updateMetadata;
+  final _UpdateTimeline _updateTimeline;
+  final _ApplyState _applyState;
+  final _SetEventPort _setEventPort;
+  final _TakePosition _takePosition;
+
+  /// Status names as used on the method channel, in `SMTC_STATUS_*` order.
+  static const _statuses = ['Closed', 'Stopped', 'Paused', 'Playing'];
+
+  /// Update the playback status.
+  bool updateStatus(Pointer<SmtcSession> session, String status) {
+    final index = _statuses.indexOf(status);
+    return _updateStatus(session, index < 0 ? 0 : index) != 0;
+  }
+
+  /// Update the media metadata.
+  bool updateMetadata(
+    Pointer<SmtcSession> session, {
+    required String title,
+    String? artist,
+    String? album,
+    Duration? duration,
+    String? albumArtUrl,
+  }) {
+    return using((arena) {
+      final titleBytes = _utf8(arena, title);
+      final artistBytes = _utf8(arena, artist);
+      final albumBytes = _utf8(arena, album);
+      final artBytes = _utf8(arena, albumArtUrl);
+      return _updateMetadata(
+            session,
+            titleBytes.$1,
+            titleBytes.$2,
+            artistBytes.$1,
+            artistBytes.$2,
+            albumBytes.$1,
+            albumBytes.$2,
+            duration?.inMicroseconds ?? 0,
+            artBytes.$1,
+            artBytes.$2,
+          ) !=
+          0;
+    });
+  }
+
+  /// Update the timeline sample.
+  bool updateTimeline(
+    Pointer<SmtcSession> session, {
+    required Duration position,
+    Duration? duration,
+    double rate = 1.0,
+  }) {
+    return _updateTimeline(
+          session,
+          position.inMicroseconds,
+          duration?.inMicroseconds ?? 0,
+          rate,
+        ) !=
+        0;
+  }
+
+  /// Apply any subset of status, metadata, timeline and enabled buttons as
+  /// one native transaction. The timeline is included if [position] is set;
+  /// [duration] defaults to the metadata's duration.
+  bool applyState(
+    Pointer<SmtcSession> session, {
+    String? status,
+    SmtcMetadata? metadata,
+    Duration? position,
+    Duration? duration,
+    double rate = 1.0,
+    Set<SmtcButton>? enabledButtons,
+  }) {
+    return using((arena) {
+      final patch = arena<_SmtcStatePatch>().ref..fields = 0;
+
+      if (status != null) {
+        final index = _statuses.indexOf(status);
+        patch
+          ..fields |= 1 << 0
+          ..status = index < 0 ? 0 : index;
+      }
+      if (metadata != null) {
+        final title = _utf8(arena, metadata.title);
+        final artist = _utf8(arena, metadata.artist?.join(', '));
+        final album = _utf8(arena, metadata.album);
+        final artUrl = _utf8(arena, metadata.albumArtUrl);
+        patch
+          ..fields |= 1 << 1
+          ..title = title.$1
+          ..titleLength = title.$2
+          ..artist = artist.$1
+          ..artistLength = artist.$2
+          ..album = album.$1
+          ..albumLength = album.$2
+          ..artUrl = artUrl.$1
+          ..artUrlLength = artUrl.$2;
+      }
+      patch.duration =
+          (duration ?? metadata?.duration)?.inMicroseconds ?? 0;
+      if (position != null) {
+        patch
+          ..fields |= 1 << 2
+          ..position = position.inMicroseconds
+          ..rate = rate;
+      }
+      if (enabledButtons != null) {
+        patch
+          ..fields |= 1 << 3
+          ..enabledButtons = enabledButtons.fold<int>(
+            0,
+            (mask, button) => mask | (1 << button.index),
+          );
+      }
+      return _applyState(session, patch.address) != 0;
+    });
+  }
+
+  /// Deliver native events to [port] instead of the events channel, or stop
+  /// delivering them if [port] is null.
+  ///
+  /// Messages are ints that [SmtcEventCode.decode] splits up.
+  void setEventPort(Pointer<SmtcSession> session, SendPort? port) {
+    if (port == null) {
+      _setEventPort(session, nullptr, 0);
+    } else {
+      _setEventPort(session, NativeApi.postCObject.cast(), port.nativePort);
+    }
+  }
+
+  /// Take the newest pending position request, or null if there is none.
+  Duration? takePosition(Pointer<SmtcSession> session) {
+    return using((arena) {
+      final position = arena<Int64>();
+      if (_takePosition(session, position) == 0) return null;
+      return Duration(microseconds: position.value);
+    });
+  }
+
+  static (Pointer<Uint8>, int) _utf8(Arena arena, String? value) {
+    if (value == null || value.isEmpty) return (nullptr, 0);
+
+    final bytes = utf8.encode(value);
+    final pointer = arena<Uint8>(bytes.length);
+    pointer.asTypedList(bytes.length).setAll(0, bytes);
+    return (pointer, bytes.length);
+  }
+}
@@ -1,7 +1,11 @@
 import 'dart:async';
+import 'dart:developer';
+import 'dart:ffi';
 import 'dart:io';
+import 'dart:isolate';
 
 import 'package:audio_service_smtc/src/metadata.dart';
+import 'package:audio_service_smtc/src/smtc_ffi.dart';
 import 'package:flutter/services.dart';
 
 /// Plugin for interacting with the Windows SMTC (System Media Transport Controls).
@@ -14,19 +18,46 @@ class SmtcPlugin {
   }
 
   final MethodChannel _channel = const MethodChannel('audio_service_smtc');
+
+  /// Direct native session, used instead of the channel once available.
+  Pointer<SmtcSession>? _session;
+  SmtcNativeBindings? _native;
+  ReceivePort? _eventPort;
   final _controlStreamController = StreamController<String>.broadcast();
-  final _positionStreamController = StreamController<Duration>.broadcast();
+  final _positionPendingController = StreamController<void>.broadcast();
 
   /// Stream of control events from SMTC (play, pause, next, previous, stop).
   Stream<String> get controlStream => _controlStreamController.stream;
 
-  /// Stream of position change events.
-  Stream<Duration> get positionStream => _positionStreamController.stream;
+  /// Time the most recent control event spent between the native button
+  /// handler and Dart, or null if no event has been received yet.
+  Duration? get lastControlLatency => _lastControlLatency;
+  Duration? _lastControlLatency;
+
+  /// Fires when a seek request from SMTC is waiting in the native mailbox.
+  ///
+  /// The mailbox keeps only the newest request, so listeners should drain it
+  /// with [takePendingPosition] until it returns null.
+  Stream<void> get positionPendingStream => _positionPendingController.stream;
 
   /// Initialize the plugin with the given identity.
   Future<void> _initialize(String identity) async {
     try {
-      await _channel.invokeMethod('initialize', {'identity': identity});
+      final result = await _channel.invokeMethod<Object?>(
+        'initialize',
+        {'identity': identity},
+      );
+
+      // Newer native builds return the session handle for dart:ffi use
+      if (result is int && result != 0) {
+        _native = SmtcNativeBindings.tryLoad();
+        if (_native != null) {
+          final session = _session = Pointer.fromAddress(result);
+          // Events are posted straight from the SMTC thread to this port
+          final port = _eventPort = ReceivePort()..listen(_handlePortEvent);
+          _native!.setEventPort(session, port.sendPort);
+        }
+      }
 
       // Set up event channel for callbacks from native code
       const eventChannel = MethodChannel('audio_service_smtc/events');
@@ -40,6 +71,12 @@ class SmtcPlugin {
   Future<void> updatePlaybackStatus(String status) async {
     if (!Platform.isWindows) return;
 
+    final session = _session;
+    if (session != null) {
+      _native!.updateStatus(session, status);
+      return;
+    }
+
     try {
       await _channel.invokeMethod('updatePlaybackStatus', {'status': status});
     } catch (e) {
@@ -51,6 +88,19 @@ class SmtcPlugin {
   Future<void> updateMetadata(SmtcMetadata metadata) async {
     if (!Platform.isWindows) return;
 
+    final session = _session;
+    if (session != null) {
+      _native!.updateMetadata(
+        session,
+        title: metadata.title,
+        artist: metadata.artist?.join(', '),
+        album: metadata.album,
+        duration: metadata.duration,
+        albumArtUrl: metadata.albumArtUrl,
+      );
+      return;
+    }
+
     try {
       await _channel.invokeMethod('updateMetadata', {
         'title': metadata.title,
@@ -64,19 +114,270 @@ class SmtcPlugin {
     }
   }
 
+  /// Update the timeline in SMTC.
+  ///
+  /// The native side extrapolates the position while playing and decides
+  /// when to republish it, so this only needs to be called when the player
+  /// reports a new position.
+  Future<void> updateTimeline({
+    required Duration position,
+    Duration? duration,
+    double rate = 1.0,
+  }) async {
+    if (!Platform.isWindows) return;
+
+    final session = _session;
+    if (session != null) {
+      _native!.updateTimeline(
+        session,
+        position: position,
+        duration: duration,
+        rate: rate,
+      );
+      return;
+    }
+
+    try {
+      await _channel.invokeMethod('updateTimeline', {
+        'position': position.inMicroseconds,
+        'duration': duration?.inMicroseconds,
+        'rate': rate,
+      });
+    } catch (e) {
+      print('Error updating timeline: $e');
+    }
+  }
+
+  /// Apply any subset of status, metadata, timeline and enabled buttons in
+  /// one round trip, committed natively as a single transaction.
+  ///
+  /// The timeline is included if [position] is set; its [duration] defaults
+  /// to the duration of [metadata].
+  Future<void> applyState({
+    String? status,
+    SmtcMetadata? metadata,
+    Duration? position,
+    Duration? duration,
+    double rate = 1.0,
+    Set<SmtcButton>? enabledButtons,
+  }) async {
+    if (!Platform.isWindows) return;
+
+    final session = _session;
+    if (session != null) {
+      _native!.applyState(
+        session,
+        status: status,
+        metadata: metadata,
+        position: position,
+        duration: duration,
+        rate: rate,
+        enabledButtons: enabledButtons,
+      );
+      return;
+    }
+
+    try {
+      await _channel.invokeMethod('applyState', {
+        if (status != null) 'status': status,
+        if (metadata != null)
+          'metadata': {
+            'title': metadata.title,
+            'artist': metadata.artist?.join(', '),
+            'album': metadata.album,
+            'duration': metadata.duration?.inMicroseconds,
+            'albumArtUrl': metadata.albumArtUrl,
+          },
+        if (position != null)
+          'timeline': {
+            'position': position.inMicroseconds,
+            'duration': (duration ?? metadata?.duration)?.inMicroseconds,
+            'rate': rate,
+          },
+        if (enabledButtons != null)
+          'enabledButtons': [for (final button in enabledButtons) button.name],
+      });
+    } catch (e) {
+      print('Error applying state: $e');
+    }
+  }
+
+  /// Takes the newest pending seek request, or null if there is none.
+  Future<Duration?> takePendingPosition() async {
+    if (!Platform.isWindows) return null;
+
+    final session = _session;
+    if (session != null) return _native!.takePosition(session);
+
+    try {
+      final position = await _channel.invokeMethod<int>('takePosition');
+      return position == null ? null : Duration(microseconds: position);
+    } catch (e) {
+      print('Error taking pending position: $e');
+      return null;
+    }
+  }
+
+  /// Counters of the native update pipeline, or null if unavailable.
+  Future<SmtcUpdateStats?> getStats() async {
+    if (!Platform.isWindows) return null;
+
+    try {
+      final stats = await _channel.invokeMapMethod<String, Object?>(
+        'getStats',
+      );
+      return stats == null ? null : SmtcUpdateStats.fromMap(stats);
+    } catch (e) {
+      print('Error getting stats: $e');
+      return null;
+    }
+  }
+
+  /// Caps the plugin's native memory and sets when it lets go of resources.
+  ///
+  /// Over [budgetBytes], cached artwork is dropped oldest first; the artwork
+  /// cache alone never holds more than [artworkCacheBytes]. Once the session
+  /// has been stopped for [idleRelease], cached artwork and idle worker
+  /// threads are released. Zero means no limit, or never.
+  Future<void> setMemoryLimits({
+    int budgetBytes = 0,
+    int artworkCacheBytes = 0,
+    Duration idleRelease = const Duration(seconds: 30),
+  }) async {
+    if (!Platform.isWindows) return;
+
+    try {
+      await _channel.invokeMethod('setMemoryLimits', {
+        'budgetBytes': budgetBytes,
+        'artworkCacheBytes': artworkCacheBytes,
+        'idleReleaseMillis': idleRelease.inMilliseconds,
+      });
+    } catch (e) {
+      print('Error setting memory limits: $e');
+    }
+  }
+
+  /// Limits the artwork handed to Windows on each track change.
+  ///
+  /// Artwork larger than [maxBytes] is scaled so its longest side is at most
+  /// [maxEdge] pixels and re-encoded (JPEG, or PNG if it has transparency)
+  /// to fit. Zero [maxBytes] passes artwork on as loaded. Applies to artwork
+  /// loaded after the call.
+  Future<void> setThumbnailBudget({
+    int maxBytes = 64 * 1024,
+    int maxEdge = 512,
+  }) async {
+    if (!Platform.isWindows) return;
+
+    try {
+      await _channel.invokeMethod('setThumbnailBudget', {
+        'maxBytes': maxBytes,
+        'maxEdge': maxEdge,
+      });
+    } catch (e) {
+      print('Error setting thumbnail budget: $e');
+    }
+  }
+
+  /// Loads the artwork at [url] into the native cache ahead of time, behind
+  /// any work for the current track, so the track it belongs to shows its
+  /// full artwork as soon as it starts.
+  Future<void> prefetchArtwork(String url) async {
+    if (!Platform.isWindows) return;
+
+    try {
+      await _channel.invokeMethod('prefetchArtwork', {'url': url});
+    } catch (e) {
+      print('Error prefetching artwork: $e');
+    }
+  }
+
+  /// Native memory held by the plugin, or null if unavailable.
+  Future<SmtcMemoryStats?> getMemoryStats() async {
+    if (!Platform.isWindows) return null;
+
+    try {
+      final stats = await _channel.invokeMapMethod<String, Object?>(
+        'getMemoryStats',
+      );
+      return stats == null ? null : SmtcMemoryStats.fromMap(stats);
+    } catch (e) {
+      print('Error getting memory stats: $e');
+      return null;
+    }
+  }
+
+  /// Starts or stops recording native spans for profiling.
+  ///
+  /// Each native thread keeps its most recent spans: method calls, lock
+  /// waits, backend updates and artwork work. Starting discards what was
+  /// recorded before; stopping keeps it for [dumpSpans]. Recording can also
+  /// be turned on from launch by setting `AUDIO_SERVICE_SMTC_SPANS` to a file
+  /// path, which the spans are written to when the plugin unloads.
+  Future<void> setSpanTracing(bool enabled) async {
+    if (!Platform.isWindows) return;
+
+    try {
+      await _channel.invokeMethod('setSpanTracing', {'enabled': enabled});
+    } catch (e) {
+      print('Error setting span tracing: $e');
+    }
+  }
+
+  /// Writes the recorded spans to [path] for ui.perfetto.dev or
+  /// chrome://tracing: Chrome trace-event JSON if [path] ends in `.json`,
+  /// a Perfetto protobuf trace otherwise. Returns false if it failed.
+  Future<bool> dumpSpans(String path) async {
+    if (!Platform.isWindows) return false;
+
+    try {
+      return await _channel.invokeMethod<bool>('dumpSpans', {'path': path}) ??
+          false;
+    } catch (e) {
+      print('Error dumping spans: $e');
+      return false;
+    }
+  }
+
   /// Clean up resources.
   Future<void> dispose() async {
     if (!Platform.isWindows) return;
 
+    // The handle dies with the native session
+    final session = _session;
+    if (session != null) _native!.setEventPort(session, null);
+    _session = null;
+    _eventPort?.close();
+    _eventPort = null;
+
     try {
       await _channel.invokeMethod('dispose');
       _controlStreamController.close();
-      _positionStreamController.close();
+      _positionPendingController.close();
     } catch (e) {
       print('Error disposing SMTC plugin: $e');
     }
   }
 
+  /// Handle events posted to the native port.
+  void _handlePortEvent(dynamic message) {
+    final (event, _) = SmtcEventCode.decode(message as int);
+    switch (event) {
+      case SmtcEventCode.play:
+        _controlStreamController.add('play');
+      case SmtcEventCode.pause:
+        _controlStreamController.add('pause');
+      case SmtcEventCode.next:
+        _controlStreamController.add('next');
+      case SmtcEventCode.previous:
+        _controlStreamController.add('previous');
+      case SmtcEventCode.stop:
+        _controlStreamController.add('stop');
+      case SmtcEventCode.positionPending:
+        _positionPendingController.add(null);
+    }
+  }
+
   /// Handle method calls from the native side.
   Future<void> _handleMethodCall(MethodCall call) async {
     final args = call.arguments as Map<dynamic, dynamic>;
@@ -84,11 +385,14 @@ class SmtcPlugin {
 
     if (type == 'control') {
       final controlType = args['controlType'] as String;
+      // Native timestamps share the monotonic clock behind Timeline.now
+      final timestamp = args['timestamp'] as int?;
+      if (timestamp != null) {
+        _lastControlLatency = Duration(microseconds: Timeline.now - timestamp);
+      }
       _controlStreamController.add(controlType);
-    } else if (type == 'position') {
-      final positionMicroseconds = args['position'] as int;
-      _positionStreamController
-          .add(Duration(microseconds: positionMicroseconds));
+    } else if (type == 'positionPending') {
+      _positionPendingController.add(null);
     }
   }
 }
@@ -4,11 +4,19 @@
 #include <flutter/plugin_registrar_windows.h>
 #include <flutter/standard_method_codec.h>
 
+#include <atomic>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <map>
 
-#include "smtc_windows/smtc_windows.h"
+#include "smtc_windows/event_dispatcher.h"
+#include "smtc_windows/position_mailbox.h"
+#include "smtc_windows/shared_session.h"
+#include "smtc_windows/smtc_c_api.h"
+#include "smtc_windows/span_tracer.h"
+#include "smtc_windows/state_patch_args.h"
+#include "smtc_windows/timeline_publisher.h"
 
 namespace audio_service_smtc {
 
@@ -24,24 +32,63 @@ class AudioServiceSmtcPlugin : public flutter::Plugin {
   // The registrar for this plugin, for accessing the window and sending events.
   flutter::PluginRegistrarWindows *registrar_;
 
-  // SMTC handler pointer
-  void* smtcHandler_ = nullptr;
+  // This engine's hold on the process-wide SMTC session
+  std::unique_ptr<SharedSession<SmtcSession>::Attachment> session_;
+
+  // SMTC session handle, set only while this engine drives state
+  std::atomic<SmtcSession*> smtcHandler_{nullptr};
 
   // Method channel for callbacks
   std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>> channel_;
 
+  // Newest seek request from SMTC, drained by Dart with takePosition
+  PositionMailbox position_mailbox_;
+
+  // Orders native->Dart events so controls never wait behind positions
+  std::unique_ptr<EventDispatcher> event_dispatcher_;
+
+  // Encoded event being sent; only touched by the dispatcher's deliverer
+  std::vector<uint8_t> event_buffer_;
+
   // Called when a method is called on this plugin's channel from Dart.
   void HandleMethodCall(
       const flutter::MethodCall<flutter::EncodableValue> &method_call,
       std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
       
+  // Receives events from the C ABI and forwards them to the handlers below
+  static void OnSmtcEvent(void* user, int32_t event, int64_t arg);
+
   // Callback for SMTC control events
   void OnControlEvent(const char* controlType);
   
   // Callback for SMTC position changes
   void OnPositionChange(int64_t positionInMicroseconds);
+
+  // Encodes a dispatched event and sends it on the events channel
+  void SendEvent(const NativeEvent& event);
+
+  // Takes over event delivery when this engine becomes the driver
+  void OnBecameDriver(SmtcSession* session);
+
+  // Releases this engine's attachment, destroying the session if it was the
+  // last one
+  void DetachSession();
+
+  // Replies for writes from an engine that does not drive state. Returns
+  // true if the call was answered.
+  bool RejectUnlessDriving(flutter::MethodResult<flutter::EncodableValue>* result);
 };
 
+namespace {
+
+// One SMTC session per process, shared by every engine that loads the plugin
+SharedSession<SmtcSession>& SharedSmtc() {
+  static SharedSession<SmtcSession> shared;
+  return shared;
+}
+
+}  // namespace
+
 // static
 void AudioServiceSmtcPlugin::RegisterWithRegistrar(
     flutter::PluginRegistrarWindows *registrar) {
@@ -67,89 +114,146 @@ AudioServiceSmtcPlugin::AudioServiceSmtcPlugin(flutter::PluginRegistrarWindows *
       std::make_unique<flutter::MethodChannel<flutter::EncodableValue>>(
           registrar_->messenger(), "audio_service_smtc/events",
           &flutter::StandardMethodCodec::GetInstance());
+
+  event_dispatcher_ = std::make_unique<EventDispatcher>(
+      [this](const NativeEvent& event) { this->SendEvent(event); });
 }
 
 AudioServiceSmtcPlugin::~AudioServiceSmtcPlugin() {
-  if (smtcHandler_) {
-    DisposeSMTCHandler(smtcHandler_);
-    smtcHandler_ = nullptr;
+  DetachSession();
+  DumpSpansToEnvironment();
+}
+
+void AudioServiceSmtcPlugin::OnBecameDriver(SmtcSession* session) {
+  // Events stop going to the port of the engine that drove before
+  smtc_set_event_port(session, nullptr, 0);
+  smtc_set_event_callback(session, &AudioServiceSmtcPlugin::OnSmtcEvent, this);
+  smtcHandler_ = session;
+}
+
+void AudioServiceSmtcPlugin::DetachSession() {
+  SmtcSession* handler = smtcHandler_.exchange(nullptr);
+  if (handler) {
+    // Stop events reaching this plugin before the next driver is promoted
+    smtc_set_event_callback(handler, nullptr, nullptr);
+  }
+  session_.reset();
+}
+
+bool AudioServiceSmtcPlugin::RejectUnlessDriving(
+    flutter::MethodResult<flutter::EncodableValue>* result) {
+  if (smtcHandler_) return false;
+  if (session_) {
+    // Attached but another engine drives state; the write is dropped
+    result->Success(flutter::EncodableValue(false));
+  } else {
+    result->Error("Not initialized", "SMTC handler not initialized");
+  }
+  return true;
+}
+
+// static
+void AudioServiceSmtcPlugin::OnSmtcEvent(void* user, int32_t event, int64_t arg) {
+  auto* plugin = static_cast<AudioServiceSmtcPlugin*>(user);
+  switch (event) {
+    case SMTC_EVENT_PLAY:
+      plugin->OnControlEvent("play");
+      break;
+    case SMTC_EVENT_PAUSE:
+      plugin->OnControlEvent("pause");
+      break;
+    case SMTC_EVENT_NEXT:
+      plugin->OnControlEvent("next");
+      break;
+    case SMTC_EVENT_PREVIOUS:
+      plugin->OnControlEvent("previous");
+      break;
+    case SMTC_EVENT_STOP:
+      plugin->OnControlEvent("stop");
+      break;
+    case SMTC_EVENT_POSITION:
+      plugin->OnPositionChange(arg);
+      break;
   }
 }
 
 void AudioServiceSmtcPlugin::OnControlEvent(const char* controlType) {
   if (!controlType) return;
   
-  // Dispatch the control event back to Flutter
-  flutter::EncodableMap args;
-  args[flutter::EncodableValue("type")] = flutter::EncodableValue("control");
-  args[flutter::EncodableValue("controlType")] = flutter::EncodableValue(std::string(controlType));
-  
-  registrar_->messenger()->Send(
-    "audio_service_smtc/events", 
-    flutter::StandardMethodCodec::GetInstance()->EncodeSuccessEnvelope(flutter::EncodableValue(args))
-  );
+  // Dispatch the control event back to Flutter ahead of any position traffic
+  event_dispatcher_->PostControl(controlType);
 }
 
 void AudioServiceSmtcPlugin::OnPositionChange(int64_t positionInMicroseconds) {
-  // Dispatch the position change event back to Flutter
-  flutter::EncodableMap args;
-  args[flutter::EncodableValue("type")] = flutter::EncodableValue("position");
-  args[flutter::EncodableValue("position")] = flutter::EncodableValue(positionInMicroseconds);
-  
-  registrar_->messenger()->Send(
-    "audio_service_smtc/events", 
-    flutter::StandardMethodCodec::GetInstance()->EncodeSuccessEnvelope(flutter::EncodableValue(args))
-  );
+  // Dart is only woken when the mailbox goes from empty to full; it then
+  // drains it one seek at a time, so a scrub collapses to the newest position.
+  if (!position_mailbox_.Post(positionInMicroseconds)) return;
+
+  event_dispatcher_->PostPosition(positionInMicroseconds);
+}
+
+void AudioServiceSmtcPlugin::SendEvent(const NativeEvent& event) {
+  // Encoded by hand: same bytes as EncodeSuccessEnvelope on the event map,
+  // without building the map on every button press. Only one delivery runs
+  // at a time, so the buffer is reused.
+  EncodeEventEnvelope(event, &event_buffer_);
+  registrar_->messenger()->Send("audio_service_smtc/events", event_buffer_.data(), event_buffer_.size());
 }
 
 void AudioServiceSmtcPlugin::HandleMethodCall(
     const flutter::MethodCall<flutter::EncodableValue> &method_call,
     std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+  SMTC_SPAN_LABELLED(span, "channel", "HandleMethodCall", method_call.method_name());
   
   // Initialize SMTC
   if (method_call.method_name() == "initialize") {
+    SetSpanThreadName("platform");
+    StartSpansFromEnvironment();
+    
     const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
     if (!arguments) {
       result->Error("Invalid arguments", "Expected a map");
       return;
     }
     
-    auto identity_it = arguments->find(flutter::EncodableValue("identity"));
-    if (identity_it == arguments->end() || !std::holds_alternative<std::string>(identity_it->second)) {
+    ArgValues<2> args;
+    std::string error;
+    if (!DecodeArgs(*arguments, InitializeArgs::kSchema, &args, &error)) {
+      result->Error("Invalid arguments", error);
+      return;
+    }
+    if (!args.Has(InitializeArgs::kIdentity)) {
       result->Error("Invalid arguments", "Identity must be a string");
       return;
     }
     
-    std::string identity = std::get<std::string>(identity_it->second);
+    std::string_view identity = args.String(InitializeArgs::kIdentity);
     
-    // Clean up previous handler if exists
-    if (smtcHandler_) {
-      DisposeSMTCHandler(smtcHandler_);
+    // Attach to the shared session; the first engine creates it with its
+    // identity and drives state until it detaches
+    if (!session_) {
+      session_ = SharedSmtc().Attach(
+          [&identity] {
+            return std::shared_ptr<SmtcSession>(
+                smtc_create(identity.data(), identity.size()), smtc_destroy);
+          },
+          [this](SmtcSession& session) { OnBecameDriver(&session); });
     }
     
-    // Create new handler
-    smtcHandler_ = CreateSMTCHandler(identity.c_str());
-    
-    if (!smtcHandler_) {
+    if (!session_) {
       result->Error("Initialization failed", "Failed to create SMTC handler");
       return;
     }
     
-    // Set up callbacks
-    SetCallbacks(
-      smtcHandler_,
-      [this](const char* controlType) { this->OnControlEvent(controlType); },
-      [this](int64_t position) { this->OnPositionChange(position); }
-    );
-    
-    result->Success();
+    // Hand the session to Dart so it can call the C ABI directly via dart:ffi.
+    // Engines that do not drive get 0 and stay on the method channel.
+    result->Success(flutter::EncodableValue(reinterpret_cast<int64_t>(smtcHandler_.load())));
     return;
   }
   
   // Update playback status
   else if (method_call.method_name() == "updatePlaybackStatus") {
-    if (!smtcHandler_) {
-      result->Error("Not initialized", "SMTC handler not initialized");
+    if (RejectUnlessDriving(result.get())) {
       return;
     }
     
@@ -159,14 +263,15 @@ void AudioServiceSmtcPlugin::HandleMethodCall(
       return;
     }
     
-    auto status_it = arguments->find(flutter::EncodableValue("status"));
-    if (status_it == arguments->end() || !std::holds_alternative<std::string>(status_it->second)) {
-      result->Error("Invalid arguments", "Status must be a string");
+    ArgValues<1> args;
+    std::string error;
+    if (!DecodeArgs(*arguments, StatusArgs::kSchema, &args, &error)) {
+      result->Error("Invalid arguments", error);
       return;
     }
     
-    std::string status = std::get<std::string>(status_it->second);
-    UpdatePlaybackStatus(smtcHandler_, status.c_str());
+    std::string_view status = args.String(StatusArgs::kStatus);
+    smtc_update_status(smtcHandler_, static_cast<int32_t>(ParsePlaybackState(status)));
     
     result->Success();
     return;
@@ -174,8 +279,7 @@ void AudioServiceSmtcPlugin::HandleMethodCall(
   
   // Update metadata
   else if (method_call.method_name() == "updateMetadata") {
-    if (!smtcHandler_) {
-      result->Error("Not initialized", "SMTC handler not initialized");
+    if (RejectUnlessDriving(result.get())) {
       return;
     }
     
@@ -185,50 +289,288 @@ void AudioServiceSmtcPlugin::HandleMethodCall(
       return;
     }
     
-    // Extract metadata fields
-    std::string title;
-    std::string artist;
-    std::string album;
-    int64_t duration = 0;
-    std::string albumArtUrl;
+    // Read in place and handed to the C ABI as pointer and length
+    ArgValues<5> args;
+    std::string error;
+    if (!DecodeArgs(*arguments, MetadataArgs::kSchema, &args, &error)) {
+      result->Error("Invalid arguments", error);
+      return;
+    }
+    
+    std::string_view title = args.String(MetadataArgs::kTitle);
+    std::string_view artist = args.String(MetadataArgs::kArtist);
+    std::string_view album = args.String(MetadataArgs::kAlbum);
+    std::string_view albumArtUrl = args.String(MetadataArgs::kAlbumArtUrl);
+    smtc_update_metadata(smtcHandler_,
+                         title.data(), title.size(),
+                         artist.data(), artist.size(),
+                         album.data(), album.size(),
+                         args.Integer(MetadataArgs::kDuration),
+                         albumArtUrl.data(), albumArtUrl.size());
     
-    auto title_it = arguments->find(flutter::EncodableValue("title"));
-    if (title_it != arguments->end() && std::holds_alternative<std::string>(title_it->second)) {
-      title = std::get<std::string>(title_it->second);
+    result->Success();
+    return;
+  }
+  
+  // Update the timeline sample
+  else if (method_call.method_name() == "updateTimeline") {
+    if (RejectUnlessDriving(result.get())) {
+      return;
     }
     
-    auto artist_it = arguments->find(flutter::EncodableValue("artist"));
-    if (artist_it != arguments->end() && std::holds_alternative<std::string>(artist_it->second)) {
-      artist = std::get<std::string>(artist_it->second);
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    if (!arguments) {
+      result->Error("Invalid arguments", "Expected a map");
+      return;
     }
     
-    auto album_it = arguments->find(flutter::EncodableValue("album"));
-    if (album_it != arguments->end() && std::holds_alternative<std::string>(album_it->second)) {
-      album = std::get<std::string>(album_it->second);
+    ArgValues<3> args;
+    std::string error;
+    if (!DecodeArgs(*arguments, TimelineArgs::kSchema, &args, &error)) {
+      result->Error("Invalid arguments", error);
+      return;
     }
     
-    auto duration_it = arguments->find(flutter::EncodableValue("duration"));
-    if (duration_it != arguments->end() && std::holds_alternative<int64_t>(duration_it->second)) {
-      duration = std::get<int64_t>(duration_it->second);
+    smtc_update_timeline(smtcHandler_,
+                         args.Integer(TimelineArgs::kPosition),
+                         args.Integer(TimelineArgs::kDuration),
+                         args.Number(TimelineArgs::kRate, 1.0));
+    
+    result->Success();
+    return;
+  }
+  
+  // Apply status, metadata, timeline and buttons in one transaction
+  else if (method_call.method_name() == "applyState") {
+    if (RejectUnlessDriving(result.get())) {
+      return;
+    }
+    
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    if (!arguments) {
+      result->Error("Invalid arguments", "Expected a map");
+      return;
     }
     
-    auto albumArtUrl_it = arguments->find(flutter::EncodableValue("albumArtUrl"));
-    if (albumArtUrl_it != arguments->end() && std::holds_alternative<std::string>(albumArtUrl_it->second)) {
-      albumArtUrl = std::get<std::string>(albumArtUrl_it->second);
+    PlayerStatePatch state;
+    std::string error;
+    if (!DecodeStatePatch(*arguments, &state, &error)) {
+      result->Error("Invalid arguments", error);
+      return;
     }
     
-    UpdateMetadata(smtcHandler_, title.c_str(), artist.c_str(), album.c_str(), duration, albumArtUrl.c_str());
+    SmtcStatePatch patch = {};
+    if (state.status) {
+      patch.fields |= SMTC_FIELD_STATUS;
+      patch.status = static_cast<int32_t>(*state.status);
+    }
+    if (state.metadata) {
+      patch.fields |= SMTC_FIELD_METADATA;
+      patch.title = state.metadata->title.data();
+      patch.title_length = state.metadata->title.size();
+      patch.artist = state.metadata->artist.view().data();
+      patch.artist_length = state.metadata->artist.size();
+      patch.album = state.metadata->album.view().data();
+      patch.album_length = state.metadata->album.size();
+      patch.art_url = state.metadata->artUrl.data();
+      patch.art_url_length = state.metadata->artUrl.size();
+      patch.duration = state.metadata->duration;
+    }
+    if (state.timeline) {
+      patch.fields |= SMTC_FIELD_TIMELINE;
+      patch.position = state.timeline->position;
+      patch.duration = state.timeline->duration;
+      patch.rate = state.timeline->rate;
+    }
+    if (state.enabledButtons) {
+      patch.fields |= SMTC_FIELD_BUTTONS;
+      patch.enabled_buttons = *state.enabledButtons;
+    }
+    smtc_apply_state(smtcHandler_, &patch);
     
     result->Success();
     return;
   }
   
+  // Update pipeline counters; answered even while the backend is stalled
+  else if (method_call.method_name() == "getStats") {
+    SmtcUpdateStats stats = {};
+    if (session_) {
+      smtc_get_update_stats(&session_->session(), &stats);
+    }
+    
+    flutter::EncodableMap map;
+    map[flutter::EncodableValue("depth")] = flutter::EncodableValue(static_cast<int64_t>(stats.depth));
+    map[flutter::EncodableValue("highWater")] = flutter::EncodableValue(static_cast<int64_t>(stats.high_water));
+    map[flutter::EncodableValue("submitted")] = flutter::EncodableValue(static_cast<int64_t>(stats.submitted));
+    map[flutter::EncodableValue("committed")] = flutter::EncodableValue(static_cast<int64_t>(stats.committed));
+    map[flutter::EncodableValue("collapsed")] = flutter::EncodableValue(static_cast<int64_t>(stats.collapsed));
+    map[flutter::EncodableValue("busy")] = flutter::EncodableValue(stats.busy != 0);
+    map[flutter::EncodableValue("healthy")] = flutter::EncodableValue(stats.healthy != 0);
+    map[flutter::EncodableValue("stalls")] = flutter::EncodableValue(static_cast<int64_t>(stats.stalls));
+    map[flutter::EncodableValue("failures")] = flutter::EncodableValue(static_cast<int64_t>(stats.failures));
+    map[flutter::EncodableValue("recoveries")] = flutter::EncodableValue(static_cast<int64_t>(stats.recoveries));
+    map[flutter::EncodableValue("lastRecoveryMicros")] = flutter::EncodableValue(stats.last_recovery_us);
+    result->Success(flutter::EncodableValue(map));
+    return;
+  }
+  
+  // Cap native memory and set when a stopped session lets go of its caches
+  else if (method_call.method_name() == "setMemoryLimits") {
+    if (RejectUnlessDriving(result.get())) {
+      return;
+    }
+    
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    if (!arguments) {
+      result->Error("Invalid arguments", "Expected a map");
+      return;
+    }
+    
+    MemoryLimits limits;
+    std::string error;
+    if (!DecodeMemoryLimits(*arguments, &limits, &error)) {
+      result->Error("Invalid arguments", error);
+      return;
+    }
+    smtc_set_memory_limits(smtcHandler_, static_cast<uint64_t>(limits.budgetBytes),
+                           static_cast<uint64_t>(limits.artworkCacheBytes),
+                           limits.idleReleaseMillis);
+    
+    result->Success(flutter::EncodableValue(true));
+    return;
+  }
+  
+  // Cap the size of the artwork stream handed to SMTC on track changes
+  else if (method_call.method_name() == "setThumbnailBudget") {
+    if (RejectUnlessDriving(result.get())) {
+      return;
+    }
+    
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    if (!arguments) {
+      result->Error("Invalid arguments", "Expected a map");
+      return;
+    }
+    
+    ThumbnailBudget budget;
+    std::string error;
+    if (!DecodeThumbnailBudget(*arguments, &budget, &error)) {
+      result->Error("Invalid arguments", error);
+      return;
+    }
+    smtc_set_thumbnail_budget(smtcHandler_, static_cast<uint64_t>(budget.maxBytes), budget.maxEdge);
+    
+    result->Success(flutter::EncodableValue(true));
+    return;
+  }
+  
+  // Warm the artwork cache for the track expected next
+  else if (method_call.method_name() == "prefetchArtwork") {
+    if (RejectUnlessDriving(result.get())) {
+      return;
+    }
+    
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    if (!arguments) {
+      result->Error("Invalid arguments", "Expected a map");
+      return;
+    }
+    
+    ArgValues<1> args;
+    std::string error;
+    if (!DecodeArgs(*arguments, PrefetchArtworkArgs::kSchema, &args, &error)) {
+      result->Error("Invalid arguments", error);
+      return;
+    }
+    std::string_view url = args.String(PrefetchArtworkArgs::kUrl);
+    smtc_prefetch_artwork(smtcHandler_, url.data(), url.size());
+    
+    result->Success(flutter::EncodableValue(true));
+    return;
+  }
+  
+  // Accounted native memory, per subsystem
+  else if (method_call.method_name() == "getMemoryStats") {
+    SmtcMemoryStats stats = {};
+    if (session_) {
+      smtc_get_memory_stats(&session_->session(), &stats);
+    }
+    
+    flutter::EncodableMap map;
+    map[flutter::EncodableValue("limit")] = flutter::EncodableValue(static_cast<int64_t>(stats.limit));
+    map[flutter::EncodableValue("used")] = flutter::EncodableValue(static_cast<int64_t>(stats.used));
+    map[flutter::EncodableValue("peak")] = flutter::EncodableValue(static_cast<int64_t>(stats.peak));
+    map[flutter::EncodableValue("artwork")] = flutter::EncodableValue(static_cast<int64_t>(stats.artwork));
+    map[flutter::EncodableValue("caches")] = flutter::EncodableValue(static_cast<int64_t>(stats.caches));
+    map[flutter::EncodableValue("strings")] = flutter::EncodableValue(static_cast<int64_t>(stats.strings));
+    map[flutter::EncodableValue("queues")] = flutter::EncodableValue(static_cast<int64_t>(stats.queues));
+    map[flutter::EncodableValue("log")] = flutter::EncodableValue(static_cast<int64_t>(stats.log));
+    map[flutter::EncodableValue("reclaims")] = flutter::EncodableValue(static_cast<int64_t>(stats.reclaims));
+    map[flutter::EncodableValue("reclaimedBytes")] = flutter::EncodableValue(static_cast<int64_t>(stats.reclaimed));
+    map[flutter::EncodableValue("idleReleases")] = flutter::EncodableValue(static_cast<int64_t>(stats.idle_releases));
+    result->Success(flutter::EncodableValue(map));
+    return;
+  }
+  
+  // Take the pending seek request, if any
+  else if (method_call.method_name() == "takePosition") {
+    int64_t position;
+    if (position_mailbox_.Take(&position)) {
+      result->Success(flutter::EncodableValue(position));
+    } else {
+      result->Success();
+    }
+    return;
+  }
+  
+  // Record native spans, process-wide, for profiling
+  else if (method_call.method_name() == "setSpanTracing") {
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    if (!arguments) {
+      result->Error("Invalid arguments", "Expected a map");
+      return;
+    }
+    
+    ArgValues<1> args;
+    std::string error;
+    if (!DecodeArgs(*arguments, SpanTracingArgs::kSchema, &args, &error)) {
+      result->Error("Invalid arguments", error);
+      return;
+    }
+    if (args.Bool(SpanTracingArgs::kEnabled, false)) {
+      StartSpans();
+    } else {
+      StopSpans();
+    }
+    
+    result->Success();
+    return;
+  }
+  
+  // Write the recorded spans to a file; .json gets Chrome's format,
+  // anything else Perfetto's
+  else if (method_call.method_name() == "dumpSpans") {
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    if (!arguments) {
+      result->Error("Invalid arguments", "Expected a map");
+      return;
+    }
+    
+    ArgValues<1> args;
+    std::string error;
+    if (!DecodeArgs(*arguments, DumpSpansArgs::kSchema, &args, &error)) {
+      result->Error("Invalid arguments", error);
+      return;
+    }
+    
+    result->Success(flutter::EncodableValue(DumpSpans(std::string(args.String(DumpSpansArgs::kPath)))));
+    return;
+  }
+  
   // Dispose the SMTC handler
   else if (method_call.method_name() == "dispose") {
-    if (smtcHandler_) {
-      DisposeSMTCHandler(smtcHandler_);
-      smtcHandler_ = nullptr;
-    }
+    DetachSession();
     
     result->Success();
     return;
@@ -0,0 +1,366 @@
+#include "artwork_pipeline.h"
+
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <utility>
+
+#include "artwork_thumbnail.h"
+#include "memory_budget.h"
+#include "span_tracer.h"
+
+namespace audio_service_smtc {
+
+namespace {
+
+// The EXIF APP1 segment is limited to 64 KiB and sits at the start of the file.
+constexpr size_t kHeadBytes = 64 * 1024;
+// Images below this size are cheap enough to show directly.
+constexpr size_t kSmallImageBytes = 32 * 1024;
+constexpr size_t kCacheEntries = 8;
+// List node and allocator overhead of a cache entry, roughly
+constexpr size_t kEntryOverhead = 2 * sizeof(void*) + 16;
+
+ArtworkBytes ExtractSmallVariant(const std::vector<uint8_t>& bytes) {
+    size_t offset, length;
+    if (FindExifThumbnail(bytes.data(), bytes.size(), &offset, &length)) {
+        return MakeArtworkBytes(std::vector<uint8_t>(bytes.begin() + offset,
+                                                     bytes.begin() + offset + length));
+    }
+    return nullptr;
+}
+
+// What stored artwork was made under: as loaded, or re-encoded to a budget
+uint64_t StoreValidator(bool decoding, const ThumbnailBudget& budget) {
+    if (!decoding || budget.maxBytes == 0) return 0;
+    const uint64_t fields[] = { budget.maxBytes, budget.maxEdge, static_cast<uint64_t>(budget.minQuality),
+                                static_cast<uint64_t>(budget.maxQuality), static_cast<uint64_t>(budget.maxAttempts) };
+    return HashBytes(fields, sizeof(fields));
+}
+
+size_t BufferBytes(const ArtworkBytes& bytes) {
+    return bytes ? sizeof(std::vector<uint8_t>) + bytes->capacity() : 0;
+}
+
+int HexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+std::string FileUrlToPath(const std::string& url) {
+    if (url.compare(0, 7, "file://") != 0) return url;
+
+    std::string path;
+    path.reserve(url.size());
+    for (size_t i = 7; i < url.size(); ++i) {
+        if (url[i] == '%' && i + 2 < url.size() &&
+            HexValue(url[i + 1]) >= 0 && HexValue(url[i + 2]) >= 0) {
+            path += static_cast<char>(HexValue(url[i + 1]) * 16 + HexValue(url[i + 2]));
+            i += 2;
+        } else {
+            path += url[i];
+        }
+    }
+    // file:///C:/music/a.jpg -> C:/music/a.jpg
+    if (path.size() > 2 && path[0] == '/' && std::isalpha(static_cast<unsigned char>(path[1])) &&
+        path[2] == ':') {
+        path.erase(0, 1);
+    }
+    return path;
+}
+
+}  // namespace
+
+ArtworkBytes MakeArtworkBytes(std::vector<uint8_t> bytes) {
+    auto* buffer = new std::vector<uint8_t>(std::move(bytes));
+    size_t charged = sizeof(*buffer) + buffer->capacity();
+    MemoryBudget::Shared().Charge(MemoryCategory::kArtwork, charged);
+    return ArtworkBytes(buffer, [charged](const std::vector<uint8_t>* released) {
+        delete released;
+        MemoryBudget::Shared().Release(MemoryCategory::kArtwork, charged);
+    });
+}
+
+bool IsLocalArtworkUrl(const std::string& url) {
+    if (url.compare(0, 7, "file://") == 0) return true;
+    // Anything with a scheme other than a drive letter is remote.
+    size_t colon = url.find("://");
+    return colon == std::string::npos;
+}
+
+bool LoadLocalArtwork(const std::string& url, size_t maxBytes, std::vector<uint8_t>& out) {
+    if (!IsLocalArtworkUrl(url)) return false;
+
+    std::ifstream file(std::filesystem::u8path(FileUrlToPath(url)), std::ios::binary);
+    if (!file) return false;
+
+    file.seekg(0, std::ios::end);
+    std::streamoff size = file.tellg();
+    if (size <= 0) return false;
+    file.seekg(0, std::ios::beg);
+
+    size_t toRead = static_cast<size_t>(size);
+    if (maxBytes != 0 && maxBytes < toRead) toRead = maxBytes;
+    out.resize(toRead);
+    file.read(reinterpret_cast<char*>(out.data()), static_cast<std::streamsize>(toRead));
+    out.resize(static_cast<size_t>(file.gcount()));
+    return !out.empty();
+}
+
+size_t ArtworkPipeline::CacheEntry::Bytes() const {
+    return BufferBytes(full) + (small != full ? BufferBytes(small) : 0);
+}
+
+size_t ArtworkPipeline::CacheEntry::UniqueBytes() const {
+    size_t bytes = full && full.use_count() == 1 ? BufferBytes(full) : 0;
+    if (small && small != full && small.use_count() == 1) bytes += BufferBytes(small);
+    return bytes;
+}
+
+size_t ArtworkPipeline::CacheEntry::Bookkeeping() const {
+    return sizeof(CacheEntry) + kEntryOverhead + url.capacity();
+}
+
+ArtworkPipeline::ArtworkPipeline(TaskExecutor& executor, ArtworkLoader loader, CommitCallback onFullImage)
+    : _executor(executor), _loader(std::move(loader)), _onFullImage(std::move(onFullImage)) {
+    _reclaimer = MemoryBudget::Shared().AddReclaimer([this](size_t wanted) { return Trim(wanted); });
+}
+
+ArtworkPipeline::~ArtworkPipeline() {
+    MemoryBudget::Shared().RemoveReclaimer(_reclaimer);
+    std::lock_guard<std::mutex> lock(_mutex);
+    while (!_cache.empty()) PopOldestLocked();
+}
+
+ArtworkImage ArtworkPipeline::Begin(uint64_t generation, const std::string& url) {
+    SMTC_SPAN(span, "artwork", "Begin");
+    ArtworkBytes placeholder;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _generation = generation;
+        if (url.empty()) return {};
+
+        if (const CacheEntry* entry = FindLocked(url)) {
+            if (entry->full) return { entry->full, false };
+            placeholder = entry->small;
+        }
+    }
+
+    if (!placeholder && IsLocalArtworkUrl(url)) {
+        SMTC_SPAN(read, "artwork", "read placeholder");
+        std::vector<uint8_t> head;
+        if (_loader(url, kHeadBytes, head)) {
+            placeholder = ExtractSmallVariant(head);
+        }
+    }
+
+    _executor.Submit(TaskPriority::kCurrent, [this, generation, url] { LoadFull(generation, url); });
+    return { placeholder, true };
+}
+
+void ArtworkPipeline::Prefetch(const std::string& url) {
+    if (url.empty()) return;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (HasFullLocked(url)) return;
+    }
+
+    _executor.Submit(TaskPriority::kPrefetch, [this, url] {
+        {
+            // Begin() or an earlier prefetch may have got to it first
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (HasFullLocked(url)) return;
+        }
+        SMTC_SPAN(span, "artwork", "Prefetch");
+        Fetch(url);
+    });
+}
+
+void ArtworkPipeline::LoadFull(uint64_t generation, const std::string& url) {
+    // Skipped tracks are dropped before any I/O happens
+    if (!IsCurrent(generation)) return;
+    SMTC_SPAN(span, "artwork", "LoadFull");
+
+    ArtworkBytes full;
+    {
+        // A prefetch may have finished since Begin()
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (const CacheEntry* entry = FindLocked(url)) full = entry->full;
+    }
+    if (!full) full = Fetch(url);
+    if (!full) return;
+    span.SetArg(static_cast<int64_t>(full->size()));
+
+    if (IsCurrent(generation)) {
+        _onFullImage(generation, { full, false });
+    }
+}
+
+ArtworkBytes ArtworkPipeline::Fetch(const std::string& url) {
+    std::shared_ptr<ArtworkStore> store;
+    uint64_t validator;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        // Local files are read where they are
+        if (!IsLocalArtworkUrl(url)) store = _store;
+        validator = StoreValidator(_decoder != nullptr, _budget);
+    }
+
+    std::vector<uint8_t> bytes;
+    StoredArtwork stored;
+    if (store) {
+        SMTC_SPAN(find, "artwork", "ArtworkStore::Find");
+        stored = store->Find(url, validator);
+    }
+    if (!stored.empty()) {
+        bytes.assign(stored.data, stored.data + stored.size);
+    } else {
+        {
+            SMTC_SPAN(fetch, "artwork", "fetch");
+            if (!_loader(url, 0, bytes) || bytes.empty()) return nullptr;
+            fetch.SetArg(static_cast<int64_t>(bytes.size()));
+        }
+        FitToBudget(bytes);
+        bool put = false;
+        if (store) {
+            SMTC_SPAN(write, "artwork", "ArtworkStore::Put");
+            put = store->Put(url, validator, bytes.data(), bytes.size());
+        }
+        if (put && store->NeedsCompaction()) {
+            _executor.Submit(TaskPriority::kMaintenance, [store] {
+                SMTC_SPAN(compact, "artwork", "ArtworkStore::Compact");
+                // Another task may have got to it first
+                if (store->NeedsCompaction()) store->Compact();
+            });
+        }
+    }
+
+    ArtworkBytes full = MakeArtworkBytes(std::move(bytes));
+    Store(url, full);
+    return full;
+}
+
+void ArtworkPipeline::FitToBudget(std::vector<uint8_t>& bytes) {
+    ArtworkDecoder decoder;
+    ThumbnailBudget budget;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        decoder = _decoder;
+        budget = _budget;
+    }
+    if (!decoder || budget.maxBytes == 0 || bytes.size() <= budget.maxBytes) return;
+    SMTC_SPAN(span, "artwork", "FitToBudget");
+
+    RgbaImage image;
+    {
+        SMTC_SPAN(decode, "artwork", "decode");
+        if (!decoder(bytes, budget.maxEdge, image)) return;
+    }
+    EncodedThumbnail thumbnail;
+    {
+        SMTC_SPAN(encode, "artwork", "encode");
+        // Kept as loaded if re-encoding doesn't make it smaller
+        if (!FitThumbnail(image, budget, &thumbnail) || thumbnail.bytes.size() >= bytes.size()) return;
+    }
+    // Cached for as long as the track may come round; charged by capacity
+    thumbnail.bytes.shrink_to_fit();
+    bytes.swap(thumbnail.bytes);
+}
+
+bool ArtworkPipeline::IsCurrent(uint64_t generation) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _generation == generation;
+}
+
+void ArtworkPipeline::Store(const std::string& url, ArtworkBytes full) {
+    CacheEntry entry{ url, nullptr, full };
+    entry.small = full->size() <= kSmallImageBytes ? full : ExtractSmallVariant(*full);
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto it = _cache.begin(); it != _cache.end(); ++it) {
+            if (it->url == url) {
+                // Moved to the back, where it is popped with its accounting
+                _cache.splice(_cache.end(), _cache, it);
+                PopOldestLocked();
+                break;
+            }
+        }
+        _cacheBytes += entry.Bytes();
+        MemoryBudget::Shared().Charge(MemoryCategory::kCaches, entry.Bookkeeping());
+        _cache.push_front(std::move(entry));
+
+        while (_cache.size() > kCacheEntries ||
+               (_cacheLimit != 0 && _cacheBytes > _cacheLimit && _cache.size() > 1)) {
+            PopOldestLocked();
+        }
+    }
+    // Outside the lock, since the reclaimers include this cache
+    MemoryBudget::Shared().Enforce();
+}
+
+void ArtworkPipeline::SetDecoder(ArtworkDecoder decoder) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _decoder = std::move(decoder);
+}
+
+void ArtworkPipeline::SetThumbnailBudget(const ThumbnailBudget& budget) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _budget = budget;
+}
+
+void ArtworkPipeline::SetStore(std::shared_ptr<ArtworkStore> store) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _store = std::move(store);
+}
+
+void ArtworkPipeline::SetCacheLimit(size_t bytes) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _cacheLimit = bytes;
+    while (_cacheLimit != 0 && _cacheBytes > _cacheLimit && _cache.size() > 1) {
+        PopOldestLocked();
+    }
+}
+
+size_t ArtworkPipeline::Trim(size_t wanted) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    size_t freed = 0;
+    while (freed < wanted && !_cache.empty()) {
+        freed += _cache.back().UniqueBytes() + _cache.back().Bookkeeping();
+        PopOldestLocked();
+    }
+    return freed;
+}
+
+size_t ArtworkPipeline::CacheBytes() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _cacheBytes;
+}
+
+void ArtworkPipeline::PopOldestLocked() {
+    const CacheEntry& oldest = _cache.back();
+    _cacheBytes -= oldest.Bytes();
+    MemoryBudget::Shared().Release(MemoryCategory::kCaches, oldest.Bookkeeping());
+    _cache.pop_back();
+}
+
+const ArtworkPipeline::CacheEntry* ArtworkPipeline::FindLocked(const std::string& url) {
+    for (auto it = _cache.begin(); it != _cache.end(); ++it) {
+        if (it->url == url) {
+            _cache.splice(_cache.begin(), _cache, it);
+            return &_cache.front();
+        }
+    }
+    return nullptr;
+}
+
+bool ArtworkPipeline::HasFullLocked(const std::string& url) const {
+    for (const CacheEntry& entry : _cache) {
+        if (entry.url == url && entry.full) return true;
+    }
+    return false;
+}
+
+}  // namespace audio_service_smtc
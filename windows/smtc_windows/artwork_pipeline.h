@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "artwork_store.h"
+#include "thumbnail_encoder.h"
+#include "worker_pool.h"
+
+namespace audio_service_smtc {
+
+using ArtworkBytes = std::shared_ptr<const std::vector<uint8_t>>;
+
+// Wraps `bytes` for sharing. The buffer is charged to the memory budget for
+// as long as any reference to it lives.
+ArtworkBytes MakeArtworkBytes(std::vector<uint8_t> bytes);
+
+// Reads the artwork behind `url` into `out`. A non-zero `maxBytes` asks for
+// at most that many leading bytes and is only used for local files.
+using ArtworkLoader = std::function<bool(const std::string& url, size_t maxBytes,
+                                         std::vector<uint8_t>& out)>;
+
+// Decodes `bytes` scaled down so neither side exceeds `maxEdge`.
+using ArtworkDecoder = std::function<bool(const std::vector<uint8_t>& bytes, uint32_t maxEdge,
+                                          RgbaImage& out)>;
+
+// Artwork ready to be handed to the backend.
+struct ArtworkImage {
+    ArtworkBytes bytes;
+    // True if a better image is still being loaded for the same track.
+    bool placeholder = false;
+
+    bool empty() const { return !bytes || bytes->empty(); }
+};
+
+// Two-stage artwork loading. Begin() returns whatever can be shown right
+// away (a cached small variant or the EXIF thumbnail of a local file) so it
+// can be committed together with the title; the full image is loaded on the
+// executor and handed to the commit callback if the track is still current.
+// Tasks reference the pipeline, so the executor has to be shut down first.
+//
+// With a decoder set, full images over the thumbnail budget are decoded,
+// scaled down and re-encoded to fit it before they are cached, so each
+// image is encoded once however often its track comes round. With a store
+// set, fetched artwork is kept on disk as it was cached, and found there
+// again before the network is asked; a stored image counts only under the
+// budget it was encoded for.
+//
+// The cache gives up its oldest entries when it grows past its byte limit
+// or the memory budget is exceeded.
+class ArtworkPipeline {
+public:
+    using CommitCallback = std::function<void(uint64_t generation, const ArtworkImage& image)>;
+
+    ArtworkPipeline(TaskExecutor& executor, ArtworkLoader loader, CommitCallback onFullImage);
+    ~ArtworkPipeline();
+
+    ArtworkPipeline(const ArtworkPipeline&) = delete;
+    ArtworkPipeline& operator=(const ArtworkPipeline&) = delete;
+
+    // Starts loading artwork for a new track. Never touches the network.
+    ArtworkImage Begin(uint64_t generation, const std::string& url);
+
+    // Loads the artwork of a track that may play next into the cache, behind
+    // any work for the current track, so Begin() finds it. Commits nothing.
+    void Prefetch(const std::string& url);
+
+    // Without a decoder full images are kept as loaded
+    void SetDecoder(ArtworkDecoder decoder);
+    // Applies to images loaded from now on; cached ones are kept
+    void SetThumbnailBudget(const ThumbnailBudget& budget);
+    // Null for no disk tier. Compaction runs on the executor when due.
+    void SetStore(std::shared_ptr<ArtworkStore> store);
+
+    // Bytes of images the cache may keep; 0 for no limit beyond its entry
+    // count. The newest entry is kept even if it alone is over.
+    void SetCacheLimit(size_t bytes);
+
+    // Drops the oldest entries until about `wanted` bytes are freed. Returns
+    // the bytes actually freed, i.e. of images nobody else was holding.
+    size_t Trim(size_t wanted);
+
+    // Bytes of images held by the cache
+    size_t CacheBytes();
+
+private:
+    struct CacheEntry {
+        std::string url;
+        ArtworkBytes small;
+        ArtworkBytes full;
+
+        size_t Bytes() const;
+        // Bytes that go away with the entry
+        size_t UniqueBytes() const;
+        size_t Bookkeeping() const;
+    };
+
+    void PopOldestLocked();
+
+    void LoadFull(uint64_t generation, const std::string& url);
+    // Loads, fits and caches the full image; null if it can't be loaded
+    ArtworkBytes Fetch(const std::string& url);
+    void FitToBudget(std::vector<uint8_t>& bytes);
+    bool IsCurrent(uint64_t generation);
+    void Store(const std::string& url, ArtworkBytes full);
+    const CacheEntry* FindLocked(const std::string& url);
+    bool HasFullLocked(const std::string& url) const;
+
+    TaskExecutor& _executor;
+    ArtworkLoader _loader;
+    CommitCallback _onFullImage;
+    ArtworkDecoder _decoder;         // Guarded by _mutex, like the budget
+    ThumbnailBudget _budget;         // and the store
+    std::shared_ptr<ArtworkStore> _store;
+
+    std::mutex _mutex;
+    std::list<CacheEntry> _cache;  // Most recently used first
+    size_t _cacheBytes = 0;
+    size_t _cacheLimit = 0;
+    uint64_t _generation = 0;
+    uint64_t _reclaimer = 0;
+};
+
+// True for file:// URLs and plain filesystem paths.
+bool IsLocalArtworkUrl(const std::string& url);
+
+// ArtworkLoader for local files; fails for anything else.
+bool LoadLocalArtwork(const std::string& url, size_t maxBytes, std::vector<uint8_t>& out);
+
+}  // namespace audio_service_smtc
@@ -0,0 +1,766 @@
+#include "artwork_store.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace audio_service_smtc {
+
+namespace fs = std::filesystem;
+
+// A file read and written at explicit offsets, created if missing.
+class StoreFile {
+public:
+    static std::unique_ptr<StoreFile> Open(const fs::path& path) {
+#ifdef _WIN32
+        HANDLE handle = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_ALWAYS,
+                                    FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (handle == INVALID_HANDLE_VALUE) return nullptr;
+#else
+        int handle = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (handle < 0) return nullptr;
+#endif
+        return std::unique_ptr<StoreFile>(new StoreFile(handle));
+    }
+
+    ~StoreFile() {
+#ifdef _WIN32
+        CloseHandle(_handle);
+#else
+        ::close(_handle);
+#endif
+    }
+
+    uint64_t Size() const {
+#ifdef _WIN32
+        LARGE_INTEGER size;
+        return GetFileSizeEx(_handle, &size) ? static_cast<uint64_t>(size.QuadPart) : 0;
+#else
+        struct stat info;
+        return fstat(_handle, &info) == 0 ? static_cast<uint64_t>(info.st_size) : 0;
+#endif
+    }
+
+    bool WriteAt(uint64_t offset, const void* data, size_t size) {
+        const char* bytes = static_cast<const char*>(data);
+        while (size > 0) {
+#ifdef _WIN32
+            OVERLAPPED at = {};
+            at.Offset = static_cast<DWORD>(offset);
+            at.OffsetHigh = static_cast<DWORD>(offset >> 32);
+            DWORD chunk = static_cast<DWORD>(std::min<size_t>(size, 1u << 30));
+            DWORD written = 0;
+            if (!WriteFile(_handle, bytes, chunk, &written, &at) || written == 0) return false;
+#else
+            ssize_t written = ::pwrite(_handle, bytes, size, static_cast<off_t>(offset));
+            if (written <= 0) return false;
+#endif
+            bytes += written;
+            offset += static_cast<uint64_t>(written);
+            size -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    bool Resize(uint64_t size) {
+#ifdef _WIN32
+        FILE_END_OF_FILE_INFO end;
+        end.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+        return SetFileInformationByHandle(_handle, FileEndOfFileInfo, &end, sizeof(end)) != 0;
+#else
+        return ::ftruncate(_handle, static_cast<off_t>(size)) == 0;
+#endif
+    }
+
+    bool Sync() {
+#ifdef _WIN32
+        return FlushFileBuffers(_handle) != 0;
+#else
+        return ::fsync(_handle) == 0;
+#endif
+    }
+
+private:
+    friend class FileMapping;
+
+#ifdef _WIN32
+    explicit StoreFile(HANDLE handle) : _handle(handle) {}
+    HANDLE _handle;
+#else
+    explicit StoreFile(int handle) : _handle(handle) {}
+    int _handle;
+#endif
+};
+
+// A view of the first `size` bytes of a file. The pack is mapped read-only
+// and remapped as it grows; the index is mapped writable.
+class FileMapping {
+public:
+    static std::shared_ptr<FileMapping> Map(const StoreFile& file, uint64_t size, bool writable) {
+        if (size == 0 || size > SIZE_MAX) return nullptr;
+#ifdef _WIN32
+        HANDLE section = CreateFileMappingW(file._handle, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY,
+                                            static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), nullptr);
+        if (!section) return nullptr;
+        void* data = MapViewOfFile(section, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0,
+                                   static_cast<SIZE_T>(size));
+        // The view keeps the section alive
+        CloseHandle(section);
+        if (!data) return nullptr;
+#else
+        void* data = ::mmap(nullptr, static_cast<size_t>(size), writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                            MAP_SHARED, file._handle, 0);
+        if (data == MAP_FAILED) return nullptr;
+        // Lookups land anywhere; reading ahead around a fault only evicts
+        // other records. Prefetch() asks for the one that is wanted.
+        ::madvise(data, static_cast<size_t>(size), MADV_RANDOM);
+#endif
+        return std::shared_ptr<FileMapping>(new FileMapping(static_cast<uint8_t*>(data), static_cast<size_t>(size)));
+    }
+
+    ~FileMapping() {
+#ifdef _WIN32
+        UnmapViewOfFile(_data);
+#else
+        ::munmap(_data, _size);
+#endif
+    }
+
+    uint8_t* data() const { return _data; }
+    size_t size() const { return _size; }
+
+    // Starts reading the pages of a range in one request, rather than one
+    // page fault at a time
+    void Prefetch(uint64_t offset, uint64_t size) const {
+        uintptr_t begin = reinterpret_cast<uintptr_t>(_data + offset) & ~uintptr_t{ 4095 };
+        uintptr_t end = reinterpret_cast<uintptr_t>(_data + offset + size);
+#ifdef _WIN32
+        WIN32_MEMORY_RANGE_ENTRY range{ reinterpret_cast<void*>(begin), static_cast<SIZE_T>(end - begin) };
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+        ::madvise(reinterpret_cast<void*>(begin), end - begin, MADV_WILLNEED);
+#endif
+    }
+
+private:
+    FileMapping(uint8_t* data, size_t size) : _data(data), _size(size) {}
+
+    uint8_t* _data;
+    size_t _size;
+};
+
+namespace {
+
+constexpr uint32_t kPackMagic = 0x4B504153;    // "SAPK"
+constexpr uint32_t kIndexMagic = 0x58494153;   // "SAIX"
+constexpr uint32_t kRecordMagic = 0x43524153;  // "SARC"
+constexpr uint32_t kVersion = 1;
+constexpr uint64_t kMinCapacity = 1024;        // power of two
+constexpr uint32_t kMaxKeyBytes = 8 * 1024;
+constexpr uint32_t kMaxPayloadBytes = 256 * 1024 * 1024;
+
+// Files are in native byte order; the plugin only runs on little-endian
+// machines, and a store from elsewhere fails its magic and is rebuilt.
+struct PackHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t generation;
+    uint64_t reserved[2];
+};
+
+struct RecordHeader {
+    uint32_t magic;
+    uint32_t keyLength;
+    uint32_t payloadLength;
+    uint32_t headerCheck;  // of this header with the field zeroed
+    uint64_t keyHash;
+    uint64_t validator;
+    uint64_t checksum;     // of the payload, seeded with keyHash
+};
+
+static_assert(sizeof(PackHeader) == 32, "pack header layout");
+static_assert(sizeof(RecordHeader) == 40, "record header layout");
+
+uint64_t Align8(uint64_t value) { return (value + 7) & ~uint64_t{ 7 }; }
+
+uint64_t RecordBytes(uint32_t keyLength, uint32_t payloadLength) {
+    return Align8(sizeof(RecordHeader) + uint64_t{ keyLength } + payloadLength);
+}
+
+uint32_t HeaderCheck(RecordHeader header) {
+    header.headerCheck = 0;
+    return static_cast<uint32_t>(HashBytes(&header, sizeof(header)));
+}
+
+// Never 0, which marks an empty slot
+uint64_t KeyHash(const std::string& key) {
+    uint64_t hash = HashBytes(key.data(), key.size());
+    return hash != 0 ? hash : 1;
+}
+
+uint64_t NextPowerOfTwo(uint64_t value) {
+    uint64_t power = kMinCapacity;
+    while (power < value) power <<= 1;
+    return power;
+}
+
+std::string GenerationName(uint64_t generation, const char* extension) {
+    return "artwork-" + std::to_string(generation) + extension;
+}
+
+// Checks the record at `offset` of `map`, which ends at `end`; on success
+// fills `header` and returns the record's size, else 0.
+uint64_t ReadRecord(const FileMapping& map, uint64_t offset, uint64_t end, RecordHeader* header) {
+    if (offset + sizeof(RecordHeader) > end || end > map.size()) return 0;
+    std::memcpy(header, map.data() + offset, sizeof(RecordHeader));
+    if (header->magic != kRecordMagic || header->headerCheck != HeaderCheck(*header)) return 0;
+    if (header->keyLength > kMaxKeyBytes || header->payloadLength > kMaxPayloadBytes) return 0;
+    uint64_t bytes = RecordBytes(header->keyLength, header->payloadLength);
+    if (offset + bytes > end) return 0;
+    const uint8_t* payload = map.data() + offset + sizeof(RecordHeader) + header->keyLength;
+    if (HashBytes(payload, header->payloadLength, header->keyHash) != header->checksum) return 0;
+    return bytes;
+}
+
+bool WritePointer(const fs::path& directory, uint64_t generation) {
+    fs::path temporary = directory / "artwork.current.tmp";
+    std::string text = std::to_string(generation) + "\n";
+    {
+        std::unique_ptr<StoreFile> file = StoreFile::Open(temporary);
+        if (!file || !file->Resize(0) || !file->WriteAt(0, text.data(), text.size()) || !file->Sync()) return false;
+    }
+    std::error_code error;
+    fs::rename(temporary, directory / "artwork.current", error);
+    return !error;
+}
+
+uint64_t ReadPointer(const fs::path& directory) {
+    std::ifstream file(directory / "artwork.current");
+    uint64_t generation = 0;
+    if (!(file >> generation)) return 0;
+    return generation;
+}
+
+// xxHash64 primes
+constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+constexpr uint64_t kPrime3 = 0x165667B19E3779F9ull;
+constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ull;
+constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ull;
+
+uint64_t Rotl(uint64_t value, int bits) { return (value << bits) | (value >> (64 - bits)); }
+
+uint64_t Read64(const uint8_t* p) {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+uint32_t Read32(const uint8_t* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+uint64_t Round(uint64_t acc, uint64_t input) {
+    acc += input * kPrime2;
+    return Rotl(acc, 31) * kPrime1;
+}
+
+uint64_t Merge(uint64_t acc, uint64_t lane) {
+    acc ^= Round(0, lane);
+    return acc * kPrime1 + kPrime4;
+}
+
+}  // namespace
+
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    const uint8_t* end = p + size;
+    uint64_t hash;
+    if (size >= 32) {
+        uint64_t v1 = seed + kPrime1 + kPrime2;
+        uint64_t v2 = seed + kPrime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - kPrime1;
+        for (; p + 32 <= end; p += 32) {
+            v1 = Round(v1, Read64(p));
+            v2 = Round(v2, Read64(p + 8));
+            v3 = Round(v3, Read64(p + 16));
+            v4 = Round(v4, Read64(p + 24));
+        }
+        hash = Rotl(v1, 1) + Rotl(v2, 7) + Rotl(v3, 12) + Rotl(v4, 18);
+        hash = Merge(hash, v1);
+        hash = Merge(hash, v2);
+        hash = Merge(hash, v3);
+        hash = Merge(hash, v4);
+    } else {
+        hash = seed + kPrime5;
+    }
+    hash += size;
+
+    for (; p + 8 <= end; p += 8) {
+        hash ^= Round(0, Read64(p));
+        hash = Rotl(hash, 27) * kPrime1 + kPrime4;
+    }
+    if (p + 4 <= end) {
+        hash ^= Read32(p) * kPrime1;
+        hash = Rotl(hash, 23) * kPrime2 + kPrime3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        hash ^= *p * kPrime5;
+        hash = Rotl(hash, 11) * kPrime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= kPrime2;
+    hash ^= hash >> 29;
+    hash *= kPrime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+struct ArtworkStore::IndexHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t generation;
+    uint64_t capacity;    // slots, a power of two
+    uint64_t count;
+    uint64_t packBytes;   // of the pack, covered by the index
+    uint64_t liveBytes;   // records the index points at
+    uint32_t clean;       // 0 while being rebuilt
+    uint32_t useClock;
+    uint64_t reserved;
+};
+
+struct ArtworkStore::Slot {
+    uint64_t keyHash;     // 0 if empty
+    uint64_t offset;
+    uint64_t validator;
+    uint32_t recordBytes;
+    uint32_t lastUse;
+};
+
+ArtworkStore::ArtworkStore(std::string directory, Options options)
+    : _directory(std::move(directory)), _options(options) {
+    static_assert(sizeof(IndexHeader) == 64, "index header layout");
+    static_assert(sizeof(Slot) == 32, "index slot layout");
+}
+
+ArtworkStore::~ArtworkStore() = default;
+
+std::unique_ptr<ArtworkStore> ArtworkStore::Open(const std::string& directory, Options options) {
+    std::error_code error;
+    fs::create_directories(fs::u8path(directory), error);
+    if (error) return nullptr;
+
+    std::unique_ptr<ArtworkStore> store(new ArtworkStore(directory, options));
+    uint64_t generation = ReadPointer(fs::u8path(directory));
+    if (generation == 0) {
+        generation = 1;
+        if (!WritePointer(fs::u8path(directory), generation)) return nullptr;
+    }
+    {
+        std::lock_guard<std::mutex> lock(store->_mutex);
+        if (!store->OpenGeneration(generation)) return nullptr;
+    }
+    store->RemoveStaleFiles();
+    return store;
+}
+
+bool ArtworkStore::OpenGeneration(uint64_t generation) {
+    fs::path directory = fs::u8path(_directory);
+    _pack = StoreFile::Open(directory / GenerationName(generation, ".pack"));
+    _index = StoreFile::Open(directory / GenerationName(generation, ".idx"));
+    if (!_pack || !_index) return false;
+    _generation = generation;
+
+    PackHeader pack = {};
+    _packEnd = _pack->Size();
+    if (_packEnd >= sizeof(PackHeader)) {
+        auto head = FileMapping::Map(*_pack, sizeof(PackHeader), false);
+        if (head) std::memcpy(&pack, head->data(), sizeof(pack));
+    }
+    if (pack.magic != kPackMagic || pack.version != kVersion || pack.generation != generation) {
+        // New, or not ours: start over
+        pack = PackHeader{ kPackMagic, kVersion, generation, { 0, 0 } };
+        if (!_pack->Resize(0) || !_pack->WriteAt(0, &pack, sizeof(pack))) return false;
+        _packEnd = sizeof(PackHeader);
+    }
+    if (!RemapPackLocked(_packEnd)) return false;
+
+    IndexHeader index = {};
+    uint64_t indexSize = _index->Size();
+    if (indexSize >= sizeof(IndexHeader)) {
+        auto head = FileMapping::Map(*_index, sizeof(IndexHeader), false);
+        if (head) std::memcpy(&index, head->data(), sizeof(index));
+    }
+    bool usable = index.magic == kIndexMagic && index.version == kVersion && index.generation == generation &&
+                  index.clean == 1 && index.capacity >= kMinCapacity &&
+                  (index.capacity & (index.capacity - 1)) == 0 &&
+                  indexSize == sizeof(IndexHeader) + index.capacity * sizeof(Slot) &&
+                  index.packBytes >= sizeof(PackHeader) && index.packBytes <= _packEnd;
+    if (usable && MapIndexLocked(index.capacity)) {
+        // Records appended after the index was last updated
+        bool torn = false;
+        uint64_t end = ScanLocked(Header()->packBytes, &torn);
+        if (!torn) {
+            Header()->packBytes = end;
+            return true;
+        }
+    }
+    return RebuildIndexLocked(kMinCapacity);
+}
+
+bool ArtworkStore::MapIndexLocked(uint64_t capacity) {
+    _indexMap = FileMapping::Map(*_index, sizeof(IndexHeader) + capacity * sizeof(Slot), true);
+    return _indexMap != nullptr;
+}
+
+bool ArtworkStore::RebuildIndexLocked(uint64_t capacity) {
+    // Nothing else maps the index, so it can be resized under the lock
+    _indexMap.reset();
+    if (!_index->Resize(0) || !_index->Resize(sizeof(IndexHeader) + capacity * sizeof(Slot))) return false;
+    if (!MapIndexLocked(capacity)) return false;
+
+    IndexHeader* header = Header();
+    *header = IndexHeader{ kIndexMagic, kVersion, _generation, capacity, 0, sizeof(PackHeader), 0, 0, 0, 0 };
+    _stats.recoveredRecords = 0;
+    bool torn = false;
+    uint64_t end = ScanLocked(sizeof(PackHeader), &torn);
+    if (torn) {
+        // A torn append; what follows it can't be trusted either
+        _stats.droppedBytes += _packEnd - end;
+        _packMap.reset();
+        if (!_pack->Resize(end) || !RemapPackLocked(end)) return false;
+        _packEnd = end;
+    }
+    header = Header();
+    header->packBytes = end;
+    header->clean = 1;
+    return true;
+}
+
+uint64_t ArtworkStore::ScanLocked(uint64_t from, bool* torn) {
+    uint64_t offset = from;
+    RecordHeader record;
+    while (offset < _packEnd) {
+        uint64_t bytes = ReadRecord(*_packMap, offset, _packEnd, &record);
+        if (bytes == 0) {
+            *torn = true;
+            return offset;
+        }
+        if (!IndexRecordLocked(offset, record.keyHash, record.validator, static_cast<uint32_t>(bytes))) {
+            *torn = true;
+            return offset;
+        }
+        ++_stats.recoveredRecords;
+        offset += bytes;
+    }
+    return offset;
+}
+
+bool ArtworkStore::IndexRecordLocked(uint64_t offset, uint64_t keyHash, uint64_t validator, uint32_t recordBytes) {
+    IndexHeader* header = Header();
+    if ((header->count + 1) * 4 > header->capacity * 3) {
+        if (!GrowIndexLocked()) return false;
+        header = Header();
+    }
+
+    Slot* slot = FindSlotLocked(keyHash);
+    if (slot) {
+        header->liveBytes -= slot->recordBytes;
+    } else {
+        uint64_t mask = header->capacity - 1;
+        Slot* slots = Slots();
+        uint64_t i = keyHash & mask;
+        while (slots[i].keyHash != 0) i = (i + 1) & mask;
+        slot = &slots[i];
+        ++header->count;
+    }
+    *slot = Slot{ keyHash, offset, validator, recordBytes, ++header->useClock };
+    header->liveBytes += recordBytes;
+    return true;
+}
+
+bool ArtworkStore::GrowIndexLocked() {
+    IndexHeader saved = *Header();
+    std::vector<Slot> live;
+    live.reserve(static_cast<size_t>(saved.count));
+    for (uint64_t i = 0; i < saved.capacity; ++i) {
+        if (Slots()[i].keyHash != 0) live.push_back(Slots()[i]);
+    }
+
+    // A crash from here on leaves an index that is rebuilt on open
+    Header()->clean = 0;
+    uint64_t capacity = saved.capacity * 2;
+    _indexMap.reset();
+    if (!_index->Resize(sizeof(IndexHeader) + capacity * sizeof(Slot)) || !MapIndexLocked(capacity)) {
+        // Keep working with the old table; it is still in the file
+        if (!MapIndexLocked(saved.capacity)) return false;
+        Header()->clean = saved.clean;
+        return false;
+    }
+
+    IndexHeader* header = Header();
+    *header = saved;
+    header->capacity = capacity;
+    header->clean = 0;
+    uint64_t mask = capacity - 1;
+    Slot* slots = Slots();
+    std::memset(slots, 0, static_cast<size_t>(capacity * sizeof(Slot)));
+    for (const Slot& slot : live) {
+        uint64_t i = slot.keyHash & mask;
+        while (slots[i].keyHash != 0) i = (i + 1) & mask;
+        slots[i] = slot;
+    }
+    // Still 0 if a rebuild is growing it
+    header->clean = saved.clean;
+    return true;
+}
+
+bool ArtworkStore::RemapPackLocked(uint64_t size) {
+    // Views handed out keep the old mapping
+    std::shared_ptr<FileMapping> map = FileMapping::Map(*_pack, size, false);
+    if (!map) return false;
+    _packMap = std::move(map);
+    return true;
+}
+
+ArtworkStore::Slot* ArtworkStore::FindSlotLocked(uint64_t keyHash) {
+    uint64_t mask = Header()->capacity - 1;
+    Slot* slots = Slots();
+    for (uint64_t i = keyHash & mask;; i = (i + 1) & mask) {
+        if (slots[i].keyHash == keyHash) return &slots[i];
+        if (slots[i].keyHash == 0) return nullptr;
+    }
+}
+
+ArtworkStore::Slot* ArtworkStore::Slots() {
+    return reinterpret_cast<Slot*>(_indexMap->data() + sizeof(IndexHeader));
+}
+
+ArtworkStore::IndexHeader* ArtworkStore::Header() {
+    return reinterpret_cast<IndexHeader*>(_indexMap->data());
+}
+
+StoredArtwork ArtworkStore::Find(const std::string& key, uint64_t validator) {
+    uint64_t keyHash = KeyHash(key);
+    std::shared_ptr<FileMapping> map;
+    uint64_t offset = 0;
+    uint64_t end = 0;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        Slot* slot = _indexMap ? FindSlotLocked(keyHash) : nullptr;
+        if (!slot || slot->validator != validator || slot->offset + slot->recordBytes > _packEnd) {
+            ++_stats.misses;
+            return {};
+        }
+        offset = slot->offset;
+        end = offset + slot->recordBytes;
+        if (end > _packMap->size() && !RemapPackLocked(_packEnd)) {
+            ++_stats.misses;
+            return {};
+        }
+        slot->lastUse = ++Header()->useClock;
+        map = _packMap;
+    }
+
+    // Checked outside the lock; the mapping can't change under us
+    map->Prefetch(offset, end - offset);
+    RecordHeader record;
+    bool valid = ReadRecord(*map, offset, end, &record) != 0 && record.keyHash == keyHash &&
+                 record.validator == validator && record.keyLength == key.size() &&
+                 std::memcmp(map->data() + offset + sizeof(RecordHeader), key.data(), key.size()) == 0;
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!valid) {
+        ++_stats.misses;
+        return {};
+    }
+    ++_stats.hits;
+    const uint8_t* payload = map->data() + offset + sizeof(RecordHeader) + record.keyLength;
+    return { std::move(map), payload, record.payloadLength };
+}
+
+bool ArtworkStore::Put(const std::string& key, uint64_t validator, const uint8_t* data, size_t size) {
+    if (key.size() > kMaxKeyBytes || size > kMaxPayloadBytes) return false;
+    uint64_t recordBytes = RecordBytes(static_cast<uint32_t>(key.size()), static_cast<uint32_t>(size));
+    if (_options.maxBytes != 0 && recordBytes > _options.maxBytes) return false;
+
+    RecordHeader header = {};
+    header.magic = kRecordMagic;
+    header.keyLength = static_cast<uint32_t>(key.size());
+    header.payloadLength = static_cast<uint32_t>(size);
+    header.keyHash = KeyHash(key);
+    header.validator = validator;
+    header.checksum = HashBytes(data, size, header.keyHash);
+    header.headerCheck = HeaderCheck(header);
+
+    std::vector<uint8_t> record(static_cast<size_t>(recordBytes), 0);
+    std::memcpy(record.data(), &header, sizeof(header));
+    std::memcpy(record.data() + sizeof(header), key.data(), key.size());
+    if (size != 0) std::memcpy(record.data() + sizeof(header) + key.size(), data, size);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_indexMap) return false;
+    // The record is complete on disk before the index points at it
+    uint64_t offset = _packEnd;
+    if (!_pack->WriteAt(offset, record.data(), record.size())) return false;
+    if (_options.syncAppends && !_pack->Sync()) return false;
+    _packEnd += recordBytes;
+    if (!IndexRecordLocked(offset, header.keyHash, validator, static_cast<uint32_t>(recordBytes))) return false;
+    Header()->packBytes = _packEnd;
+    ++_stats.appends;
+    return true;
+}
+
+bool ArtworkStore::NeedsCompaction() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_indexMap) return false;
+    uint64_t records = _packEnd - sizeof(PackHeader);
+    uint64_t dead = records - Header()->liveBytes;
+    if (_options.maxBytes != 0 && records > _options.maxBytes) return true;
+    return records >= _options.compactMinBytes && dead >= records * _options.compactDeadFraction;
+}
+
+bool ArtworkStore::Compact() {
+    std::lock_guard<std::mutex> compact(_compactMutex);
+
+    // What to keep: the most recently used records, up to three quarters of
+    // the limit so the next compaction isn't due right away
+    std::vector<Slot> keep;
+    std::shared_ptr<FileMapping> oldMap;
+    uint64_t copiedUpTo;
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_indexMap || (_packMap->size() < _packEnd && !RemapPackLocked(_packEnd))) return false;
+        oldMap = _packMap;
+        copiedUpTo = _packEnd;
+        generation = _generation + 1;
+        IndexHeader* header = Header();
+        keep.reserve(static_cast<size_t>(header->count));
+        for (uint64_t i = 0; i < header->capacity; ++i) {
+            if (Slots()[i].keyHash != 0) keep.push_back(Slots()[i]);
+        }
+    }
+    std::sort(keep.begin(), keep.end(), [](const Slot& a, const Slot& b) { return a.lastUse > b.lastUse; });
+    if (_options.maxBytes != 0) {
+        uint64_t total = 0;
+        size_t count = 0;
+        while (count < keep.size() && total + keep[count].recordBytes <= _options.maxBytes / 4 * 3) {
+            total += keep[count++].recordBytes;
+        }
+        keep.resize(count);
+    }
+
+    // Written without the lock: the old pack below copiedUpTo never changes
+    fs::path directory = fs::u8path(_directory);
+    std::unique_ptr<StoreFile> pack = StoreFile::Open(directory / GenerationName(generation, ".pack"));
+    std::unique_ptr<StoreFile> index = StoreFile::Open(directory / GenerationName(generation, ".idx"));
+    if (!pack || !index || !pack->Resize(0) || !index->Resize(0)) return false;
+
+    PackHeader packHeader{ kPackMagic, kVersion, generation, { 0, 0 } };
+    if (!pack->WriteAt(0, &packHeader, sizeof(packHeader))) return false;
+    uint64_t capacity = NextPowerOfTwo(keep.size() * 2);
+    std::vector<Slot> slots(static_cast<size_t>(capacity), Slot{});
+    IndexHeader indexHeader{ kIndexMagic, kVersion, generation, capacity, 0, sizeof(PackHeader), 0, 1, 0, 0 };
+    // Oldest first, so use order survives
+    for (auto it = keep.rbegin(); it != keep.rend(); ++it) {
+        RecordHeader record;
+        if (ReadRecord(*oldMap, it->offset, copiedUpTo, &record) != it->recordBytes) continue;
+        if (!pack->WriteAt(indexHeader.packBytes, oldMap->data() + it->offset, it->recordBytes)) return false;
+
+        uint64_t i = it->keyHash & (capacity - 1);
+        while (slots[i].keyHash != 0) i = (i + 1) & (capacity - 1);
+        slots[i] = Slot{ it->keyHash, indexHeader.packBytes, it->validator, it->recordBytes, ++indexHeader.useClock };
+        indexHeader.packBytes += it->recordBytes;
+        indexHeader.liveBytes += it->recordBytes;
+        ++indexHeader.count;
+    }
+    if (!index->WriteAt(0, &indexHeader, sizeof(indexHeader)) ||
+        !index->WriteAt(sizeof(indexHeader), slots.data(), slots.size() * sizeof(Slot)) || !pack->Sync() ||
+        !index->Sync()) {
+        return false;
+    }
+    std::shared_ptr<FileMapping> packMap = FileMapping::Map(*pack, indexHeader.packBytes, false);
+    std::shared_ptr<FileMapping> indexMap =
+        FileMapping::Map(*index, sizeof(IndexHeader) + capacity * sizeof(Slot), true);
+    if (!packMap || !indexMap) return false;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!WritePointer(directory, generation)) return false;
+
+    uint64_t oldGeneration = _generation;
+    uint64_t oldEnd = _packEnd;
+    std::unique_ptr<StoreFile> oldPack = std::move(_pack);
+    _pack = std::move(pack);
+    _index = std::move(index);
+    _packMap = std::move(packMap);
+    _indexMap = std::move(indexMap);
+    _generation = generation;
+    _packEnd = indexHeader.packBytes;
+
+    // Appended while the copy ran; a lost one is only a miss
+    std::shared_ptr<FileMapping> tail = oldEnd > copiedUpTo ? FileMapping::Map(*oldPack, oldEnd, false) : nullptr;
+    RecordHeader record;
+    for (uint64_t offset = copiedUpTo; tail && offset < oldEnd;) {
+        uint64_t bytes = ReadRecord(*tail, offset, oldEnd, &record);
+        uint64_t at = _packEnd;
+        if (bytes == 0 || !_pack->WriteAt(at, tail->data() + offset, static_cast<size_t>(bytes))) break;
+        _packEnd += bytes;
+        if (!IndexRecordLocked(at, record.keyHash, record.validator, static_cast<uint32_t>(bytes))) break;
+        Header()->packBytes = _packEnd;
+        offset += bytes;
+    }
+    tail.reset();
+    oldPack.reset();
+    ++_stats.compactions;
+
+    // Fails on Windows while views of the old pack are held; Open() retries
+    std::error_code error;
+    fs::remove(directory / GenerationName(oldGeneration, ".pack"), error);
+    fs::remove(directory / GenerationName(oldGeneration, ".idx"), error);
+    return true;
+}
+
+ArtworkStoreStats ArtworkStore::Stats() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    ArtworkStoreStats stats = _stats;
+    if (_indexMap) {
+        stats.entries = Header()->count;
+        stats.liveBytes = Header()->liveBytes;
+    }
+    stats.packBytes = _packEnd;
+    return stats;
+}
+
+void ArtworkStore::RemoveStaleFiles() {
+    std::error_code error;
+    std::string current = "artwork-" + std::to_string(_generation) + ".";
+    for (const fs::directory_entry& entry : fs::directory_iterator(fs::u8path(_directory), error)) {
+        std::string name = entry.path().filename().u8string();
+        bool ours = name.rfind("artwork-", 0) == 0 || name == "artwork.current.tmp";
+        if (ours && name.rfind(current, 0) != 0) {
+            std::error_code ignored;
+            fs::remove(entry.path(), ignored);
+        }
+    }
+}
+
+}  // namespace audio_service_smtc
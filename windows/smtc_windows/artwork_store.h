@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace audio_service_smtc {
+
+class FileMapping;
+class StoreFile;
+
+// Bytes of a stored image, read in place from the mapped pack file. Keeps
+// its mapping alive, so it stays valid across appends and compaction.
+struct StoredArtwork {
+    std::shared_ptr<const FileMapping> mapping;
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+    bool empty() const { return size == 0; }
+};
+
+struct ArtworkStoreStats {
+    uint64_t entries = 0;
+    uint64_t liveBytes = 0;       // records the index points at
+    uint64_t packBytes = 0;       // pack file size, live or not
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t appends = 0;
+    uint64_t compactions = 0;
+    uint64_t recoveredRecords = 0;  // re-indexed from the pack when opening
+    uint64_t droppedBytes = 0;      // torn tail cut off when opening
+};
+
+// Persistent artwork, packed into one append-only file with a memory-mapped
+// hash index beside it, so a lookup is a probe in the index and a read from
+// the mapped pack rather than an open, stat and read of a file per image.
+//
+// Each record in the pack carries its key, a validator chosen by the caller
+// (which encoder settings produced it, say) and a checksum. Appends write the
+// record before the index points at it; on open, records past what the index
+// covers are checked and re-indexed, and a torn tail is cut off. An index
+// that is missing or was left half rewritten is rebuilt from the pack.
+//
+// Replaced and evicted records stay in the pack until Compact() copies the
+// live ones into a new pack of the next generation, most recently used first
+// and up to the size limit, and switches over by renaming a small pointer
+// file. Readers holding StoredArtwork keep the old mapping until they let go.
+class ArtworkStore {
+public:
+    struct Options {
+        // Live bytes compaction keeps; 0 for no limit
+        uint64_t maxBytes = 64ull * 1024 * 1024;
+        // Compaction is due once this much of the pack is dead...
+        double compactDeadFraction = 0.5;
+        // ...and it is at least this large
+        uint64_t compactMinBytes = 1024 * 1024;
+        // fsync the pack after every append; compaction always syncs
+        bool syncAppends = false;
+    };
+
+    // Opens or creates the store in `directory`. Returns null if the
+    // directory or its files can't be used; a damaged index is rebuilt.
+    static std::unique_ptr<ArtworkStore> Open(const std::string& directory, Options options);
+    static std::unique_ptr<ArtworkStore> Open(const std::string& directory) { return Open(directory, Options{}); }
+    ~ArtworkStore();
+
+    ArtworkStore(const ArtworkStore&) = delete;
+    ArtworkStore& operator=(const ArtworkStore&) = delete;
+
+    // The image stored for `key`, if it was stored with `validator` and
+    // its checksum still holds; empty otherwise.
+    StoredArtwork Find(const std::string& key, uint64_t validator);
+
+    // Appends `bytes` under `key`, replacing what was there. False if the
+    // write failed or the image is too large to store.
+    bool Put(const std::string& key, uint64_t validator, const uint8_t* data, size_t size);
+
+    // True once enough of the pack is dead or it has grown past the limit.
+    bool NeedsCompaction();
+
+    // Rewrites the live records into a new pack. Appends and lookups carry
+    // on meanwhile; only the final switch holds the lock.
+    bool Compact();
+
+    ArtworkStoreStats Stats();
+
+private:
+    struct Slot;
+    struct IndexHeader;
+
+    ArtworkStore(std::string directory, Options options);
+
+    bool OpenGeneration(uint64_t generation);
+    bool MapIndexLocked(uint64_t capacity);
+    bool RebuildIndexLocked(uint64_t capacity);
+    uint64_t ScanLocked(uint64_t from, bool* torn);
+    bool IndexRecordLocked(uint64_t offset, uint64_t keyHash, uint64_t validator, uint32_t recordBytes);
+    bool GrowIndexLocked();
+    bool RemapPackLocked(uint64_t size);
+    Slot* FindSlotLocked(uint64_t keyHash);
+    Slot* Slots();
+    IndexHeader* Header();
+    void RemoveStaleFiles();
+
+    std::string _directory;
+    Options _options;
+
+    std::mutex _mutex;
+    uint64_t _generation = 0;
+    std::unique_ptr<StoreFile> _pack;
+    std::unique_ptr<StoreFile> _index;
+    std::shared_ptr<FileMapping> _packMap;
+    std::shared_ptr<FileMapping> _indexMap;
+    uint64_t _packEnd = 0;           // where the next record goes
+    ArtworkStoreStats _stats;
+
+    std::mutex _compactMutex;        // one compaction at a time
+};
+
+// 64-bit xxHash of `size` bytes, used for keys and checksums.
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0);
+
+}  // namespace audio_service_smtc
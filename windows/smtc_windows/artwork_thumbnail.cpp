@@ -0,0 +1,134 @@
+#include "artwork_thumbnail.h"
+
+namespace audio_service_smtc {
+
+namespace {
+
+constexpr uint16_t kTagThumbnailOffset = 0x0201;
+constexpr uint16_t kTagThumbnailLength = 0x0202;
+
+// Bounds-checked reader for a TIFF block of either byte order.
+class TiffReader {
+public:
+    TiffReader(const uint8_t* data, size_t size, bool littleEndian)
+        : _data(data), _size(size), _littleEndian(littleEndian) {}
+
+    bool Read16(size_t pos, uint16_t* value) const {
+        if (pos + 2 > _size) return false;
+        *value = _littleEndian
+            ? static_cast<uint16_t>(_data[pos] | (_data[pos + 1] << 8))
+            : static_cast<uint16_t>((_data[pos] << 8) | _data[pos + 1]);
+        return true;
+    }
+
+    bool Read32(size_t pos, uint32_t* value) const {
+        uint16_t a, b;
+        if (!Read16(pos, &a) || !Read16(pos + 2, &b)) return false;
+        *value = _littleEndian ? (static_cast<uint32_t>(b) << 16) | a
+                               : (static_cast<uint32_t>(a) << 16) | b;
+        return true;
+    }
+
+private:
+    const uint8_t* _data;
+    size_t _size;
+    bool _littleEndian;
+};
+
+bool FindThumbnailInTiff(const uint8_t* tiff, size_t size,
+                         size_t* offset, size_t* length) {
+    if (size < 8) return false;
+
+    bool littleEndian;
+    if (tiff[0] == 'I' && tiff[1] == 'I') {
+        littleEndian = true;
+    } else if (tiff[0] == 'M' && tiff[1] == 'M') {
+        littleEndian = false;
+    } else {
+        return false;
+    }
+
+    TiffReader reader(tiff, size, littleEndian);
+    uint16_t magic;
+    uint32_t ifd0;
+    if (!reader.Read16(2, &magic) || magic != 42) return false;
+    if (!reader.Read32(4, &ifd0)) return false;
+
+    // IFD1 (the thumbnail directory) follows the entries of IFD0.
+    uint16_t count;
+    if (!reader.Read16(ifd0, &count)) return false;
+    uint32_t ifd1;
+    if (!reader.Read32(ifd0 + 2 + static_cast<size_t>(count) * 12, &ifd1) || ifd1 == 0) {
+        return false;
+    }
+    if (!reader.Read16(ifd1, &count)) return false;
+
+    uint32_t thumbOffset = 0;
+    uint32_t thumbLength = 0;
+    for (uint16_t i = 0; i < count; ++i) {
+        size_t entry = ifd1 + 2 + static_cast<size_t>(i) * 12;
+        uint16_t tag;
+        if (!reader.Read16(entry, &tag)) return false;
+        if (tag == kTagThumbnailOffset) {
+            reader.Read32(entry + 8, &thumbOffset);
+        } else if (tag == kTagThumbnailLength) {
+            reader.Read32(entry + 8, &thumbLength);
+        }
+    }
+
+    if (thumbOffset == 0 || thumbLength < 4) return false;
+    if (static_cast<size_t>(thumbOffset) + thumbLength > size) return false;
+    if (tiff[thumbOffset] != 0xFF || tiff[thumbOffset + 1] != 0xD8) return false;
+
+    *offset = thumbOffset;
+    *length = thumbLength;
+    return true;
+}
+
+}  // namespace
+
+bool FindExifThumbnail(const uint8_t* data, size_t size,
+                       size_t* offset, size_t* length) {
+    if (!data || size < 4 || data[0] != 0xFF || data[1] != 0xD8) return false;
+
+    size_t pos = 2;
+    while (pos + 4 <= size) {
+        if (data[pos] != 0xFF) return false;
+        uint8_t marker = data[pos + 1];
+        if (marker == 0xFF) {
+            ++pos;  // Fill byte
+            continue;
+        }
+        // Start of scan or end of image: no more metadata segments.
+        if (marker == 0xDA || marker == 0xD9) return false;
+
+        size_t segmentLength = (static_cast<size_t>(data[pos + 2]) << 8) | data[pos + 3];
+        if (segmentLength < 2) return false;
+        size_t payload = pos + 4;
+        size_t payloadSize = segmentLength - 2;
+
+        static const uint8_t kExifHeader[] = { 'E', 'x', 'i', 'f', 0, 0 };
+        if (marker == 0xE1 && payloadSize > sizeof(kExifHeader) && payload + sizeof(kExifHeader) <= size) {
+            bool isExif = true;
+            for (size_t i = 0; i < sizeof(kExifHeader); ++i) {
+                isExif = isExif && data[payload + i] == kExifHeader[i];
+            }
+            if (isExif) {
+                size_t tiffStart = payload + sizeof(kExifHeader);
+                size_t tiffEnd = payload + payloadSize;
+                if (tiffEnd > size) tiffEnd = size;
+                size_t tiffOffset;
+                if (!FindThumbnailInTiff(data + tiffStart, tiffEnd - tiffStart, &tiffOffset, length)) {
+                    return false;
+                }
+                *offset = tiffStart + tiffOffset;
+                return true;
+            }
+        }
+
+        pos += 2 + segmentLength;
+    }
+    return false;
+}
+
+}  // namespace audio_service_smtc
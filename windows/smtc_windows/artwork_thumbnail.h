@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace audio_service_smtc {
+
+// Locates the JPEG thumbnail embedded in the EXIF block of a JPEG image.
+// Only the first APP1 segment is inspected, so the first 64 KiB of a file
+// are enough. On success `offset`/`length` describe the thumbnail inside
+// `data`; returns false if the image carries no usable thumbnail.
+bool FindExifThumbnail(const uint8_t* data, size_t size,
+                       size_t* offset, size_t* length);
+
+}  // namespace audio_service_smtc
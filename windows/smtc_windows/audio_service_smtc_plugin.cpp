@@ -7,11 +7,45 @@
 #include <flutter/plugin_registrar_windows.h>
 #include <flutter/standard_method_codec.h>
 
+#include <chrono>
 #include <memory>
 #include <sstream>
 
+#include "native_log.h"
+#include "session_trace.h"
+#include "span_tracer.h"
+#include "state_patch_args.h"
+
 namespace audio_service_smtc {
 
+namespace {
+
+// One backend, artwork cache and worker pool per process, shared by every
+// engine that loads the plugin.
+SharedSession<SmtcSession>& SharedSmtc() {
+  static SharedSession<SmtcSession> shared;
+  return shared;
+}
+
+// Set to a file path to record a session trace for trace_replay.
+constexpr char kTraceVariable[] = "AUDIO_SERVICE_SMTC_TRACE";
+
+void StartTraceFromEnvironment() {
+  char path[MAX_PATH];
+  DWORD length = GetEnvironmentVariableA(kTraceVariable, path, MAX_PATH);
+  if (length == 0 || length >= MAX_PATH) return;
+  if (!StartTrace(path)) {
+    SMTC_LOG_WARNING("Could not create session trace", path);
+  }
+}
+
+// Adds the call to the session trace, if one is being recorded.
+void TraceCall(const std::string& method, const PlayerStatePatch* patch) {
+  if (TraceRecorder* trace = ActiveTrace()) trace->RecordCall(method, patch);
+}
+
+}  // namespace
+
 // static
 void AudioServiceSmtcPlugin::RegisterWithRegistrar(
     flutter::PluginRegistrarWindows *registrar) {
@@ -31,102 +65,308 @@ void AudioServiceSmtcPlugin::RegisterWithRegistrar(
 }
 
 AudioServiceSmtcPlugin::AudioServiceSmtcPlugin(flutter::PluginRegistrarWindows *registrar)
-    : registrar_(registrar),
-      smtc_implementation_(std::make_unique<SmtcWindows>()) {}
+    : registrar_(registrar) {
+  event_dispatcher_ = std::make_unique<EventDispatcher>(
+      [this](const NativeEvent& event) { this->SendEvent(event); });
+}
 
-AudioServiceSmtcPlugin::~AudioServiceSmtcPlugin() {}
+AudioServiceSmtcPlugin::~AudioServiceSmtcPlugin() {
+  // The session outlives this engine if others are attached
+  if (SmtcSession* session = driven_session()) {
+    // Also drops the event port Dart may have set through dart:ffi
+    smtc_set_event_port(session, nullptr, 0);
+  }
+  FlushTrace();
+  DumpSpansToEnvironment();
+}
+
+SmtcSession* AudioServiceSmtcPlugin::driven_session() const {
+  return session_ && session_->IsDriver() ? &session_->session() : nullptr;
+}
+
+void AudioServiceSmtcPlugin::OnBecameDriver(SmtcSession& session) {
+  // Events stop going to the port of the engine that drove before
+  smtc_set_event_port(&session, nullptr, 0);
+  session.SetControlCallback(
+    [this](const std::string& command) {
+      if (TraceRecorder* trace = ActiveTrace()) trace->RecordEvent("control", command, 0);
+      // Sent ahead of any position traffic
+      event_dispatcher_->PostControl(command);
+    });
+  session.SetPositionCallback(
+    [this](int64_t position) { OnPositionChange(position); });
+}
+
+void AudioServiceSmtcPlugin::OnPositionChange(int64_t positionInMicroseconds) {
+  if (TraceRecorder* trace = ActiveTrace()) trace->RecordEvent("position", {}, positionInMicroseconds);
+  // Dart is only woken when the mailbox goes from empty to full; it then
+  // drains it one seek at a time, so a scrub collapses to the newest position.
+  if (!position_mailbox_.Post(positionInMicroseconds)) return;
+
+  event_dispatcher_->PostPosition(positionInMicroseconds);
+}
+
+void AudioServiceSmtcPlugin::SendEvent(const NativeEvent& event) {
+  // Only one delivery runs at a time, so the buffer is reused
+  EncodeEventEnvelope(event, &event_buffer_);
+  registrar_->messenger()->Send("audio_service_smtc/events", event_buffer_.data(), event_buffer_.size());
+}
 
 void AudioServiceSmtcPlugin::HandleMethodCall(
     const flutter::MethodCall<flutter::EncodableValue> &method_call,
     std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+  SMTC_SPAN_LABELLED(span, "channel", "HandleMethodCall", method_call.method_name());
+  // Only the driving engine writes state; the others get false back
+  SmtcSession* session = driven_session();
   
   if (method_call.method_name().compare("initialize") == 0) {
+    StartTraceFromEnvironment();
+    SetSpanThreadName("platform");
+    StartSpansFromEnvironment();
+    TraceCall(method_call.method_name(), nullptr);
+
     // Get app identity from arguments if provided
-    std::string identity = "audio_service_smtc";
+    ArgValues<2> args;
+    std::string error;
     const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
-    if (arguments) {
-      auto it = arguments->find(flutter::EncodableValue("identity"));
-      if (it != arguments->end()) {
-        const auto* identity_value = std::get_if<std::string>(&it->second);
-        if (identity_value) {
-          identity = *identity_value;
-        }
-      }
+    if (arguments && !DecodeArgs(*arguments, InitializeArgs::kSchema, &args, &error)) {
+      result->Error("invalid_arguments", error);
+      return;
+    }
+    std::string identity(args.String(InitializeArgs::kIdentity, "audio_service_smtc"));
+    
+    // The first engine to attach creates the session and picks its identity
+    if (!session_) {
+      session_ = SharedSmtc().Attach(
+          [&identity] {
+            return std::shared_ptr<SmtcSession>(
+                smtc_create(identity.data(), identity.size()), smtc_destroy);
+          },
+          [this](SmtcSession& shared) { OnBecameDriver(shared); });
+    }
+    if (!session_) {
+      result->Success(flutter::EncodableValue(false));
+      return;
     }
     
-    bool success = smtc_implementation_->Initialize(identity);
-    result->Success(flutter::EncodableValue(success));
+    int64_t threads = args.Integer(InitializeArgs::kWorkerThreads);
+    SmtcSession* driven = driven_session();
+    if (driven && threads > 0) driven->SetWorkerThreadCount(static_cast<size_t>(threads));
+    // The handle lets Dart call the C ABI directly via dart:ffi. Engines that
+    // do not drive get 0 and stay on the method channel.
+    result->Success(flutter::EncodableValue(reinterpret_cast<int64_t>(driven)));
   } 
   else if (method_call.method_name().compare("updatePlaybackStatus") == 0) {
     const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
-    if (arguments) {
-      auto it = arguments->find(flutter::EncodableValue("status"));
-      if (it != arguments->end() && std::holds_alternative<std::string>(it->second)) {
-        std::string status = std::get<std::string>(it->second);
-        bool success = smtc_implementation_->UpdatePlaybackStatus(status);
-        result->Success(flutter::EncodableValue(success));
-      } else {
-        result->Error("invalid_arguments", "Status argument is required");
-      }
-    } else {
+    ArgValues<1> args;
+    std::string error;
+    if (!arguments) {
       result->Error("invalid_arguments", "Arguments required");
+    } else if (!DecodeArgs(*arguments, StatusArgs::kSchema, &args, &error)) {
+      result->Error("invalid_arguments", error);
+    } else {
+      PlayerStatePatch patch;
+      patch.status = ParsePlaybackState(args.String(StatusArgs::kStatus));
+      TraceCall(method_call.method_name(), &patch);
+      bool success = session && session->ApplyState(patch);
+      result->Success(flutter::EncodableValue(success));
     }
   } 
   else if (method_call.method_name().compare("updateMetadata") == 0) {
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    ArgValues<5> args;
+    std::string error;
+    if (!arguments) {
+      result->Error("invalid_arguments", "Arguments required");
+    } else if (!DecodeArgs(*arguments, MetadataArgs::kSchema, &args, &error)) {
+      result->Error("invalid_arguments", error);
+    } else {
+      PlayerStatePatch patch;
+      patch.metadata = MetadataFromArgs(args);
+      TraceCall(method_call.method_name(), &patch);
+      bool success = session && session->ApplyState(patch);
+      result->Success(flutter::EncodableValue(success));
+    }
+  } 
+  else if (method_call.method_name().compare("updateTimeline") == 0) {
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    ArgValues<3> args;
+    std::string error;
+    if (!arguments) {
+      result->Error("invalid_arguments", "Arguments required");
+    } else if (!DecodeArgs(*arguments, TimelineArgs::kSchema, &args, &error)) {
+      result->Error("invalid_arguments", error);
+    } else {
+      PlayerStatePatch patch;
+      patch.timeline = TimelineSnapshot{
+          args.Integer(TimelineArgs::kPosition),
+          args.Integer(TimelineArgs::kDuration),
+          args.Number(TimelineArgs::kRate, 1.0) };
+      TraceCall(method_call.method_name(), &patch);
+      bool success = session && session->ApplyState(patch);
+      result->Success(flutter::EncodableValue(success));
+    }
+  } 
+  else if (method_call.method_name().compare("applyState") == 0) {
     const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
     if (arguments) {
-      std::string title, artist, album, albumArtUrl;
-      int64_t duration = 0;
-      
-      // Extract title (required)
-      auto title_it = arguments->find(flutter::EncodableValue("title"));
-      if (title_it != arguments->end() && std::holds_alternative<std::string>(title_it->second)) {
-        title = std::get<std::string>(title_it->second);
-      } else {
-        result->Error("invalid_arguments", "Title is required");
+      PlayerStatePatch patch;
+      std::string error;
+      if (!DecodeStatePatch(*arguments, &patch, &error)) {
+        result->Error("invalid_arguments", error);
         return;
       }
       
-      // Extract optional fields
-      auto artist_it = arguments->find(flutter::EncodableValue("artist"));
-      if (artist_it != arguments->end() && std::holds_alternative<std::string>(artist_it->second)) {
-        artist = std::get<std::string>(artist_it->second);
-      }
-      
-      auto album_it = arguments->find(flutter::EncodableValue("album"));
-      if (album_it != arguments->end() && std::holds_alternative<std::string>(album_it->second)) {
-        album = std::get<std::string>(album_it->second);
-      }
-      
-      auto duration_it = arguments->find(flutter::EncodableValue("duration"));
-      if (duration_it != arguments->end() && std::holds_alternative<int64_t>(duration_it->second)) {
-        duration = std::get<int64_t>(duration_it->second);
-      }
-      
-      auto art_it = arguments->find(flutter::EncodableValue("albumArtUrl"));
-      if (art_it != arguments->end() && std::holds_alternative<std::string>(art_it->second)) {
-        albumArtUrl = std::get<std::string>(art_it->second);
-      }
-      
-      bool success = smtc_implementation_->UpdateMetadata(title, artist, album, duration, albumArtUrl);
+      TraceCall(method_call.method_name(), &patch);
+      bool success = session && session->ApplyState(patch);
       result->Success(flutter::EncodableValue(success));
     } else {
       result->Error("invalid_arguments", "Arguments required");
     }
   } 
-  else if (method_call.method_name().compare("setCallbacks") == 0) {
-    // Set control callback to send events back to Flutter
-    smtc_implementation_->SetControlCallback(
-      [&](const std::string& command) {
-        // Here you would implement a mechanism to invoke methods on Flutter side
-        // For now, just log the command
-        OutputDebugStringA(("SMTC command received: " + command).c_str());
+  else if (method_call.method_name().compare("getStats") == 0) {
+    TraceCall(method_call.method_name(), nullptr);
+    // Answered on the platform thread even while the backend is stalled
+    UpdatePipelineStats stats = session_ ? session_->session().GetUpdateStats()
+                                         : UpdatePipelineStats{};
+    WatchdogStats health = session_ ? session_->session().GetWatchdogStats()
+                                    : WatchdogStats{};
+    flutter::EncodableMap map;
+    map[flutter::EncodableValue("depth")] = flutter::EncodableValue(static_cast<int64_t>(stats.depth));
+    map[flutter::EncodableValue("highWater")] = flutter::EncodableValue(static_cast<int64_t>(stats.highWater));
+    map[flutter::EncodableValue("submitted")] = flutter::EncodableValue(static_cast<int64_t>(stats.submitted));
+    map[flutter::EncodableValue("committed")] = flutter::EncodableValue(static_cast<int64_t>(stats.committed));
+    map[flutter::EncodableValue("collapsed")] = flutter::EncodableValue(static_cast<int64_t>(stats.collapsed));
+    map[flutter::EncodableValue("busy")] = flutter::EncodableValue(stats.busy);
+    map[flutter::EncodableValue("healthy")] = flutter::EncodableValue(health.healthy);
+    map[flutter::EncodableValue("stalls")] = flutter::EncodableValue(static_cast<int64_t>(health.stalls));
+    map[flutter::EncodableValue("failures")] = flutter::EncodableValue(static_cast<int64_t>(health.failures));
+    map[flutter::EncodableValue("recoveries")] = flutter::EncodableValue(static_cast<int64_t>(health.recoveries));
+    map[flutter::EncodableValue("lastRecoveryMicros")] = flutter::EncodableValue(health.lastRecoveryMicros);
+    result->Success(flutter::EncodableValue(map));
+  } 
+  else if (method_call.method_name().compare("setMemoryLimits") == 0) {
+    TraceCall(method_call.method_name(), nullptr);
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    MemoryLimits limits;
+    std::string error;
+    if (!arguments) {
+      result->Error("invalid_arguments", "Arguments required");
+    } else if (!DecodeMemoryLimits(*arguments, &limits, &error)) {
+      result->Error("invalid_arguments", error);
+    } else {
+      if (session) {
+        session->SetMemoryLimits(static_cast<size_t>(limits.budgetBytes),
+                                 static_cast<size_t>(limits.artworkCacheBytes),
+                                 std::chrono::milliseconds(limits.idleReleaseMillis));
+      }
+      result->Success(flutter::EncodableValue(session != nullptr));
+    }
+  } 
+  else if (method_call.method_name().compare("setThumbnailBudget") == 0) {
+    TraceCall(method_call.method_name(), nullptr);
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    ThumbnailBudget budget;
+    std::string error;
+    if (!arguments) {
+      result->Error("invalid_arguments", "Arguments required");
+    } else if (!DecodeThumbnailBudget(*arguments, &budget, &error)) {
+      result->Error("invalid_arguments", error);
+    } else {
+      if (session) {
+        session->SetThumbnailBudget(budget.maxBytes, budget.maxEdge);
       }
-    );
+      result->Success(flutter::EncodableValue(session != nullptr));
+    }
+  } 
+  else if (method_call.method_name().compare("prefetchArtwork") == 0) {
+    TraceCall(method_call.method_name(), nullptr);
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    ArgValues<1> args;
+    std::string error;
+    if (!arguments) {
+      result->Error("invalid_arguments", "Arguments required");
+    } else if (!DecodeArgs(*arguments, PrefetchArtworkArgs::kSchema, &args, &error)) {
+      result->Error("invalid_arguments", error);
+    } else {
+      if (session) {
+        session->PrefetchArtwork(std::string(args.String(PrefetchArtworkArgs::kUrl)));
+      }
+      result->Success(flutter::EncodableValue(session != nullptr));
+    }
+  } 
+  else if (method_call.method_name().compare("getMemoryStats") == 0) {
+    TraceCall(method_call.method_name(), nullptr);
+    MemoryStats stats = session_ ? session_->session().GetMemoryStats() : MemoryStats{};
+    auto category = [&](MemoryCategory which) {
+      return flutter::EncodableValue(static_cast<int64_t>(stats.byCategory[static_cast<size_t>(which)]));
+    };
+    flutter::EncodableMap map;
+    map[flutter::EncodableValue("limit")] = flutter::EncodableValue(static_cast<int64_t>(stats.limit));
+    map[flutter::EncodableValue("used")] = flutter::EncodableValue(static_cast<int64_t>(stats.used));
+    map[flutter::EncodableValue("peak")] = flutter::EncodableValue(static_cast<int64_t>(stats.peak));
+    map[flutter::EncodableValue("artwork")] = category(MemoryCategory::kArtwork);
+    map[flutter::EncodableValue("caches")] = category(MemoryCategory::kCaches);
+    map[flutter::EncodableValue("strings")] = category(MemoryCategory::kStrings);
+    map[flutter::EncodableValue("queues")] = category(MemoryCategory::kQueues);
+    map[flutter::EncodableValue("log")] = category(MemoryCategory::kLog);
+    map[flutter::EncodableValue("reclaims")] = flutter::EncodableValue(static_cast<int64_t>(stats.reclaims));
+    map[flutter::EncodableValue("reclaimedBytes")] = flutter::EncodableValue(static_cast<int64_t>(stats.reclaimedBytes));
+    map[flutter::EncodableValue("idleReleases")] = flutter::EncodableValue(static_cast<int64_t>(stats.idleReleases));
+    result->Success(flutter::EncodableValue(map));
+  } 
+  else if (method_call.method_name().compare("setCallbacks") == 0) {
+    TraceCall(method_call.method_name(), nullptr);
+    // Events are hooked on initialize; kept for callers that still ask
+    if (session) {
+      OnBecameDriver(*session);
+    }
     
-    result->Success(flutter::EncodableValue(true));
+    result->Success(flutter::EncodableValue(session != nullptr));
+  } 
+  else if (method_call.method_name().compare("takePosition") == 0) {
+    TraceCall(method_call.method_name(), nullptr);
+    int64_t position;
+    if (position_mailbox_.Take(&position)) {
+      result->Success(flutter::EncodableValue(position));
+    } else {
+      result->Success();
+    }
+  } 
+  else if (method_call.method_name().compare("setSpanTracing") == 0) {
+    TraceCall(method_call.method_name(), nullptr);
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    ArgValues<1> args;
+    std::string error;
+    if (!arguments) {
+      result->Error("invalid_arguments", "Arguments required");
+    } else if (!DecodeArgs(*arguments, SpanTracingArgs::kSchema, &args, &error)) {
+      result->Error("invalid_arguments", error);
+    } else {
+      // Process-wide, so any engine may switch it
+      if (args.Bool(SpanTracingArgs::kEnabled, false)) {
+        StartSpans();
+      } else {
+        StopSpans();
+      }
+      result->Success();
+    }
+  } 
+  else if (method_call.method_name().compare("dumpSpans") == 0) {
+    TraceCall(method_call.method_name(), nullptr);
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    ArgValues<1> args;
+    std::string error;
+    if (!arguments) {
+      result->Error("invalid_arguments", "Arguments required");
+    } else if (!DecodeArgs(*arguments, DumpSpansArgs::kSchema, &args, &error)) {
+      result->Error("invalid_arguments", error);
+    } else {
+      result->Success(flutter::EncodableValue(DumpSpans(std::string(args.String(DumpSpansArgs::kPath)))));
+    }
   } 
   else {
+    TraceCall(method_call.method_name(), nullptr);
     result->NotImplemented();
   }
 }
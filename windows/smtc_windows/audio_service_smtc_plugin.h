@@ -5,7 +5,11 @@
 #include <flutter/plugin_registrar_windows.h>
 
 #include <memory>
-#include "smtc_windows.h"
+#include <vector>
+#include "event_dispatcher.h"
+#include "position_mailbox.h"
+#include "shared_session.h"
+#include "smtc_session.h"
 
 namespace audio_service_smtc {
 
@@ -26,8 +30,29 @@ class AudioServiceSmtcPlugin : public flutter::Plugin {
       std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
 
  private:
+  // Returns the shared session if this engine drives state, else null.
+  SmtcSession* driven_session() const;
+
+  // Routes the session's events to this engine once it drives state
+  void OnBecameDriver(SmtcSession& session);
+
+  // Called on the SMTC event thread for every seek request
+  void OnPositionChange(int64_t positionInMicroseconds);
+  void SendEvent(const NativeEvent& event);
+
   flutter::PluginRegistrarWindows *registrar_;
-  std::unique_ptr<SmtcWindows> smtc_implementation_;
+
+  // Newest seek request from SMTC, drained by Dart with takePosition
+  PositionMailbox position_mailbox_;
+
+  // Orders native->Dart events so controls never wait behind positions
+  std::unique_ptr<EventDispatcher> event_dispatcher_;
+
+  // Encoded event being sent; only touched by the dispatcher's deliverer
+  std::vector<uint8_t> event_buffer_;
+
+  // This engine's hold on the process-wide session, taken on initialize.
+  std::unique_ptr<SharedSession<SmtcSession>::Attachment> session_;
 };
 
 }  // namespace audio_service_smtc
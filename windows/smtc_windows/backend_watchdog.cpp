@@ -0,0 +1,141 @@
+#include "backend_watchdog.h"
+
+#include <chrono>
+#include <utility>
+
+#include "event_dispatcher.h"
+#include "span_tracer.h"
+
+namespace audio_service_smtc {
+
+BackendWatchdog::BackendWatchdog(Rebuild rebuild, Options options)
+    : _rebuild(std::move(rebuild)), _options(std::move(options)) {
+    _thread = std::thread(&BackendWatchdog::Monitor, this);
+}
+
+BackendWatchdog::~BackendWatchdog() {
+    Stop();
+}
+
+void BackendWatchdog::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _cv.notify_all();
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+}
+
+bool BackendWatchdog::Run(const std::function<bool()>& call) {
+    uint64_t id;
+    bool wasIdle;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        id = ++_lastCall;
+        ++_stats.calls;
+        wasIdle = _inFlight.empty();
+        _inFlight.emplace(id, MonotonicMicros());
+    }
+    // An idle monitor sleeps without a deadline; give it this one
+    if (wasIdle) _cv.notify_all();
+
+    bool ok = false;
+    try {
+        ok = call();
+    }
+    catch (...) {
+        ok = false;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    // A call the monitor already gave up on has been counted as a stall
+    bool stalled = _inFlight.erase(id) == 0;
+    if (!ok && !stalled) {
+        ++_stats.failures;
+        MarkUnhealthyLocked(MonotonicMicros());
+        _cv.notify_all();
+    }
+    return ok && !stalled;
+}
+
+bool BackendWatchdog::Healthy() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats.healthy;
+}
+
+WatchdogStats BackendWatchdog::Stats() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+}
+
+void BackendWatchdog::MarkUnhealthyLocked(int64_t now) {
+    if (!_stats.healthy) return;
+    _stats.healthy = false;
+    _unhealthySince = now;
+}
+
+void BackendWatchdog::Monitor() {
+    SetSpanThreadName("backend watchdog");
+    if (_options.onThreadStart) _options.onThreadStart();
+
+    int64_t retryInterval = _options.retryInterval;
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_stopping) {
+        int64_t now = MonotonicMicros();
+
+        // Calls past their deadline are stalled; stop tracking them so each
+        // is counted once, however long it stays blocked
+        for (auto it = _inFlight.begin(); it != _inFlight.end();) {
+            if (now - it->second < _options.deadline) {
+                ++it;
+                continue;
+            }
+            ++_stats.stalls;
+            MarkUnhealthyLocked(now);
+            it = _inFlight.erase(it);
+        }
+
+        if (!_stats.healthy) {
+            lock.unlock();
+            bool rebuilt = false;
+            try {
+                rebuilt = _rebuild();
+            }
+            catch (...) {
+                rebuilt = false;
+            }
+            lock.lock();
+
+            if (rebuilt) {
+                _stats.healthy = true;
+                ++_stats.recoveries;
+                _stats.lastRecoveryMicros = MonotonicMicros() - _unhealthySince;
+                retryInterval = _options.retryInterval;
+                continue;
+            }
+            _cv.wait_for(lock, std::chrono::microseconds(retryInterval),
+                         [this] { return _stopping; });
+            retryInterval *= 2;
+            if (retryInterval > _options.maxRetryInterval) {
+                retryInterval = _options.maxRetryInterval;
+            }
+            continue;
+        }
+
+        if (_inFlight.empty()) {
+            _cv.wait(lock);
+            continue;
+        }
+
+        // Ids grow with start time, so the oldest call is the first to expire
+        int64_t expiry = _inFlight.begin()->second + _options.deadline;
+        _cv.wait_for(lock, std::chrono::microseconds(expiry - now));
+    }
+    lock.unlock();
+
+    if (_options.onThreadExit) _options.onThreadExit();
+}
+
+}  // namespace audio_service_smtc
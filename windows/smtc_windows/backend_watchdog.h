@@ -0,0 +1,75 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace audio_service_smtc {
+
+struct WatchdogStats {
+    uint64_t calls = 0;
+    uint64_t stalls = 0;              // calls that overran the deadline
+    uint64_t failures = 0;            // calls that reported an error
+    uint64_t recoveries = 0;          // successful rebuilds
+    int64_t lastRecoveryMicros = 0;   // unhealthy until rebuilt, latest recovery
+    bool healthy = true;
+};
+
+// Times backend calls and rebuilds the backend once one fails or overruns
+// its deadline. The rebuild runs on the watchdog's own thread, so it goes
+// ahead even while the stalled call is still blocked.
+class BackendWatchdog {
+public:
+    // Tears down and re-creates the backend, then replays the committed
+    // state into it. Returns false if the backend could not be rebuilt yet.
+    using Rebuild = std::function<bool()>;
+
+    struct Options {
+        int64_t deadline = 2000000;       // microseconds a call may take
+        // Between failed rebuilds, doubling up to maxRetryInterval, so a
+        // backend that stays away isn't polled hard
+        int64_t retryInterval = 1000000;
+        int64_t maxRetryInterval = 30000000;
+        // Run on the watchdog thread, e.g. to join a COM apartment
+        std::function<void()> onThreadStart;
+        std::function<void()> onThreadExit;
+    };
+
+    BackendWatchdog(Rebuild rebuild, Options options);
+    explicit BackendWatchdog(Rebuild rebuild) : BackendWatchdog(std::move(rebuild), Options{}) {}
+    ~BackendWatchdog();
+
+    BackendWatchdog(const BackendWatchdog&) = delete;
+    BackendWatchdog& operator=(const BackendWatchdog&) = delete;
+
+    // Stops rebuilding, waiting for a rebuild in progress. Calls still run
+    // and are counted, so threads may keep reporting to a stopped watchdog.
+    void Stop();
+
+    // Runs one backend call, which returns false on failure. Calls may come
+    // from several threads at once.
+    bool Run(const std::function<bool()>& call);
+
+    bool Healthy() const;
+    WatchdogStats Stats() const;
+
+private:
+    void Monitor();
+    void MarkUnhealthyLocked(int64_t now);
+
+    Rebuild _rebuild;
+    Options _options;
+    mutable std::mutex _mutex;
+    std::condition_variable _cv;
+    std::map<uint64_t, int64_t> _inFlight;  // call id -> start time
+    uint64_t _lastCall = 0;
+    int64_t _unhealthySince = 0;
+    WatchdogStats _stats;
+    bool _stopping = false;
+    std::thread _thread;
+};
+
+}  // namespace audio_service_smtc
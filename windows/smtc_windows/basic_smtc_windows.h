@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "artwork_pipeline.h"
+#include "native_log.h"
+#include "player_state.h"
+
+namespace audio_service_smtc {
+
+// Lock policies. Either is used through std::lock_guard.
+struct NoLock {
+    void lock() {}
+    void unlock() {}
+};
+using MutexLock = std::mutex;
+
+// Log policies, told the name of the backend call that failed.
+struct NullLog {
+    static void BackendFailed(const char*) {}
+};
+
+struct AsyncLog {
+    static void BackendFailed(const char* operation) {
+        SMTC_LOG_ERROR("SMTC backend call failed", operation);
+    }
+};
+
+// SmtcWindows reduced to its commit path, with the locking, logging and
+// backend chosen at compile time. Calls go straight to the backend on the
+// calling thread: there is no update queue, watchdog or timeline throttling,
+// and only local artwork is shown, loaded inline.
+//
+// Backend needs no base class. It is constructed from the identity string
+// and provides:
+//   bool IsReady() const;
+//   bool ApplyState(const PlayerState&, uint32_t changed, const ArtworkImage&);
+//   bool UpdateTimeline(const TimelineSnapshot&);
+//   void SetControlCallback(std::function<void(const std::string&)>);
+//   void SetPositionCallback(std::function<void(int64_t)>);
+//
+// With NoLock every call, callbacks included, must come from one thread.
+// SmtcWindows remains the default for the plugin.
+template <typename Backend, typename LockPolicy = MutexLock, typename LogPolicy = AsyncLog>
+class BasicSmtcWindows {
+public:
+    BasicSmtcWindows() = default;
+
+    BasicSmtcWindows(const BasicSmtcWindows&) = delete;
+    BasicSmtcWindows& operator=(const BasicSmtcWindows&) = delete;
+
+    bool Initialize(const std::string& identity = "audio_service_smtc") {
+        std::lock_guard<LockPolicy> lock(_lock);
+        if (_backend) return true;
+
+        _backend.emplace(identity);
+        if (!_backend->IsReady()) {
+            LogPolicy::BackendFailed("Initialize");
+            _backend.reset();
+            return false;
+        }
+        return true;
+    }
+
+    bool UpdatePlaybackStatus(const std::string& status) {
+        PlayerStatePatch patch;
+        patch.status = ParsePlaybackState(status.c_str());
+        return ApplyState(patch);
+    }
+
+    bool UpdateMetadata(const std::string& title, const std::string& artist,
+                        const std::string& album, int64_t duration,
+                        const std::string& albumArtUrl) {
+        PlayerStatePatch patch;
+        patch.metadata = MakeMetadata(title, artist, album, albumArtUrl, duration);
+        return ApplyState(patch);
+    }
+
+    bool UpdateTimeline(int64_t position, int64_t duration, double rate) {
+        PlayerStatePatch patch;
+        patch.timeline = TimelineSnapshot{ position, duration, rate };
+        return ApplyState(patch);
+    }
+
+    // Commits the patch before returning. False if the backend rejected it.
+    bool ApplyState(const PlayerStatePatch& patch) {
+        std::lock_guard<LockPolicy> lock(_lock);
+        if (!_backend) return false;
+
+        uint32_t changed = _state.Apply(patch);
+        const PlayerState& state = _state.Committed();
+        if (changed & kMetadataField) {
+            _artwork = LoadArtwork(state.metadata.artUrl);
+        }
+
+        bool ok = true;
+        if (changed & (kStatusField | kMetadataField | kButtonsField)) {
+            if (!_backend->ApplyState(state, changed, _artwork)) {
+                LogPolicy::BackendFailed("ApplyState");
+                ok = false;
+            }
+        }
+        if (changed & kTimelineField) {
+            if (!_backend->UpdateTimeline(state.timeline)) {
+                LogPolicy::BackendFailed("UpdateTimeline");
+                ok = false;
+            }
+        }
+        return ok;
+    }
+
+    void SetControlCallback(std::function<void(const std::string&)> callback) {
+        std::lock_guard<LockPolicy> lock(_lock);
+        if (_backend) _backend->SetControlCallback(std::move(callback));
+    }
+
+    void SetPositionCallback(std::function<void(int64_t)> callback) {
+        std::lock_guard<LockPolicy> lock(_lock);
+        if (_backend) _backend->SetPositionCallback(std::move(callback));
+    }
+
+    // The state last committed to the backend
+    PlayerState Committed() {
+        std::lock_guard<LockPolicy> lock(_lock);
+        return _state.Committed();
+    }
+
+private:
+    static ArtworkImage LoadArtwork(const std::string& url) {
+        ArtworkImage image;
+        if (url.empty() || !IsLocalArtworkUrl(url)) return image;
+
+        std::vector<uint8_t> bytes;
+        if (LoadLocalArtwork(url, 0, bytes)) {
+            image.bytes = MakeArtworkBytes(std::move(bytes));
+        }
+        return image;
+    }
+
+    LockPolicy _lock;
+    std::optional<Backend> _backend;
+    PlayerStateStore _state;
+    ArtworkImage _artwork;
+};
+
+}  // namespace audio_service_smtc
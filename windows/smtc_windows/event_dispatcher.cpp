@@ -0,0 +1,123 @@
+#include "event_dispatcher.h"
+
+#include <chrono>
+#include <cstring>
+#include <string_view>
+#include <utility>
+
+#include "memory_budget.h"
+
+namespace audio_service_smtc {
+
+namespace {
+
+// Standard message codec type tags
+constexpr uint8_t kCodecInt64 = 4;
+constexpr uint8_t kCodecString = 7;
+constexpr uint8_t kCodecMap = 13;
+
+void WriteSize(std::vector<uint8_t>* out, size_t size) {
+    if (size < 254) {
+        out->push_back(static_cast<uint8_t>(size));
+    } else if (size <= 0xFFFF) {
+        uint16_t value = static_cast<uint16_t>(size);
+        out->push_back(254);
+        out->insert(out->end(), reinterpret_cast<uint8_t*>(&value), reinterpret_cast<uint8_t*>(&value) + 2);
+    } else {
+        uint32_t value = static_cast<uint32_t>(size);
+        out->push_back(255);
+        out->insert(out->end(), reinterpret_cast<uint8_t*>(&value), reinterpret_cast<uint8_t*>(&value) + 4);
+    }
+}
+
+void WriteString(std::vector<uint8_t>* out, std::string_view text) {
+    out->push_back(kCodecString);
+    WriteSize(out, text.size());
+    out->insert(out->end(), text.begin(), text.end());
+}
+
+void WriteInt64(std::vector<uint8_t>* out, int64_t value) {
+    // Follows the type byte directly; the codec pads only float64 and
+    // typed list payloads
+    out->push_back(kCodecInt64);
+    uint8_t bytes[8];
+    std::memcpy(bytes, &value, sizeof(bytes));
+    out->insert(out->end(), bytes, bytes + sizeof(bytes));
+}
+
+}  // namespace
+
+void EncodeEventEnvelope(const NativeEvent& event, std::vector<uint8_t>* out) {
+    out->clear();
+    out->push_back(0);  // success envelope
+    out->push_back(kCodecMap);
+    // Keys in EncodableMap order, so the bytes match the codec's exactly
+    if (event.kind == NativeEventKind::kControl) {
+        WriteSize(out, 3);
+        WriteString(out, "controlType");
+        WriteString(out, event.control);
+    } else {
+        WriteSize(out, 2);
+    }
+    WriteString(out, "timestamp");
+    WriteInt64(out, event.timestamp);
+    WriteString(out, "type");
+    WriteString(out, event.kind == NativeEventKind::kControl ? "control" : "positionPending");
+}
+
+int64_t MonotonicMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+EventDispatcher::EventDispatcher(Sink sink) : _sink(std::move(sink)) {}
+
+void EventDispatcher::PostControl(const std::string& control) {
+    NativeEvent event;
+    event.kind = NativeEventKind::kControl;
+    event.control = control;
+    event.timestamp = MonotonicMicros();
+
+    // Control names fit in the string's inline buffer, so the event is all
+    MemoryBudget::Shared().Charge(MemoryCategory::kQueues, sizeof(NativeEvent));
+    std::unique_lock<std::mutex> lock(_mutex);
+    _controls.push_back(std::move(event));
+    Deliver(lock);
+}
+
+void EventDispatcher::PostPosition(int64_t positionMicroseconds) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _position.kind = NativeEventKind::kPosition;
+    _position.position = positionMicroseconds;
+    _position.timestamp = MonotonicMicros();
+    _positionPending = true;
+    Deliver(lock);
+}
+
+void EventDispatcher::Deliver(std::unique_lock<std::mutex>& lock) {
+    // Someone else is delivering and will pick up what we just queued
+    if (_delivering) return;
+    _delivering = true;
+
+    for (;;) {
+        NativeEvent event;
+        if (!_controls.empty()) {
+            event = std::move(_controls.front());
+            _controls.pop_front();
+            MemoryBudget::Shared().Release(MemoryCategory::kQueues, sizeof(NativeEvent));
+        } else if (_positionPending) {
+            event = _position;
+            _positionPending = false;
+        } else {
+            break;
+        }
+
+        lock.unlock();
+        _sink(event);
+        lock.lock();
+    }
+
+    _delivering = false;
+}
+
+}  // namespace audio_service_smtc
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace audio_service_smtc {
+
+// Microseconds on the steady clock. On Windows this is the
+// QueryPerformanceCounter timebase, the same one Dart's Timeline.now uses,
+// so Dart can compute the age of an event by subtraction.
+int64_t MonotonicMicros();
+
+enum class NativeEventKind {
+    kControl,
+    kPosition,
+};
+
+struct NativeEvent {
+    NativeEventKind kind = NativeEventKind::kControl;
+    std::string control;
+    int64_t position = 0;
+    int64_t timestamp = 0;  // MonotonicMicros() when the event was posted
+};
+
+// Writes the bytes StandardMethodCodec::EncodeSuccessEnvelope produces for
+// the event's map ({type, controlType?, timestamp}), without building
+// EncodableValues. Replaces the contents of `out`. tools/smtc_event_codec_check
+// compares the two byte for byte.
+void EncodeEventEnvelope(const NativeEvent& event, std::vector<uint8_t>* out);
+
+// Delivers native events to Dart with control events ahead of position
+// traffic. Control events are queued in order; position events are
+// coalesced so only the newest one is ever waiting.
+//
+// Whichever thread posts while no delivery is running becomes the deliverer
+// and drains both queues, so no extra thread is needed and the sink is never
+// called concurrently.
+class EventDispatcher {
+public:
+    using Sink = std::function<void(const NativeEvent& event)>;
+
+    explicit EventDispatcher(Sink sink);
+
+    void PostControl(const std::string& control);
+    void PostPosition(int64_t positionMicroseconds);
+
+private:
+    void Deliver(std::unique_lock<std::mutex>& lock);
+
+    Sink _sink;
+    std::mutex _mutex;
+    std::deque<NativeEvent> _controls;
+    NativeEvent _position;
+    bool _positionPending = false;
+    bool _delivering = false;
+};
+
+}  // namespace audio_service_smtc
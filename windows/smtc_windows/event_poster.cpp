@@ -0,0 +1,43 @@
+#include "event_poster.h"
+
+#include "smtc_c_api.h"
+
+namespace audio_service_smtc {
+
+namespace {
+
+// Prefix of Dart_CObject from dart_native_api.h; only the int64 member is
+// used. The padding keeps the struct as large as the real union.
+enum DartCObjectType : int32_t {
+    kDartCObjectInt64 = 3,
+};
+
+struct DartCObject {
+    DartCObjectType type;
+    union {
+        int64_t asInt64;
+        void* padding[5];
+    } value;
+};
+
+}  // namespace
+
+bool DartPortPoster::Post(int64_t message) {
+    DartCObject object;
+    object.type = kDartCObjectInt64;
+    object.value.asInt64 = message;
+    // The message is copied before Dart_PostCObject returns
+    return _postCObject(_port, &object);
+}
+
+void PortEventSink::PostControl(int32_t event) {
+    _poster->Post(EncodePortEvent(event, 0));
+}
+
+void PortEventSink::PostPosition(int64_t positionMicroseconds) {
+    if (_positions.Post(positionMicroseconds)) {
+        _poster->Post(EncodePortEvent(SMTC_EVENT_POSITION_PENDING, 0));
+    }
+}
+
+}  // namespace audio_service_smtc
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include "position_mailbox.h"
+
+namespace audio_service_smtc {
+
+// Events sent to a Dart port are single integers: the event code in the top
+// 8 bits and a non-negative argument in the low 56 bits.
+constexpr int64_t EncodePortEvent(int32_t event, int64_t arg) {
+    return (static_cast<int64_t>(event) << 56) | (arg & ((int64_t{ 1 } << 56) - 1));
+}
+
+// Delivers encoded events. Implementations must be callable from any thread.
+class EventPoster {
+public:
+    virtual ~EventPoster() = default;
+    virtual bool Post(int64_t message) = 0;
+};
+
+// Signature of Dart_PostCObject, as handed out by NativeApi.postCObject.
+using DartPostCObjectFn = bool (*)(int64_t port, void* message);
+
+// Posts straight into a Dart ReceivePort through the Dart native API, which
+// skips the platform thread hop and the method codec.
+class DartPortPoster final : public EventPoster {
+public:
+    DartPortPoster(DartPostCObjectFn postCObject, int64_t port)
+        : _postCObject(postCObject), _port(port) {}
+
+    bool Post(int64_t message) override;
+
+private:
+    DartPostCObjectFn _postCObject;
+    int64_t _port;
+};
+
+// Turns SMTC events into port messages. Position requests go through a
+// latest-wins mailbox: Dart is only woken when it goes from empty to full
+// and drains it with TakePosition().
+class PortEventSink {
+public:
+    explicit PortEventSink(std::unique_ptr<EventPoster> poster) : _poster(std::move(poster)) {}
+
+    void PostControl(int32_t event);
+    void PostPosition(int64_t positionMicroseconds);
+    bool TakePosition(int64_t* positionMicroseconds) { return _positions.Take(positionMicroseconds); }
+
+private:
+    std::unique_ptr<EventPoster> _poster;
+    PositionMailbox _positions;
+};
+
+}  // namespace audio_service_smtc
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "artwork_pipeline.h"
+#include "player_state.h"
+
+namespace audio_service_smtc {
+
+// A platform media surface: SMTC on Windows (SMTCHandlerImpl), MPRIS on
+// Linux (MprisBackend). Calls come from one thread at a time; callbacks may
+// fire on a thread of the backend's own and must not be delivered once they
+// have been replaced.
+class MediaBackend {
+public:
+    virtual ~MediaBackend() = default;
+
+    // False if the surface could not be set up
+    virtual bool IsReady() const = 0;
+
+    // Pushes the fields flagged in `changed` as one update. Returns false if
+    // the surface rejected it.
+    virtual bool ApplyState(const PlayerState& state, uint32_t changed, const ArtworkImage& artwork) = 0;
+
+    virtual bool UpdateThumbnail(const ArtworkImage& artwork) = 0;
+    virtual bool UpdateTimeline(const TimelineSnapshot& timeline) = 0;
+
+    virtual void SetControlCallback(std::function<void(const std::string&)> callback) = 0;
+    virtual void SetPositionCallback(std::function<void(int64_t)> callback) = 0;
+};
+
+}  // namespace audio_service_smtc
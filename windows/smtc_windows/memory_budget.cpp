@@ -0,0 +1,101 @@
+#include "memory_budget.h"
+
+#include <limits>
+
+namespace audio_service_smtc {
+
+MemoryBudget& MemoryBudget::Shared() {
+    static MemoryBudget* budget = new MemoryBudget();
+    return *budget;
+}
+
+void MemoryBudget::SetLimit(size_t bytes) {
+    _limit.store(bytes, std::memory_order_relaxed);
+    Enforce();
+}
+
+void MemoryBudget::Charge(MemoryCategory category, size_t bytes) {
+    if (bytes == 0) return;
+    _byCategory[static_cast<size_t>(category)].fetch_add(bytes, std::memory_order_relaxed);
+    size_t used = _used.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+
+    size_t peak = _peak.load(std::memory_order_relaxed);
+    while (used > peak && !_peak.compare_exchange_weak(peak, used, std::memory_order_relaxed)) {}
+}
+
+void MemoryBudget::Release(MemoryCategory category, size_t bytes) {
+    if (bytes == 0) return;
+    _byCategory[static_cast<size_t>(category)].fetch_sub(bytes, std::memory_order_relaxed);
+    _used.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+bool MemoryBudget::OverLimit() const {
+    size_t limit = _limit.load(std::memory_order_relaxed);
+    return limit != 0 && _used.load(std::memory_order_relaxed) > limit;
+}
+
+uint64_t MemoryBudget::AddReclaimer(Reclaimer reclaimer) {
+    std::lock_guard<std::mutex> lock(_reclaimMutex);
+    uint64_t id = _nextReclaimer++;
+    _reclaimers.emplace_back(id, std::move(reclaimer));
+    return id;
+}
+
+void MemoryBudget::RemoveReclaimer(uint64_t id) {
+    std::lock_guard<std::mutex> lock(_reclaimMutex);
+    for (auto it = _reclaimers.begin(); it != _reclaimers.end(); ++it) {
+        if (it->first == id) {
+            _reclaimers.erase(it);
+            return;
+        }
+    }
+}
+
+size_t MemoryBudget::Enforce() {
+    if (!OverLimit()) return 0;
+
+    std::lock_guard<std::mutex> lock(_reclaimMutex);
+    // Another thread may have trimmed while this one waited
+    size_t limit = _limit.load(std::memory_order_relaxed);
+    size_t used = _used.load(std::memory_order_relaxed);
+    if (limit == 0 || used <= limit) return 0;
+
+    _reclaims.fetch_add(1, std::memory_order_relaxed);
+    return Reclaim(used - limit);
+}
+
+size_t MemoryBudget::ReleaseIdle() {
+    std::lock_guard<std::mutex> lock(_reclaimMutex);
+    _idleReleases.fetch_add(1, std::memory_order_relaxed);
+    return Reclaim(std::numeric_limits<size_t>::max());
+}
+
+size_t MemoryBudget::Reclaim(size_t wanted) {
+    size_t freed = 0;
+    for (auto& [id, reclaimer] : _reclaimers) {
+        if (freed >= wanted) break;
+        freed += reclaimer(wanted - freed);
+    }
+    _reclaimedBytes.fetch_add(freed, std::memory_order_relaxed);
+    return freed;
+}
+
+MemoryStats MemoryBudget::Stats() const {
+    MemoryStats stats;
+    stats.limit = _limit.load(std::memory_order_relaxed);
+    stats.used = _used.load(std::memory_order_relaxed);
+    stats.peak = _peak.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < kMemoryCategoryCount; ++i) {
+        stats.byCategory[i] = _byCategory[i].load(std::memory_order_relaxed);
+    }
+    stats.reclaims = _reclaims.load(std::memory_order_relaxed);
+    stats.reclaimedBytes = _reclaimedBytes.load(std::memory_order_relaxed);
+    stats.idleReleases = _idleReleases.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void MemoryBudget::ResetPeak() {
+    _peak.store(_used.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+}  // namespace audio_service_smtc
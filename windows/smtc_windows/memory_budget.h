@@ -0,0 +1,95 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace audio_service_smtc {
+
+// What the plugin's native memory is held for.
+enum class MemoryCategory : uint8_t {
+    kArtwork = 0,   // encoded image buffers, wherever they are held
+    kCaches = 1,    // cache bookkeeping and converted strings
+    kStrings = 2,   // string pool arenas and index
+    kQueues = 3,    // events waiting for Dart
+    kLog = 4,       // per-thread log and span rings
+};
+
+constexpr size_t kMemoryCategoryCount = 5;
+
+struct MemoryStats {
+    size_t limit = 0;                                  // 0 if unlimited
+    size_t used = 0;
+    size_t peak = 0;
+    std::array<size_t, kMemoryCategoryCount> byCategory{};
+    uint64_t reclaims = 0;        // times usage went over the limit and caches were trimmed
+    uint64_t reclaimedBytes = 0;
+    uint64_t idleReleases = 0;    // times everything reclaimable was dropped for idleness
+};
+
+// Process-wide account of the bytes the plugin holds natively, against an
+// optional limit. Charging is a few relaxed atomic adds and never blocks or
+// frees anything itself: subsystems call Enforce() at a point where they hold
+// none of their own locks, and it asks the registered reclaimers (caches) to
+// give back enough to get under the limit again.
+class MemoryBudget {
+public:
+    // Frees up to `wanted` bytes and returns how many it freed. Called with
+    // no subsystem lock held by the caller.
+    using Reclaimer = std::function<size_t(size_t wanted)>;
+
+    // Never destroyed, so buffers released during static teardown are fine.
+    static MemoryBudget& Shared();
+
+    MemoryBudget() = default;
+
+    MemoryBudget(const MemoryBudget&) = delete;
+    MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+    void SetLimit(size_t bytes);
+
+    void Charge(MemoryCategory category, size_t bytes);
+    void Release(MemoryCategory category, size_t bytes);
+
+    bool OverLimit() const;
+
+    // Returns an id for RemoveReclaimer. Reclaimers are asked in the order
+    // they were added.
+    uint64_t AddReclaimer(Reclaimer reclaimer);
+    // Waits for a reclaim in progress, so the reclaimer's owner can go away
+    void RemoveReclaimer(uint64_t id);
+
+    // Trims caches until usage is under the limit again, or they have nothing
+    // left to give. Returns the bytes freed; cheap when under the limit.
+    size_t Enforce();
+
+    // Asks every reclaimer for everything it holds.
+    size_t ReleaseIdle();
+
+    MemoryStats Stats() const;
+
+    // Starts peak tracking over from current usage
+    void ResetPeak();
+
+private:
+    size_t Reclaim(size_t wanted);
+
+    std::atomic<size_t> _limit{ 0 };
+    std::atomic<size_t> _used{ 0 };
+    std::atomic<size_t> _peak{ 0 };
+    std::array<std::atomic<size_t>, kMemoryCategoryCount> _byCategory{};
+    std::atomic<uint64_t> _reclaims{ 0 };
+    std::atomic<uint64_t> _reclaimedBytes{ 0 };
+    std::atomic<uint64_t> _idleReleases{ 0 };
+
+    // Held while reclaimers run
+    std::mutex _reclaimMutex;
+    std::vector<std::pair<uint64_t, Reclaimer>> _reclaimers;
+    uint64_t _nextReclaimer = 1;
+};
+
+}  // namespace audio_service_smtc
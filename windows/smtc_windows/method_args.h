@@ -0,0 +1,161 @@
+#pragma once
+
+#include <flutter/encodable_value.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <variant>
+
+#include "span_tracer.h"
+
+namespace audio_service_smtc {
+
+enum class ArgType : uint8_t {
+    kString,
+    kInteger,   // int32 or int64; the standard codec picks the smaller
+    kNumber,    // double, or an integer
+    kBool,
+    kMap,
+    kList,
+};
+
+struct ArgField {
+    std::string_view name;
+    ArgType type;
+    bool required = false;
+};
+
+// The arguments one method takes. Declared constexpr next to an enum that
+// names each field's index, so reading a field is an array access:
+//
+//   struct TimelineArgs {
+//       enum : size_t { kPosition, kDuration };
+//       static constexpr ArgSchema<2> kSchema{ {{
+//           { "position", ArgType::kInteger, true },
+//           { "duration", ArgType::kInteger },
+//       }} };
+//   };
+template <size_t N>
+struct ArgSchema {
+    std::array<ArgField, N> fields;
+
+    // N if `name` isn't a field
+    constexpr size_t Find(std::string_view name) const {
+        for (size_t i = 0; i < N; ++i) {
+            if (fields[i].name == name) return i;
+        }
+        return N;
+    }
+};
+
+// What DecodeArgs found: pointers into the decoded map, so strings are read
+// in place and the map has to outlive this. Accessors take the field index
+// and return `fallback` for fields that were absent or null.
+template <size_t N>
+class ArgValues {
+public:
+    bool Has(size_t field) const { return _values[field] != nullptr; }
+
+    std::string_view String(size_t field, std::string_view fallback = {}) const {
+        return Has(field) ? std::string_view(std::get<std::string>(*_values[field])) : fallback;
+    }
+    int64_t Integer(size_t field, int64_t fallback = 0) const {
+        return Has(field) ? _values[field]->LongValue() : fallback;
+    }
+    double Number(size_t field, double fallback) const {
+        if (!Has(field)) return fallback;
+        if (const auto* value = std::get_if<double>(_values[field])) return *value;
+        return static_cast<double>(_values[field]->LongValue());
+    }
+    bool Bool(size_t field, bool fallback) const {
+        return Has(field) ? std::get<bool>(*_values[field]) : fallback;
+    }
+    // Null if absent
+    const flutter::EncodableMap* Map(size_t field) const {
+        return Has(field) ? &std::get<flutter::EncodableMap>(*_values[field]) : nullptr;
+    }
+    const flutter::EncodableList* List(size_t field) const {
+        return Has(field) ? &std::get<flutter::EncodableList>(*_values[field]) : nullptr;
+    }
+
+private:
+    template <size_t M>
+    friend bool DecodeArgs(const flutter::EncodableMap& arguments, const ArgSchema<M>& schema,
+                           ArgValues<M>* values, std::string* error);
+
+    std::array<const flutter::EncodableValue*, N> _values{};
+};
+
+namespace method_args_internal {
+
+inline bool HasType(const flutter::EncodableValue& value, ArgType type) {
+    switch (type) {
+    case ArgType::kString: return std::holds_alternative<std::string>(value);
+    case ArgType::kInteger:
+        return std::holds_alternative<int32_t>(value) || std::holds_alternative<int64_t>(value);
+    case ArgType::kNumber:
+        return std::holds_alternative<double>(value) || std::holds_alternative<int32_t>(value) ||
+               std::holds_alternative<int64_t>(value);
+    case ArgType::kBool: return std::holds_alternative<bool>(value);
+    case ArgType::kMap: return std::holds_alternative<flutter::EncodableMap>(value);
+    case ArgType::kList: return std::holds_alternative<flutter::EncodableList>(value);
+    }
+    return false;
+}
+
+// "position" -> "Position must be an integer"
+inline std::string FieldError(std::string_view name, const char* problem) {
+    std::string message(name);
+    if (!message.empty() && message[0] >= 'a' && message[0] <= 'z') message[0] -= 'a' - 'A';
+    return message + problem;
+}
+
+inline const char* TypeProblem(ArgType type) {
+    switch (type) {
+    case ArgType::kString: return " must be a string";
+    case ArgType::kInteger: return " must be an integer";
+    case ArgType::kNumber: return " must be a number";
+    case ArgType::kBool: return " must be a bool";
+    case ArgType::kMap: return " must be a map";
+    case ArgType::kList: return " must be a list";
+    }
+    return " has the wrong type";
+}
+
+}  // namespace method_args_internal
+
+// Decodes `arguments` against `schema` in one pass over the map. Keys the
+// schema doesn't name are ignored and null values count as absent. Returns
+// false and sets `error` if a field has the wrong type or a required one is
+// missing.
+template <size_t N>
+bool DecodeArgs(const flutter::EncodableMap& arguments, const ArgSchema<N>& schema,
+                ArgValues<N>* values, std::string* error) {
+    using namespace method_args_internal;
+    SMTC_SPAN(span, "channel", "DecodeArgs");
+
+    values->_values.fill(nullptr);
+    for (const auto& [key, value] : arguments) {
+        const auto* name = std::get_if<std::string>(&key);
+        if (!name || value.IsNull()) continue;
+        size_t field = schema.Find(*name);
+        if (field == N) continue;
+        if (!HasType(value, schema.fields[field].type)) {
+            *error = FieldError(schema.fields[field].name, TypeProblem(schema.fields[field].type));
+            return false;
+        }
+        values->_values[field] = &value;
+    }
+    for (size_t field = 0; field < N; ++field) {
+        if (schema.fields[field].required && !values->_values[field]) {
+            *error = FieldError(schema.fields[field].name, " is required");
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace audio_service_smtc
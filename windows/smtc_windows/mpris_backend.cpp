@@ -0,0 +1,683 @@
+#include "mpris_backend.h"
+
+#include <dbus/dbus.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <cstdlib>
+
+#include "event_dispatcher.h"
+#include "native_log.h"
+#include "utf16_transcode.h"
+
+namespace audio_service_smtc {
+
+namespace {
+
+constexpr const char* kObjectPath = "/org/mpris/MediaPlayer2";
+constexpr const char* kRootInterface = "org.mpris.MediaPlayer2";
+constexpr const char* kPlayerInterface = "org.mpris.MediaPlayer2.Player";
+constexpr const char* kPropertiesInterface = "org.freedesktop.DBus.Properties";
+constexpr const char* kIntrospectableInterface = "org.freedesktop.DBus.Introspectable";
+constexpr const char* kNoTrack = "/org/mpris/MediaPlayer2/TrackList/NoTrack";
+
+// A timeline that lands further than this from where the old one would have
+// got to by now is a seek, and is announced with Seeked
+constexpr int64_t kSeekThreshold = 1000000;
+
+constexpr const char* kRootProperties[] = {
+    "CanQuit", "CanRaise", "HasTrackList", "Identity", "SupportedUriSchemes", "SupportedMimeTypes",
+};
+constexpr const char* kPlayerProperties[] = {
+    "PlaybackStatus", "Rate", "Metadata", "Position", "MinimumRate", "MaximumRate",
+    "CanGoNext", "CanGoPrevious", "CanPlay", "CanPause", "CanSeek", "CanControl",
+};
+
+constexpr const char* kIntrospection =
+    DBUS_INTROSPECT_1_0_XML_DOCTYPE_DECL_NODE
+    "<node>\n"
+    " <interface name=\"org.freedesktop.DBus.Introspectable\">\n"
+    "  <method name=\"Introspect\"><arg direction=\"out\" type=\"s\"/></method>\n"
+    " </interface>\n"
+    " <interface name=\"org.freedesktop.DBus.Properties\">\n"
+    "  <method name=\"Get\"><arg direction=\"in\" type=\"s\"/><arg direction=\"in\" type=\"s\"/>"
+    "<arg direction=\"out\" type=\"v\"/></method>\n"
+    "  <method name=\"GetAll\"><arg direction=\"in\" type=\"s\"/><arg direction=\"out\" type=\"a{sv}\"/></method>\n"
+    "  <method name=\"Set\"><arg direction=\"in\" type=\"s\"/><arg direction=\"in\" type=\"s\"/>"
+    "<arg direction=\"in\" type=\"v\"/></method>\n"
+    "  <signal name=\"PropertiesChanged\"><arg type=\"s\"/><arg type=\"a{sv}\"/><arg type=\"as\"/></signal>\n"
+    " </interface>\n"
+    " <interface name=\"org.mpris.MediaPlayer2\">\n"
+    "  <method name=\"Raise\"/><method name=\"Quit\"/>\n"
+    "  <property name=\"CanQuit\" type=\"b\" access=\"read\"/>\n"
+    "  <property name=\"CanRaise\" type=\"b\" access=\"read\"/>\n"
+    "  <property name=\"HasTrackList\" type=\"b\" access=\"read\"/>\n"
+    "  <property name=\"Identity\" type=\"s\" access=\"read\"/>\n"
+    "  <property name=\"SupportedUriSchemes\" type=\"as\" access=\"read\"/>\n"
+    "  <property name=\"SupportedMimeTypes\" type=\"as\" access=\"read\"/>\n"
+    " </interface>\n"
+    " <interface name=\"org.mpris.MediaPlayer2.Player\">\n"
+    "  <method name=\"Next\"/><method name=\"Previous\"/><method name=\"Pause\"/>\n"
+    "  <method name=\"PlayPause\"/><method name=\"Stop\"/><method name=\"Play\"/>\n"
+    "  <method name=\"Seek\"><arg direction=\"in\" type=\"x\"/></method>\n"
+    "  <method name=\"SetPosition\"><arg direction=\"in\" type=\"o\"/><arg direction=\"in\" type=\"x\"/></method>\n"
+    "  <method name=\"OpenUri\"><arg direction=\"in\" type=\"s\"/></method>\n"
+    "  <signal name=\"Seeked\"><arg type=\"x\"/></signal>\n"
+    "  <property name=\"PlaybackStatus\" type=\"s\" access=\"read\"/>\n"
+    "  <property name=\"Rate\" type=\"d\" access=\"read\"/>\n"
+    "  <property name=\"Metadata\" type=\"a{sv}\" access=\"read\"/>\n"
+    "  <property name=\"Position\" type=\"x\" access=\"read\"/>\n"
+    "  <property name=\"MinimumRate\" type=\"d\" access=\"read\"/>\n"
+    "  <property name=\"MaximumRate\" type=\"d\" access=\"read\"/>\n"
+    "  <property name=\"CanGoNext\" type=\"b\" access=\"read\"/>\n"
+    "  <property name=\"CanGoPrevious\" type=\"b\" access=\"read\"/>\n"
+    "  <property name=\"CanPlay\" type=\"b\" access=\"read\"/>\n"
+    "  <property name=\"CanPause\" type=\"b\" access=\"read\"/>\n"
+    "  <property name=\"CanSeek\" type=\"b\" access=\"read\"/>\n"
+    "  <property name=\"CanControl\" type=\"b\" access=\"read\"/>\n"
+    " </interface>\n"
+    "</node>\n";
+
+// D-Bus rejects strings that aren't UTF-8; bad sequences become U+FFFD
+std::string ValidUtf8(std::string_view text) {
+    std::u16string utf16;
+    if (Utf8ToUtf16(text, utf16)) return std::string(text);
+
+    std::string out;
+    for (size_t i = 0; i < utf16.size(); ++i) {
+        uint32_t c = utf16[i];
+        if (c >= 0xD800 && c < 0xDC00 && i + 1 < utf16.size()) {
+            c = 0x10000 + ((c - 0xD800) << 10) + (utf16[++i] - 0xDC00);
+        }
+        if (c < 0x80) {
+            out.push_back(static_cast<char>(c));
+        } else if (c < 0x800) {
+            out.push_back(static_cast<char>(0xC0 | (c >> 6)));
+            out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        } else if (c < 0x10000) {
+            out.push_back(static_cast<char>(0xE0 | (c >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        } else {
+            out.push_back(static_cast<char>(0xF0 | (c >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        }
+    }
+    return out;
+}
+
+// Bus name elements are [A-Za-z0-9_] and may not start with a digit
+std::string BusNameElement(const std::string& identity) {
+    std::string element;
+    for (char c : identity) {
+        element.push_back(std::isalnum(static_cast<unsigned char>(c)) ? c : '_');
+    }
+    if (element.empty() || std::isdigit(static_cast<unsigned char>(element[0]))) element.insert(0, "_");
+    return element;
+}
+
+const char* StatusName(PlaybackState status) {
+    switch (status) {
+    case PlaybackState::kPlaying:
+        return "Playing";
+    case PlaybackState::kPaused:
+        return "Paused";
+    default:
+        return "Stopped";
+    }
+}
+
+void AppendBasic(DBusMessageIter* iter, int type, const void* value) {
+    char signature[2] = { static_cast<char>(type), '\0' };
+    DBusMessageIter variant;
+    dbus_message_iter_open_container(iter, DBUS_TYPE_VARIANT, signature, &variant);
+    dbus_message_iter_append_basic(&variant, type, value);
+    dbus_message_iter_close_container(iter, &variant);
+}
+
+void AppendBool(DBusMessageIter* iter, bool value) {
+    dbus_bool_t b = value ? TRUE : FALSE;
+    AppendBasic(iter, DBUS_TYPE_BOOLEAN, &b);
+}
+
+void AppendDouble(DBusMessageIter* iter, double value) {
+    AppendBasic(iter, DBUS_TYPE_DOUBLE, &value);
+}
+
+void AppendString(DBusMessageIter* iter, const std::string& value) {
+    const char* s = value.c_str();
+    AppendBasic(iter, DBUS_TYPE_STRING, &s);
+}
+
+void AppendStringArray(DBusMessageIter* iter, const std::vector<std::string>& values) {
+    DBusMessageIter variant;
+    DBusMessageIter array;
+    dbus_message_iter_open_container(iter, DBUS_TYPE_VARIANT, "as", &variant);
+    dbus_message_iter_open_container(&variant, DBUS_TYPE_ARRAY, "s", &array);
+    for (const std::string& value : values) {
+        const char* s = value.c_str();
+        dbus_message_iter_append_basic(&array, DBUS_TYPE_STRING, &s);
+    }
+    dbus_message_iter_close_container(&variant, &array);
+    dbus_message_iter_close_container(iter, &variant);
+}
+
+// Writes an a{sv}, wrapped in a variant when `inVariant` is set
+class DictWriter {
+public:
+    explicit DictWriter(DBusMessageIter* iter, bool inVariant) : _iter(iter), _inVariant(inVariant) {
+        DBusMessageIter* parent = iter;
+        if (_inVariant) {
+            dbus_message_iter_open_container(iter, DBUS_TYPE_VARIANT, "a{sv}", &_variant);
+            parent = &_variant;
+        }
+        dbus_message_iter_open_container(parent, DBUS_TYPE_ARRAY, "{sv}", &_array);
+    }
+
+    ~DictWriter() {
+        if (_inVariant) {
+            dbus_message_iter_close_container(&_variant, &_array);
+            dbus_message_iter_close_container(_iter, &_variant);
+        } else {
+            dbus_message_iter_close_container(_iter, &_array);
+        }
+    }
+
+    // Appends the key and returns where its variant value goes; call Close after
+    DBusMessageIter* Key(const char* key) {
+        dbus_message_iter_open_container(&_array, DBUS_TYPE_DICT_ENTRY, nullptr, &_entry);
+        dbus_message_iter_append_basic(&_entry, DBUS_TYPE_STRING, &key);
+        return &_entry;
+    }
+
+    void Close() { dbus_message_iter_close_container(&_array, &_entry); }
+
+private:
+    DBusMessageIter* _iter;
+    bool _inVariant;
+    DBusMessageIter _variant;
+    DBusMessageIter _array;
+    DBusMessageIter _entry;
+};
+
+void AppendMetadata(DBusMessageIter* iter, const MediaMetadata& metadata, const std::string& trackId) {
+    DictWriter dict(iter, true);
+
+    const char* id = trackId.c_str();
+    AppendBasic(dict.Key("mpris:trackid"), DBUS_TYPE_OBJECT_PATH, &id);
+    dict.Close();
+    if (metadata.duration > 0) {
+        dbus_int64_t length = metadata.duration;
+        AppendBasic(dict.Key("mpris:length"), DBUS_TYPE_INT64, &length);
+        dict.Close();
+    }
+    AppendString(dict.Key("xesam:title"), ValidUtf8(metadata.title));
+    dict.Close();
+    if (!metadata.artist.empty()) {
+        AppendStringArray(dict.Key("xesam:artist"), { ValidUtf8(metadata.artist.view()) });
+        dict.Close();
+    }
+    if (!metadata.album.empty()) {
+        AppendString(dict.Key("xesam:album"), ValidUtf8(metadata.album.view()));
+        dict.Close();
+    }
+    if (!metadata.artUrl.empty()) {
+        // Local paths are handed over as file URLs
+        std::string url = metadata.artUrl[0] == '/' ? "file://" + metadata.artUrl : metadata.artUrl;
+        AppendString(dict.Key("mpris:artUrl"), ValidUtf8(url));
+        dict.Close();
+    }
+}
+
+bool IsPlayerProperty(const std::string& name) {
+    for (const char* property : kPlayerProperties) {
+        if (name == property) return true;
+    }
+    return false;
+}
+
+bool IsRootProperty(const std::string& name) {
+    for (const char* property : kRootProperties) {
+        if (name == property) return true;
+    }
+    return false;
+}
+
+}  // namespace
+
+// The libdbus entry point and the property values, with access to the
+// backend's state. AppendProperty callers hold the backend's _mutex.
+struct MprisDispatch {
+    static DBusHandlerResult Message(DBusConnection*, DBusMessage* message, void* user) {
+        auto* backend = static_cast<MprisBackend*>(user);
+        return backend->HandleMessage(message) ? DBUS_HANDLER_RESULT_HANDLED : DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+    }
+
+    static void AppendProperty(const MprisBackend& backend, DBusMessageIter* iter, const std::string& name) {
+        const PlayerState& state = backend._state;
+        if (name == "PlaybackStatus") {
+            AppendString(iter, StatusName(state.status));
+        } else if (name == "Rate") {
+            AppendDouble(iter, state.timeline.rate);
+        } else if (name == "Metadata") {
+            AppendMetadata(iter, state.metadata, backend.TrackId());
+        } else if (name == "Position") {
+            dbus_int64_t position = backend.PositionNow();
+            AppendBasic(iter, DBUS_TYPE_INT64, &position);
+        } else if (name == "MinimumRate") {
+            AppendDouble(iter, 0.25);
+        } else if (name == "MaximumRate") {
+            AppendDouble(iter, 4.0);
+        } else if (name == "CanGoNext") {
+            AppendBool(iter, (state.enabledButtons & kNextButton) != 0);
+        } else if (name == "CanGoPrevious") {
+            AppendBool(iter, (state.enabledButtons & kPreviousButton) != 0);
+        } else if (name == "CanPlay") {
+            AppendBool(iter, (state.enabledButtons & kPlayButton) != 0);
+        } else if (name == "CanPause") {
+            AppendBool(iter, (state.enabledButtons & kPauseButton) != 0);
+        } else if (name == "CanSeek") {
+            AppendBool(iter, state.metadata.duration > 0);
+        } else if (name == "CanControl") {
+            AppendBool(iter, true);
+        } else if (name == "CanQuit" || name == "CanRaise" || name == "HasTrackList") {
+            AppendBool(iter, false);
+        } else if (name == "Identity") {
+            AppendString(iter, ValidUtf8(backend._identity));
+        } else if (name == "SupportedUriSchemes" || name == "SupportedMimeTypes") {
+            AppendStringArray(iter, {});
+        }
+    }
+};
+
+MprisBackend::MprisBackend(const std::string& identity, const std::string& busAddress)
+    : _identity(identity) {
+    _timelineStamp = MonotonicMicros();
+    if (!Connect(busAddress)) {
+        if (_connection) {
+            dbus_connection_close(_connection);
+            dbus_connection_unref(_connection);
+            _connection = nullptr;
+        }
+        _busName.clear();
+        return;
+    }
+    _thread = std::thread(&MprisBackend::Run, this);
+}
+
+MprisBackend::~MprisBackend() {
+    if (_thread.joinable()) {
+        _stopping = true;
+        char byte = 0;
+        (void)!write(_wake[1], &byte, 1);
+        _thread.join();
+    }
+    if (_connection) {
+        dbus_connection_close(_connection);
+        dbus_connection_unref(_connection);
+    }
+    for (int fd : _wake) {
+        if (fd >= 0) close(fd);
+    }
+}
+
+bool MprisBackend::Connect(const std::string& busAddress) {
+    dbus_threads_init_default();
+
+    DBusError error;
+    dbus_error_init(&error);
+    if (busAddress.empty()) {
+        _connection = dbus_bus_get_private(DBUS_BUS_SESSION, &error);
+    } else {
+        _connection = dbus_connection_open_private(busAddress.c_str(), &error);
+        if (_connection) dbus_bus_register(_connection, &error);
+    }
+    if (dbus_error_is_set(&error)) {
+        SMTC_LOG_ERROR("Failed to connect to the session bus", error.message);
+        dbus_error_free(&error);
+        return false;
+    }
+    if (!_connection) return false;
+    // A lost bus must not take the app down with it
+    dbus_connection_set_exit_on_disconnect(_connection, FALSE);
+
+    std::string name = std::string(kRootInterface) + "." + BusNameElement(_identity);
+    int owned = dbus_bus_request_name(_connection, name.c_str(), DBUS_NAME_FLAG_DO_NOT_QUEUE, &error);
+    if (owned != DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER && !dbus_error_is_set(&error)) {
+        // Another instance of the app; the spec's suffix keeps both visible
+        name += ".instance" + std::to_string(getpid());
+        owned = dbus_bus_request_name(_connection, name.c_str(), DBUS_NAME_FLAG_DO_NOT_QUEUE, &error);
+    }
+    if (dbus_error_is_set(&error) || owned != DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER) {
+        SMTC_LOG_ERROR("Failed to own the MPRIS bus name", dbus_error_is_set(&error) ? error.message : name.c_str());
+        dbus_error_free(&error);
+        return false;
+    }
+    _busName = name;
+
+    static const DBusObjectPathVTable kVTable = { nullptr, &MprisDispatch::Message, nullptr, nullptr, nullptr, nullptr };
+    if (!dbus_connection_register_object_path(_connection, kObjectPath, &kVTable, this)) return false;
+
+    if (pipe(_wake) != 0) return false;
+    fcntl(_wake[0], F_SETFL, O_NONBLOCK);
+    fcntl(_wake[1], F_SETFL, O_NONBLOCK);
+    return true;
+}
+
+void MprisBackend::Run() {
+    int busFd = -1;
+    dbus_connection_get_unix_fd(_connection, &busFd);
+
+    // All bus I/O happens here. Callers queue messages and wake the thread
+    // through the pipe, so a send never waits for a poll timeout.
+    while (!_stopping) {
+        dbus_connection_read_write(_connection, 0);
+        while (dbus_connection_dispatch(_connection) == DBUS_DISPATCH_DATA_REMAINS) {}
+        if (!dbus_connection_get_is_connected(_connection)) {
+            SMTC_LOG_WARNING("MPRIS connection lost", _busName);
+            break;
+        }
+
+        pollfd fds[2] = {};
+        fds[0].fd = busFd;
+        fds[0].events = POLLIN;
+        if (dbus_connection_has_messages_to_send(_connection)) fds[0].events |= POLLOUT;
+        fds[1].fd = _wake[0];
+        fds[1].events = POLLIN;
+        poll(fds, 2, -1);
+        if (fds[1].revents & POLLIN) {
+            char drain[64];
+            while (read(_wake[0], drain, sizeof(drain)) > 0) {}
+        }
+    }
+}
+
+bool MprisBackend::Send(DBusMessage* message) {
+    if (!message) return false;
+    bool sent = dbus_connection_send(_connection, message, nullptr);
+    dbus_message_unref(message);
+    char byte = 0;
+    (void)!write(_wake[1], &byte, 1);
+    return sent;
+}
+
+bool MprisBackend::IsReady() const {
+    return _thread.joinable();
+}
+
+bool MprisBackend::ApplyState(const PlayerState& state, uint32_t changed, const ArtworkImage&) {
+    if (!IsReady()) return false;
+
+    DBusMessage* signal = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::vector<const char*> names;
+        if ((changed & kStatusField) && state.status != _state.status) {
+            // Freeze or restart the extrapolated position at the switch
+            _state.timeline.position = PositionNow();
+            _timelineStamp = MonotonicMicros();
+            _state.status = state.status;
+            names.push_back("PlaybackStatus");
+        }
+        if (changed & kMetadataField) {
+            bool seekable = _state.metadata.duration > 0;
+            _state.metadata = state.metadata;
+            ++_track;
+            names.push_back("Metadata");
+            if (seekable != (state.metadata.duration > 0)) names.push_back("CanSeek");
+        }
+        if ((changed & kButtonsField) && state.enabledButtons != _state.enabledButtons) {
+            _state.enabledButtons = state.enabledButtons;
+            names.insert(names.end(), { "CanPlay", "CanPause", "CanGoNext", "CanGoPrevious" });
+        }
+        if (names.empty()) return true;
+        // One signal for the whole commit
+        signal = PropertiesChanged(kPlayerInterface, names);
+    }
+    return Send(signal);
+}
+
+bool MprisBackend::UpdateThumbnail(const ArtworkImage&) {
+    // MPRIS clients load mpris:artUrl themselves; it went out with the metadata
+    return IsReady();
+}
+
+bool MprisBackend::UpdateTimeline(const TimelineSnapshot& timeline) {
+    if (!IsReady()) return false;
+
+    DBusMessage* rateSignal = nullptr;
+    DBusMessage* seeked = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        int64_t expected = PositionNow();
+        bool rateChanged = timeline.rate != _state.timeline.rate;
+        _state.timeline = timeline;
+        _timelineStamp = MonotonicMicros();
+
+        if (rateChanged) rateSignal = PropertiesChanged(kPlayerInterface, { "Rate" });
+        if (std::llabs(timeline.position - expected) > kSeekThreshold) {
+            seeked = dbus_message_new_signal(kObjectPath, kPlayerInterface, "Seeked");
+            dbus_int64_t position = timeline.position;
+            if (seeked) dbus_message_append_args(seeked, DBUS_TYPE_INT64, &position, DBUS_TYPE_INVALID);
+        }
+    }
+    bool ok = true;
+    if (rateSignal) ok = Send(rateSignal) && ok;
+    if (seeked) ok = Send(seeked) && ok;
+    return ok;
+}
+
+void MprisBackend::SetControlCallback(std::function<void(const std::string&)> callback) {
+    std::lock_guard<std::mutex> lock(_callbackMutex);
+    _controlCallback = std::move(callback);
+}
+
+void MprisBackend::SetPositionCallback(std::function<void(int64_t)> callback) {
+    std::lock_guard<std::mutex> lock(_callbackMutex);
+    _positionCallback = std::move(callback);
+}
+
+bool MprisBackend::HandleMessage(DBusMessage* message) {
+    if (dbus_message_get_type(message) != DBUS_MESSAGE_TYPE_METHOD_CALL) return false;
+
+    const char* interface = dbus_message_get_interface(message);
+    const char* member = dbus_message_get_member(message);
+    if (!interface || !member) return false;
+
+    std::string name(interface);
+    if (name == kPlayerInterface) return HandlePlayerMethod(message, member);
+    if (name == kPropertiesInterface) return HandleProperties(message, member);
+    if (name == kIntrospectableInterface && std::string(member) == "Introspect") {
+        DBusMessage* reply = dbus_message_new_method_return(message);
+        const char* xml = kIntrospection;
+        if (reply) dbus_message_append_args(reply, DBUS_TYPE_STRING, &xml, DBUS_TYPE_INVALID);
+        Send(reply);
+        return true;
+    }
+    if (name == kRootInterface) {
+        // Raise and Quit: CanRaise and CanQuit are false, so they do nothing
+        Send(dbus_message_new_method_return(message));
+        return true;
+    }
+    return false;
+}
+
+bool MprisBackend::HandlePlayerMethod(DBusMessage* message, const char* member) {
+    std::string method(member);
+    if (method == "Play") {
+        Control(kPlayButton, "play");
+    } else if (method == "Pause") {
+        Control(kPauseButton, "pause");
+    } else if (method == "PlayPause") {
+        bool playing;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            playing = _state.status == PlaybackState::kPlaying;
+        }
+        if (playing) {
+            Control(kPauseButton, "pause");
+        } else {
+            Control(kPlayButton, "play");
+        }
+    } else if (method == "Next") {
+        Control(kNextButton, "next");
+    } else if (method == "Previous") {
+        Control(kPreviousButton, "previous");
+    } else if (method == "Stop") {
+        Control(kStopButton, "stop");
+    } else if (method == "Seek") {
+        dbus_int64_t offset = 0;
+        if (!dbus_message_get_args(message, nullptr, DBUS_TYPE_INT64, &offset, DBUS_TYPE_INVALID)) {
+            Send(dbus_message_new_error(message, DBUS_ERROR_INVALID_ARGS, "Seek takes an offset"));
+            return true;
+        }
+        int64_t target;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            target = PositionNow() + offset;
+        }
+        RequestPosition(target < 0 ? 0 : target);
+    } else if (method == "SetPosition") {
+        const char* trackId = nullptr;
+        dbus_int64_t position = 0;
+        if (!dbus_message_get_args(message, nullptr, DBUS_TYPE_OBJECT_PATH, &trackId, DBUS_TYPE_INT64, &position,
+                                   DBUS_TYPE_INVALID)) {
+            Send(dbus_message_new_error(message, DBUS_ERROR_INVALID_ARGS, "SetPosition takes a track id and position"));
+            return true;
+        }
+        bool current;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            current = TrackId() == trackId;
+        }
+        // Stale requests for a previous track are ignored, as the spec asks
+        if (current && position >= 0) RequestPosition(position);
+    } else if (method == "OpenUri") {
+        Send(dbus_message_new_error(message, DBUS_ERROR_NOT_SUPPORTED, "OpenUri is not supported"));
+        return true;
+    } else {
+        return false;
+    }
+    Send(dbus_message_new_method_return(message));
+    return true;
+}
+
+bool MprisBackend::HandleProperties(DBusMessage* message, const char* member) {
+    std::string method(member);
+    const char* interface = nullptr;
+    const char* property = nullptr;
+
+    if (method == "Get") {
+        if (!dbus_message_get_args(message, nullptr, DBUS_TYPE_STRING, &interface, DBUS_TYPE_STRING, &property,
+                                   DBUS_TYPE_INVALID)) {
+            Send(dbus_message_new_error(message, DBUS_ERROR_INVALID_ARGS, "Get takes an interface and a name"));
+            return true;
+        }
+        std::string name(property);
+        bool known = std::string(interface) == kPlayerInterface ? IsPlayerProperty(name)
+                   : std::string(interface) == kRootInterface   ? IsRootProperty(name)
+                                                                : false;
+        if (!known) {
+            Send(dbus_message_new_error(message, DBUS_ERROR_UNKNOWN_PROPERTY, property));
+            return true;
+        }
+        DBusMessage* reply = dbus_message_new_method_return(message);
+        if (reply) {
+            DBusMessageIter iter;
+            dbus_message_iter_init_append(reply, &iter);
+            std::lock_guard<std::mutex> lock(_mutex);
+            MprisDispatch::AppendProperty(*this, &iter, name);
+        }
+        Send(reply);
+        return true;
+    }
+
+    if (method == "GetAll") {
+        if (!dbus_message_get_args(message, nullptr, DBUS_TYPE_STRING, &interface, DBUS_TYPE_INVALID)) {
+            Send(dbus_message_new_error(message, DBUS_ERROR_INVALID_ARGS, "GetAll takes an interface"));
+            return true;
+        }
+        DBusMessage* reply = dbus_message_new_method_return(message);
+        if (reply) {
+            DBusMessageIter iter;
+            dbus_message_iter_init_append(reply, &iter);
+            DictWriter dict(&iter, false);
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (std::string(interface) == kPlayerInterface) {
+                for (const char* name : kPlayerProperties) {
+                    MprisDispatch::AppendProperty(*this, dict.Key(name), name);
+                    dict.Close();
+                }
+            } else if (std::string(interface) == kRootInterface) {
+                for (const char* name : kRootProperties) {
+                    MprisDispatch::AppendProperty(*this, dict.Key(name), name);
+                    dict.Close();
+                }
+            }
+        }
+        Send(reply);
+        return true;
+    }
+
+    if (method == "Set") {
+        Send(dbus_message_new_error(message, DBUS_ERROR_PROPERTY_READ_ONLY, "Properties are read-only"));
+        return true;
+    }
+    return false;
+}
+
+void MprisBackend::Control(uint32_t button, const char* command) {
+    {
+        // A disabled button is a no-op, as the Can* properties promise
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!(_state.enabledButtons & button)) return;
+    }
+    std::lock_guard<std::mutex> lock(_callbackMutex);
+    if (_controlCallback) _controlCallback(command);
+}
+
+void MprisBackend::RequestPosition(int64_t position) {
+    std::lock_guard<std::mutex> lock(_callbackMutex);
+    if (_positionCallback) _positionCallback(position);
+}
+
+int64_t MprisBackend::PositionNow() const {
+    const TimelineSnapshot& timeline = _state.timeline;
+    int64_t position = timeline.position;
+    if (_state.status == PlaybackState::kPlaying) {
+        position += static_cast<int64_t>(static_cast<double>(MonotonicMicros() - _timelineStamp) * timeline.rate);
+    }
+    if (timeline.duration > 0 && position > timeline.duration) position = timeline.duration;
+    return position < 0 ? 0 : position;
+}
+
+std::string MprisBackend::TrackId() const {
+    if (_track == 0) return kNoTrack;
+    return std::string(kObjectPath) + "/track/" + std::to_string(_track);
+}
+
+DBusMessage* MprisBackend::PropertiesChanged(const char* interface, const std::vector<const char*>& names) const {
+    DBusMessage* signal = dbus_message_new_signal(kObjectPath, kPropertiesInterface, "PropertiesChanged");
+    if (!signal) return nullptr;
+
+    DBusMessageIter iter;
+    dbus_message_iter_init_append(signal, &iter);
+    dbus_message_iter_append_basic(&iter, DBUS_TYPE_STRING, &interface);
+    {
+        DictWriter dict(&iter, false);
+        for (const char* name : names) {
+            MprisDispatch::AppendProperty(*this, dict.Key(name), name);
+            dict.Close();
+        }
+    }
+    DBusMessageIter invalidated;
+    dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "s", &invalidated);
+    dbus_message_iter_close_container(&iter, &invalidated);
+    return signal;
+}
+
+}  // namespace audio_service_smtc
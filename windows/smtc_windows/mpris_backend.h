@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "media_backend.h"
+
+// Linux only, and not part of the Windows build: needs libdbus-1
+// (pkg-config dbus-1).
+struct DBusConnection;
+struct DBusMessage;
+
+namespace audio_service_smtc {
+
+// Publishes the session over MPRIS (org.mpris.MediaPlayer2) on the D-Bus
+// session bus. Each ApplyState emits at most one PropertiesChanged signal
+// carrying every property the commit changed. Position is never signalled:
+// clients read it, and it is extrapolated from the last timeline on demand.
+// A jump in the timeline is announced with Seeked, as the spec asks.
+//
+// Method calls from clients are handled on a thread of the backend's own,
+// which is also where the control and position callbacks fire.
+class MprisBackend final : public MediaBackend {
+public:
+    // Connects to the session bus, or to `busAddress` if given, and owns
+    // org.mpris.MediaPlayer2.<identity> (with an instance suffix if another
+    // process already does).
+    explicit MprisBackend(const std::string& identity, const std::string& busAddress = "");
+    ~MprisBackend() override;
+
+    MprisBackend(const MprisBackend&) = delete;
+    MprisBackend& operator=(const MprisBackend&) = delete;
+
+    bool IsReady() const override;
+    bool ApplyState(const PlayerState& state, uint32_t changed, const ArtworkImage& artwork) override;
+    bool UpdateThumbnail(const ArtworkImage& artwork) override;
+    bool UpdateTimeline(const TimelineSnapshot& timeline) override;
+    void SetControlCallback(std::function<void(const std::string&)> callback) override;
+    void SetPositionCallback(std::function<void(int64_t)> callback) override;
+
+    // The well-known name owned on the bus; empty if not ready
+    const std::string& busName() const { return _busName; }
+
+private:
+    friend struct MprisDispatch;
+
+    bool Connect(const std::string& busAddress);
+    void Run();
+
+    // Queues `message` for the bus thread to write, and drops the reference
+    bool Send(DBusMessage* message);
+
+    // Runs on the bus thread. False if the message isn't for us.
+    bool HandleMessage(DBusMessage* message);
+    bool HandlePlayerMethod(DBusMessage* message, const char* member);
+    bool HandleProperties(DBusMessage* message, const char* member);
+
+    void Control(uint32_t button, const char* command);
+    void RequestPosition(int64_t position);
+
+    // Callers hold _mutex
+    int64_t PositionNow() const;
+    std::string TrackId() const;
+    DBusMessage* PropertiesChanged(const char* interface, const std::vector<const char*>& names) const;
+
+    std::string _identity;
+    std::string _busName;
+    DBusConnection* _connection = nullptr;
+    int _wake[2] = { -1, -1 };
+    std::atomic<bool> _stopping{ false };
+    std::thread _thread;
+
+    // What the properties report. Guards nothing the bus thread blocks on.
+    mutable std::mutex _mutex;
+    PlayerState _state;
+    int64_t _timelineStamp = 0;   // MonotonicMicros() when the timeline was last set
+    uint64_t _track = 0;          // bumped for each new metadata, names the track id
+
+    std::function<void(const std::string&)> _controlCallback;
+    std::function<void(int64_t)> _positionCallback;
+    std::mutex _callbackMutex;
+};
+
+}  // namespace audio_service_smtc
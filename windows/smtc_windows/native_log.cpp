@@ -0,0 +1,244 @@
+#include "native_log.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "event_dispatcher.h"
+#include "memory_budget.h"
+
+namespace audio_service_smtc {
+
+namespace {
+
+constexpr size_t kRingSize = 128;  // power of two
+constexpr uint32_t kSiteRateLimit = 10;
+constexpr int64_t kSiteRateWindow = 1000000;
+// Records are written out in batches at most this often
+constexpr auto kFlushInterval = std::chrono::milliseconds(100);
+
+// Single-producer, single-consumer ring owned by one logging thread.
+struct LogRing {
+    std::array<LogRecord, kRingSize> records;
+    std::atomic<uint64_t> head{ 0 };  // written by the owning thread
+    std::atomic<uint64_t> tail{ 0 };  // written by whoever drains
+    std::atomic<bool> retired{ false };
+    uint32_t thread = 0;
+};
+
+void WriteToDefaultSink(const LogRecord& record) {
+    char line[256];
+    std::string_view detail = record.Detail();
+    int length;
+    if (record.suppressed != 0) {
+        length = std::snprintf(line, sizeof(line), "[audio_service_smtc] %s t%u %s%s%.*s (%u similar suppressed)\n",
+            LogLevelName(record.site->level), record.thread, record.site->message,
+            detail.empty() ? "" : ": ", static_cast<int>(detail.size()), detail.data(), record.suppressed);
+    } else {
+        length = std::snprintf(line, sizeof(line), "[audio_service_smtc] %s t%u %s%s%.*s\n",
+            LogLevelName(record.site->level), record.thread, record.site->message,
+            detail.empty() ? "" : ": ", static_cast<int>(detail.size()), detail.data());
+    }
+    if (length <= 0) return;
+
+#ifdef _WIN32
+    OutputDebugStringA(line);
+#endif
+    std::fputs(line, stderr);
+}
+
+// Owns the rings of all threads and writes them out on its own thread, so
+// logging threads never wait on console or debugger I/O.
+class LogFlusher {
+public:
+    // Never destroyed: threads may log while statics are torn down
+    static LogFlusher& Instance() {
+        static LogFlusher* flusher = new LogFlusher();
+        return *flusher;
+    }
+
+    std::shared_ptr<LogRing> Register() {
+        auto ring = std::make_shared<LogRing>();
+        // Freed by the flusher once the thread is gone
+        MemoryBudget::Shared().Charge(MemoryCategory::kLog, sizeof(LogRing));
+        std::lock_guard<std::mutex> lock(_mutex);
+        ring->thread = ++_lastThread;
+        _rings.push_back(ring);
+        return ring;
+    }
+
+    // Called after a record is written. Only the first record of a batch
+    // takes the wake lock, which the flusher never holds while writing.
+    void NotifyPending() {
+        if (_pending.exchange(true, std::memory_order_acq_rel)) return;
+        std::lock_guard<std::mutex> lock(_wakeMutex);
+        _wake.notify_one();
+    }
+
+    void SetSink(LogSink sink) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _sink = std::move(sink);
+    }
+
+    void Flush() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        DrainLocked();
+    }
+
+    std::atomic<uint64_t> dropped{ 0 };
+
+private:
+    LogFlusher() {
+        _thread = std::thread(&LogFlusher::Run, this);
+        _thread.detach();
+    }
+
+    void Run() {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(_wakeMutex);
+                _wake.wait(lock, [this] { return _pending.load(std::memory_order_acquire); });
+            }
+            // Let a burst collect before writing it out
+            std::this_thread::sleep_for(kFlushInterval);
+            _pending.store(false, std::memory_order_release);
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            DrainLocked();
+        }
+    }
+
+    void DrainLocked() {
+        for (auto it = _rings.begin(); it != _rings.end();) {
+            LogRing& ring = **it;
+            // Read before draining, so a ring retired meanwhile is drained
+            // once more before it goes
+            bool retired = ring.retired.load(std::memory_order_acquire);
+            uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+            uint64_t head = ring.head.load(std::memory_order_acquire);
+            for (; tail != head; ++tail) {
+                const LogRecord& record = ring.records[tail & (kRingSize - 1)];
+                if (_sink) {
+                    _sink(record);
+                } else {
+                    WriteToDefaultSink(record);
+                }
+            }
+            ring.tail.store(tail, std::memory_order_release);
+
+            if (retired) {
+                it = _rings.erase(it);
+                MemoryBudget::Shared().Release(MemoryCategory::kLog, sizeof(LogRing));
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    std::mutex _mutex;  // rings and sink
+    std::vector<std::shared_ptr<LogRing>> _rings;
+    LogSink _sink;
+    uint32_t _lastThread = 0;
+
+    std::mutex _wakeMutex;
+    std::condition_variable _wake;
+    std::atomic<bool> _pending{ false };
+    std::thread _thread;
+};
+
+// Marks the ring retired when its thread exits; the flusher frees it.
+struct ThreadRing {
+    std::shared_ptr<LogRing> ring;
+
+    ~ThreadRing() {
+        if (ring) ring->retired.store(true, std::memory_order_release);
+    }
+};
+
+thread_local ThreadRing t_ring;
+
+bool AdmitBySiteRate(LogSite& site, int64_t now) {
+    int64_t start = site.windowStart.load(std::memory_order_relaxed);
+    if (now - start >= kSiteRateWindow &&
+        site.windowStart.compare_exchange_strong(start, now, std::memory_order_relaxed)) {
+        site.windowCount.store(0, std::memory_order_relaxed);
+    }
+    if (site.windowCount.fetch_add(1, std::memory_order_relaxed) < kSiteRateLimit) {
+        return true;
+    }
+    site.suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+}  // namespace
+
+const char* LogLevelName(LogLevel level) {
+    switch (level) {
+    case LogLevel::kTrace:
+        return "TRACE";
+    case LogLevel::kDebug:
+        return "DEBUG";
+    case LogLevel::kInfo:
+        return "INFO";
+    case LogLevel::kWarning:
+        return "WARNING";
+    default:
+        return "ERROR";
+    }
+}
+
+void SetLogSink(LogSink sink) {
+    LogFlusher::Instance().SetSink(std::move(sink));
+}
+
+void Log(LogSite& site, std::string_view detail) {
+    int64_t now = MonotonicMicros();
+    if (!AdmitBySiteRate(site, now)) return;
+
+    LogFlusher& flusher = LogFlusher::Instance();
+    if (!t_ring.ring) {
+        // Once per thread
+        t_ring.ring = flusher.Register();
+    }
+    LogRing& ring = *t_ring.ring;
+
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) >= kRingSize) {
+        flusher.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    LogRecord& record = ring.records[head & (kRingSize - 1)];
+    record.timestamp = now;
+    record.site = &site;
+    record.thread = ring.thread;
+    record.suppressed = site.suppressed.exchange(0, std::memory_order_relaxed);
+    record.detailLength = static_cast<uint32_t>(detail.size() < LogRecord::kMaxDetail ? detail.size() : LogRecord::kMaxDetail);
+    if (record.detailLength != 0) {
+        std::memcpy(record.detail, detail.data(), record.detailLength);
+    }
+    ring.head.store(head + 1, std::memory_order_release);
+
+    flusher.NotifyPending();
+}
+
+void FlushLog() {
+    LogFlusher::Instance().Flush();
+}
+
+uint64_t DroppedLogRecords() {
+    return LogFlusher::Instance().dropped.load(std::memory_order_relaxed);
+}
+
+}  // namespace audio_service_smtc
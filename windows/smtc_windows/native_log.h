@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+
+// Levels below this are compiled out, arguments included. 0 trace, 1 debug,
+// 2 info, 3 warning, 4 error, 5 off.
+#ifndef SMTC_LOG_LEVEL
+#define SMTC_LOG_LEVEL 2
+#endif
+
+namespace audio_service_smtc {
+
+enum class LogLevel {
+    kTrace = 0,
+    kDebug = 1,
+    kInfo = 2,
+    kWarning = 3,
+    kError = 4,
+};
+
+const char* LogLevelName(LogLevel level);
+
+// One log statement. Each site is rate limited on its own, so an error storm
+// from one call keeps the rest of the log readable.
+struct LogSite {
+    LogLevel level;
+    const char* message;
+    std::atomic<int64_t> windowStart{ 0 };
+    std::atomic<uint32_t> windowCount{ 0 };
+    std::atomic<uint32_t> suppressed{ 0 };
+
+    LogSite(LogLevel level, const char* message) : level(level), message(message) {}
+};
+
+struct LogRecord {
+    static constexpr size_t kMaxDetail = 112;
+
+    int64_t timestamp = 0;         // MonotonicMicros()
+    const LogSite* site = nullptr;
+    uint32_t thread = 0;           // small per-thread number, in order of first log
+    uint32_t suppressed = 0;       // records this site dropped before this one
+    uint32_t detailLength = 0;
+    char detail[kMaxDetail];       // truncated copy, not NUL-terminated
+
+    std::string_view Detail() const { return std::string_view(detail, detailLength); }
+};
+
+// Receives records on the flush thread, in order per thread.
+using LogSink = std::function<void(const LogRecord& record)>;
+
+// Replaces the sink; null restores the default (OutputDebugString on Windows,
+// stderr elsewhere).
+void SetLogSink(LogSink sink);
+
+// Writes a record into the calling thread's ring without locking or
+// allocating. Drops it if the site is over its rate or the ring is full.
+void Log(LogSite& site, std::string_view detail);
+
+// Blocks until everything logged so far has reached the sink.
+void FlushLog();
+
+// Records dropped because a thread's ring was full.
+uint64_t DroppedLogRecords();
+
+}  // namespace audio_service_smtc
+
+#define SMTC_LOG(level, message, detail)                                                   \
+    do {                                                                                   \
+        if constexpr (static_cast<int>(level) >= SMTC_LOG_LEVEL) {                         \
+            static ::audio_service_smtc::LogSite smtcLogSite_{ level, message };           \
+            ::audio_service_smtc::Log(smtcLogSite_, detail);                               \
+        }                                                                                  \
+    } while (0)
+
+#define SMTC_LOG_TRACE(message, detail) SMTC_LOG(::audio_service_smtc::LogLevel::kTrace, message, detail)
+#define SMTC_LOG_DEBUG(message, detail) SMTC_LOG(::audio_service_smtc::LogLevel::kDebug, message, detail)
+#define SMTC_LOG_INFO(message, detail) SMTC_LOG(::audio_service_smtc::LogLevel::kInfo, message, detail)
+#define SMTC_LOG_WARNING(message, detail) SMTC_LOG(::audio_service_smtc::LogLevel::kWarning, message, detail)
+#define SMTC_LOG_ERROR(message, detail) SMTC_LOG(::audio_service_smtc::LogLevel::kError, message, detail)
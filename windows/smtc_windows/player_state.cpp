@@ -0,0 +1,58 @@
+#include "player_state.h"
+
+#include <utility>
+
+namespace audio_service_smtc {
+
+namespace {
+
+struct LastInterned {
+    InternedString artist;
+    InternedString album;
+};
+
+thread_local LastInterned t_last;
+
+const InternedString& InternField(InternedString& last, std::string_view text) {
+    if (text != last.view()) last = InternedString(text);
+    return last;
+}
+
+}  // namespace
+
+MediaMetadata MakeMetadata(std::string title, std::string_view artist, std::string_view album,
+                           std::string artUrl, int64_t duration) {
+    return MediaMetadata{ std::move(title), InternField(t_last.artist, artist), InternField(t_last.album, album),
+                          std::move(artUrl), duration };
+}
+
+void PlayerStatePatch::Merge(const PlayerStatePatch& newer) {
+    if (newer.status) status = newer.status;
+    if (newer.metadata) metadata = newer.metadata;
+    if (newer.timeline) timeline = newer.timeline;
+    if (newer.enabledButtons) enabledButtons = newer.enabledButtons;
+}
+
+uint32_t PlayerStateStore::Apply(const PlayerStatePatch& patch) {
+    uint32_t changed = 0;
+
+    if (patch.status && *patch.status != _state.status) {
+        _state.status = *patch.status;
+        changed |= kStatusField;
+    }
+    if (patch.metadata && *patch.metadata != _state.metadata) {
+        _state.metadata = *patch.metadata;
+        changed |= kMetadataField;
+    }
+    if (patch.timeline) {
+        _state.timeline = *patch.timeline;
+        changed |= kTimelineField;
+    }
+    if (patch.enabledButtons && *patch.enabledButtons != _state.enabledButtons) {
+        _state.enabledButtons = *patch.enabledButtons;
+        changed |= kButtonsField;
+    }
+    return changed;
+}
+
+}  // namespace audio_service_smtc
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "string_pool.h"
+#include "timeline_publisher.h"
+
+namespace audio_service_smtc {
+
+// Bits of PlayerState::enabledButtons.
+enum ControlButton : uint32_t {
+    kPlayButton = 1u << 0,
+    kPauseButton = 1u << 1,
+    kNextButton = 1u << 2,
+    kPreviousButton = 1u << 3,
+    kStopButton = 1u << 4,
+    kAllButtons = (1u << 5) - 1,
+};
+
+// Bits describing which parts of a PlayerState a patch touched or changed.
+enum StateField : uint32_t {
+    kStatusField = 1u << 0,
+    kMetadataField = 1u << 1,
+    kTimelineField = 1u << 2,
+    kButtonsField = 1u << 3,
+};
+
+// Artist and album repeat across a queue, so they are interned: copies along
+// the update path bump a refcount and comparing them is an id compare.
+struct MediaMetadata {
+    std::string title;
+    InternedString artist;
+    InternedString album;
+    std::string artUrl;
+    int64_t duration = 0;
+
+    bool operator==(const MediaMetadata& other) const {
+        return duration == other.duration && title == other.title && artist == other.artist &&
+               album == other.album && artUrl == other.artUrl;
+    }
+    bool operator!=(const MediaMetadata& other) const { return !(*this == other); }
+};
+
+// Metadata from decoded strings. Each thread keeps the last artist and album
+// it interned; text equal to the field's last value reuses that handle
+// without going to the pool, so a value is interned once per run of updates
+// that repeat it. This is the only place their text is compared; diffs
+// further on compare ids.
+MediaMetadata MakeMetadata(std::string title, std::string_view artist, std::string_view album,
+                           std::string artUrl, int64_t duration);
+
+// Everything the backend shows for the session.
+struct PlayerState {
+    PlaybackState status = PlaybackState::kClosed;
+    MediaMetadata metadata;
+    TimelineSnapshot timeline;
+    uint32_t enabledButtons = kAllButtons;
+};
+
+// Any subset of a PlayerState, applied as one transaction.
+struct PlayerStatePatch {
+    std::optional<PlaybackState> status;
+    std::optional<MediaMetadata> metadata;
+    std::optional<TimelineSnapshot> timeline;
+    std::optional<uint32_t> enabledButtons;
+
+    bool empty() const { return !status && !metadata && !timeline && !enabledButtons; }
+
+    // Folds a newer patch into this one; fields set in `newer` win.
+    void Merge(const PlayerStatePatch& newer);
+};
+
+// Holds the committed state and works out what a patch actually changes.
+class PlayerStateStore {
+public:
+    // Applies `patch` and returns the StateField bits that changed. A
+    // timeline counts as changed whenever one is supplied, since positions
+    // are samples rather than state.
+    uint32_t Apply(const PlayerStatePatch& patch);
+
+    const PlayerState& Committed() const { return _state; }
+
+private:
+    PlayerState _state;
+};
+
+}  // namespace audio_service_smtc
@@ -0,0 +1,144 @@
+#include "position_estimator.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace audio_service_smtc {
+
+namespace {
+
+constexpr double kMicros = 1e6;
+
+}  // namespace
+
+void PositionEstimator::Restart(int64_t position, double rate, int64_t now) {
+    _rate = rate;
+    StartSegment(position, now);
+
+    _anchorAt = now;
+    _anchorPosition = static_cast<double>(position);
+    _slope = _rate * (1.0 + _drift);
+    _correction = 0.0;
+}
+
+PositionEstimator::SampleKind PositionEstimator::AddSample(int64_t position, int64_t now) {
+    double sinceLast = static_cast<double>(std::max<int64_t>(0, now - _lastSampleAt));
+    double error = position - FitAt(now);
+    double residual = std::fabs(error);
+    if (residual > _options.seekThreshold + _options.maxDrift * std::fabs(_rate) * sinceLast) {
+        Restart(position, _rate, now);
+        AddSample(position, now);
+        return SampleKind::kSeek;
+    }
+
+    bool first = _samples == 0;
+    double weight = 1.0;
+    if (first) {
+        // Where Restart() started from was a guess; measure from the sample
+        StartSegment(position, now);
+    } else {
+        double decay = std::exp2(-sinceLast / static_cast<double>(_options.halfLife));
+        _w *= decay;
+        _wx *= decay;
+        _wy *= decay;
+        _wxx *= decay;
+        _wxy *= decay;
+        _priorWeight = std::max(BaseWeight(), _priorWeight * decay);
+        double offsetDecay = std::exp2(-sinceLast / static_cast<double>(_options.offsetHalfLife));
+        _ow *= offsetDecay;
+        _owx *= offsetDecay;
+        _owy *= offsetDecay;
+
+        // What jitter and the drift still unknown could explain; past
+        // that the sample's weight falls off with its distance
+        double spread = _w > 0.0 ? _wxx - _wx * _wx / _w : 0.0;
+        double jitter = _options.jitter / kMicros;
+        double driftError = std::min(_options.maxDrift, jitter / std::sqrt(spread + _priorWeight));
+        double expected = _options.jitter + 2.0 * driftError * std::fabs(_rate) * sinceLast;
+        // Delivery delays only ever make a sample look old
+        bool behind = error * _rate < 0.0;
+        if (behind && residual > expected) weight = expected / residual;
+    }
+
+    double x = _rate * (now - _originAt) / kMicros;
+    double y = (position - _originPosition) / kMicros - x;
+    _w += weight;
+    _wx += weight * x;
+    _wy += weight * y;
+    _wxx += weight * x * x;
+    _wxy += weight * x * y;
+    _ow += weight;
+    _owx += weight * x;
+    _owy += weight * y;
+    _lastSampleAt = now;
+    ++_samples;
+
+    Refit();
+    SlewTo(now);
+    return first ? SampleKind::kStart : SampleKind::kTracked;
+}
+
+int64_t PositionEstimator::PositionAt(int64_t now) const {
+    double elapsed = static_cast<double>(now - _anchorAt);
+    double blend = std::min(1.0, elapsed / _slewFor);
+    return std::llround(_anchorPosition + _slope * elapsed + _correction * blend);
+}
+
+double PositionEstimator::FitAt(int64_t now) const {
+    double elapsed = static_cast<double>(now - _originAt);
+    return _originPosition + _rate * (1.0 + _drift) * elapsed + _offset * kMicros;
+}
+
+double PositionEstimator::BaseWeight() const {
+    double span = _rate * _options.driftPriorSpan / kMicros;
+    return span * span / 2.0;
+}
+
+void PositionEstimator::Refit() {
+    // Least squares for offset + drift * x, plus lambda * (drift - prior)^2
+    // so a short or sparse segment leans on what was learned before it
+    double lambda = _priorWeight;
+    double det = _w * (_wxx + lambda) - _wx * _wx;
+
+    double drift = _priorDrift;
+    if (det > 1e-12) {
+        drift = (_w * (_wxy + lambda * _priorDrift) - _wx * _wy) / det;
+    }
+    _drift = std::clamp(drift, -_options.maxDrift, _options.maxDrift);
+    _offset = _ow > 0.0 ? (_owy - _drift * _owx) / _ow : 0.0;
+}
+
+void PositionEstimator::StartSegment(int64_t position, int64_t now) {
+    // What the ending segment said about drift carries over in full, as if
+    // one regression with an offset per segment ran across all of them
+    if (_w > 0.0) _priorWeight += _wxx - _wx * _wx / _w;
+    _priorWeight = std::max(BaseWeight(), _priorWeight);
+
+    _originPosition = position;
+    _originAt = now;
+    _lastSampleAt = now;
+    _priorDrift = _drift;
+    _w = _wx = _wy = _wxx = _wxy = 0.0;
+    _ow = _owx = _owy = 0.0;
+    _offset = 0.0;
+    _samples = 0;
+}
+
+void PositionEstimator::SlewTo(int64_t now) {
+    double current = _anchorPosition + _slope * (now - _anchorAt) +
+                     _correction * std::min(1.0, static_cast<double>(now - _anchorAt) / _slewFor);
+
+    _anchorAt = now;
+    _anchorPosition = current;
+    _slope = _rate * (1.0 + _drift);
+    _correction = FitAt(now) - current;
+
+    // Pulling back faster than half the slope would stall or reverse
+    double slewFor = static_cast<double>(_options.slewTime);
+    if (_correction * _slope < 0.0) {
+        slewFor = std::max(slewFor, 2.0 * std::fabs(_correction / _slope));
+    }
+    _slewFor = std::max<int64_t>(1, static_cast<int64_t>(slewFor));
+}
+
+}  // namespace audio_service_smtc
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+
+namespace audio_service_smtc {
+
+// Tracks the playback position between the player's occasional samples.
+//
+// The player's position advances on the audio device's clock, which runs a
+// little fast or slow against ours, and each sample reaches us with some
+// jitter. Extrapolating every sample at the nominal rate therefore steps at
+// the next one, by more the longer samples are apart. Instead this fits the
+// effective rate and offset to the samples seen since playback last started
+// or seeked: a linear regression in which older samples fade out, pulled
+// towards the drift estimated so far. The drift belongs to the device, so it
+// carries over seeks, pauses and rate changes.
+//
+// The position handed out never steps while playing. When a sample moves the
+// estimate, the difference is blended in over `slewTime`, or longer if it
+// would otherwise slow playback below half speed, so it never runs backwards
+// either. A sample too far off to be drift or jitter is taken as a seek and
+// jumped to.
+//
+// Like TimelinePolicy it is a pure state machine driven by explicit
+// timestamps. Times and positions are in microseconds.
+class PositionEstimator {
+public:
+    struct Options {
+        // A sample further than this from the estimate, plus what drift could
+        // account for since the previous sample, is a seek
+        int64_t seekThreshold = 1000000;
+        // How far the device clock may run from ours, as a fraction
+        double maxDrift = 0.01;
+        // Samples lose half their say in the drift after this long...
+        int64_t halfLife = 300000000;
+        // ...and in the offset after this long, so a drift that wanders
+        // doesn't leave the position lagging
+        int64_t offsetHalfLife = 10000000;
+        // How strongly the drift assumed at first (none) holds against
+        // samples, as the time span a pair of them would need to outweigh it
+        int64_t driftPriorSpan = 10000000;
+        // Typical sample jitter. Samples further off than this and the
+        // drift uncertainty explain count for less, so one that arrives
+        // late barely moves the estimate
+        int64_t jitter = 50000;
+        // Shortest time a correction is blended in over
+        int64_t slewTime = 2000000;
+    };
+
+    enum class SampleKind {
+        kTracked,  // consistent with the estimate; blended in
+        kStart,    // the first sample since Restart()
+        kSeek,     // too far off; jumped to
+    };
+
+    explicit PositionEstimator(Options options) : _options(options) {}
+    PositionEstimator() : PositionEstimator(Options{}) {}
+
+    // Starts over from a known position, for playback starting or resuming
+    // or the rate changing. The drift estimate is kept.
+    void Restart(int64_t position, double rate, int64_t now);
+
+    // Folds in a position the player reported at `now`.
+    SampleKind AddSample(int64_t position, int64_t now);
+
+    // Smoothed position at `now`, for `now` at or after the last call.
+    int64_t PositionAt(int64_t now) const;
+
+    // Estimated drift of the device clock against ours, as a fraction.
+    double Drift() const { return _drift; }
+
+    // Samples taken since the last Restart() or seek.
+    uint64_t Samples() const { return _samples; }
+
+private:
+    // The fitted line: position at `now` with the current drift and offset
+    double FitAt(int64_t now) const;
+    double BaseWeight() const;
+    void Refit();
+    void StartSegment(int64_t position, int64_t now);
+    void SlewTo(int64_t now);
+
+    Options _options;
+    double _rate = 1.0;
+    double _drift = 0.0;
+
+    // Regression of the offset from the nominal line (seconds) against the
+    // media time elapsed at the nominal rate (seconds), since `_origin`.
+    // Weights decay from `_lastSampleAt`; the `_o` sums on the offset's
+    // shorter half-life.
+    int64_t _originPosition = 0;
+    int64_t _originAt = 0;
+    int64_t _lastSampleAt = 0;
+    double _priorDrift = 0.0;
+    double _priorWeight = 0.0;
+    double _w = 0.0;
+    double _wx = 0.0;
+    double _wy = 0.0;
+    double _wxx = 0.0;
+    double _wxy = 0.0;
+    double _ow = 0.0;
+    double _owx = 0.0;
+    double _owy = 0.0;
+    double _offset = 0.0;
+    uint64_t _samples = 0;
+
+    // What PositionAt() follows: a line from the anchor at the fitted
+    // slope, plus `_correction` blended in over `_slewFor`.
+    int64_t _anchorAt = 0;
+    double _anchorPosition = 0.0;
+    double _slope = 1.0;
+    double _correction = 0.0;
+    int64_t _slewFor = 1;
+};
+
+}  // namespace audio_service_smtc
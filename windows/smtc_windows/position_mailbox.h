@@ -0,0 +1,34 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+
+namespace audio_service_smtc {
+
+// Single-slot, lock-free, latest-wins mailbox for position requests. Posting
+// replaces any position that has not been taken yet, so the reader only ever
+// sees the newest request and the last one posted is never lost.
+class PositionMailbox {
+public:
+    // Returns true if the mailbox was empty, i.e. the reader has to be woken.
+    bool Post(int64_t positionMicroseconds) {
+        if (positionMicroseconds < 0) positionMicroseconds = 0;
+        return _slot.exchange(positionMicroseconds, std::memory_order_acq_rel) == kEmpty;
+    }
+
+    // Takes the pending position, if any, leaving the mailbox empty.
+    bool Take(int64_t* positionMicroseconds) {
+        int64_t value = _slot.exchange(kEmpty, std::memory_order_acq_rel);
+        if (value == kEmpty) return false;
+        *positionMicroseconds = value;
+        return true;
+    }
+
+private:
+    static constexpr int64_t kEmpty = std::numeric_limits<int64_t>::min();
+
+    std::atomic<int64_t> _slot{ kEmpty };
+};
+
+}  // namespace audio_service_smtc
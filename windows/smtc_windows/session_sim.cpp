@@ -0,0 +1,709 @@
+#include "session_sim.h"
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <utility>
+
+#include "artwork_pipeline.h"
+#include "event_dispatcher.h"
+#include "media_backend.h"
+#include "memory_budget.h"
+#include "player_state.h"
+#include "position_mailbox.h"
+#include "sim_executor.h"
+#include "update_pipeline.h"
+
+namespace audio_service_smtc {
+
+namespace {
+
+constexpr int64_t kNoCause = -1;
+// "previous" restarts the track past this point, as audio_service does
+constexpr int64_t kRestartThreshold = 3000000;
+
+// SplitMix64, so a seed gives the same session with every standard library
+class SimRandom {
+public:
+    explicit SimRandom(uint64_t seed) : _state(seed) {}
+
+    uint64_t Next() {
+        uint64_t z = (_state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // In [low, high]
+    int64_t Between(int64_t low, int64_t high) {
+        if (high <= low) return low;
+        return low + static_cast<int64_t>(Next() % static_cast<uint64_t>(high - low + 1));
+    }
+
+private:
+    uint64_t _state;
+};
+
+int64_t Percentile(std::vector<int64_t>& sorted, double fraction) {
+    if (sorted.empty()) return 0;
+    size_t index = static_cast<size_t>(fraction * static_cast<double>(sorted.size() - 1));
+    return sorted[index];
+}
+
+SimAction Control(int64_t at, const char* control) {
+    SimAction action;
+    action.at = at;
+    action.kind = SimActionKind::kControl;
+    action.control = control;
+    return action;
+}
+
+SimAction Valued(int64_t at, SimActionKind kind, int64_t value) {
+    SimAction action;
+    action.at = at;
+    action.kind = kind;
+    action.value = value;
+    return action;
+}
+
+// One SMTC handler. An Explorer restart kills it for good; the watchdog has
+// to build a new one.
+class SimBackend : public MediaBackend {
+public:
+    bool alive = true;
+    PlayerState shown;
+    ArtworkImage artwork;
+
+    bool IsReady() const override { return alive; }
+
+    bool ApplyState(const PlayerState& state, uint32_t changed, const ArtworkImage& image) override {
+        if (!alive) return false;
+        if (changed & kStatusField) shown.status = state.status;
+        if (changed & kMetadataField) {
+            shown.metadata = state.metadata;
+            artwork = image;
+        }
+        if (changed & kTimelineField) shown.timeline = state.timeline;
+        if (changed & kButtonsField) shown.enabledButtons = state.enabledButtons;
+        return true;
+    }
+
+    bool UpdateThumbnail(const ArtworkImage& image) override {
+        if (!alive) return false;
+        artwork = image;
+        return true;
+    }
+
+    bool UpdateTimeline(const TimelineSnapshot& timeline) override {
+        if (!alive) return false;
+        shown.timeline = timeline;
+        return true;
+    }
+
+    void SetControlCallback(std::function<void(const std::string&)>) override {}
+    void SetPositionCallback(std::function<void(int64_t)>) override {}
+};
+
+// The Dart player, the native session and the surface on one executor.
+// Native threads are modelled by when they would run and wake up:
+//
+// - Update thread: UpdateQueue, one commit at a time, idle release timer.
+// - Timeline thread: TimelinePolicy, woken by notifies and its own timer.
+// - Backend calls: serialized like SmtcWindows' mutex, each taking
+//   `callTime` of virtual time.
+// - Watchdog: a wakeup per call and deadline, rebuilds with backoff.
+class SessionSim {
+public:
+    SessionSim(const SimOptions& options, SimReport& report)
+        : _options(options),
+          _report(report),
+          _policy(options.timeline),
+          _artwork(
+              _executor,
+              [this](const std::string& url, size_t, std::vector<uint8_t>& out) { return LoadArtwork(url, out); },
+              [this](uint64_t generation, const ArtworkImage& image) { CommitArtwork(generation, image); }),
+          _events([this](const NativeEvent& event) { PostToDart(event); }),
+          _backend(std::make_shared<SimBackend>()),
+          _retryInterval(options.watchdog.retryInterval) {
+        _executor.SetTaskDelay(options.artworkLoadTime);
+        _artwork.SetCacheLimit(options.artworkCacheLimit);
+    }
+
+    void Run(const SimScript& script) {
+        PlayerStatePatch buttons;
+        buttons.enabledButtons = kAllButtons;
+        Send(buttons, kNoCause);
+        PlayTrack(0, kNoCause);
+
+        for (const SimAction& action : script.actions) {
+            _executor.PostAt(action.at, [this, &action] { Perform(action); });
+        }
+        _executor.RunUntil(script.duration);
+
+        const UpdatePipelineStats& stats = _queue.Stats();
+        _report.simulatedMicros = _executor.Now();
+        _report.tasks = _executor.TasksRun();
+        _report.submitted = stats.submitted;
+        _report.collapsed = stats.collapsed;
+        _report.queueHighWater = stats.highWater;
+        _report.stateCommits = stats.committed;
+
+        std::sort(_latencies.begin(), _latencies.end());
+        _report.latencyP50 = Percentile(_latencies, 0.5);
+        _report.latencyP99 = Percentile(_latencies, 0.99);
+        _report.latencyMax = _latencies.empty() ? 0 : _latencies.back();
+
+        const PlayerState& reported = _reported.Committed();
+        const PlayerState& shown = _backend->shown;
+        _report.finalStateMatches = _backend->alive && shown.status == reported.status &&
+                                    shown.metadata == reported.metadata &&
+                                    shown.enabledButtons == reported.enabledButtons;
+    }
+
+private:
+    // ---- Outside world ----
+
+    void Perform(const SimAction& action) {
+        if (action.kind == SimActionKind::kSurfaceRestart) {
+            ++_report.surfaceRestarts;
+            _backend->alive = false;
+            _surfaceUp = false;
+            _executor.PostAfter(action.value, [this] {
+                _surfaceUp = true;
+                _surfaceBackAt = _executor.Now();
+            });
+            return;
+        }
+
+        // The flyout of a dead handler doesn't reach us
+        if (!_backend->alive) {
+            ++_report.droppedActions;
+            return;
+        }
+        _policy.NoteSurfaceActivity(_executor.Now());
+        NotifyTimeline();
+
+        if (action.kind == SimActionKind::kControl) {
+            ++_report.controls;
+            _events.PostControl(action.control);
+        } else {
+            ++_report.seeks;
+            _lastSeekAt = _executor.Now();
+            if (_mailbox.Post(action.value)) _events.PostPosition(action.value);
+        }
+    }
+
+    // ---- Dart side ----
+
+    void PostToDart(const NativeEvent& event) {
+        int64_t cause = _executor.Now();
+        _executor.PostAfter(_options.channelHop, [this, event, cause] {
+            if (event.kind == NativeEventKind::kControl) {
+                OnControl(event.control, cause);
+                return;
+            }
+            int64_t position;
+            if (!_mailbox.Take(&position)) return;
+            ++_report.seeksDelivered;
+            Seek(position, _lastSeekAt);
+        });
+    }
+
+    void OnControl(const std::string& control, int64_t cause) {
+        if (control == "play") {
+            if (_playing) return;
+            _playing = true;
+            _anchor = _executor.Now();
+            SendPlayback(PlaybackState::kPlaying, cause);
+        } else if (control == "pause") {
+            if (!_playing) return;
+            _position = PlayerPosition();
+            _playing = false;
+            SendPlayback(PlaybackState::kPaused, cause);
+        } else if (control == "stop") {
+            _playing = false;
+            _position = 0;
+            SendPlayback(PlaybackState::kStopped, cause);
+        } else if (control == "next") {
+            PlayTrack(_track + 1, cause);
+        } else if (control == "previous") {
+            if (PlayerPosition() > kRestartThreshold) {
+                Seek(0, cause);
+            } else {
+                PlayTrack(_track > 0 ? _track - 1 : 0, cause);
+            }
+        }
+    }
+
+    int64_t PlayerPosition() const {
+        if (!_playing) return _position;
+        return std::min(_position + (_executor.Now() - _anchor), _length);
+    }
+
+    int64_t TrackLength(size_t track) const {
+        SimRandom random(track);
+        return random.Between(_options.minTrackLength, _options.maxTrackLength);
+    }
+
+    MediaMetadata TrackMetadata(size_t track) const {
+        size_t album = _options.tracksPerAlbum > 0 ? track / _options.tracksPerAlbum : track;
+        std::string artist = "Artist " + std::to_string(album % 7);
+        std::string albumName = "Album " + std::to_string(album);
+        return MediaMetadata{
+            "Track " + std::to_string(track),
+            std::string_view(artist),
+            std::string_view(albumName),
+            "https://artwork.invalid/album-" + std::to_string(album) + ".jpg",
+            TrackLength(track) };
+    }
+
+    void PlayTrack(size_t track, int64_t cause) {
+        ++_report.tracks;
+        _track = track;
+        _length = TrackLength(track);
+        _position = 0;
+        _anchor = _executor.Now();
+
+        PlayerStatePatch patch;
+        patch.metadata = TrackMetadata(track);
+        patch.timeline = TimelineSnapshot{ 0, _length, 1.0 };
+        if (!_playing) {
+            _playing = true;
+            patch.status = PlaybackState::kPlaying;
+        }
+        Send(patch, cause);
+        ScheduleTrack();
+    }
+
+    void Seek(int64_t position, int64_t cause) {
+        _position = std::clamp<int64_t>(position, 0, _length);
+        _anchor = _executor.Now();
+
+        PlayerStatePatch patch;
+        patch.timeline = TimelineSnapshot{ _position, _length, 1.0 };
+        Send(patch, cause);
+        ScheduleTrack();
+    }
+
+    void SendPlayback(PlaybackState status, int64_t cause) {
+        PlayerStatePatch patch;
+        patch.status = status;
+        patch.timeline = TimelineSnapshot{ _position, _length, 1.0 };
+        Send(patch, cause);
+        ScheduleTrack();
+    }
+
+    // Track end and position reports follow the player's clock
+    void ScheduleTrack() {
+        _executor.Cancel(_trackEnd);
+        _executor.Cancel(_sample);
+        _trackEnd = _sample = 0;
+        if (!_playing) return;
+
+        _trackEnd = _executor.PostAt(_anchor + _length - _position, [this] {
+            _trackEnd = 0;
+            PlayTrack(_track + 1, kNoCause);
+        });
+        ScheduleSample();
+    }
+
+    void ScheduleSample() {
+        if (_options.positionSampleInterval <= 0) return;
+        _sample = _executor.PostAfter(_options.positionSampleInterval, [this] {
+            _sample = 0;
+            PlayerStatePatch patch;
+            patch.timeline = TimelineSnapshot{ PlayerPosition(), _length, 1.0 };
+            Send(patch, kNoCause);
+            ScheduleSample();
+        });
+    }
+
+    void Send(const PlayerStatePatch& patch, int64_t cause) {
+        _reported.Apply(patch);
+        _executor.PostAfter(_options.channelHop, [this, patch, cause] { Submit(patch, cause); });
+    }
+
+    // ---- Update thread ----
+
+    void Submit(const PlayerStatePatch& patch, int64_t cause) {
+        if (!_queue.Submit(patch)) return;
+        if (cause != kNoCause) _causes.emplace_back(_queue.Stats().submitted, cause);
+        // A busy thread picks it up after the commit in flight
+        if (_committing) return;
+
+        ++_report.updateWakeups;
+        _executor.Cancel(_idleTimer);
+        _idleTimer = 0;
+        StartCommit();
+    }
+
+    void StartCommit() {
+        PlayerStatePatch patch;
+        _queue.Take(&patch);
+        _committing = true;
+        _covered = _queue.Stats().submitted;
+        RunLocked([this, patch] { return CommitState(patch); }, [this](bool ok) { FinishCommit(ok); });
+    }
+
+    bool CommitState(const PlayerStatePatch& patch) {
+        _changed = _state.Apply(patch);
+        const PlayerState& state = _state.Committed();
+        for (int bit = 0; bit < 4; ++bit) {
+            if (_changed & (1u << bit)) ++_report.fieldCommits[bit];
+        }
+
+        ArtworkImage artwork;
+        if (_changed & kMetadataField) {
+            artwork = _artwork.Begin(++_artworkGeneration, state.metadata.artUrl);
+            _shownArtwork = artwork;
+        }
+        _shownState = state;
+        return _backend->ApplyState(state, _changed, artwork);
+    }
+
+    void FinishCommit(bool ok) {
+        const PlayerState& state = _state.Committed();
+        int64_t now = _executor.Now();
+        if (_changed & kStatusField) {
+            _policy.SetPlaybackState(state.status, now);
+            NotifyTimeline();
+        }
+        if (_changed & kTimelineField) {
+            _policy.SetTimeline(state.timeline.position, state.timeline.duration, state.timeline.rate, now);
+            NotifyTimeline();
+        }
+        MemoryBudget::Shared().Enforce();
+
+        _queue.Done();
+        _committing = false;
+        for (; !_causes.empty() && _causes.front().first <= _covered; _causes.pop_front()) {
+            // Shown once the watchdog has replayed the state into a new handler
+            if (ok) {
+                _latencies.push_back(now - _causes.front().second);
+            } else {
+                _awaitingRecovery.push_back(_causes.front().second);
+            }
+        }
+
+        if (_queue.HasPending()) {
+            StartCommit();
+        } else if (_options.idleRelease > 0) {
+            _idleTimer = _executor.PostAfter(_options.idleRelease, [this] {
+                _idleTimer = 0;
+                ++_report.updateWakeups;
+                ReleaseIdleResources();
+            });
+        }
+    }
+
+    void ReleaseIdleResources() {
+        PlaybackState status = _state.Committed().status;
+        if (status != PlaybackState::kStopped && status != PlaybackState::kClosed) return;
+        _shownArtwork = ArtworkImage{};
+        MemoryBudget::Shared().ReleaseIdle();
+    }
+
+    // ---- Artwork worker ----
+
+    bool LoadArtwork(const std::string& url, std::vector<uint8_t>& out) {
+        ++_report.artworkLoads;
+        out.assign(_options.artworkBytes, static_cast<uint8_t>(url.size()));
+        return true;
+    }
+
+    void CommitArtwork(uint64_t generation, const ArtworkImage& image) {
+        RunLocked([this, generation, image] {
+            // A newer track may have started while the image was loading
+            if (generation != _artworkGeneration) return true;
+            ++_report.thumbnailCommits;
+            _shownArtwork = image;
+            return _backend->UpdateThumbnail(image);
+        }, nullptr);
+    }
+
+    // ---- Timeline thread ----
+
+    void NotifyTimeline() {
+        // A busy thread looks at the policy again once its commit is done;
+        // notifies in the same instant wake it once
+        if (_timelineBusy || _timelineWake) return;
+        _executor.Cancel(_timelineTimer);
+        _timelineTimer = 0;
+        _timelineWake = _executor.Post([this] {
+            _timelineWake = 0;
+            ++_report.timelineWakeups;
+            TimelineLoop();
+        });
+    }
+
+    void TimelineLoop() {
+        int64_t now = _executor.Now();
+        int64_t next = _policy.NextPublishTime(now);
+        if (next > now) {
+            if (next != TimelinePolicy::kNever) {
+                _timelineTimer = _executor.PostAt(next, [this] {
+                    _timelineTimer = 0;
+                    ++_report.timelineWakeups;
+                    TimelineLoop();
+                });
+            }
+            return;
+        }
+
+        TimelineSnapshot snapshot = _policy.Publish(now);
+        _timelineBusy = true;
+        RunLocked([this, snapshot] {
+            ++_report.timelineCommits;
+            _shownTimeline = snapshot;
+            return _backend->UpdateTimeline(snapshot);
+        }, [this](bool) {
+            _timelineBusy = false;
+            TimelineLoop();
+        });
+    }
+
+    // ---- Backend calls ----
+
+    struct LockedCall {
+        std::function<bool()> call;
+        std::function<void(bool ok)> done;
+    };
+
+    // Runs `call` once the calls queued before it are done. It takes
+    // `callTime`, after which `done` runs, still in turn.
+    void RunLocked(std::function<bool()> call, std::function<void(bool ok)> done) {
+        _locked.push_back({ std::move(call), std::move(done) });
+        if (!_lockHeld) RunNextLocked();
+    }
+
+    void RunNextLocked() {
+        if (_locked.empty()) {
+            _lockHeld = false;
+            return;
+        }
+        _lockHeld = true;
+        LockedCall next = std::move(_locked.front());
+        _locked.pop_front();
+
+        uint64_t number = ++_callCount;
+        int64_t cost = _options.slowCallEvery > 0 && number % _options.slowCallEvery == 0
+            ? _options.slowCallTime : _options.callTime;
+
+        CallStarted();
+        bool ok = next.call();
+        _executor.PostAfter(cost, [this, ok, done = std::move(next.done)] {
+            CallFinished(ok);
+            if (done) done(ok);
+            RunNextLocked();
+        });
+    }
+
+    // ---- Watchdog ----
+
+    void CallStarted() {
+        _callInFlight = true;
+        _callStalled = false;
+        _callStart = _executor.Now();
+        // Healthy, the monitor is woken for every call and then sleeps until
+        // its deadline; while rebuilding it ignores calls
+        if (!_healthy) return;
+        ++_report.watchdogWakeups;
+        ArmDeadline();
+    }
+
+    void CallFinished(bool ok) {
+        _callInFlight = false;
+        if (ok || _callStalled) return;
+        ++_report.failedCalls;
+        if (!_healthy) return;
+        ++_report.watchdogWakeups;
+        MarkUnhealthy();
+        TryRebuild();
+    }
+
+    void ArmDeadline() {
+        _executor.Cancel(_monitorTimer);
+        _monitorTimer = _executor.PostAt(_callStart + _options.watchdog.deadline, [this] {
+            _monitorTimer = 0;
+            ++_report.watchdogWakeups;
+            if (!_callInFlight) return;
+            _callStalled = true;
+            MarkUnhealthy();
+            TryRebuild();
+        });
+    }
+
+    void MarkUnhealthy() {
+        _executor.Cancel(_monitorTimer);
+        _monitorTimer = 0;
+        _healthy = false;
+        _retryInterval = _options.watchdog.retryInterval;
+    }
+
+    void TryRebuild() {
+        if (!_surfaceUp) {
+            _monitorTimer = _executor.PostAfter(_retryInterval, [this] {
+                _monitorTimer = 0;
+                ++_report.watchdogWakeups;
+                TryRebuild();
+            });
+            _retryInterval = std::min(_retryInterval * 2, _options.watchdog.maxRetryInterval);
+            return;
+        }
+
+        // As SmtcWindows::RebuildBackend: a new handler with the shown state
+        _backend = std::make_shared<SimBackend>();
+        _backend->ApplyState(_shownState, kButtonsField | kStatusField | kMetadataField, _shownArtwork);
+        _backend->UpdateTimeline(_shownTimeline);
+        _healthy = true;
+
+        int64_t now = _executor.Now();
+        ++_report.recoveries;
+        _report.recoveryMax = std::max(_report.recoveryMax, now - _surfaceBackAt);
+        for (int64_t cause : _awaitingRecovery) _latencies.push_back(now - cause);
+        _awaitingRecovery.clear();
+
+        if (_callInFlight && !_callStalled) ArmDeadline();
+    }
+
+    const SimOptions& _options;
+    SimReport& _report;
+    SimExecutor _executor;
+
+    // Dart player
+    PlayerStateStore _reported;  // everything it has sent
+    size_t _track = 0;
+    bool _playing = false;
+    int64_t _position = 0;       // at _anchor
+    int64_t _anchor = 0;
+    int64_t _length = 0;
+    SimExecutor::TaskId _trackEnd = 0;
+    SimExecutor::TaskId _sample = 0;
+
+    // Native session
+    UpdateQueue _queue;
+    bool _committing = false;
+    uint64_t _covered = 0;       // submissions the commit in flight carries
+    uint32_t _changed = 0;
+    SimExecutor::TaskId _idleTimer = 0;
+    PlayerStateStore _state;
+    TimelinePolicy _policy;
+    ArtworkPipeline _artwork;
+    uint64_t _artworkGeneration = 0;
+    EventDispatcher _events;
+    PositionMailbox _mailbox;
+    int64_t _lastSeekAt = 0;
+
+    bool _timelineBusy = false;
+    SimExecutor::TaskId _timelineWake = 0;
+    SimExecutor::TaskId _timelineTimer = 0;
+
+    std::deque<LockedCall> _locked;
+    bool _lockHeld = false;
+    uint64_t _callCount = 0;
+
+    // Recovery state, as recorded for SmtcWindows::RebuildBackend
+    std::shared_ptr<SimBackend> _backend;
+    PlayerState _shownState;
+    ArtworkImage _shownArtwork;
+    TimelineSnapshot _shownTimeline;
+
+    bool _healthy = true;
+    bool _callInFlight = false;
+    bool _callStalled = false;
+    int64_t _callStart = 0;
+    int64_t _retryInterval;
+    SimExecutor::TaskId _monitorTimer = 0;
+    bool _surfaceUp = true;
+    int64_t _surfaceBackAt = 0;
+
+    // Submission number and time of the press or seek it answers
+    std::deque<std::pair<uint64_t, int64_t>> _causes;
+    std::vector<int64_t> _awaitingRecovery;
+    std::vector<int64_t> _latencies;
+};
+
+}  // namespace
+
+SimScript ScriptListeningSession(const ListeningSessionOptions& options) {
+    SimRandom random(options.seed);
+    SimScript script;
+    script.duration = options.duration;
+    std::vector<SimAction>& actions = script.actions;
+
+    int64_t end = options.duration - options.stoppedTail;
+    int64_t gap = options.interactionGap;
+    int64_t at = 0;
+    while (true) {
+        at += random.Between(gap / 10, 2 * gap - gap / 10);
+        if (at >= end) break;
+
+        int64_t roll = random.Between(0, 99);
+        if (roll < 35) {
+            actions.push_back(Control(at, "next"));
+        } else if (roll < 45) {
+            actions.push_back(Control(at, "previous"));
+        } else if (roll < 55) {
+            // Skipping through a few tracks to find one
+            int64_t count = random.Between(3, 8);
+            for (int64_t i = 0; i < count; ++i) {
+                actions.push_back(Control(at, "next"));
+                at += random.Between(300000, 700000);
+            }
+        } else if (roll < 75) {
+            // Dragging the flyout's scrubber
+            int64_t from = random.Between(0, 110000000);
+            int64_t to = random.Between(0, 110000000);
+            int64_t steps = random.Between(15, 40);
+            for (int64_t i = 0; i <= steps; ++i) {
+                actions.push_back(Valued(at, SimActionKind::kSeek, from + (to - from) * i / steps));
+                at += 50000;
+            }
+        } else {
+            actions.push_back(Control(at, "pause"));
+            at += random.Between(30000000, 900000000);
+            if (at >= end) break;
+            actions.push_back(Control(at, "play"));
+        }
+    }
+
+    int64_t interval = options.surfaceRestartInterval;
+    if (interval > 0) {
+        for (int64_t restart = interval; restart < end; restart += interval) {
+            int64_t jitter = random.Between(-interval / 10, interval / 10);
+            actions.push_back(Valued(restart + jitter, SimActionKind::kSurfaceRestart, options.surfaceDowntime));
+        }
+    }
+
+    actions.push_back(Control(end, "stop"));
+    std::stable_sort(actions.begin(), actions.end(),
+                     [](const SimAction& a, const SimAction& b) { return a.at < b.at; });
+    return script;
+}
+
+SimReport SimulateSession(const SimScript& script, const SimOptions& options) {
+    SimReport report;
+    MemoryBudget& budget = MemoryBudget::Shared();
+    MemoryStats before = budget.Stats();
+    budget.SetLimit(options.memoryLimit);
+    budget.ResetPeak();
+
+    int64_t start = MonotonicMicros();
+    {
+        SessionSim session(options, report);
+        session.Run(script);
+
+        MemoryStats after = budget.Stats();
+        report.memoryPeak = after.peak;
+        report.memoryEnd = after.used;
+        report.idleReleases = after.idleReleases - before.idleReleases;
+    }
+    report.wallMicros = MonotonicMicros() - start;
+
+    budget.SetLimit(before.limit);
+    return report;
+}
+
+}  // namespace audio_service_smtc
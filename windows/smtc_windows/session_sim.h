@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "backend_watchdog.h"
+#include "timeline_publisher.h"
+
+namespace audio_service_smtc {
+
+// Something done to the session from outside the player.
+enum class SimActionKind {
+    kControl,         // a media key or flyout button, named by `control`
+    kSeek,            // the flyout's scrubber moved to `value` microseconds
+    kSurfaceRestart,  // Explorer restarted; the surface is gone for `value` microseconds
+};
+
+struct SimAction {
+    int64_t at = 0;
+    SimActionKind kind = SimActionKind::kControl;
+    std::string control;
+    int64_t value = 0;
+};
+
+struct SimScript {
+    int64_t duration = 0;            // simulated microseconds
+    std::vector<SimAction> actions;  // in time order
+};
+
+struct ListeningSessionOptions {
+    uint64_t seed = 1;
+    int64_t duration = 8LL * 3600 * 1000000;
+    // Average time between two things the user does
+    int64_t interactionGap = 600000000;
+    int64_t surfaceRestartInterval = 2LL * 3600 * 1000000;
+    int64_t surfaceDowntime = 6000000;
+    // Stopped for this long at the end, so idle release gets its turn
+    int64_t stoppedTail = 300000000;
+};
+
+// A listening session with skips, skip bursts, scrubs, pauses and Explorer
+// restarts at random but reproducible times.
+SimScript ScriptListeningSession(const ListeningSessionOptions& options);
+
+// Cost model and settings of the simulated plugin. Times are in microseconds.
+struct SimOptions {
+    // Tracks are between these lengths; every `tracksPerAlbum` share artwork
+    int64_t minTrackLength = 120000000;
+    int64_t maxTrackLength = 420000000;
+    uint32_t tracksPerAlbum = 10;
+    // How often the player reports its position while playing; 0 never
+    int64_t positionSampleInterval = 10000000;
+
+    // Method channel, either way
+    int64_t channelHop = 300;
+    // Each backend call; every `slowCallEvery`-th takes `slowCallTime`
+    int64_t callTime = 2000;
+    int64_t slowCallTime = 80000;
+    uint32_t slowCallEvery = 50;
+    // Fetching the full artwork of a track
+    int64_t artworkLoadTime = 150000;
+    size_t artworkBytes = 200 * 1024;
+
+    size_t memoryLimit = 0;
+    size_t artworkCacheLimit = 0;
+    int64_t idleRelease = 30000000;
+    TimelinePolicy::Options timeline;
+    // Only the deadline and retry intervals are used
+    BackendWatchdog::Options watchdog;
+};
+
+struct SimReport {
+    int64_t simulatedMicros = 0;
+    int64_t wallMicros = 0;
+    uint64_t tasks = 0;               // executor tasks run
+
+    // Times each native thread would have woken up
+    uint64_t updateWakeups = 0;
+    uint64_t timelineWakeups = 0;
+    uint64_t watchdogWakeups = 0;
+
+    uint64_t tracks = 0;
+    uint64_t submitted = 0;           // state patches reaching native code
+    uint64_t collapsed = 0;
+    size_t queueHighWater = 0;
+    uint64_t stateCommits = 0;
+    uint64_t fieldCommits[4] = {};    // per StateField bit, in bit order
+    uint64_t timelineCommits = 0;
+    uint64_t thumbnailCommits = 0;
+    uint64_t artworkLoads = 0;
+    uint64_t failedCalls = 0;
+
+    uint64_t surfaceRestarts = 0;
+    uint64_t recoveries = 0;
+    int64_t recoveryMax = 0;          // surface back to state replayed
+
+    uint64_t controls = 0;
+    uint64_t seeks = 0;
+    uint64_t seeksDelivered = 0;      // after the mailbox coalesced them
+    uint64_t droppedActions = 0;      // came while the surface was gone
+    // From a button press or seek to the backend showing the player's answer
+    int64_t latencyP50 = 0;
+    int64_t latencyP99 = 0;
+    int64_t latencyMax = 0;
+
+    size_t memoryPeak = 0;
+    size_t memoryEnd = 0;
+    uint64_t idleReleases = 0;
+
+    // The backend ended up showing what the player last reported
+    bool finalStateMatches = false;
+};
+
+// Runs the portable core of the plugin (update queue, state store, timeline
+// policy, artwork pipeline, event dispatch, memory budget) the way
+// SmtcWindows wires it, with its threads and the backend watchdog modelled
+// as tasks on a SimExecutor, against a fake backend and a scripted player.
+// Takes milliseconds for hours of session and gives the same report every
+// run, wall time aside. Uses the shared MemoryBudget, so only one runs at a
+// time.
+SimReport SimulateSession(const SimScript& script, const SimOptions& options);
+
+}  // namespace audio_service_smtc
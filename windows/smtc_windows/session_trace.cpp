@@ -0,0 +1,274 @@
+#include "session_trace.h"
+
+#include <atomic>
+#include <cstring>
+
+#include "event_dispatcher.h"
+
+namespace audio_service_smtc {
+
+namespace {
+
+constexpr char kMagic[8] = { 'S', 'M', 'T', 'C', 'T', 'R', 'C', '1' };
+constexpr size_t kRecordHeader = 1 + 8 + 4;
+// Records past this size are taken as damage rather than allocated
+constexpr uint32_t kMaxPayload = 1u << 20;
+// Buffered records reach the file at least this often, so a trace cut short
+// by a crash still holds all but the last moment
+constexpr int64_t kFlushInterval = 1000000;
+
+std::atomic<TraceRecorder*> g_active{ nullptr };
+std::mutex g_startMutex;
+
+template <typename T>
+void Put(std::vector<uint8_t>& out, T value) {
+    uint8_t bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+void PutString(std::vector<uint8_t>& out, std::string_view text) {
+    Put<uint32_t>(out, static_cast<uint32_t>(text.size()));
+    out.insert(out.end(), text.begin(), text.end());
+}
+
+void PutPatch(std::vector<uint8_t>& out, const PlayerStatePatch& patch) {
+    uint8_t fields = 0;
+    if (patch.status) fields |= kStatusField;
+    if (patch.metadata) fields |= kMetadataField;
+    if (patch.timeline) fields |= kTimelineField;
+    if (patch.enabledButtons) fields |= kButtonsField;
+    Put<uint8_t>(out, fields);
+
+    if (patch.status) {
+        Put<int32_t>(out, static_cast<int32_t>(*patch.status));
+    }
+    if (patch.metadata) {
+        PutString(out, patch.metadata->title);
+        PutString(out, patch.metadata->artist.view());
+        PutString(out, patch.metadata->album.view());
+        PutString(out, patch.metadata->artUrl);
+        Put<int64_t>(out, patch.metadata->duration);
+    }
+    if (patch.timeline) {
+        Put<int64_t>(out, patch.timeline->position);
+        Put<int64_t>(out, patch.timeline->duration);
+        Put<double>(out, patch.timeline->rate);
+    }
+    if (patch.enabledButtons) {
+        Put<uint32_t>(out, *patch.enabledButtons);
+    }
+}
+
+// Bounds-checked reads over one payload
+class PayloadReader {
+public:
+    PayloadReader(const uint8_t* data, size_t size) : _data(data), _size(size) {}
+
+    template <typename T>
+    bool Get(T* value) {
+        if (_size - _offset < sizeof(T)) return false;
+        std::memcpy(value, _data + _offset, sizeof(T));
+        _offset += sizeof(T);
+        return true;
+    }
+
+    bool GetString(std::string* text) {
+        uint32_t size;
+        if (!Get(&size) || _size - _offset < size) return false;
+        text->assign(reinterpret_cast<const char*>(_data + _offset), size);
+        _offset += size;
+        return true;
+    }
+
+    bool GetPatch(PlayerStatePatch* patch) {
+        uint8_t fields;
+        if (!Get(&fields)) return false;
+
+        if (fields & kStatusField) {
+            int32_t status;
+            if (!Get(&status)) return false;
+            patch->status = static_cast<PlaybackState>(status);
+        }
+        if (fields & kMetadataField) {
+            std::string title;
+            std::string artist;
+            std::string album;
+            std::string artUrl;
+            int64_t duration;
+            if (!GetString(&title) || !GetString(&artist) || !GetString(&album) || !GetString(&artUrl) ||
+                !Get(&duration)) {
+                return false;
+            }
+            patch->metadata = MakeMetadata(std::move(title), artist, album, std::move(artUrl), duration);
+        }
+        if (fields & kTimelineField) {
+            TimelineSnapshot timeline;
+            if (!Get(&timeline.position) || !Get(&timeline.duration) || !Get(&timeline.rate)) return false;
+            patch->timeline = timeline;
+        }
+        if (fields & kButtonsField) {
+            uint32_t buttons;
+            if (!Get(&buttons)) return false;
+            patch->enabledButtons = buttons;
+        }
+        return true;
+    }
+
+private:
+    const uint8_t* _data;
+    size_t _size;
+    size_t _offset = 0;
+};
+
+}  // namespace
+
+std::unique_ptr<TraceRecorder> TraceRecorder::Open(const std::string& path) {
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) return nullptr;
+    if (std::fwrite(kMagic, 1, sizeof(kMagic), file) != sizeof(kMagic)) {
+        std::fclose(file);
+        return nullptr;
+    }
+    return std::unique_ptr<TraceRecorder>(new TraceRecorder(file, MonotonicMicros()));
+}
+
+TraceRecorder::TraceRecorder(std::FILE* file, int64_t start)
+    : _file(file), _start(start), _lastFlush(start) {}
+
+TraceRecorder::~TraceRecorder() {
+    std::fclose(_file);
+}
+
+void TraceRecorder::RecordCall(std::string_view method, const PlayerStatePatch* patch) {
+    std::vector<uint8_t> payload;
+    PutString(payload, method);
+    Put<uint8_t>(payload, patch ? 1 : 0);
+    if (patch) PutPatch(payload, *patch);
+    Write(TraceKind::kCall, payload);
+}
+
+void TraceRecorder::RecordEvent(std::string_view name, std::string_view text, int64_t value) {
+    std::vector<uint8_t> payload;
+    PutString(payload, name);
+    PutString(payload, text);
+    Put<int64_t>(payload, value);
+    Write(TraceKind::kEvent, payload);
+}
+
+void TraceRecorder::RecordCommit(const PlayerStatePatch& patch, uint32_t changed) {
+    std::vector<uint8_t> payload;
+    Put<uint32_t>(payload, changed);
+    PutPatch(payload, patch);
+    Write(TraceKind::kCommit, payload);
+}
+
+void TraceRecorder::Flush() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::fflush(_file);
+}
+
+void TraceRecorder::Write(TraceKind kind, const std::vector<uint8_t>& payload) {
+    std::vector<uint8_t> header;
+    header.reserve(kRecordHeader);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    // Stamped under the lock, so timestamps never go backwards in the file
+    int64_t now = MonotonicMicros();
+    Put<uint8_t>(header, static_cast<uint8_t>(kind));
+    Put<int64_t>(header, now - _start);
+    Put<uint32_t>(header, static_cast<uint32_t>(payload.size()));
+    std::fwrite(header.data(), 1, header.size(), _file);
+    std::fwrite(payload.data(), 1, payload.size(), _file);
+
+    if (now - _lastFlush >= kFlushInterval) {
+        std::fflush(_file);
+        _lastFlush = now;
+    }
+}
+
+std::unique_ptr<TraceReader> TraceReader::Open(const std::string& path) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) return nullptr;
+
+    char magic[sizeof(kMagic)];
+    if (std::fread(magic, 1, sizeof(magic), file) != sizeof(magic) ||
+        std::memcmp(magic, kMagic, sizeof(kMagic)) != 0) {
+        std::fclose(file);
+        return nullptr;
+    }
+    return std::unique_ptr<TraceReader>(new TraceReader(file));
+}
+
+TraceReader::~TraceReader() {
+    std::fclose(_file);
+}
+
+bool TraceReader::Next(TraceRecord* record) {
+    if (_damaged) return false;
+
+    uint8_t header[kRecordHeader];
+    size_t read = std::fread(header, 1, sizeof(header), _file);
+    if (read == 0 && std::feof(_file)) return false;
+
+    uint32_t size = 0;
+    if (read == sizeof(header)) std::memcpy(&size, header + 9, sizeof(size));
+    if (read != sizeof(header) || size > kMaxPayload) {
+        _damaged = true;
+        return false;
+    }
+    _payload.resize(size);
+    if (std::fread(_payload.data(), 1, size, _file) != size) {
+        _damaged = true;
+        return false;
+    }
+
+    *record = TraceRecord{};
+    record->kind = static_cast<TraceKind>(header[0]);
+    std::memcpy(&record->timestamp, header + 1, sizeof(record->timestamp));
+
+    PayloadReader payload(_payload.data(), _payload.size());
+    bool ok = false;
+    switch (record->kind) {
+    case TraceKind::kCall: {
+        uint8_t hasPatch;
+        ok = payload.GetString(&record->name) && payload.Get(&hasPatch);
+        if (ok && hasPatch) {
+            record->patch.emplace();
+            ok = payload.GetPatch(&*record->patch);
+        }
+        break;
+    }
+    case TraceKind::kEvent:
+        ok = payload.GetString(&record->name) && payload.GetString(&record->text) &&
+             payload.Get(&record->value);
+        break;
+    case TraceKind::kCommit:
+        record->patch.emplace();
+        ok = payload.Get(&record->changed) && payload.GetPatch(&*record->patch);
+        break;
+    }
+    if (!ok) _damaged = true;
+    return ok;
+}
+
+TraceRecorder* ActiveTrace() {
+    return g_active.load(std::memory_order_acquire);
+}
+
+bool StartTrace(const std::string& path) {
+    std::lock_guard<std::mutex> lock(g_startMutex);
+    if (g_active.load(std::memory_order_relaxed)) return true;
+
+    // Never freed: recording threads may still be using it at exit
+    std::unique_ptr<TraceRecorder> recorder = TraceRecorder::Open(path);
+    if (!recorder) return false;
+    g_active.store(recorder.release(), std::memory_order_release);
+    return true;
+}
+
+void FlushTrace() {
+    if (TraceRecorder* recorder = ActiveTrace()) recorder->Flush();
+}
+
+}  // namespace audio_service_smtc
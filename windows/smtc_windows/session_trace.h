@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "player_state.h"
+
+namespace audio_service_smtc {
+
+// Binary trace of a session: what Dart called, what the backend reported
+// back and what was committed to it. Used to reproduce field problems and
+// replayed as benchmarks by trace_replay.
+//
+// File layout, little-endian: the 8-byte magic "SMTCTRC1", then records of
+//   u8 kind, i64 timestamp (microseconds since the trace started),
+//   u32 payload size, payload.
+// Strings are u32 size + bytes. A state patch is a u8 mask of StateField
+// bits followed by the fields present, in bit order.
+enum class TraceKind : uint8_t {
+    kCall = 1,     // name, u8 has patch, [patch]
+    kEvent = 2,    // name, text, i64 value
+    kCommit = 3,   // u32 changed, patch
+};
+
+struct TraceRecord {
+    TraceKind kind = TraceKind::kCall;
+    int64_t timestamp = 0;
+    std::string name;                         // method or event
+    std::string text;                         // event argument
+    int64_t value = 0;                        // event argument
+    std::optional<PlayerStatePatch> patch;    // state a call decoded, or a commit applied
+    uint32_t changed = 0;                     // StateField bits a commit changed
+};
+
+class TraceRecorder {
+public:
+    // Null if the file can't be created
+    static std::unique_ptr<TraceRecorder> Open(const std::string& path);
+
+    ~TraceRecorder();
+
+    TraceRecorder(const TraceRecorder&) = delete;
+    TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+    // Safe from any thread. `patch` is null for calls that change no state.
+    void RecordCall(std::string_view method, const PlayerStatePatch* patch);
+    void RecordEvent(std::string_view name, std::string_view text, int64_t value);
+    void RecordCommit(const PlayerStatePatch& patch, uint32_t changed);
+
+    void Flush();
+
+private:
+    TraceRecorder(std::FILE* file, int64_t start);
+
+    void Write(TraceKind kind, const std::vector<uint8_t>& payload);
+
+    std::mutex _mutex;
+    std::FILE* _file;
+    int64_t _start;
+    int64_t _lastFlush;
+};
+
+class TraceReader {
+public:
+    // Null if the file is missing or not a trace
+    static std::unique_ptr<TraceReader> Open(const std::string& path);
+
+    ~TraceReader();
+
+    TraceReader(const TraceReader&) = delete;
+    TraceReader& operator=(const TraceReader&) = delete;
+
+    // False at the end of the trace, or at a truncated or damaged record,
+    // which is what a trace cut short by a crash ends with
+    bool Next(TraceRecord* record);
+
+    bool damaged() const { return _damaged; }
+
+private:
+    explicit TraceReader(std::FILE* file) : _file(file) {}
+
+    std::FILE* _file;
+    std::vector<uint8_t> _payload;
+    bool _damaged = false;
+};
+
+// The process-wide recorder; null unless tracing. Recording costs one
+// atomic load while tracing is off.
+TraceRecorder* ActiveTrace();
+
+// Starts tracing to `path`. Tracing runs until the process exits; starting
+// again while tracing keeps the first file.
+bool StartTrace(const std::string& path);
+
+// Writes out what the active recorder has buffered.
+void FlushTrace();
+
+}  // namespace audio_service_smtc
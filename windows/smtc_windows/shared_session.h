@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace audio_service_smtc {
+
+// Process-wide owner of one backend session shared by every Flutter engine
+// that loads the plugin. Engines attach and detach by refcount: the session
+// is created by the first attachment and destroyed with the last one.
+//
+// Exactly one attachment drives state at a time. The first engine to attach
+// is the driver; when it detaches, the oldest remaining attachment is
+// promoted. Other attachments can read the session but must not write to it.
+template <typename Session>
+class SharedSession {
+public:
+    using Factory = std::function<std::shared_ptr<Session>()>;
+
+    // Called with the session when an attachment becomes the driver. Invoked
+    // outside the registry lock, on the thread that attached or detached.
+    using DriverListener = std::function<void(Session&)>;
+
+    class Attachment {
+    public:
+        ~Attachment() { _owner.Detach(_id); }
+
+        Attachment(const Attachment&) = delete;
+        Attachment& operator=(const Attachment&) = delete;
+
+        Session& session() const { return *_session; }
+        uint64_t id() const { return _id; }
+        bool IsDriver() const { return _owner.DriverId() == _id; }
+
+    private:
+        friend class SharedSession;
+
+        Attachment(SharedSession& owner, uint64_t id, Session* session)
+            : _owner(owner), _id(id), _session(session) {}
+
+        SharedSession& _owner;
+        uint64_t _id;
+        Session* _session;
+    };
+
+    SharedSession() = default;
+
+    SharedSession(const SharedSession&) = delete;
+    SharedSession& operator=(const SharedSession&) = delete;
+
+    // Attaches an engine, building the session with |create| if this is the
+    // first attachment. Returns null if the session could not be created.
+    std::unique_ptr<Attachment> Attach(const Factory& create, DriverListener listener = nullptr) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (!_session) {
+            _session = create();
+            if (!_session) return nullptr;
+        }
+
+        uint64_t id = ++_lastId;
+        bool driver = _entries.empty();
+        _entries.push_back(Entry{ id, listener });
+        Session* session = _session.get();
+        std::unique_ptr<Attachment> attachment(new Attachment(*this, id, session));
+        lock.unlock();
+
+        if (driver && listener) listener(*session);
+        return attachment;
+    }
+
+    size_t Attachments() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _entries.size();
+    }
+
+    // Id of the driving attachment, or 0 when nothing is attached.
+    uint64_t DriverId() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _entries.empty() ? 0 : _entries.front().id;
+    }
+
+private:
+    struct Entry {
+        uint64_t id;
+        DriverListener listener;
+    };
+
+    void Detach(uint64_t id) {
+        DriverListener promoted;
+        Session* session = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (auto it = _entries.begin(); it != _entries.end(); ++it) {
+                if (it->id != id) continue;
+                bool wasDriver = it == _entries.begin();
+                _entries.erase(it);
+                if (_entries.empty()) {
+                    // Torn down under the lock so a concurrent Attach never
+                    // builds a second backend while this one still exists
+                    _session.reset();
+                } else if (wasDriver) {
+                    promoted = _entries.front().listener;
+                    session = _session.get();
+                }
+                break;
+            }
+        }
+
+        if (promoted) promoted(*session);
+    }
+
+    mutable std::mutex _mutex;
+    std::shared_ptr<Session> _session;
+    std::vector<Entry> _entries;
+    uint64_t _lastId = 0;
+};
+
+}  // namespace audio_service_smtc
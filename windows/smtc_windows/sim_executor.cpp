@@ -0,0 +1,56 @@
+#include "sim_executor.h"
+
+#include <limits>
+
+namespace audio_service_smtc {
+
+SimExecutor::TaskId SimExecutor::PostAt(int64_t when, Task task) {
+    if (when < _now) when = _now;
+    TaskId id = ++_lastId;
+    _tasks.emplace(std::make_pair(when, id), std::move(task));
+    _dueTimes.emplace(id, when);
+    return id;
+}
+
+bool SimExecutor::Cancel(TaskId id) {
+    auto due = _dueTimes.find(id);
+    if (due == _dueTimes.end()) return false;
+    _tasks.erase(std::make_pair(due->second, id));
+    _dueTimes.erase(due);
+    return true;
+}
+
+void SimExecutor::Submit(TaskPriority, Task task) {
+    PostAfter(_taskDelay, std::move(task));
+}
+
+uint64_t SimExecutor::RunUntil(int64_t until) {
+    uint64_t before = _tasksRun;
+    while (RunNext(until)) {}
+    if (until > _now) _now = until;
+    return _tasksRun - before;
+}
+
+uint64_t SimExecutor::RunUntilIdle() {
+    uint64_t before = _tasksRun;
+    while (RunNext(std::numeric_limits<int64_t>::max())) {}
+    return _tasksRun - before;
+}
+
+bool SimExecutor::RunNext(int64_t until) {
+    if (_tasks.empty()) return false;
+    auto next = _tasks.begin();
+    if (next->first.first > until) return false;
+
+    // Taken out first, so the task may post and cancel others
+    _now = next->first.first;
+    _dueTimes.erase(next->first.second);
+    Task task = std::move(next->second);
+    _tasks.erase(next);
+
+    ++_tasksRun;
+    task();
+    return true;
+}
+
+}  // namespace audio_service_smtc
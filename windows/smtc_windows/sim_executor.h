@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <utility>
+
+#include "worker_pool.h"
+
+namespace audio_service_smtc {
+
+// Runs tasks one at a time on the caller's thread against a virtual clock,
+// in order of due time and then of posting. The clock only moves when the
+// executor jumps to the next due task, so hours of timers run in
+// milliseconds and every run of the same script does exactly the same.
+// Times are in microseconds from zero.
+class SimExecutor : public TaskExecutor {
+public:
+    using TaskId = uint64_t;
+
+    int64_t Now() const { return _now; }
+
+    // Tasks due in the past run at the current time
+    TaskId PostAt(int64_t when, Task task);
+    TaskId PostAfter(int64_t delay, Task task) { return PostAt(_now + delay, std::move(task)); }
+    TaskId Post(Task task) { return PostAt(_now, std::move(task)); }
+
+    // False if the task already ran or was cancelled
+    bool Cancel(TaskId id);
+
+    // Background work runs `taskDelay` after it was submitted, standing in
+    // for the time a worker spends on it. Priorities are not modelled.
+    void Submit(TaskPriority priority, Task task) override;
+    void SetTaskDelay(int64_t delay) { _taskDelay = delay; }
+
+    // Runs every task due up to `until`, including ones they post, then
+    // leaves the clock at `until`. Returns the tasks run.
+    uint64_t RunUntil(int64_t until);
+    // Runs until nothing is queued
+    uint64_t RunUntilIdle();
+
+    bool Idle() const { return _tasks.empty(); }
+    uint64_t TasksRun() const { return _tasksRun; }
+
+private:
+    bool RunNext(int64_t until);
+
+    int64_t _now = 0;
+    int64_t _taskDelay = 0;
+    TaskId _lastId = 0;
+    uint64_t _tasksRun = 0;
+    std::map<std::pair<int64_t, TaskId>, Task> _tasks;
+    std::unordered_map<TaskId, int64_t> _dueTimes;
+};
+
+}  // namespace audio_service_smtc
@@ -0,0 +1,251 @@
+#include "smtc_c_api.h"
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "event_poster.h"
+#include "smtc_session.h"
+#include "timeline_publisher.h"
+
+using audio_service_smtc::PlaybackState;
+static_assert(SMTC_STATUS_CLOSED == static_cast<int>(PlaybackState::kClosed), "status mismatch");
+static_assert(SMTC_STATUS_STOPPED == static_cast<int>(PlaybackState::kStopped), "status mismatch");
+static_assert(SMTC_STATUS_PAUSED == static_cast<int>(PlaybackState::kPaused), "status mismatch");
+static_assert(SMTC_STATUS_PLAYING == static_cast<int>(PlaybackState::kPlaying), "status mismatch");
+static_assert(static_cast<uint32_t>(SMTC_FIELD_STATUS) == audio_service_smtc::kStatusField, "field mismatch");
+static_assert(static_cast<uint32_t>(SMTC_FIELD_METADATA) == audio_service_smtc::kMetadataField, "field mismatch");
+static_assert(static_cast<uint32_t>(SMTC_FIELD_TIMELINE) == audio_service_smtc::kTimelineField, "field mismatch");
+static_assert(static_cast<uint32_t>(SMTC_FIELD_BUTTONS) == audio_service_smtc::kButtonsField, "field mismatch");
+static_assert(static_cast<uint32_t>(SMTC_BUTTON_PLAY) == audio_service_smtc::kPlayButton, "button mismatch");
+static_assert(static_cast<uint32_t>(SMTC_BUTTON_PAUSE) == audio_service_smtc::kPauseButton, "button mismatch");
+static_assert(static_cast<uint32_t>(SMTC_BUTTON_NEXT) == audio_service_smtc::kNextButton, "button mismatch");
+static_assert(static_cast<uint32_t>(SMTC_BUTTON_PREVIOUS) == audio_service_smtc::kPreviousButton, "button mismatch");
+static_assert(static_cast<uint32_t>(SMTC_BUTTON_STOP) == audio_service_smtc::kStopButton, "button mismatch");
+
+namespace {
+
+std::string ToString(const char* data, size_t length) {
+    return data ? std::string(data, length) : std::string();
+}
+
+std::string_view ToView(const char* data, size_t length) {
+    return data ? std::string_view(data, length) : std::string_view();
+}
+
+PlaybackState ToPlaybackState(int32_t status) {
+    if (status < SMTC_STATUS_CLOSED || status > SMTC_STATUS_PLAYING) return PlaybackState::kClosed;
+    return static_cast<PlaybackState>(status);
+}
+
+int32_t ControlEvent(const std::string& command) {
+    if (command == "play") return SMTC_EVENT_PLAY;
+    if (command == "pause") return SMTC_EVENT_PAUSE;
+    if (command == "next") return SMTC_EVENT_NEXT;
+    if (command == "previous") return SMTC_EVENT_PREVIOUS;
+    if (command == "stop") return SMTC_EVENT_STOP;
+    return 0;
+}
+
+}  // namespace
+
+SmtcSession* smtc_create(const char* identity, size_t identity_length) {
+    try {
+        auto session = std::make_unique<SmtcSession>();
+        std::string name = identity ? std::string(identity, identity_length) : "audio_service_smtc";
+        if (!session->Initialize(name)) {
+            return nullptr;
+        }
+        return session.release();
+    }
+    catch (...) {
+        return nullptr;
+    }
+}
+
+void smtc_destroy(SmtcSession* session) {
+    delete session;
+}
+
+int32_t smtc_update_status(SmtcSession* session, int32_t status) {
+    if (!session) return 0;
+    audio_service_smtc::PlayerStatePatch patch;
+    patch.status = ToPlaybackState(status);
+    return session->ApplyState(patch) ? 1 : 0;
+}
+
+int32_t smtc_update_metadata(SmtcSession* session,
+                             const char* title, size_t title_length,
+                             const char* artist, size_t artist_length,
+                             const char* album, size_t album_length,
+                             int64_t duration,
+                             const char* art_url, size_t art_url_length) {
+    if (!session || !title) return 0;
+    return session->UpdateMetadata(ToString(title, title_length),
+                                   ToString(artist, artist_length),
+                                   ToString(album, album_length),
+                                   duration,
+                                   ToString(art_url, art_url_length)) ? 1 : 0;
+}
+
+int32_t smtc_update_timeline(SmtcSession* session, int64_t position,
+                             int64_t duration, double rate) {
+    if (!session) return 0;
+    return session->UpdateTimeline(position, duration, rate) ? 1 : 0;
+}
+
+int32_t smtc_apply_state(SmtcSession* session, const SmtcStatePatch* patch) {
+    if (!session || !patch) return 0;
+
+    audio_service_smtc::PlayerStatePatch state;
+    if (patch->fields & SMTC_FIELD_STATUS) {
+        state.status = ToPlaybackState(patch->status);
+    }
+    if (patch->fields & SMTC_FIELD_METADATA) {
+        state.metadata = audio_service_smtc::MakeMetadata(
+            ToString(patch->title, patch->title_length),
+            ToView(patch->artist, patch->artist_length),
+            ToView(patch->album, patch->album_length),
+            ToString(patch->art_url, patch->art_url_length),
+            patch->duration);
+    }
+    if (patch->fields & SMTC_FIELD_TIMELINE) {
+        state.timeline = audio_service_smtc::TimelineSnapshot{ patch->position, patch->duration, patch->rate };
+    }
+    if (patch->fields & SMTC_FIELD_BUTTONS) {
+        state.enabledButtons = patch->enabled_buttons;
+    }
+    return session->ApplyState(state) ? 1 : 0;
+}
+
+int32_t smtc_get_update_stats(SmtcSession* session, SmtcUpdateStats* stats) {
+    if (!session || !stats) return 0;
+
+    audio_service_smtc::UpdatePipelineStats current = session->GetUpdateStats();
+    stats->depth = current.depth;
+    stats->high_water = current.highWater;
+    stats->submitted = current.submitted;
+    stats->committed = current.committed;
+    stats->collapsed = current.collapsed;
+    stats->busy = current.busy ? 1 : 0;
+
+    audio_service_smtc::WatchdogStats health = session->GetWatchdogStats();
+    stats->healthy = health.healthy ? 1 : 0;
+    stats->stalls = health.stalls;
+    stats->failures = health.failures;
+    stats->recoveries = health.recoveries;
+    stats->last_recovery_us = health.lastRecoveryMicros;
+    return 1;
+}
+
+int32_t smtc_set_memory_limits(SmtcSession* session, uint64_t budget_bytes,
+                               uint64_t artwork_cache_bytes, int64_t idle_release_ms) {
+    if (!session || idle_release_ms < 0) return 0;
+
+    session->SetMemoryLimits(static_cast<size_t>(budget_bytes),
+                             static_cast<size_t>(artwork_cache_bytes),
+                             std::chrono::milliseconds(idle_release_ms));
+    return 1;
+}
+
+int32_t smtc_set_thumbnail_budget(SmtcSession* session, uint64_t max_bytes, uint32_t max_edge) {
+    if (!session) return 0;
+
+    session->SetThumbnailBudget(static_cast<size_t>(max_bytes), max_edge);
+    return 1;
+}
+
+int32_t smtc_prefetch_artwork(SmtcSession* session, const char* url, size_t url_length) {
+    if (!session || !url) return 0;
+
+    session->PrefetchArtwork(ToString(url, url_length));
+    return 1;
+}
+
+int32_t smtc_get_memory_stats(SmtcSession* session, SmtcMemoryStats* stats) {
+    if (!session || !stats) return 0;
+
+    using audio_service_smtc::MemoryCategory;
+    audio_service_smtc::MemoryStats current = session->GetMemoryStats();
+    auto category = [&](MemoryCategory which) {
+        return current.byCategory[static_cast<size_t>(which)];
+    };
+    stats->limit = current.limit;
+    stats->used = current.used;
+    stats->peak = current.peak;
+    stats->artwork = category(MemoryCategory::kArtwork);
+    stats->caches = category(MemoryCategory::kCaches);
+    stats->strings = category(MemoryCategory::kStrings);
+    stats->queues = category(MemoryCategory::kQueues);
+    stats->log = category(MemoryCategory::kLog);
+    stats->reclaims = current.reclaims;
+    stats->reclaimed = current.reclaimedBytes;
+    stats->idle_releases = current.idleReleases;
+    return 1;
+}
+
+void smtc_set_event_callback(SmtcSession* session,
+                             SmtcEventCallback callback, void* user) {
+    if (!session) return;
+
+    if (!callback) {
+        session->SetControlCallback(nullptr);
+        session->SetPositionCallback(nullptr);
+        return;
+    }
+
+    session->SetControlCallback([callback, user](const std::string& command) {
+        int32_t event = ControlEvent(command);
+        if (event != 0) {
+            callback(user, event, 0);
+        }
+    });
+    session->SetPositionCallback([callback, user](int64_t position) {
+        callback(user, SMTC_EVENT_POSITION, position);
+    });
+}
+
+void smtc_set_event_port(SmtcSession* session, void* post_cobject, int64_t port) {
+    if (!session) return;
+
+    std::shared_ptr<audio_service_smtc::PortEventSink> sink;
+    if (post_cobject) {
+        sink = std::make_shared<audio_service_smtc::PortEventSink>(
+            std::make_unique<audio_service_smtc::DartPortPoster>(
+                reinterpret_cast<audio_service_smtc::DartPostCObjectFn>(post_cobject), port));
+    }
+    {
+        std::lock_guard<std::mutex> lock(session->portMutex);
+        session->portSink = sink;
+    }
+
+    if (!sink) {
+        session->SetControlCallback(nullptr);
+        session->SetPositionCallback(nullptr);
+        return;
+    }
+
+    // Posted straight from the SMTC event thread
+    session->SetControlCallback([sink](const std::string& command) {
+        int32_t event = ControlEvent(command);
+        if (event != 0) {
+            sink->PostControl(event);
+        }
+    });
+    session->SetPositionCallback([sink](int64_t position) {
+        sink->PostPosition(position);
+    });
+}
+
+int32_t smtc_take_position(SmtcSession* session, int64_t* position) {
+    if (!session || !position) return 0;
+
+    std::shared_ptr<audio_service_smtc::PortEventSink> sink;
+    {
+        std::lock_guard<std::mutex> lock(session->portMutex);
+        sink = session->portSink;
+    }
+    return sink && sink->TakePosition(position) ? 1 : 0;
+}
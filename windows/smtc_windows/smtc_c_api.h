@@ -0,0 +1,187 @@
+#ifndef AUDIO_SERVICE_SMTC_C_API_H_
+#define AUDIO_SERVICE_SMTC_C_API_H_
+
+/*
+ * Plain C ABI over SmtcWindows, usable from dart:ffi. Strings are passed as
+ * UTF-8 pointer + byte length pairs and need not be NUL-terminated. All
+ * functions are safe to call from any thread.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define SMTC_API __declspec(dllexport)
+#else
+#define SMTC_API __attribute__((visibility("default")))
+#endif
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+typedef struct SmtcSession SmtcSession;
+
+/* Playback status values for smtc_update_status. */
+enum {
+    SMTC_STATUS_CLOSED = 0,
+    SMTC_STATUS_STOPPED = 1,
+    SMTC_STATUS_PAUSED = 2,
+    SMTC_STATUS_PLAYING = 3,
+};
+
+/* Event codes passed to SmtcEventCallback. */
+enum {
+    SMTC_EVENT_PLAY = 1,
+    SMTC_EVENT_PAUSE = 2,
+    SMTC_EVENT_NEXT = 3,
+    SMTC_EVENT_PREVIOUS = 4,
+    SMTC_EVENT_STOP = 5,
+    /* `arg` is the requested position in microseconds. */
+    SMTC_EVENT_POSITION = 16,
+    /* Port delivery only: a position request waits in smtc_take_position. */
+    SMTC_EVENT_POSITION_PENDING = 17,
+};
+
+/* Bits of SmtcStatePatch.fields. */
+enum {
+    SMTC_FIELD_STATUS = 1 << 0,
+    SMTC_FIELD_METADATA = 1 << 1,
+    SMTC_FIELD_TIMELINE = 1 << 2,
+    SMTC_FIELD_BUTTONS = 1 << 3,
+};
+
+/* Bits of SmtcStatePatch.enabled_buttons. */
+enum {
+    SMTC_BUTTON_PLAY = 1 << 0,
+    SMTC_BUTTON_PAUSE = 1 << 1,
+    SMTC_BUTTON_NEXT = 1 << 2,
+    SMTC_BUTTON_PREVIOUS = 1 << 3,
+    SMTC_BUTTON_STOP = 1 << 4,
+};
+
+/*
+ * Any subset of the session state; only the groups flagged in `fields` are
+ * read. `duration` applies to both metadata and timeline.
+ */
+typedef struct SmtcStatePatch {
+    uint32_t fields;
+    int32_t status;
+    const char* title;
+    size_t title_length;
+    const char* artist;
+    size_t artist_length;
+    const char* album;
+    size_t album_length;
+    const char* art_url;
+    size_t art_url_length;
+    int64_t duration;
+    int64_t position;
+    double rate;
+    uint32_t enabled_buttons;
+} SmtcStatePatch;
+
+/* Counters of the backend update pipeline and its watchdog. */
+typedef struct SmtcUpdateStats {
+    uint64_t depth;       /* submissions waiting for the backend */
+    uint64_t high_water;  /* largest depth seen */
+    uint64_t submitted;
+    uint64_t committed;
+    uint64_t collapsed;   /* submissions folded into a newer one */
+    int32_t busy;         /* 1 while a commit is running */
+    int32_t healthy;      /* 0 from a failed or stalled call until rebuilt */
+    uint64_t stalls;      /* calls that overran the watchdog deadline */
+    uint64_t failures;    /* calls SMTC rejected */
+    uint64_t recoveries;  /* times the controls were rebuilt */
+    int64_t last_recovery_us;  /* how long the latest recovery took */
+} SmtcUpdateStats;
+
+/* Native memory the plugin accounts for, in bytes. */
+typedef struct SmtcMemoryStats {
+    uint64_t limit;       /* 0 if unlimited */
+    uint64_t used;
+    uint64_t peak;
+    uint64_t artwork;     /* encoded image buffers */
+    uint64_t caches;      /* cache bookkeeping and converted strings */
+    uint64_t strings;     /* interned artist and album names */
+    uint64_t queues;      /* events waiting for Dart */
+    uint64_t log;         /* per-thread log and span rings */
+    uint64_t reclaims;    /* times caches were trimmed to get under the limit */
+    uint64_t reclaimed;   /* bytes freed by trimming */
+    uint64_t idle_releases;
+} SmtcMemoryStats;
+
+/* Called on the SMTC event thread; `arg` is 0 unless noted above. */
+typedef void (*SmtcEventCallback)(void* user, int32_t event, int64_t arg);
+
+/* Returns NULL if the system controls could not be initialized. */
+SMTC_API SmtcSession* smtc_create(const char* identity, size_t identity_length);
+SMTC_API void smtc_destroy(SmtcSession* session);
+
+/* Update functions return 1 on success and 0 on failure. */
+SMTC_API int32_t smtc_update_status(SmtcSession* session, int32_t status);
+SMTC_API int32_t smtc_update_metadata(SmtcSession* session,
+                                      const char* title, size_t title_length,
+                                      const char* artist, size_t artist_length,
+                                      const char* album, size_t album_length,
+                                      int64_t duration,
+                                      const char* art_url, size_t art_url_length);
+SMTC_API int32_t smtc_update_timeline(SmtcSession* session, int64_t position,
+                                      int64_t duration, double rate);
+
+/*
+ * Applies a patch as one transaction with a single backend commit. Updates
+ * are committed on a backend thread and never block the caller; while it is
+ * busy, newer patches are merged into the one waiting.
+ */
+SMTC_API int32_t smtc_apply_state(SmtcSession* session, const SmtcStatePatch* patch);
+
+/* Fills `stats`; returns 0 if either argument is NULL. */
+SMTC_API int32_t smtc_get_update_stats(SmtcSession* session, SmtcUpdateStats* stats);
+
+/*
+ * Caps native memory (0: unlimited) and the artwork cache (0: entry count
+ * only), and sets how long a stopped session keeps cached artwork and idle
+ * threads (0: forever).
+ */
+SMTC_API int32_t smtc_set_memory_limits(SmtcSession* session, uint64_t budget_bytes,
+                                        uint64_t artwork_cache_bytes,
+                                        int64_t idle_release_ms);
+
+/*
+ * Re-encodes artwork larger than `max_bytes` (0: never) to fit it, scaled so
+ * neither side exceeds `max_edge` pixels. Applies to artwork loaded from now
+ * on.
+ */
+SMTC_API int32_t smtc_set_thumbnail_budget(SmtcSession* session, uint64_t max_bytes, uint32_t max_edge);
+
+/*
+ * Loads the artwork of the track expected to play next into the cache,
+ * behind any work for the current track. Returns at once.
+ */
+SMTC_API int32_t smtc_prefetch_artwork(SmtcSession* session, const char* url, size_t url_length);
+
+/* Fills `stats`; returns 0 if either argument is NULL. */
+SMTC_API int32_t smtc_get_memory_stats(SmtcSession* session, SmtcMemoryStats* stats);
+
+/* Replaces the event callback; pass NULL to stop receiving events. */
+SMTC_API void smtc_set_event_callback(SmtcSession* session,
+                                      SmtcEventCallback callback, void* user);
+
+/*
+ * Delivers events to a Dart ReceivePort instead of a callback. `post_cobject`
+ * is NativeApi.postCObject and `port` the SendPort's nativePort. Each message
+ * is an int: event code << 56 | argument. Replaces any event callback; pass
+ * NULL to stop.
+ */
+SMTC_API void smtc_set_event_port(SmtcSession* session, void* post_cobject,
+                                  int64_t port);
+
+/* Takes the newest pending position request. Returns 1 if there was one. */
+SMTC_API int32_t smtc_take_position(SmtcSession* session, int64_t* position);
+
+#if defined(__cplusplus)
+}  // extern "C"
+#endif
+
+#endif  // AUDIO_SERVICE_SMTC_C_API_H_
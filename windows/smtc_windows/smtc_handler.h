@@ -0,0 +1,303 @@
+#pragma once
+
+// WinRT backend for SmtcWindows and BasicSmtcWindows. Pulls in the C++/WinRT
+// headers, so only include it from translation units that need the handler.
+
+#include <windows.h>
+#include <winrt/base.h>
+#include <winrt/Windows.Foundation.h>
+#include <winrt/Windows.Media.h>
+#include <winrt/Windows.Storage.Streams.h>
+#include <shcore.h>
+#include <shlwapi.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "artwork_pipeline.h"
+#include "basic_smtc_windows.h"
+#include "media_backend.h"
+#include "native_log.h"
+#include "player_state.h"
+#include "span_tracer.h"
+#include "timeline_publisher.h"
+#include "utf16_transcode.h"
+
+namespace audio_service_smtc {
+namespace winrt_backend {
+
+// Kept inside this namespace so including the header doesn't leak them
+using namespace winrt;
+using namespace winrt::Windows::Media;
+using namespace winrt::Windows::Foundation;
+using namespace winrt::Windows::Storage::Streams;
+
+// Wraps encoded image bytes in a WinRT stream without going through the
+// async DataWriter APIs, so it can be used on the platform thread.
+inline IRandomAccessStream CreateStreamFromBytes(const std::vector<uint8_t>& bytes) {
+    winrt::com_ptr<IStream> memStream;
+    memStream.attach(SHCreateMemStream(bytes.data(), static_cast<UINT>(bytes.size())));
+    if (!memStream) return nullptr;
+
+    IRandomAccessStream stream{ nullptr };
+    winrt::check_hresult(CreateRandomAccessStreamOverStream(
+        memStream.get(), BSOS_DEFAULT, winrt::guid_of<IRandomAccessStream>(), winrt::put_abi(stream)));
+    return stream;
+}
+
+// Owns the system media transport controls of the process. Calls are
+// synchronous WinRT calls; failures are logged and reported as false.
+// Final, so BasicSmtcWindows calls it without virtual dispatch.
+class SMTCHandlerImpl final : public MediaBackend {
+public:
+    SMTCHandlerImpl(const std::string& identity) : _identity(identity) {
+        init_apartment();
+        InitializeControls();
+    }
+
+    ~SMTCHandlerImpl() override {
+        // Clean up resources
+        try {
+            if (_controls) {
+                _controls.ButtonPressed(_buttonPressedToken);
+                _controls.PlaybackPositionChangeRequested(_positionChangeRequestedToken);
+                _controls = nullptr;
+            }
+            _displayUpdater = nullptr;
+        }
+        catch (...) {
+            // Ignore exceptions during cleanup
+        }
+    }
+
+    // False if the system controls could not be obtained
+    bool IsReady() const override {
+        return _controls && _displayUpdater;
+    }
+
+    // Pushes the fields flagged in `changed`; the display updater is
+    // committed at most once, so status and metadata change together.
+    // Returns false if SMTC rejected the update.
+    bool ApplyState(const PlayerState& state, uint32_t changed, const ArtworkImage& artwork) override {
+        SMTC_SPAN(span, "backend", "ApplyState");
+        if (!IsReady()) return false;
+
+        try {
+            if (changed & kButtonsField) {
+                _controls.IsPlayEnabled((state.enabledButtons & kPlayButton) != 0);
+                _controls.IsPauseEnabled((state.enabledButtons & kPauseButton) != 0);
+                _controls.IsNextEnabled((state.enabledButtons & kNextButton) != 0);
+                _controls.IsPreviousEnabled((state.enabledButtons & kPreviousButton) != 0);
+                _controls.IsStopEnabled((state.enabledButtons & kStopButton) != 0);
+            }
+
+            if (changed & kStatusField) {
+                _controls.PlaybackStatus(ToMediaPlaybackStatus(state.status));
+            }
+
+            if (changed & kMetadataField) {
+                _displayUpdater.Type(MediaPlaybackType::Music);
+                
+                // Set every field so nothing from the previous track lingers
+                auto musicProps = _displayUpdater.MusicProperties();
+                musicProps.Title(ToHString(state.metadata.title));
+                musicProps.Artist(ToHString(state.metadata.artist.view()));
+                musicProps.AlbumTitle(ToHString(state.metadata.album.view()));
+                
+                // Placeholder artwork goes out in the same update as the title
+                SetThumbnail(artwork);
+                
+                // Apply changes
+                CommitDisplay();
+            }
+            return true;
+        }
+        catch (const winrt::hresult_error& ex) {
+            SMTC_LOG_ERROR("Error applying state", winrt::to_string(ex.message()));
+            return false;
+        }
+    }
+
+    bool UpdateThumbnail(const ArtworkImage& artwork) override {
+        SMTC_SPAN(span, "backend", "UpdateThumbnail");
+        if (!IsReady()) return false;
+
+        try {
+            SetThumbnail(artwork);
+            CommitDisplay();
+            return true;
+        }
+        catch (const winrt::hresult_error& ex) {
+            SMTC_LOG_ERROR("Error updating thumbnail", winrt::to_string(ex.message()));
+            return false;
+        }
+    }
+
+    bool UpdateTimeline(const TimelineSnapshot& timeline) override {
+        SMTC_SPAN(span, "backend", "UpdateTimeline");
+        if (!IsReady()) return false;
+
+        try {
+            SystemMediaTransportControlsTimelineProperties properties;
+            properties.StartTime(TimeSpan{ 0 });
+            properties.MinSeekTime(TimeSpan{ 0 });
+            properties.EndTime(std::chrono::microseconds(timeline.duration));
+            properties.MaxSeekTime(std::chrono::microseconds(timeline.duration));
+            properties.Position(std::chrono::microseconds(timeline.position));
+            _controls.UpdateTimelineProperties(properties);
+            _controls.PlaybackRate(timeline.rate);
+            return true;
+        }
+        catch (const winrt::hresult_error& ex) {
+            SMTC_LOG_ERROR("Error updating timeline", winrt::to_string(ex.message()));
+            return false;
+        }
+    }
+
+    void SetControlCallback(std::function<void(const std::string&)> controlCb) override {
+        std::lock_guard<std::mutex> lock(_callbackMutex);
+        _controlCallback = controlCb;
+    }
+    
+    void SetPositionCallback(std::function<void(int64_t)> positionCb) override {
+        std::lock_guard<std::mutex> lock(_callbackMutex);
+        _positionCallback = positionCb;
+    }
+
+private:
+    std::string _identity;
+    SystemMediaTransportControls _controls{ nullptr };
+    SystemMediaTransportControlsDisplayUpdater _displayUpdater{ nullptr };
+    winrt::event_token _buttonPressedToken{};
+    winrt::event_token _positionChangeRequestedToken{};
+    
+    std::function<void(const std::string&)> _controlCallback;
+    std::function<void(int64_t)> _positionCallback;
+    std::mutex _callbackMutex;
+    Utf16Cache<hstring> _strings;
+
+    // Artist and album rarely change between tracks; their hstrings are reused
+    // rather than transcoded and allocated again
+    const hstring& ToHString(std::string_view text) {
+        return _strings.Get(text, [](std::u16string_view utf16) {
+            return hstring(reinterpret_cast<const wchar_t*>(utf16.data()),
+                           static_cast<hstring::size_type>(utf16.size()));
+        });
+    }
+
+    static MediaPlaybackStatus ToMediaPlaybackStatus(PlaybackState state) {
+        switch (state) {
+        case PlaybackState::kPlaying:
+            return MediaPlaybackStatus::Playing;
+        case PlaybackState::kPaused:
+            return MediaPlaybackStatus::Paused;
+        case PlaybackState::kStopped:
+            return MediaPlaybackStatus::Stopped;
+        default:
+            return MediaPlaybackStatus::Closed;
+        }
+    }
+
+    // Spanned on its own: this is the call that blocks while the shell is
+    // slow to take an update
+    void CommitDisplay() {
+        SMTC_SPAN(span, "backend", "DisplayUpdater.Update");
+        _displayUpdater.Update();
+    }
+
+    void SetThumbnail(const ArtworkImage& artwork) {
+        SMTC_SPAN(span, "backend", "SetThumbnail");
+        if (artwork.empty()) {
+            _displayUpdater.Thumbnail(nullptr);
+            return;
+        }
+        span.SetArg(static_cast<int64_t>(artwork.bytes->size()));
+        IRandomAccessStream stream = CreateStreamFromBytes(*artwork.bytes);
+        _displayUpdater.Thumbnail(stream ? RandomAccessStreamReference::CreateFromStream(stream) : nullptr);
+    }
+
+    void InitializeControls() {
+        SMTC_SPAN(span, "backend", "InitializeControls");
+        try {
+            // Get the system media transport controls for the current view
+            _controls = SystemMediaTransportControls::GetForCurrentView();
+            
+            if (!_controls) {
+                SMTC_LOG_ERROR("Failed to get SMTC for current view", "");
+                return;
+            }
+            
+            // Enable controls
+            _controls.IsEnabled(true);
+            _controls.IsPlayEnabled(true);
+            _controls.IsPauseEnabled(true);
+            _controls.IsNextEnabled(true);
+            _controls.IsPreviousEnabled(true);
+            _controls.IsStopEnabled(true);
+            
+            // Get the display updater
+            _displayUpdater = _controls.DisplayUpdater();
+            
+            // Register for button events
+            _buttonPressedToken = _controls.ButtonPressed([this](
+                SystemMediaTransportControls const& sender,
+                SystemMediaTransportControlsButtonPressedEventArgs const& args) {
+                    
+                std::string command;
+                
+                switch (args.Button()) {
+                case SystemMediaTransportControlsButton::Play:
+                    command = "play";
+                    break;
+                case SystemMediaTransportControlsButton::Pause:
+                    command = "pause";
+                    break;
+                case SystemMediaTransportControlsButton::Next:
+                    command = "next";
+                    break;
+                case SystemMediaTransportControlsButton::Previous:
+                    command = "previous";
+                    break;
+                case SystemMediaTransportControlsButton::Stop:
+                    command = "stop";
+                    break;
+                default:
+                    return;
+                }
+                
+                SMTC_SPAN_LABELLED(span, "backend", "ButtonPressed", command);
+                std::lock_guard<std::mutex> lock(_callbackMutex);
+                if (_controlCallback) {
+                    _controlCallback(command);
+                }
+            });
+
+            // Seek bar drags arrive here, one request per position
+            _positionChangeRequestedToken = _controls.PlaybackPositionChangeRequested([this](
+                SystemMediaTransportControls const& sender,
+                PlaybackPositionChangeRequestedEventArgs const& args) {
+                // TimeSpan ticks are 100ns
+                int64_t positionMicroseconds = args.RequestedPlaybackPosition().count() / 10;
+
+                std::lock_guard<std::mutex> lock(_callbackMutex);
+                if (_positionCallback) {
+                    _positionCallback(positionMicroseconds);
+                }
+            });
+        }
+        catch (const winrt::hresult_error& ex) {
+            SMTC_LOG_ERROR("Error initializing SMTC", winrt::to_string(ex.message()));
+        }
+    }
+};
+
+// No locking, no logging, no queue: for hosts that drive SMTC from a single
+// thread and want the least per-call overhead
+using SingleThreadSmtcWindows = BasicSmtcWindows<SMTCHandlerImpl, NoLock, NullLog>;
+
+}  // namespace winrt_backend
+}  // namespace audio_service_smtc
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+
+#include "event_poster.h"
+#include "smtc_c_api.h"
+#include "smtc_windows.h"
+
+// The object behind the C ABI's opaque handle: the SmtcWindows instance plus
+// the state of the port delivery mode. Create and destroy it with
+// smtc_create and smtc_destroy; a plugin holding one can call SmtcWindows
+// directly and still hand the handle to dart:ffi.
+struct SmtcSession : SmtcWindows {
+    std::mutex portMutex;
+    std::shared_ptr<audio_service_smtc::PortEventSink> portSink;
+};
@@ -6,283 +6,433 @@
 #include <winrt/Windows.Media.Playback.h>
 #include <winrt/Windows.Storage.Streams.h>
 #include <winrt/Windows.Foundation.Collections.h>
+#include <winrt/Windows.Graphics.Imaging.h>
+#include <winrt/Windows.Web.Http.h>
+#include <shcore.h>
+#include <shlwapi.h>
 #include "smtc_windows.h"
+#include "smtc_handler.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
 #include <string>
 #include <functional>
-#include <iostream>
 #include <mutex>
 
+#include "native_log.h"
+#include "session_trace.h"
+#include "span_tracer.h"
+
 using namespace winrt;
 using namespace Windows::Media;
 using namespace Windows::Foundation;
+using namespace Windows::Storage::Streams;
+using audio_service_smtc::ArtworkImage;
+using audio_service_smtc::LockWithSpan;
+using audio_service_smtc::MediaBackend;
+using audio_service_smtc::MemoryBudget;
+using audio_service_smtc::MemoryStats;
+using audio_service_smtc::PlaybackState;
+using audio_service_smtc::PlayerState;
+using audio_service_smtc::PlayerStatePatch;
+using audio_service_smtc::RgbaImage;
+using audio_service_smtc::ThumbnailBudget;
+using audio_service_smtc::TimelineSnapshot;
+using audio_service_smtc::UpdatePipelineStats;
+using audio_service_smtc::WatchdogStats;
+using audio_service_smtc::winrt_backend::SMTCHandlerImpl;
 
-// Implementation class to hide WinRT details
-class SMTCHandlerImpl {
-public:
-    SMTCHandlerImpl(const std::string& identity) : _identity(identity) {
-        init_apartment();
-        InitializeControls();
-    }
+// How long a stopped session keeps its artwork and threads by default
+static constexpr std::chrono::milliseconds kIdleRelease{ 30000 };
 
-    ~SMTCHandlerImpl() {
-        // Clean up resources
-        try {
-            if (_controls) {
-                _controls.ButtonPressed(_buttonPressedToken);
-                _controls = nullptr;
-            }
-            _displayUpdater = nullptr;
-        }
-        catch (...) {
-            // Ignore exceptions during cleanup
-        }
-    }
+// Waits for _mutex, labelled with the caller. The backend thread holds it
+// across WinRT calls, so this is where a slow Update() shows up elsewhere.
+static constexpr audio_service_smtc::SpanSite kMutexWait{ "lock", "SmtcWindows::_mutex" };
 
-    void UpdatePlaybackState(const std::string& state) {
-        if (!_controls) return;
-
-        MediaPlaybackStatus status = MediaPlaybackStatus::Closed;
-        
-        if (state == "Playing") {
-            status = MediaPlaybackStatus::Playing;
-        } else if (state == "Paused") {
-            status = MediaPlaybackStatus::Paused;
-        } else if (state == "Stopped") {
-            status = MediaPlaybackStatus::Stopped;
-        }
+// Artwork loader used by the pipeline. Remote URLs are only fetched from
+// the worker pool, never for the placeholder stage.
+static bool LoadArtwork(const std::string& url, size_t maxBytes, std::vector<uint8_t>& out) {
+    if (audio_service_smtc::IsLocalArtworkUrl(url)) {
+        return audio_service_smtc::LoadLocalArtwork(url, maxBytes, out);
+    }
+    if (maxBytes != 0) return false;
 
-        _controls.PlaybackStatus(status);
+    try {
+        Windows::Web::Http::HttpClient client;
+        IBuffer buffer = client.GetBufferAsync(Uri(winrt::to_hstring(url))).get();
+        out.assign(buffer.data(), buffer.data() + buffer.Length());
+        return true;
     }
+    catch (const winrt::hresult_error& ex) {
+        SMTC_LOG_ERROR("Error fetching artwork", winrt::to_string(ex.message()));
+        return false;
+    }
+}
 
-    void UpdateMetadata(const std::string& title, const std::string& artist, 
-                         const std::string& album, int64_t durationMicroseconds, 
-                         const std::string& albumArtUrl) {
-        if (!_displayUpdater) return;
-
-        try {
-            // Clear existing properties
-            _displayUpdater.Type(MediaPlaybackType::Music);
-            
-            // Set music properties
-            auto musicProps = _displayUpdater.MusicProperties();
-            musicProps.Title(winrt::to_hstring(title));
-            
-            if (!artist.empty()) {
-                musicProps.Artist(winrt::to_hstring(artist));
-            }
-            
-            if (!album.empty()) {
-                musicProps.AlbumTitle(winrt::to_hstring(album));
-            }
-            
-            // Set thumbnail if URL is provided
-            if (!albumArtUrl.empty()) {
-                // Note: This is a simplified example. 
-                // In a real implementation, you would need to download
-                // the image or use a local file
-                // _displayUpdater.Thumbnail(/* Set thumbnail from URL */);
-            }
-            
-            // Apply changes
-            _displayUpdater.Update();
-        }
-        catch (const winrt::hresult_error& ex) {
-            std::cerr << "Error updating metadata: " << winrt::to_string(ex.message()) << std::endl;
+// Decoder for thumbnail re-encoding. Scales while decoding, so the full-size
+// bitmap is never held. EXIF orientation is ignored: album art rarely
+// carries one, and the scaled size is then simply the pixel size.
+static bool DecodeArtwork(const std::vector<uint8_t>& bytes, uint32_t maxEdge, RgbaImage& out) {
+    using namespace Windows::Graphics::Imaging;
+    try {
+        IRandomAccessStream stream = audio_service_smtc::winrt_backend::CreateStreamFromBytes(bytes);
+        if (!stream) return false;
+        BitmapDecoder decoder = BitmapDecoder::CreateAsync(stream).get();
+
+        uint32_t width = decoder.PixelWidth();
+        uint32_t height = decoder.PixelHeight();
+        if (width == 0 || height == 0) return false;
+        BitmapTransform transform;
+        uint32_t longest = (std::max)(width, height);
+        if (maxEdge != 0 && longest > maxEdge) {
+            width = (std::max)(1u, static_cast<uint32_t>(static_cast<uint64_t>(width) * maxEdge / longest));
+            height = (std::max)(1u, static_cast<uint32_t>(static_cast<uint64_t>(height) * maxEdge / longest));
+            transform.ScaledWidth(width);
+            transform.ScaledHeight(height);
+            transform.InterpolationMode(BitmapInterpolationMode::Fant);
         }
-    }
 
-    void SetControlCallback(std::function<void(const std::string&)> controlCb) {
-        _controlCallback = controlCb;
+        PixelDataProvider pixels = decoder.GetPixelDataAsync(
+            BitmapPixelFormat::Rgba8, BitmapAlphaMode::Straight, transform,
+            ExifOrientationMode::IgnoreExifOrientation, ColorManagementMode::ColorManageToSRgb).get();
+        com_array<uint8_t> data = pixels.DetachPixelData();
+        if (data.size() != static_cast<size_t>(width) * height * 4) return false;
+
+        out.width = width;
+        out.height = height;
+        out.pixels.assign(data.begin(), data.end());
+        return true;
     }
-    
-    void SetPositionCallback(std::function<void(int64_t)> positionCb) {
-        _positionCallback = positionCb;
+    catch (const winrt::hresult_error& ex) {
+        SMTC_LOG_WARNING("Error decoding artwork", winrt::to_string(ex.message()));
+        return false;
     }
+}
 
-private:
-    std::string _identity;
-    SystemMediaTransportControls _controls{ nullptr };
-    SystemMediaTransportControlsDisplayUpdater _displayUpdater{ nullptr };
-    winrt::event_token _buttonPressedToken{};
-    
-    std::function<void(const std::string&)> _controlCallback;
-    std::function<void(int64_t)> _positionCallback;
-    std::mutex _callbackMutex;
-
-    void InitializeControls() {
-        try {
-            // Get the system media transport controls for the current view
-            _controls = SystemMediaTransportControls::GetForCurrentView();
-            
-            if (!_controls) {
-                std::cerr << "Failed to get SMTC for current view" << std::endl;
-                return;
-            }
-            
-            // Enable controls
-            _controls.IsEnabled(true);
-            _controls.IsPlayEnabled(true);
-            _controls.IsPauseEnabled(true);
-            _controls.IsNextEnabled(true);
-            _controls.IsPreviousEnabled(true);
-            _controls.IsStopEnabled(true);
-            
-            // Get the display updater
-            _displayUpdater = _controls.DisplayUpdater();
-            
-            // Register for button events
-            _buttonPressedToken = _controls.ButtonPressed([this](
-                SystemMediaTransportControls const& sender,
-                SystemMediaTransportControlsButtonPressedEventArgs const& args) {
-                    
-                std::string command;
-                
-                switch (args.Button()) {
-                case SystemMediaTransportControlsButton::Play:
-                    command = "play";
-                    break;
-                case SystemMediaTransportControlsButton::Pause:
-                    command = "pause";
-                    break;
-                case SystemMediaTransportControlsButton::Next:
-                    command = "next";
-                    break;
-                case SystemMediaTransportControlsButton::Previous:
-                    command = "previous";
-                    break;
-                case SystemMediaTransportControlsButton::Stop:
-                    command = "stop";
-                    break;
-                default:
-                    return;
-                }
-                
-                std::lock_guard<std::mutex> lock(_callbackMutex);
-                if (_controlCallback) {
-                    _controlCallback(command);
-                }
-            });
-        }
-        catch (const winrt::hresult_error& ex) {
-            std::cerr << "Error initializing SMTC: " << winrt::to_string(ex.message()) << std::endl;
-        }
+// Where fetched artwork is kept between runs:
+// %LOCALAPPDATA%\audio_service_smtc\<identity>\artwork. Empty if unknown.
+static std::string ArtworkStoreDirectory(const std::string& identity) {
+    wchar_t base[MAX_PATH];
+    DWORD length = GetEnvironmentVariableW(L"LOCALAPPDATA", base, MAX_PATH);
+    if (length == 0 || length >= MAX_PATH) return {};
+
+    std::string folder;
+    for (char c : identity) {
+        folder.push_back(std::isalnum(static_cast<unsigned char>(c)) || c == '.' || c == '-' ? c : '_');
     }
-};
+    if (folder.empty()) folder = "default";
+    return winrt::to_string(std::wstring_view(base, length)) + "\\audio_service_smtc\\" + folder + "\\artwork";
+}
 
 // SmtcWindows implementation
-SmtcWindows::SmtcWindows() : _initialized(false) {}
+SmtcWindows::SmtcWindows() : _artworkGeneration(0), _initialized(false) {}
 
 SmtcWindows::~SmtcWindows() {
-    // Impl will be cleaned up by unique_ptr
+    // Forget the handlers first, so a rebuild racing with teardown can't
+    // hand them to a new backend, then wait out any rebuild in progress
+    {
+        std::lock_guard<std::mutex> lock(_recoveryMutex);
+        _controlHandler = nullptr;
+        _positionHandler = nullptr;
+    }
+    if (_watchdog) _watchdog->Stop();
+
+    // Wait for in-flight SMTC events, then stop the threads before the
+    // pipeline, publisher and handler they call into go away
+    if (auto impl = Backend()) {
+        impl->SetControlCallback(nullptr);
+        impl->SetPositionCallback(nullptr);
+    }
+    _updates.reset();
+    _workers.reset();
+    _timeline.reset();
+    // Last, since every thread above still reports its calls to it
+    _watchdog.reset();
+    _artwork.reset();
 }
 
 bool SmtcWindows::Initialize(const std::string& identity) {
-    std::lock_guard<std::mutex> lock(_mutex);
+    SMTC_SPAN(span, "session", "Initialize");
+    auto lock = LockWithSpan(_mutex, kMutexWait, "Initialize");
     if (_initialized) return true;
     
     try {
-        _impl = std::make_unique<SMTCHandlerImpl>(identity);
+        _identity = identity;
+        _impl = std::make_shared<SMTCHandlerImpl>(identity);
+        audio_service_smtc::BackendWatchdog::Options watchdogOptions;
+        watchdogOptions.onThreadStart = [] { init_apartment(); };
+        watchdogOptions.onThreadExit = [] { uninit_apartment(); };
+        _watchdog = std::make_unique<audio_service_smtc::BackendWatchdog>(
+            [this] { return RebuildBackend(); },
+            std::move(watchdogOptions));
+        audio_service_smtc::WorkerPool::Options options;
+        options.onThreadStart = [] { init_apartment(); };
+        options.onThreadExit = [] { uninit_apartment(); };
+        _workers = std::make_unique<audio_service_smtc::WorkerPool>(std::move(options));
+        _artwork = std::make_unique<audio_service_smtc::ArtworkPipeline>(
+            *_workers,
+            LoadArtwork,
+            [this](uint64_t generation, const ArtworkImage& image) { CommitArtwork(generation, image); });
+        _artwork->SetDecoder(DecodeArtwork);
+        // Opening may rebuild the index after a crash, so not on this thread.
+        // The pool is shut down before the pipeline.
+        _workers->Submit(audio_service_smtc::TaskPriority::kMaintenance, [this, identity] {
+            std::string directory = ArtworkStoreDirectory(identity);
+            if (directory.empty()) return;
+            std::shared_ptr<audio_service_smtc::ArtworkStore> store =
+                audio_service_smtc::ArtworkStore::Open(directory);
+            if (store) {
+                _artwork->SetStore(std::move(store));
+            } else {
+                SMTC_LOG_WARNING("Artwork store unavailable", directory);
+            }
+        });
+        _timeline = std::make_unique<audio_service_smtc::TimelinePublisher>(
+            [this](const TimelineSnapshot& timeline) { CommitTimeline(timeline); });
+        audio_service_smtc::UpdatePipeline::Options updateOptions;
+        updateOptions.onThreadStart = [] { init_apartment(); };
+        updateOptions.onThreadExit = [] { uninit_apartment(); };
+        updateOptions.onIdle = [this] { ReleaseIdleResources(); };
+        updateOptions.idleTimeout = kIdleRelease;
+        _updates = std::make_unique<audio_service_smtc::UpdatePipeline>(
+            [this](const PlayerStatePatch& patch) { CommitState(patch); },
+            std::move(updateOptions));
         _initialized = true;
         return true;
     }
     catch (const std::exception& ex) {
-        std::cerr << "Failed to initialize SMTC: " << ex.what() << std::endl;
+        SMTC_LOG_ERROR("Failed to initialize SMTC", ex.what());
         return false;
     }
 }
 
 bool SmtcWindows::UpdatePlaybackStatus(const std::string& status) {
-    std::lock_guard<std::mutex> lock(_mutex);
-    if (!_initialized || !_impl) return false;
-    
-    try {
-        _impl->UpdatePlaybackState(status);
-        return true;
-    }
-    catch (const std::exception& ex) {
-        std::cerr << "Error updating playback status: " << ex.what() << std::endl;
-        return false;
-    }
+    PlayerStatePatch patch;
+    patch.status = audio_service_smtc::ParsePlaybackState(status.c_str());
+    return ApplyState(patch);
 }
 
 bool SmtcWindows::UpdateMetadata(const std::string& title, const std::string& artist, 
                                const std::string& album, int64_t duration, 
                                const std::string& albumArtUrl) {
-    std::lock_guard<std::mutex> lock(_mutex);
-    if (!_initialized || !_impl) return false;
+    PlayerStatePatch patch;
+    patch.metadata = audio_service_smtc::MakeMetadata(title, artist, album, albumArtUrl, duration);
+    return ApplyState(patch);
+}
+
+bool SmtcWindows::ApplyState(const PlayerStatePatch& patch) {
+    // Deliberately not taking _mutex: the backend thread holds it across
+    // WinRT calls. The pipeline is only published once Initialize is done.
+    if (!_initialized) return false;
+
+    // Committed on the backend thread, so a stalled Update() never blocks the
+    // caller; patches that pile up meanwhile are merged
+    _updates->Submit(patch);
+    return true;
+}
+
+UpdatePipelineStats SmtcWindows::GetUpdateStats() {
+    return _initialized ? _updates->Stats() : UpdatePipelineStats{};
+}
+
+WatchdogStats SmtcWindows::GetWatchdogStats() {
+    return _initialized ? _watchdog->Stats() : WatchdogStats{};
+}
+
+std::shared_ptr<MediaBackend> SmtcWindows::Backend() {
+    std::lock_guard<std::mutex> lock(_recoveryMutex);
+    return _impl;
+}
+
+bool SmtcWindows::RebuildBackend() {
+    // Runs on the watchdog thread, possibly while a stalled call still holds
+    // _mutex, so only the recovery state is touched here
+    SMTC_SPAN(span, "session", "RebuildBackend");
+    SMTC_LOG_WARNING("Rebuilding SMTC controls", "");
+    auto impl = std::make_shared<SMTCHandlerImpl>(_identity);
+    if (!impl->IsReady()) return false;
+
+    std::lock_guard<std::mutex> lock(_recoveryMutex);
+    // The old handler lives on until the stalled call drops it; silence it
+    // first so no button press is delivered twice
+    if (_impl) {
+        _impl->SetControlCallback(nullptr);
+        _impl->SetPositionCallback(nullptr);
+    }
+    impl->SetControlCallback(_controlHandler);
+    impl->SetPositionCallback(_positionHandler);
+
+    using namespace audio_service_smtc;
+    bool replayed = impl->ApplyState(_shownState, kButtonsField | kStatusField | kMetadataField, _shownArtwork)
+        && impl->UpdateTimeline(_shownTimeline);
+    _impl = impl;
+    return replayed;
+}
+
+void SmtcWindows::CommitState(const PlayerStatePatch& patch) {
+    SMTC_SPAN(span, "session", "CommitState");
+    auto lock = LockWithSpan(_mutex, kMutexWait, "CommitState");
+    if (!_initialized) return;
     
     try {
-        _impl->UpdateMetadata(title, artist, album, duration, albumArtUrl);
-        return true;
+        uint32_t changed = _state.Apply(patch);
+        const PlayerState& state = _state.Committed();
+        if (audio_service_smtc::TraceRecorder* trace = audio_service_smtc::ActiveTrace()) {
+            trace->RecordCommit(patch, changed);
+        }
+
+        ArtworkImage artwork;
+        if (changed & audio_service_smtc::kMetadataField) {
+            artwork = _artwork->Begin(++_artworkGeneration, state.metadata.artUrl);
+        }
+
+        std::shared_ptr<MediaBackend> impl;
+        {
+            // Recorded before the call, so a rebuild racing with it replays
+            // this state
+            std::lock_guard<std::mutex> recovery(_recoveryMutex);
+            _shownState = state;
+            if (changed & audio_service_smtc::kMetadataField) {
+                _shownArtwork = artwork;
+            }
+            impl = _impl;
+        }
+        _watchdog->Run([&] { return impl->ApplyState(state, changed, artwork); });
+
+        if (changed & audio_service_smtc::kStatusField) {
+            _timeline->SetPlaybackState(state.status);
+        }
+        if (changed & audio_service_smtc::kTimelineField) {
+            _timeline->SetTimeline(state.timeline.position, state.timeline.duration, state.timeline.rate);
+        }
+        // Interned artist and album names and queued events are charged
+        // outside any cache
+        MemoryBudget::Shared().Enforce();
     }
     catch (const std::exception& ex) {
-        std::cerr << "Error updating metadata: " << ex.what() << std::endl;
-        return false;
+        SMTC_LOG_ERROR("Error applying state", ex.what());
     }
 }
 
-void SmtcWindows::SetControlCallback(std::function<void(const std::string&)> callback) {
-    std::lock_guard<std::mutex> lock(_mutex);
-    if (_initialized && _impl) {
-        _impl->SetControlCallback(callback);
+void SmtcWindows::CommitArtwork(uint64_t generation, const ArtworkImage& image) {
+    SMTC_SPAN(span, "session", "CommitArtwork");
+    auto lock = LockWithSpan(_mutex, kMutexWait, "CommitArtwork");
+    // A newer track may have started while the image was loading
+    if (!_initialized || generation != _artworkGeneration) return;
+
+    std::shared_ptr<MediaBackend> impl;
+    {
+        std::lock_guard<std::mutex> recovery(_recoveryMutex);
+        _shownArtwork = image;
+        impl = _impl;
     }
+    _watchdog->Run([&] { return impl->UpdateThumbnail(image); });
 }
 
-void SmtcWindows::SetPositionCallback(std::function<void(int64_t)> callback) {
-    std::lock_guard<std::mutex> lock(_mutex);
-    if (_initialized && _impl) {
-        _impl->SetPositionCallback(callback);
-    }
+bool SmtcWindows::UpdateTimeline(int64_t position, int64_t duration, double rate) {
+    PlayerStatePatch patch;
+    patch.timeline = TimelineSnapshot{ position, duration, rate };
+    return ApplyState(patch);
 }
 
-// C interface implementation
-void* CreateSMTCHandler(const char* identity) {
-    try {
-        return new SMTCHandlerImpl(identity ? identity : "audio_service_smtc");
-    }
-    catch (...) {
-        return nullptr;
+void SmtcWindows::CommitTimeline(const TimelineSnapshot& timeline) {
+    SMTC_SPAN(span, "session", "CommitTimeline");
+    auto lock = LockWithSpan(_mutex, kMutexWait, "CommitTimeline");
+    if (!_initialized) return;
+
+    std::shared_ptr<MediaBackend> impl;
+    {
+        std::lock_guard<std::mutex> recovery(_recoveryMutex);
+        _shownTimeline = timeline;
+        impl = _impl;
     }
+    _watchdog->Run([&] { return impl->UpdateTimeline(timeline); });
 }
 
-void DisposeSMTCHandler(void* handler) {
-    if (handler) {
-        delete static_cast<SMTCHandlerImpl*>(handler);
+void SmtcWindows::SetControlCallback(std::function<void(const std::string&)> callback) {
+    // Not under _mutex, so a stalled backend call doesn't hold this up
+    if (!_initialized) return;
+
+    std::function<void(const std::string&)> handler;
+    if (callback) {
+        // A button press means a system surface is showing our session
+        handler = [this, callback](const std::string& command) {
+            _timeline->NoteSurfaceActivity();
+            callback(command);
+        };
     }
+
+    std::lock_guard<std::mutex> lock(_recoveryMutex);
+    _controlHandler = handler;
+    _impl->SetControlCallback(std::move(handler));
 }
 
-void UpdatePlaybackStatus(void* handler, const char* status) {
-    if (handler && status) {
-        static_cast<SMTCHandlerImpl*>(handler)->UpdatePlaybackState(status);
+void SmtcWindows::SetPositionCallback(std::function<void(int64_t)> callback) {
+    if (!_initialized) return;
+
+    std::function<void(int64_t)> handler;
+    if (callback) {
+        handler = [this, callback](int64_t position) {
+            _timeline->NoteSurfaceActivity();
+            callback(position);
+        };
     }
+
+    std::lock_guard<std::mutex> lock(_recoveryMutex);
+    _positionHandler = handler;
+    _impl->SetPositionCallback(std::move(handler));
 }
 
-void UpdateMetadata(void* handler, const char* title, const char* artist, 
-                   const char* album, int64_t duration, const char* albumArtUrl) {
-    if (handler && title) {
-        static_cast<SMTCHandlerImpl*>(handler)->UpdateMetadata(
-            title, 
-            artist ? artist : "", 
-            album ? album : "", 
-            duration,
-            albumArtUrl ? albumArtUrl : "");
+void SmtcWindows::SetWorkerThreadCount(size_t count) {
+    auto lock = LockWithSpan(_mutex, kMutexWait, "SetWorkerThreadCount");
+    if (_initialized && _workers) {
+        _workers->SetThreadCount(count);
     }
 }
 
-void SetCallbacks(void* handler, 
-                 std::function<void(const char*)> controlCallback,
-                 std::function<void(int64_t)> positionCallback) {
-    if (handler) {
-        auto impl = static_cast<SMTCHandlerImpl*>(handler);
-        
-        if (controlCallback) {
-            impl->SetControlCallback([cb = controlCallback](const std::string& cmd) {
-                cb(cmd.c_str());
-            });
-        }
-        
-        if (positionCallback) {
-            impl->SetPositionCallback(positionCallback);
-        }
-    }
+void SmtcWindows::SetMemoryLimits(size_t budgetBytes, size_t artworkCacheBytes,
+                                  std::chrono::milliseconds idleRelease) {
+    if (!_initialized) return;
+
+    _artwork->SetCacheLimit(artworkCacheBytes);
+    _updates->SetIdleTimeout(idleRelease);
+    MemoryBudget::Shared().SetLimit(budgetBytes);
+}
+
+void SmtcWindows::SetThumbnailBudget(size_t maxBytes, uint32_t maxEdge) {
+    if (!_initialized) return;
+
+    ThumbnailBudget budget;
+    budget.maxBytes = maxBytes;
+    budget.maxEdge = maxEdge;
+    _artwork->SetThumbnailBudget(budget);
+}
+
+void SmtcWindows::PrefetchArtwork(const std::string& url) {
+    if (!_initialized) return;
+
+    _artwork->Prefetch(url);
+}
+
+MemoryStats SmtcWindows::GetMemoryStats() {
+    return MemoryBudget::Shared().Stats();
 }
+
+void SmtcWindows::ReleaseIdleResources() {
+    SMTC_SPAN(span, "session", "ReleaseIdleResources");
+    {
+        auto lock = LockWithSpan(_mutex, kMutexWait, "ReleaseIdleResources");
+        if (!_initialized) return;
+        PlaybackState status = _state.Committed().status;
+        if (status != PlaybackState::kStopped && status != PlaybackState::kClosed) return;
+    }
+    {
+        // The handler holds its own copy of the thumbnail; a rebuild while
+        // stopped just comes back without one
+        std::lock_guard<std::mutex> recovery(_recoveryMutex);
+        _shownArtwork = ArtworkImage{};
+    }
+    _workers->ReleaseIdleThreads();
+    size_t freed = MemoryBudget::Shared().ReleaseIdle();
+    SMTC_LOG_INFO("Released idle resources", std::to_string(freed) + " bytes");
+}
\ No newline at end of file
@@ -1,14 +1,25 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <functional>
 #include <cstdint>
 #include <string>
 #include <memory>
 #include <mutex>
 
-// Forward declare handler class to avoid including WinRT headers in header
-class SMTCHandlerImpl;
+#include "artwork_pipeline.h"
+#include "backend_watchdog.h"
+#include "media_backend.h"
+#include "memory_budget.h"
+#include "player_state.h"
+#include "timeline_publisher.h"
+#include "update_pipeline.h"
+#include "worker_pool.h"
 
+// The plugin's session: type-erased over the WinRT handler, thread-safe, with
+// queued commits, watchdog recovery and background artwork loading. See
+// BasicSmtcWindows for a configurable synchronous variant.
 class SmtcWindows {
 public:
     SmtcWindows();
@@ -24,6 +35,20 @@ public:
     bool UpdateMetadata(const std::string& title, const std::string& artist, 
                        const std::string& album, int64_t duration, 
                        const std::string& albumArtUrl);
+
+    // Update the timeline sample (microseconds); publishing is rate-adapted
+    bool UpdateTimeline(int64_t position, int64_t duration, double rate);
+
+    // Apply any subset of status, metadata, timeline and enabled buttons as
+    // one transaction with a single backend commit. Queued for the backend
+    // thread; returns once the patch is accepted.
+    bool ApplyState(const audio_service_smtc::PlayerStatePatch& patch);
+
+    // Queue depth and drop counters of the backend update pipeline
+    audio_service_smtc::UpdatePipelineStats GetUpdateStats();
+
+    // Stalls, failures and recoveries seen by the backend watchdog
+    audio_service_smtc::WatchdogStats GetWatchdogStats();
     
     // Set callback for handling media controls from SMTC
     void SetControlCallback(std::function<void(const std::string&)> callback);
@@ -31,21 +56,66 @@ public:
     // Set callback for position changes
     void SetPositionCallback(std::function<void(int64_t)> callback);
 
+    // Set the number of background worker threads (artwork fetch and decode)
+    void SetWorkerThreadCount(size_t count);
+
+    // Caps the plugin's native memory (0: no cap) and the artwork cache, and
+    // sets how long the session sits stopped before cached artwork and idle
+    // worker threads are released (0: never)
+    void SetMemoryLimits(size_t budgetBytes, size_t artworkCacheBytes, std::chrono::milliseconds idleRelease);
+
+    // Re-encodes artwork over `maxBytes` (0: never) to fit it, scaled down so
+    // neither side exceeds `maxEdge`; applies to artwork loaded from now on
+    void SetThumbnailBudget(size_t maxBytes, uint32_t maxEdge);
+
+    // Loads the artwork of the track expected next into the cache at
+    // prefetch priority, so it shows in full as soon as that track starts
+    void PrefetchArtwork(const std::string& url);
+
+    // Accounted native memory, per subsystem
+    audio_service_smtc::MemoryStats GetMemoryStats();
+
 private:
-    // Implementation using PIMPL to hide WinRT dependencies
-    std::unique_ptr<SMTCHandlerImpl> _impl;
+    // The current handler; a rebuild may swap it at any time
+    std::shared_ptr<audio_service_smtc::MediaBackend> Backend();
+
+    // Re-creates the handler and replays the shown state; runs on the
+    // watchdog thread
+    bool RebuildBackend();
+
+    // Commits a state patch to SMTC; runs on the update pipeline thread
+    void CommitState(const audio_service_smtc::PlayerStatePatch& patch);
+
+    // Commits the full-quality artwork once the pipeline has loaded it
+    void CommitArtwork(uint64_t generation, const audio_service_smtc::ArtworkImage& image);
+
+    // Publishes the timeline when the publisher decides it is due
+    void CommitTimeline(const audio_service_smtc::TimelineSnapshot& timeline);
+
+    // Drops caches and idle threads if playback is still stopped; runs on the
+    // update pipeline thread once commits have been quiet for a while
+    void ReleaseIdleResources();
+
+    std::unique_ptr<audio_service_smtc::BackendWatchdog> _watchdog;
+    std::unique_ptr<audio_service_smtc::WorkerPool> _workers;
+    std::unique_ptr<audio_service_smtc::ArtworkPipeline> _artwork;
+    std::unique_ptr<audio_service_smtc::TimelinePublisher> _timeline;
+    std::unique_ptr<audio_service_smtc::UpdatePipeline> _updates;
+    audio_service_smtc::PlayerStateStore _state;
+    uint64_t _artworkGeneration;
+    std::string _identity;
     std::mutex _mutex;
-    bool _initialized;
-};
+    std::atomic<bool> _initialized;
 
-// C interface for Flutter plugin
-extern "C" {
-    __declspec(dllexport) void* CreateSMTCHandler(const char* identity);
-    __declspec(dllexport) void DisposeSMTCHandler(void* handler);
-    __declspec(dllexport) void UpdatePlaybackStatus(void* handler, const char* status);
-    __declspec(dllexport) void UpdateMetadata(void* handler, const char* title, const char* artist, 
-        const char* album, int64_t duration, const char* albumArtUrl);
-    __declspec(dllexport) void SetCallbacks(void* handler, 
-        std::function<void(const char*)> controlCallback,
-        std::function<void(int64_t)> positionCallback);
-}
+    // The handler and what a rebuilt one needs. Kept apart from _mutex, which
+    // a stalled backend call holds.
+    std::mutex _recoveryMutex;
+    // Held through the backend interface so no WinRT header leaks out of
+    // smtc_windows.cpp
+    std::shared_ptr<audio_service_smtc::MediaBackend> _impl;
+    audio_service_smtc::PlayerState _shownState;
+    audio_service_smtc::ArtworkImage _shownArtwork;
+    audio_service_smtc::TimelineSnapshot _shownTimeline;
+    std::function<void(const std::string&)> _controlHandler;
+    std::function<void(int64_t)> _positionHandler;
+};
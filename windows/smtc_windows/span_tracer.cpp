@@ -0,0 +1,510 @@
+#include "span_tracer.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+#include "memory_budget.h"
+#include "native_log.h"
+
+namespace audio_service_smtc {
+
+namespace {
+
+constexpr size_t kRingSize = 1024;  // power of two
+constexpr size_t kLabelWords = ScopedSpan::kMaxLabel / sizeof(uint64_t);
+// Rings of exited threads kept for the next dump; workers come and go
+constexpr size_t kRetiredRings = 8;
+// Marks a span without an argument
+constexpr int64_t kNoArg = INT64_MIN;
+
+// Set to a file path to record spans from initialize until the plugin unloads.
+constexpr char kSpansVariable[] = "AUDIO_SERVICE_SMTC_SPANS";
+
+int64_t NowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// One span in one cache line, written by the owning thread and read by a
+// dump under a sequence lock: odd while being written, so a torn read is
+// skipped.
+struct SpanSlot {
+    std::atomic<uint64_t> sequence{ 0 };
+    std::atomic<const SpanSite*> site{ nullptr };
+    std::atomic<int64_t> start{ 0 };
+    std::atomic<int64_t> duration{ 0 };
+    std::atomic<int64_t> arg{ 0 };
+    std::array<std::atomic<uint64_t>, kLabelWords> label{};  // zero padded
+};
+
+// Overwriting ring owned by one thread.
+struct SpanRing {
+    std::array<SpanSlot, kRingSize> slots;
+    std::atomic<uint64_t> head{ 0 };   // written by the owning thread
+    std::atomic<uint64_t> floor{ 0 };  // spans below were discarded by StartSpans()
+    std::atomic<const char*> name{ nullptr };
+    std::atomic<bool> retired{ false };
+    uint32_t thread = 0;
+};
+
+class SpanRegistry {
+public:
+    // Never destroyed: threads may record while statics are torn down
+    static SpanRegistry& Instance() {
+        static SpanRegistry* registry = new SpanRegistry();
+        return *registry;
+    }
+
+    std::shared_ptr<SpanRing> Register(const char* name) {
+        auto ring = std::make_shared<SpanRing>();
+        ring->name.store(name, std::memory_order_relaxed);
+        MemoryBudget::Shared().Charge(MemoryCategory::kLog, sizeof(SpanRing));
+        std::lock_guard<std::mutex> lock(_mutex);
+        ring->thread = ++_lastThread;
+        _rings.push_back(ring);
+        TrimRetiredLocked(kRetiredRings);
+        return ring;
+    }
+
+    // Discards everything recorded so far
+    void Restart() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        TrimRetiredLocked(0);
+        for (const auto& ring : _rings) {
+            ring->floor.store(ring->head.load(std::memory_order_acquire), std::memory_order_release);
+        }
+    }
+
+    std::vector<std::shared_ptr<SpanRing>> Rings() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _rings;
+    }
+
+private:
+    SpanRegistry() = default;
+
+    // Drops the oldest rings of exited threads until at most `keep` are left
+    void TrimRetiredLocked(size_t keep) {
+        size_t retired = 0;
+        for (const auto& ring : _rings) {
+            if (ring->retired.load(std::memory_order_acquire)) ++retired;
+        }
+        for (auto it = _rings.begin(); it != _rings.end() && retired > keep;) {
+            if ((*it)->retired.load(std::memory_order_acquire)) {
+                it = _rings.erase(it);
+                --retired;
+                MemoryBudget::Shared().Release(MemoryCategory::kLog, sizeof(SpanRing));
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    std::mutex _mutex;
+    std::vector<std::shared_ptr<SpanRing>> _rings;
+    uint32_t _lastThread = 0;
+};
+
+// Marks the ring retired when its thread exits; the registry frees it.
+struct ThreadSpans {
+    std::shared_ptr<SpanRing> ring;
+    const char* name = nullptr;
+
+    ~ThreadSpans() {
+        if (ring) ring->retired.store(true, std::memory_order_release);
+    }
+};
+
+thread_local ThreadSpans t_spans;
+
+// Reads one slot; false if it was being rewritten meanwhile
+bool ReadSlot(const SpanSlot& slot, SpanRecord* record) {
+    uint64_t before = slot.sequence.load(std::memory_order_acquire);
+    if (before & 1) return false;
+
+    const SpanSite* site = slot.site.load(std::memory_order_relaxed);
+    int64_t start = slot.start.load(std::memory_order_relaxed);
+    int64_t duration = slot.duration.load(std::memory_order_relaxed);
+    int64_t arg = slot.arg.load(std::memory_order_relaxed);
+    char label[ScopedSpan::kMaxLabel];
+    for (size_t i = 0; i < kLabelWords; ++i) {
+        uint64_t word = slot.label[i].load(std::memory_order_relaxed);
+        std::memcpy(label + i * sizeof(word), &word, sizeof(word));
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != before || !site) return false;
+
+    record->site = site;
+    record->start = start;
+    record->duration = duration;
+    record->hasArg = arg != kNoArg;
+    record->arg = record->hasArg ? arg : 0;
+    size_t length = 0;
+    while (length < sizeof(label) && label[length] != 0) ++length;
+    record->label.assign(label, length);
+    return true;
+}
+
+int64_t ProcessId() {
+#ifdef _WIN32
+    return static_cast<int64_t>(GetCurrentProcessId());
+#else
+    return static_cast<int64_t>(getpid());
+#endif
+}
+
+std::string EnvironmentSpansPath() {
+#ifdef _WIN32
+    char path[MAX_PATH];
+    DWORD length = GetEnvironmentVariableA(kSpansVariable, path, MAX_PATH);
+    if (length == 0 || length >= MAX_PATH) return {};
+    return std::string(path, length);
+#else
+    const char* path = std::getenv(kSpansVariable);
+    return path ? path : "";
+#endif
+}
+
+void AppendJsonString(std::string* out, std::string_view text) {
+    out->push_back('"');
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out->push_back('\\');
+            out->push_back(c);
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+            out->append(escaped);
+        } else {
+            out->push_back(c);
+        }
+    }
+    out->push_back('"');
+}
+
+// Nanoseconds as microseconds with three decimals, Chrome's unit
+void AppendMicros(std::string* out, int64_t nanos) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%" PRId64 ".%03d", nanos / 1000, static_cast<int>(nanos % 1000));
+    out->append(text);
+}
+
+// Protobuf wire format, just what the Perfetto trace needs
+void PutVarint(std::string* out, uint64_t value) {
+    while (value >= 0x80) {
+        out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out->push_back(static_cast<char>(value));
+}
+
+void PutVarintField(std::string* out, uint32_t field, uint64_t value) {
+    PutVarint(out, static_cast<uint64_t>(field) << 3);
+    PutVarint(out, value);
+}
+
+void PutBytesField(std::string* out, uint32_t field, std::string_view bytes) {
+    PutVarint(out, (static_cast<uint64_t>(field) << 3) | 2);
+    PutVarint(out, bytes.size());
+    out->append(bytes.data(), bytes.size());
+}
+
+// Field numbers from perfetto/protos/perfetto/trace
+namespace pb {
+constexpr uint32_t kTracePacket = 1;
+constexpr uint32_t kPacketTimestamp = 8;
+constexpr uint32_t kPacketSequenceId = 10;
+constexpr uint32_t kPacketTrackEvent = 11;
+constexpr uint32_t kPacketSequenceFlags = 13;
+constexpr uint32_t kPacketTrackDescriptor = 60;
+constexpr uint32_t kTrackUuid = 1;
+constexpr uint32_t kTrackProcess = 3;
+constexpr uint32_t kTrackThread = 4;
+constexpr uint32_t kProcessPid = 1;
+constexpr uint32_t kProcessName = 6;
+constexpr uint32_t kThreadPid = 1;
+constexpr uint32_t kThreadTid = 2;
+constexpr uint32_t kThreadName = 5;
+constexpr uint32_t kEventDebugAnnotations = 4;
+constexpr uint32_t kEventType = 9;
+constexpr uint32_t kEventTrackUuid = 11;
+constexpr uint32_t kEventCategories = 22;
+constexpr uint32_t kEventName = 23;
+constexpr uint32_t kAnnotationIntValue = 4;
+constexpr uint32_t kAnnotationStringValue = 6;
+constexpr uint32_t kAnnotationName = 10;
+constexpr uint64_t kSliceBegin = 1;
+constexpr uint64_t kSliceEnd = 2;
+constexpr uint64_t kIncrementalStateCleared = 1;
+constexpr uint64_t kSequenceId = 1;
+constexpr uint64_t kProcessTrack = 1;
+}  // namespace pb
+
+void PutPacket(std::string* out, const std::string& packet) {
+    PutBytesField(out, pb::kTracePacket, packet);
+}
+
+void PutSliceBegin(std::string* out, uint64_t track, const SpanRecord& span) {
+    std::string event;
+    PutVarintField(&event, pb::kEventType, pb::kSliceBegin);
+    PutVarintField(&event, pb::kEventTrackUuid, track);
+    PutBytesField(&event, pb::kEventCategories, span.site->category);
+    PutBytesField(&event, pb::kEventName, span.site->name);
+    if (!span.label.empty()) {
+        std::string annotation;
+        PutBytesField(&annotation, pb::kAnnotationName, "label");
+        PutBytesField(&annotation, pb::kAnnotationStringValue, span.label);
+        PutBytesField(&event, pb::kEventDebugAnnotations, annotation);
+    }
+    if (span.hasArg) {
+        std::string annotation;
+        PutBytesField(&annotation, pb::kAnnotationName, "value");
+        PutVarintField(&annotation, pb::kAnnotationIntValue, static_cast<uint64_t>(span.arg));
+        PutBytesField(&event, pb::kEventDebugAnnotations, annotation);
+    }
+
+    std::string packet;
+    PutVarintField(&packet, pb::kPacketTimestamp, static_cast<uint64_t>(span.start));
+    PutVarintField(&packet, pb::kPacketSequenceId, pb::kSequenceId);
+    PutBytesField(&packet, pb::kPacketTrackEvent, event);
+    PutPacket(out, packet);
+}
+
+void PutSliceEnd(std::string* out, uint64_t track, int64_t at) {
+    std::string event;
+    PutVarintField(&event, pb::kEventType, pb::kSliceEnd);
+    PutVarintField(&event, pb::kEventTrackUuid, track);
+
+    std::string packet;
+    PutVarintField(&packet, pb::kPacketTimestamp, static_cast<uint64_t>(at));
+    PutVarintField(&packet, pb::kPacketSequenceId, pb::kSequenceId);
+    PutBytesField(&packet, pb::kPacketTrackEvent, event);
+    PutPacket(out, packet);
+}
+
+}  // namespace
+
+void StartSpans() {
+    SpanRegistry::Instance().Restart();
+    internal::g_spansOn.store(true, std::memory_order_relaxed);
+}
+
+void StopSpans() {
+    internal::g_spansOn.store(false, std::memory_order_relaxed);
+}
+
+void SetSpanThreadName(const char* name) {
+    t_spans.name = name;
+    if (t_spans.ring) t_spans.ring->name.store(name, std::memory_order_relaxed);
+}
+
+void ScopedSpan::Begin(const SpanSite& site, std::string_view label) {
+    size_t length = (std::min)(label.size(), kMaxLabel);
+    // Don't cut a UTF-8 sequence in half
+    if (length < label.size()) {
+        while (length > 0 && (static_cast<unsigned char>(label[length]) & 0xc0) == 0x80) --length;
+    }
+    std::memcpy(_label, label.data(), length);
+    _labelLength = static_cast<uint8_t>(length);
+    _site = &site;
+    _start = NowNanos();
+}
+
+void ScopedSpan::End() {
+    int64_t end = NowNanos();
+    if (!t_spans.ring) {
+        // Once per thread
+        t_spans.ring = SpanRegistry::Instance().Register(t_spans.name);
+    }
+    SpanRing& ring = *t_spans.ring;
+
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+    SpanSlot& slot = ring.slots[head & (kRingSize - 1)];
+    uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.site.store(_site, std::memory_order_relaxed);
+    slot.start.store(_start, std::memory_order_relaxed);
+    slot.duration.store(end - _start, std::memory_order_relaxed);
+    slot.arg.store(_hasArg ? _arg : kNoArg, std::memory_order_relaxed);
+    char label[kMaxLabel] = {};
+    std::memcpy(label, _label, _labelLength);
+    for (size_t i = 0; i < kLabelWords; ++i) {
+        uint64_t word;
+        std::memcpy(&word, label + i * sizeof(word), sizeof(word));
+        slot.label[i].store(word, std::memory_order_relaxed);
+    }
+
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+std::vector<SpanThread> CollectSpans() {
+    std::vector<SpanThread> threads;
+    for (const auto& ring : SpanRegistry::Instance().Rings()) {
+        SpanThread thread;
+        thread.id = ring->thread;
+        if (const char* name = ring->name.load(std::memory_order_relaxed)) thread.name = name;
+
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t first = (std::max)(ring->floor.load(std::memory_order_acquire),
+                                    head > kRingSize ? head - kRingSize : 0);
+        thread.spans.reserve(static_cast<size_t>(head - first));
+        for (uint64_t index = first; index < head; ++index) {
+            SpanRecord record;
+            if (ReadSlot(ring->slots[index & (kRingSize - 1)], &record)) {
+                thread.spans.push_back(std::move(record));
+            }
+        }
+        if (thread.spans.empty()) continue;
+
+        // Recorded as they end; an enclosing span goes before what it encloses
+        std::sort(thread.spans.begin(), thread.spans.end(), [](const SpanRecord& a, const SpanRecord& b) {
+            return a.start != b.start ? a.start < b.start : a.duration > b.duration;
+        });
+        threads.push_back(std::move(thread));
+    }
+    return threads;
+}
+
+SpanFormat SpanFormatForPath(std::string_view path) {
+    constexpr std::string_view kJson = ".json";
+    bool json = path.size() >= kJson.size() && path.substr(path.size() - kJson.size()) == kJson;
+    return json ? SpanFormat::kChrome : SpanFormat::kPerfetto;
+}
+
+void WriteChromeTrace(const std::vector<SpanThread>& threads, std::string* out) {
+    std::string pid = std::to_string(ProcessId());
+    out->append("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    out->append("{\"ph\":\"M\",\"pid\":" + pid + ",\"name\":\"process_name\",\"args\":{\"name\":\"audio_service_smtc\"}}");
+
+    for (const SpanThread& thread : threads) {
+        std::string tid = std::to_string(thread.id);
+        if (!thread.name.empty()) {
+            out->append(",\n{\"ph\":\"M\",\"pid\":" + pid + ",\"tid\":" + tid + ",\"name\":\"thread_name\",\"args\":{\"name\":");
+            AppendJsonString(out, thread.name);
+            out->append("}}");
+        }
+        for (const SpanRecord& span : thread.spans) {
+            out->append(",\n{\"ph\":\"X\",\"pid\":" + pid + ",\"tid\":" + tid + ",\"cat\":");
+            AppendJsonString(out, span.site->category);
+            out->append(",\"name\":");
+            AppendJsonString(out, span.site->name);
+            out->append(",\"ts\":");
+            AppendMicros(out, span.start);
+            out->append(",\"dur\":");
+            AppendMicros(out, span.duration);
+            if (!span.label.empty() || span.hasArg) {
+                out->append(",\"args\":{");
+                if (!span.label.empty()) {
+                    out->append("\"label\":");
+                    AppendJsonString(out, span.label);
+                }
+                if (span.hasArg) {
+                    out->append(span.label.empty() ? "\"value\":" : ",\"value\":");
+                    out->append(std::to_string(span.arg));
+                }
+                out->push_back('}');
+            }
+            out->push_back('}');
+        }
+    }
+    out->append("]}\n");
+}
+
+void WritePerfettoTrace(const std::vector<SpanThread>& threads, std::string* out) {
+    uint64_t pid = static_cast<uint64_t>(ProcessId());
+    {
+        std::string process;
+        PutVarintField(&process, pb::kProcessPid, pid);
+        PutBytesField(&process, pb::kProcessName, "audio_service_smtc");
+        std::string track;
+        PutVarintField(&track, pb::kTrackUuid, pb::kProcessTrack);
+        PutBytesField(&track, pb::kTrackProcess, process);
+        std::string packet;
+        PutVarintField(&packet, pb::kPacketSequenceId, pb::kSequenceId);
+        PutVarintField(&packet, pb::kPacketSequenceFlags, pb::kIncrementalStateCleared);
+        PutBytesField(&packet, pb::kPacketTrackDescriptor, track);
+        PutPacket(out, packet);
+    }
+
+    for (const SpanThread& thread : threads) {
+        uint64_t uuid = pb::kProcessTrack + thread.id;
+        std::string descriptor;
+        PutVarintField(&descriptor, pb::kThreadPid, pid);
+        PutVarintField(&descriptor, pb::kThreadTid, thread.id);
+        if (!thread.name.empty()) PutBytesField(&descriptor, pb::kThreadName, thread.name);
+        std::string track;
+        PutVarintField(&track, pb::kTrackUuid, uuid);
+        PutBytesField(&track, pb::kTrackThread, descriptor);
+        std::string packet;
+        PutVarintField(&packet, pb::kPacketSequenceId, pb::kSequenceId);
+        PutBytesField(&packet, pb::kPacketTrackDescriptor, track);
+        PutPacket(out, packet);
+
+        // Slices on a track must nest: spans of one thread do, by scope, but
+        // the ring may have lost an enclosing one, so ends are emitted from a
+        // stack and clamped to the span they sit in
+        std::vector<int64_t> ends;
+        for (const SpanRecord& span : thread.spans) {
+            while (!ends.empty() && ends.back() <= span.start) {
+                PutSliceEnd(out, uuid, ends.back());
+                ends.pop_back();
+            }
+            int64_t end = span.start + span.duration;
+            if (!ends.empty()) end = (std::min)(end, ends.back());
+            PutSliceBegin(out, uuid, span);
+            ends.push_back(end);
+        }
+        while (!ends.empty()) {
+            PutSliceEnd(out, uuid, ends.back());
+            ends.pop_back();
+        }
+    }
+}
+
+bool DumpSpans(const std::string& path, SpanFormat format) {
+    std::vector<SpanThread> threads = CollectSpans();
+    std::string bytes;
+    if (format == SpanFormat::kChrome) {
+        WriteChromeTrace(threads, &bytes);
+    } else {
+        WritePerfettoTrace(threads, &bytes);
+    }
+
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) return false;
+    bool written = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    return std::fclose(file) == 0 && written;
+}
+
+bool DumpSpans(const std::string& path) {
+    return DumpSpans(path, SpanFormatForPath(path));
+}
+
+void StartSpansFromEnvironment() {
+    if (!SpansEnabled() && !EnvironmentSpansPath().empty()) StartSpans();
+}
+
+void DumpSpansToEnvironment() {
+    std::string path = EnvironmentSpansPath();
+    if (path.empty()) return;
+    if (!DumpSpans(path)) {
+        SMTC_LOG_WARNING("Could not write span trace", path);
+    }
+}
+
+}  // namespace audio_service_smtc
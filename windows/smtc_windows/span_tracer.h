@@ -0,0 +1,140 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace audio_service_smtc {
+
+// Timed spans of native work, for finding out where the time of one slow
+// call or track change went. Each thread records into its own ring, which
+// keeps the newest spans and overwrites the oldest; nothing is written out
+// until DumpSpans() is asked for a Chrome trace-event JSON file or a
+// Perfetto trace, both of which ui.perfetto.dev and chrome://tracing open.
+//
+// Recording is off until StartSpans(). While off, a span costs one relaxed
+// atomic load; while on, two clock reads and a copy into the ring, without
+// locking or allocating after the thread's first span.
+
+// One instrumented scope. Declared static by SMTC_SPAN, never freed.
+struct SpanSite {
+    const char* category;
+    const char* name;
+};
+
+namespace internal {
+// Read on entry to every span
+inline std::atomic<bool> g_spansOn{ false };
+}  // namespace internal
+
+inline bool SpansEnabled() {
+    return internal::g_spansOn.load(std::memory_order_relaxed);
+}
+
+// Starts recording. Spans recorded before are discarded.
+void StartSpans();
+
+// Stops recording; what was recorded stays until the next StartSpans().
+void StopSpans();
+
+// Name the calling thread's spans are shown under. `name` must outlive the
+// thread, e.g. a literal. Cheap enough to call whether recording or not.
+void SetSpanThreadName(const char* name);
+
+// Measures from construction to destruction if recording was on at
+// construction.
+class ScopedSpan {
+public:
+    static constexpr size_t kMaxLabel = 24;
+
+    // `label` tells apart calls through one site, e.g. which method; it is
+    // truncated to kMaxLabel bytes
+    explicit ScopedSpan(const SpanSite& site, std::string_view label = {}) {
+        if (SpansEnabled()) Begin(site, label);
+    }
+    ~ScopedSpan() {
+        if (_site) End();
+    }
+
+    ScopedSpan(const ScopedSpan&) = delete;
+    ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+    // A number shown with the span, e.g. a size in bytes
+    void SetArg(int64_t value) {
+        _arg = value;
+        _hasArg = true;
+    }
+
+private:
+    void Begin(const SpanSite& site, std::string_view label);
+    void End();
+
+    const SpanSite* _site = nullptr;
+    int64_t _start = 0;
+    int64_t _arg = 0;
+    bool _hasArg = false;
+    uint8_t _labelLength = 0;
+    char _label[kMaxLabel];
+};
+
+// Locks `mutex`, with a span for the time spent waiting if it was held.
+// An uncontended lock records nothing.
+template <typename Mutex>
+std::unique_lock<Mutex> LockWithSpan(Mutex& mutex, const SpanSite& site, std::string_view label = {}) {
+    std::unique_lock<Mutex> lock(mutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        ScopedSpan wait(site, label);
+        lock.lock();
+    }
+    return lock;
+}
+
+struct SpanRecord {
+    const SpanSite* site = nullptr;
+    int64_t start = 0;      // nanoseconds, steady clock
+    int64_t duration = 0;   // nanoseconds
+    int64_t arg = 0;
+    bool hasArg = false;
+    std::string label;
+};
+
+struct SpanThread {
+    uint32_t id = 0;                 // small number, in order of first span
+    std::string name;                // empty if never named
+    std::vector<SpanRecord> spans;   // by start time
+};
+
+// Copies out what the rings hold now, including rings of threads that have
+// exited since. Safe while other threads record.
+std::vector<SpanThread> CollectSpans();
+
+enum class SpanFormat {
+    kChrome,    // trace-event JSON
+    kPerfetto,  // protobuf
+};
+
+// .json files get Chrome's format, anything else Perfetto's
+SpanFormat SpanFormatForPath(std::string_view path);
+
+void WriteChromeTrace(const std::vector<SpanThread>& threads, std::string* out);
+void WritePerfettoTrace(const std::vector<SpanThread>& threads, std::string* out);
+
+// Collects and writes the spans to `path`. False if it can't be written.
+bool DumpSpans(const std::string& path, SpanFormat format);
+bool DumpSpans(const std::string& path);
+
+// If AUDIO_SERVICE_SMTC_SPANS names a file, starts recording; the spans are
+// written to it by DumpSpansToEnvironment(), e.g. when the plugin unloads.
+void StartSpansFromEnvironment();
+void DumpSpansToEnvironment();
+
+}  // namespace audio_service_smtc
+
+#define SMTC_SPAN_LABELLED(variable, category, name, label)                                   \
+    static constexpr ::audio_service_smtc::SpanSite variable##Site_{ category, name };        \
+    ::audio_service_smtc::ScopedSpan variable(variable##Site_, label)
+
+#define SMTC_SPAN(variable, category, name) SMTC_SPAN_LABELLED(variable, category, name, {})
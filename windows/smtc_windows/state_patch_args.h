@@ -0,0 +1,201 @@
+#pragma once
+
+#include <flutter/encodable_value.h>
+
+#include <string>
+
+#include "method_args.h"
+#include "player_state.h"
+#include "thumbnail_encoder.h"
+
+namespace audio_service_smtc {
+
+// Argument schemas of the method channel calls, shared by both plugins.
+
+struct InitializeArgs {
+    enum : size_t { kIdentity, kWorkerThreads };
+    static constexpr ArgSchema<2> kSchema{ {{
+        { "identity", ArgType::kString },
+        { "workerThreads", ArgType::kInteger },
+    }} };
+};
+
+struct StatusArgs {
+    enum : size_t { kStatus };
+    static constexpr ArgSchema<1> kSchema{ {{
+        { "status", ArgType::kString, true },
+    }} };
+};
+
+struct MetadataArgs {
+    enum : size_t { kTitle, kArtist, kAlbum, kDuration, kAlbumArtUrl };
+    static constexpr ArgSchema<5> kSchema{ {{
+        { "title", ArgType::kString, true },
+        { "artist", ArgType::kString },
+        { "album", ArgType::kString },
+        { "duration", ArgType::kInteger },
+        { "albumArtUrl", ArgType::kString },
+    }} };
+};
+
+struct TimelineArgs {
+    enum : size_t { kPosition, kDuration, kRate };
+    static constexpr ArgSchema<3> kSchema{ {{
+        { "position", ArgType::kInteger, true },
+        { "duration", ArgType::kInteger },
+        { "rate", ArgType::kNumber },
+    }} };
+};
+
+struct StatePatchArgs {
+    enum : size_t { kStatus, kMetadata, kTimeline, kEnabledButtons };
+    static constexpr ArgSchema<4> kSchema{ {{
+        { "status", ArgType::kString },
+        { "metadata", ArgType::kMap },
+        { "timeline", ArgType::kMap },
+        { "enabledButtons", ArgType::kList },
+    }} };
+};
+
+struct MemoryLimitArgs {
+    enum : size_t { kBudgetBytes, kArtworkCacheBytes, kIdleReleaseMillis };
+    static constexpr ArgSchema<3> kSchema{ {{
+        { "budgetBytes", ArgType::kInteger },
+        { "artworkCacheBytes", ArgType::kInteger },
+        { "idleReleaseMillis", ArgType::kInteger },
+    }} };
+};
+
+struct ThumbnailBudgetArgs {
+    enum : size_t { kMaxBytes, kMaxEdge };
+    static constexpr ArgSchema<2> kSchema{ {{
+        { "maxBytes", ArgType::kInteger },
+        { "maxEdge", ArgType::kInteger },
+    }} };
+};
+
+struct PrefetchArtworkArgs {
+    enum : size_t { kUrl };
+    static constexpr ArgSchema<1> kSchema{ {{
+        { "url", ArgType::kString, true },
+    }} };
+};
+
+struct SpanTracingArgs {
+    enum : size_t { kEnabled };
+    static constexpr ArgSchema<1> kSchema{ {{
+        { "enabled", ArgType::kBool, true },
+    }} };
+};
+
+struct DumpSpansArgs {
+    enum : size_t { kPath };
+    static constexpr ArgSchema<1> kSchema{ {{
+        { "path", ArgType::kString, true },
+    }} };
+};
+
+inline MediaMetadata MetadataFromArgs(const ArgValues<5>& args) {
+    return MakeMetadata(
+        std::string(args.String(MetadataArgs::kTitle)),
+        args.String(MetadataArgs::kArtist),
+        args.String(MetadataArgs::kAlbum),
+        std::string(args.String(MetadataArgs::kAlbumArtUrl)),
+        args.Integer(MetadataArgs::kDuration));
+}
+
+// Decodes the arguments of applyState:
+//   status:         String
+//   metadata:       {title, artist?, album?, duration?, albumArtUrl?}
+//   timeline:       {position, duration?, rate?}
+//   enabledButtons: List<String> of play/pause/next/previous/stop
+// Every key is optional. Returns false and sets `error` if a key is present
+// with the wrong type.
+inline bool DecodeStatePatch(const flutter::EncodableMap& arguments,
+                             PlayerStatePatch* patch, std::string* error) {
+    ArgValues<4> args;
+    if (!DecodeArgs(arguments, StatePatchArgs::kSchema, &args, error)) return false;
+
+    if (args.Has(StatePatchArgs::kStatus)) {
+        patch->status = ParsePlaybackState(args.String(StatePatchArgs::kStatus));
+    }
+
+    if (const auto* metadata = args.Map(StatePatchArgs::kMetadata)) {
+        ArgValues<5> fields;
+        if (!DecodeArgs(*metadata, MetadataArgs::kSchema, &fields, error)) return false;
+        patch->metadata = MetadataFromArgs(fields);
+    }
+
+    if (const auto* timeline = args.Map(StatePatchArgs::kTimeline)) {
+        ArgValues<3> fields;
+        if (!DecodeArgs(*timeline, TimelineArgs::kSchema, &fields, error)) return false;
+
+        TimelineSnapshot value;
+        value.position = fields.Integer(TimelineArgs::kPosition);
+        value.duration = fields.Integer(TimelineArgs::kDuration,
+                                        patch->metadata ? patch->metadata->duration : 0);
+        value.rate = fields.Number(TimelineArgs::kRate, value.rate);
+        patch->timeline = value;
+    }
+
+    if (const auto* buttons = args.List(StatePatchArgs::kEnabledButtons)) {
+        uint32_t mask = 0;
+        for (const auto& button : *buttons) {
+            const auto* name = std::get_if<std::string>(&button);
+            if (!name) continue;
+            if (*name == "play") mask |= kPlayButton;
+            else if (*name == "pause") mask |= kPauseButton;
+            else if (*name == "next") mask |= kNextButton;
+            else if (*name == "previous") mask |= kPreviousButton;
+            else if (*name == "stop") mask |= kStopButton;
+        }
+        patch->enabledButtons = mask;
+    }
+
+    return true;
+}
+
+struct MemoryLimits {
+    int64_t budgetBytes = 0;
+    int64_t artworkCacheBytes = 0;
+    int64_t idleReleaseMillis = 0;
+};
+
+// Decodes the arguments of setMemoryLimits:
+//   budgetBytes, artworkCacheBytes, idleReleaseMillis: int >= 0
+// A missing key is 0, i.e. no limit or never released.
+inline bool DecodeMemoryLimits(const flutter::EncodableMap& arguments,
+                               MemoryLimits* limits, std::string* error) {
+    ArgValues<3> args;
+    if (!DecodeArgs(arguments, MemoryLimitArgs::kSchema, &args, error)) return false;
+
+    limits->budgetBytes = args.Integer(MemoryLimitArgs::kBudgetBytes);
+    limits->artworkCacheBytes = args.Integer(MemoryLimitArgs::kArtworkCacheBytes);
+    limits->idleReleaseMillis = args.Integer(MemoryLimitArgs::kIdleReleaseMillis);
+    if (limits->budgetBytes < 0 || limits->artworkCacheBytes < 0 || limits->idleReleaseMillis < 0) {
+        *error = "Memory limits must not be negative";
+        return false;
+    }
+    return true;
+}
+
+// Decodes the arguments of setThumbnailBudget:
+//   maxBytes, maxEdge: int >= 0
+// A missing key keeps the default; maxBytes 0 turns re-encoding off.
+inline bool DecodeThumbnailBudget(const flutter::EncodableMap& arguments,
+                                  ThumbnailBudget* budget, std::string* error) {
+    ArgValues<2> args;
+    if (!DecodeArgs(arguments, ThumbnailBudgetArgs::kSchema, &args, error)) return false;
+
+    int64_t maxBytes = args.Integer(ThumbnailBudgetArgs::kMaxBytes, static_cast<int64_t>(budget->maxBytes));
+    int64_t maxEdge = args.Integer(ThumbnailBudgetArgs::kMaxEdge, budget->maxEdge);
+    if (maxBytes < 0 || maxEdge < 0 || maxEdge > UINT32_MAX) {
+        *error = "Thumbnail budget must not be negative";
+        return false;
+    }
+    budget->maxBytes = static_cast<size_t>(maxBytes);
+    budget->maxEdge = static_cast<uint32_t>(maxEdge);
+    return true;
+}
+
+}  // namespace audio_service_smtc
@@ -0,0 +1,241 @@
+#include "string_pool.h"
+
+#include <cstring>
+#include <new>
+
+#include "memory_budget.h"
+
+namespace audio_service_smtc {
+
+StringPool& StringPool::Shared() {
+    static StringPool* pool = new StringPool();
+    return *pool;
+}
+
+StringPool::StringPool() : _index(kInitialIndexSlots) {}
+
+StringPool::~StringPool() {
+    for (const IndexSlot& slot : _index) {
+        if (slot.id == 0) continue;
+        const Entry& entry = At(slot.id);
+        if (entry.size > kMaxClassSize) delete[] entry.data;
+    }
+    for (char* chunk : _chunks) {
+        delete[] chunk;
+    }
+    for (auto& block : _blocks) {
+        delete[] block.load(std::memory_order_relaxed);
+    }
+    MemoryBudget::Shared().Release(MemoryCategory::kStrings, _charged);
+}
+
+// Eight bytes per step; names are short, so this beats std::hash
+uint32_t StringPool::Hash(std::string_view text) {
+    constexpr uint64_t kMultiplier = 0xFF51AFD7ED558CCDULL;
+    uint64_t hash = text.size() * 0x9E3779B97F4A7C15ULL;
+    size_t offset = 0;
+    for (; offset + 8 <= text.size(); offset += 8) {
+        uint64_t word;
+        std::memcpy(&word, text.data() + offset, 8);
+        hash = (hash ^ word) * kMultiplier;
+        hash ^= hash >> 32;
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, text.data() + offset, text.size() - offset);
+    hash = (hash ^ tail) * kMultiplier;
+    return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+uint32_t StringPool::Intern(std::string_view text, const char** data) {
+    if (text.empty()) {
+        *data = "";
+        return 0;
+    }
+
+    uint32_t hash = Hash(text);
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++_lookups;
+    size_t slot = FindSlotLocked(text, hash);
+    if (_index[slot].id != 0) {
+        ++_hits;
+        Entry& entry = At(_index[slot].id);
+        entry.refs.fetch_add(1, std::memory_order_relaxed);
+        *data = entry.data;
+        return _index[slot].id;
+    }
+
+    uint32_t id = NewIdLocked();
+    if (id == 0) {
+        // Over four million distinct live strings
+        throw std::bad_alloc();
+    }
+    char* copy = AllocateLocked(text.size());
+    std::memcpy(copy, text.data(), text.size());
+
+    Entry& entry = At(id);
+    entry.hash = hash;
+    entry.data = copy;
+    entry.size = static_cast<uint32_t>(text.size());
+    entry.live = true;
+    entry.refs.store(1, std::memory_order_relaxed);
+    _index[slot] = IndexSlot{ hash, id };
+    _liveBytes += text.size();
+    ++_strings;
+    if (_strings * 2 > _index.size()) GrowIndexLocked();
+    AccountLocked();
+    *data = copy;
+    return id;
+}
+
+void InternedString::Assign(std::string_view text) {
+    if (text.empty()) return;
+    _id = StringPool::Shared().Intern(text, &_data);
+    _size = static_cast<uint32_t>(text.size());
+}
+
+void StringPool::AddRef(uint32_t id) {
+    At(id).refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void StringPool::Release(uint32_t id) {
+    Entry& entry = At(id);
+    if (entry.refs.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    // Interned again, or already reclaimed by a later release, while this
+    // one waited for the lock
+    if (!entry.live || entry.refs.load(std::memory_order_relaxed) != 0) return;
+
+    EraseSlotLocked(FindSlotLocked(std::string_view(entry.data, entry.size), entry.hash));
+    FreeLocked(entry.data, entry.size);
+    _liveBytes -= entry.size;
+    --_strings;
+    entry.live = false;
+    entry.data = nullptr;
+    entry.size = 0;
+    _freeIds.push_back(id);
+    AccountLocked();
+}
+
+StringPoolStats StringPool::Stats() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    StringPoolStats stats;
+    stats.strings = _strings;
+    stats.liveBytes = _liveBytes;
+    stats.arenaBytes = _chunks.size() * kChunkBytes + _largeBytes;
+    stats.lookups = _lookups;
+    stats.hits = _hits;
+    for (const IndexSlot& slot : _index) {
+        if (slot.id != 0) stats.references += At(slot.id).refs.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+size_t StringPool::FindSlotLocked(std::string_view text, uint32_t hash) {
+    size_t mask = _index.size() - 1;
+    for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        const IndexSlot& candidate = _index[slot];
+        if (candidate.id == 0) return slot;
+        if (candidate.hash != hash) continue;
+        const Entry& entry = At(candidate.id);
+        if (entry.size == text.size() && std::memcmp(entry.data, text.data(), text.size()) == 0) return slot;
+    }
+}
+
+void StringPool::EraseSlotLocked(size_t slot) {
+    // Shifts the rest of the probe run back over the hole, so lookups never
+    // meet a tombstone. A slot may move back unless its home lies between
+    // the hole and where it sits now.
+    size_t mask = _index.size() - 1;
+    size_t hole = slot;
+    for (size_t next = (hole + 1) & mask; _index[next].id != 0; next = (next + 1) & mask) {
+        size_t home = _index[next].hash & mask;
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            _index[hole] = _index[next];
+            hole = next;
+        }
+    }
+    _index[hole] = IndexSlot{};
+}
+
+void StringPool::GrowIndexLocked() {
+    std::vector<IndexSlot> old(_index.size() * 2);
+    old.swap(_index);
+    size_t mask = _index.size() - 1;
+    for (const IndexSlot& entry : old) {
+        if (entry.id == 0) continue;
+        size_t slot = entry.hash & mask;
+        while (_index[slot].id != 0) slot = (slot + 1) & mask;
+        _index[slot] = entry;
+    }
+}
+
+uint32_t StringPool::NewIdLocked() {
+    if (!_freeIds.empty()) {
+        uint32_t id = _freeIds.back();
+        _freeIds.pop_back();
+        return id;
+    }
+
+    uint32_t id = _nextId;
+    size_t block = id / kBlockEntries;
+    if (block >= kMaxBlocks) return 0;
+    if (!_blocks[block].load(std::memory_order_relaxed)) {
+        _blocks[block].store(new Entry[kBlockEntries], std::memory_order_release);
+        ++_entryBlocks;
+    }
+    ++_nextId;
+    return id;
+}
+
+char* StringPool::AllocateLocked(size_t size) {
+    if (size > kMaxClassSize) {
+        _largeBytes += size;
+        return new char[size];
+    }
+
+    size_t sizeClass = (size - 1) / kSizeClass;
+    auto& freeBlocks = _freeBlocks[sizeClass];
+    if (!freeBlocks.empty()) {
+        char* block = freeBlocks.back();
+        freeBlocks.pop_back();
+        return block;
+    }
+
+    size_t blockSize = (sizeClass + 1) * kSizeClass;
+    if (_chunkLeft < blockSize) {
+        // The tail of the old chunk is too small for this class; leave it
+        _chunks.push_back(new char[kChunkBytes]);
+        _chunkCursor = _chunks.back();
+        _chunkLeft = kChunkBytes;
+    }
+    char* block = _chunkCursor;
+    _chunkCursor += blockSize;
+    _chunkLeft -= blockSize;
+    return block;
+}
+
+void StringPool::AccountLocked() {
+    size_t held = _entryBlocks * kBlockEntries * sizeof(Entry) + _chunks.size() * kChunkBytes + _largeBytes +
+                  _index.capacity() * sizeof(IndexSlot) +
+                  _freeIds.capacity() * sizeof(uint32_t);
+    for (const auto& freeBlocks : _freeBlocks) held += freeBlocks.capacity() * sizeof(char*);
+    if (held > _charged) {
+        MemoryBudget::Shared().Charge(MemoryCategory::kStrings, held - _charged);
+    } else {
+        MemoryBudget::Shared().Release(MemoryCategory::kStrings, _charged - held);
+    }
+    _charged = held;
+}
+
+void StringPool::FreeLocked(const char* data, size_t size) {
+    char* block = const_cast<char*>(data);
+    if (size > kMaxClassSize) {
+        _largeBytes -= size;
+        delete[] block;
+        return;
+    }
+    _freeBlocks[(size - 1) / kSizeClass].push_back(block);
+}
+
+}  // namespace audio_service_smtc
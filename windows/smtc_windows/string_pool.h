@@ -0,0 +1,178 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace audio_service_smtc {
+
+struct StringPoolStats {
+    size_t strings = 0;       // distinct live strings
+    size_t references = 0;    // handles holding them
+    size_t liveBytes = 0;     // their text
+    size_t arenaBytes = 0;    // memory reserved for text, free blocks included
+    uint64_t lookups = 0;     // Intern calls for non-empty text
+    uint64_t hits = 0;        // of which found an existing string
+};
+
+// Deduplicated, refcounted storage for metadata values that repeat across a
+// queue, like artist and album names. Each distinct value is stored once and
+// named by a 32-bit id; the text is reclaimed when the last handle goes.
+//
+// Interning takes a lock. Copying and comparing handles doesn't.
+class StringPool {
+public:
+    // Process-wide pool; never destroyed, so handles in statics stay valid.
+    static StringPool& Shared();
+
+    StringPool();
+    ~StringPool();
+
+    StringPool(const StringPool&) = delete;
+    StringPool& operator=(const StringPool&) = delete;
+
+    // Returns the id of `text` with a reference added. Empty text is id 0,
+    // which is never stored or counted. `*data` receives the stored text,
+    // valid for as long as the reference is held.
+    uint32_t Intern(std::string_view text, const char** data);
+
+    void AddRef(uint32_t id);
+    void Release(uint32_t id);
+
+    StringPoolStats Stats();
+
+private:
+    static constexpr size_t kBlockEntries = 1024;
+    static constexpr size_t kMaxBlocks = 4096;
+    static constexpr size_t kSizeClass = 16;
+    static constexpr size_t kMaxClassSize = 256;
+    static constexpr size_t kChunkBytes = 64 * 1024;
+    static constexpr size_t kInitialIndexSlots = 1024;
+
+    struct Entry {
+        std::atomic<uint32_t> refs{ 0 };
+        uint32_t hash = 0;
+        const char* data = nullptr;
+        uint32_t size = 0;
+        bool live = false;
+    };
+
+    // The index is open-addressed with linear probing and kept at most half
+    // full. A lookup touches a slot, the entry and the text, where a node
+    // based map chases two more pointers. Id 0 marks a free slot.
+    struct IndexSlot {
+        uint32_t hash = 0;
+        uint32_t id = 0;
+    };
+
+    Entry& At(uint32_t id) {
+        return _blocks[id / kBlockEntries].load(std::memory_order_acquire)[id % kBlockEntries];
+    }
+
+    static uint32_t Hash(std::string_view text);
+
+    // The slot holding `text`, or the free slot where it would go
+    size_t FindSlotLocked(std::string_view text, uint32_t hash);
+    void EraseSlotLocked(size_t slot);
+    void GrowIndexLocked();
+
+    uint32_t NewIdLocked();
+    char* AllocateLocked(size_t size);
+    void FreeLocked(const char* data, size_t size);
+    // Brings the memory budget's charge in line with what the pool holds
+    void AccountLocked();
+
+    // Blocks are never moved or freed while the pool lives, so handles read
+    // entries without the lock
+    std::array<std::atomic<Entry*>, kMaxBlocks> _blocks{};
+
+    std::mutex _mutex;
+    std::vector<IndexSlot> _index;
+    std::vector<uint32_t> _freeIds;
+    uint32_t _nextId = 1;  // 0 is the empty string
+
+    // Text up to kMaxClassSize is carved from chunks in 16-byte classes and
+    // recycled per class; longer text is allocated on its own
+    std::vector<char*> _chunks;
+    char* _chunkCursor = nullptr;
+    size_t _chunkLeft = 0;
+    std::array<std::vector<char*>, kMaxClassSize / kSizeClass> _freeBlocks;
+    size_t _largeBytes = 0;
+    size_t _entryBlocks = 0;
+    size_t _charged = 0;      // bytes charged to the memory budget
+
+    size_t _liveBytes = 0;
+    size_t _strings = 0;
+    uint64_t _lookups = 0;
+    uint64_t _hits = 0;
+};
+
+// Handle to a string in the shared pool. Copies bump a refcount instead of
+// allocating, and equality is an id compare. Constructing one from text
+// interns it; see MakeMetadata for skipping the pool on repeated values.
+class InternedString {
+public:
+    InternedString() = default;
+    InternedString(std::string_view text) { Assign(text); }
+    InternedString(const std::string& text) { Assign(text); }
+    InternedString(const char* text) { Assign(text ? std::string_view(text) : std::string_view()); }
+
+    InternedString(const InternedString& other) : _id(other._id), _data(other._data), _size(other._size) {
+        if (_id != 0) StringPool::Shared().AddRef(_id);
+    }
+    InternedString(InternedString&& other) noexcept : _id(other._id), _data(other._data), _size(other._size) {
+        other.Reset();
+    }
+    ~InternedString() {
+        if (_id != 0) StringPool::Shared().Release(_id);
+    }
+
+    InternedString& operator=(const InternedString& other) {
+        if (_id != other._id) {
+            InternedString copy(other);
+            Swap(copy);
+        }
+        return *this;
+    }
+    InternedString& operator=(InternedString&& other) noexcept {
+        InternedString moved(std::move(other));
+        Swap(moved);
+        return *this;
+    }
+
+    uint32_t id() const { return _id; }
+    bool empty() const { return _id == 0; }
+    size_t size() const { return _size; }
+    std::string_view view() const { return std::string_view(_data, _size); }
+    std::string str() const { return std::string(_data, _size); }
+
+    bool operator==(const InternedString& other) const { return _id == other._id; }
+    bool operator!=(const InternedString& other) const { return _id != other._id; }
+
+private:
+    // Only called on an empty handle
+    void Assign(std::string_view text);
+
+    void Reset() {
+        _id = 0;
+        _data = "";
+        _size = 0;
+    }
+
+    void Swap(InternedString& other) {
+        std::swap(_id, other._id);
+        std::swap(_data, other._data);
+        std::swap(_size, other._size);
+    }
+
+    uint32_t _id = 0;
+    const char* _data = "";
+    uint32_t _size = 0;
+};
+
+}  // namespace audio_service_smtc
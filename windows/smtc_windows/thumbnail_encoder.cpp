@@ -0,0 +1,646 @@
+#include "thumbnail_encoder.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace audio_service_smtc {
+
+namespace {
+
+// ---- JPEG ----
+
+// Annex K tables, in natural (row-major) order
+constexpr uint8_t kLumaQuant[64] = {
+    16, 11, 10, 16, 24, 40, 51, 61,     12, 12, 14, 19, 26, 58, 60, 55,
+    14, 13, 16, 24, 40, 57, 69, 56,     14, 17, 22, 29, 51, 87, 80, 62,
+    18, 22, 37, 56, 68, 109, 103, 77,   24, 35, 55, 64, 81, 104, 113, 92,
+    49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99,
+};
+
+constexpr uint8_t kChromaQuant[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+};
+
+// Natural index of the i-th coefficient in zigzag order
+constexpr uint8_t kZigzag[64] = {
+    0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+constexpr uint8_t kDcLumaBits[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+constexpr uint8_t kDcChromaBits[16] = { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+constexpr uint8_t kDcValues[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+constexpr uint8_t kAcLumaBits[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d };
+constexpr uint8_t kAcLumaValues[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+    0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+    0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa,
+};
+
+constexpr uint8_t kAcChromaBits[16] = { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+constexpr uint8_t kAcChromaValues[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+    0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+    0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa,
+};
+
+struct HuffmanTable {
+    std::array<uint16_t, 256> code{};
+    std::array<uint8_t, 256> size{};
+};
+
+HuffmanTable BuildHuffman(const uint8_t* bits, const uint8_t* values) {
+    HuffmanTable table;
+    uint16_t code = 0;
+    size_t k = 0;
+    for (int length = 1; length <= 16; ++length) {
+        for (int i = 0; i < bits[length - 1]; ++i, ++k) {
+            table.code[values[k]] = code++;
+            table.size[values[k]] = static_cast<uint8_t>(length);
+        }
+        code <<= 1;
+    }
+    return table;
+}
+
+struct JpegTables {
+    HuffmanTable dcLuma = BuildHuffman(kDcLumaBits, kDcValues);
+    HuffmanTable dcChroma = BuildHuffman(kDcChromaBits, kDcValues);
+    HuffmanTable acLuma = BuildHuffman(kAcLumaBits, kAcLumaValues);
+    HuffmanTable acChroma = BuildHuffman(kAcChromaBits, kAcChromaValues);
+    // cos((2x + 1) u pi / 16) * C(u) / 2
+    float dct[8][8];
+
+    JpegTables() {
+        for (int u = 0; u < 8; ++u) {
+            float scale = u == 0 ? 0.5f / std::sqrt(2.0f) : 0.5f;
+            for (int x = 0; x < 8; ++x) {
+                dct[u][x] = scale * static_cast<float>(std::cos((2 * x + 1) * u * 3.14159265358979323846 / 16));
+            }
+        }
+    }
+};
+
+const JpegTables& Tables() {
+    static const JpegTables tables;
+    return tables;
+}
+
+// Entropy-coded segment writer: MSB first, 0xFF stuffed with 0x00
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>* out) : _out(out) {}
+
+    void Put(uint32_t bits, int count) {
+        _buffer = (_buffer << count) | (bits & ((1u << count) - 1));
+        _count += count;
+        while (_count >= 8) {
+            uint8_t byte = static_cast<uint8_t>(_buffer >> (_count - 8));
+            _out->push_back(byte);
+            if (byte == 0xFF) _out->push_back(0);
+            _count -= 8;
+        }
+    }
+
+    // Pads the last byte with ones
+    void Flush() {
+        if (_count > 0) Put(0x7F, 8 - _count);
+    }
+
+private:
+    std::vector<uint8_t>* _out;
+    uint32_t _buffer = 0;
+    int _count = 0;
+};
+
+void PutU16(std::vector<uint8_t>* out, uint32_t value) {
+    out->push_back(static_cast<uint8_t>(value >> 8));
+    out->push_back(static_cast<uint8_t>(value));
+}
+
+void PutMarker(std::vector<uint8_t>* out, uint8_t marker, size_t payload) {
+    out->push_back(0xFF);
+    out->push_back(marker);
+    PutU16(out, static_cast<uint32_t>(payload + 2));
+}
+
+void PutHuffmanSegment(std::vector<uint8_t>* out, uint8_t classAndId, const uint8_t* bits,
+                       const uint8_t* values, size_t count) {
+    PutMarker(out, 0xC4, 1 + 16 + count);
+    out->push_back(classAndId);
+    out->insert(out->end(), bits, bits + 16);
+    out->insert(out->end(), values, values + count);
+}
+
+// IJG quality scaling, written in zigzag order as DQT wants it
+void ScaleQuant(const uint8_t* base, int quality, uint8_t* zigzagged) {
+    int scale = quality < 50 ? 5000 / quality : 200 - 2 * quality;
+    for (int i = 0; i < 64; ++i) {
+        int value = (base[kZigzag[i]] * scale + 50) / 100;
+        zigzagged[i] = static_cast<uint8_t>(std::clamp(value, 1, 255));
+    }
+}
+
+int BitLength(int value) {
+    int magnitude = std::abs(value);
+    int length = 0;
+    while (magnitude) {
+        ++length;
+        magnitude >>= 1;
+    }
+    return length;
+}
+
+void PutValue(BitWriter& writer, int value, int length) {
+    // Negative values are sent as their ones' complement
+    if (value < 0) value += (1 << length) - 1;
+    writer.Put(static_cast<uint32_t>(value), length);
+}
+
+// Transforms, quantizes and entropy-codes one 8x8 block of level-shifted
+// samples. `quant` is in zigzag order.
+void EncodeBlock(BitWriter& writer, const float* block, const uint8_t* quant, int& previousDc,
+                 const HuffmanTable& dc, const HuffmanTable& ac) {
+    const JpegTables& tables = Tables();
+
+    float rows[64];
+    for (int y = 0; y < 8; ++y) {
+        for (int u = 0; u < 8; ++u) {
+            float sum = 0;
+            for (int x = 0; x < 8; ++x) sum += tables.dct[u][x] * block[y * 8 + x];
+            rows[y * 8 + u] = sum;
+        }
+    }
+
+    int coefficients[64];
+    for (int i = 0; i < 64; ++i) {
+        int natural = kZigzag[i];
+        int u = natural % 8;
+        int v = natural / 8;
+        float sum = 0;
+        for (int y = 0; y < 8; ++y) sum += tables.dct[v][y] * rows[y * 8 + u];
+        coefficients[i] = static_cast<int>(std::lround(sum / quant[i]));
+    }
+
+    int diff = coefficients[0] - previousDc;
+    previousDc = coefficients[0];
+    int length = BitLength(diff);
+    writer.Put(dc.code[length], dc.size[length]);
+    if (length) PutValue(writer, diff, length);
+
+    int zeros = 0;
+    for (int i = 1; i < 64; ++i) {
+        if (coefficients[i] == 0) {
+            ++zeros;
+            continue;
+        }
+        for (; zeros >= 16; zeros -= 16) writer.Put(ac.code[0xF0], ac.size[0xF0]);
+        length = BitLength(coefficients[i]);
+        int symbol = (zeros << 4) | length;
+        writer.Put(ac.code[symbol], ac.size[symbol]);
+        PutValue(writer, coefficients[i], length);
+        zeros = 0;
+    }
+    if (zeros) writer.Put(ac.code[0x00], ac.size[0x00]);
+}
+
+// Copies the 8x8 block at (x, y) of a plane and level-shifts it
+void LoadBlock(const std::vector<float>& plane, size_t stride, size_t x, size_t y, float* block) {
+    for (int row = 0; row < 8; ++row) {
+        const float* source = &plane[(y + row) * stride + x];
+        for (int column = 0; column < 8; ++column) block[row * 8 + column] = source[column] - 128.0f;
+    }
+}
+
+// ---- PNG ----
+
+const std::array<uint32_t, 256>& CrcTable() {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> result{};
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            result[n] = c;
+        }
+        return result;
+    }();
+    return table;
+}
+
+uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+    const auto& table = CrcTable();
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+uint32_t Adler32(const uint8_t* data, size_t size) {
+    uint32_t a = 1, b = 0;
+    while (size > 0) {
+        // Largest run before the sums can overflow
+        size_t run = std::min<size_t>(size, 5552);
+        for (size_t i = 0; i < run; ++i) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += run;
+        size -= run;
+    }
+    return (b << 16) | a;
+}
+
+void PutU32(std::vector<uint8_t>* out, uint32_t value) {
+    PutU16(out, value >> 16);
+    PutU16(out, value & 0xFFFF);
+}
+
+void PutChunk(std::vector<uint8_t>* out, const char* type, const std::vector<uint8_t>& data) {
+    PutU32(out, static_cast<uint32_t>(data.size()));
+    size_t start = out->size();
+    out->insert(out->end(), type, type + 4);
+    out->insert(out->end(), data.begin(), data.end());
+    PutU32(out, Crc32(out->data() + start, out->size() - start));
+}
+
+// Deflate bit writer: LSB first, Huffman codes reversed
+class DeflateWriter {
+public:
+    explicit DeflateWriter(std::vector<uint8_t>* out) : _out(out) {}
+
+    void Put(uint32_t bits, int count) {
+        _buffer |= static_cast<uint64_t>(bits) << _count;
+        _count += count;
+        while (_count >= 8) {
+            _out->push_back(static_cast<uint8_t>(_buffer));
+            _buffer >>= 8;
+            _count -= 8;
+        }
+    }
+
+    void PutCode(uint32_t code, int length) {
+        uint32_t reversed = 0;
+        for (int i = 0; i < length; ++i) reversed |= ((code >> i) & 1) << (length - 1 - i);
+        Put(reversed, length);
+    }
+
+    // Fixed Huffman literal/length code
+    void PutSymbol(int symbol) {
+        if (symbol < 144) PutCode(0x30 + symbol, 8);
+        else if (symbol < 256) PutCode(0x190 + symbol - 144, 9);
+        else if (symbol < 280) PutCode(symbol - 256, 7);
+        else PutCode(0xC0 + symbol - 280, 8);
+    }
+
+    void Flush() {
+        if (_count > 0) Put(0, 8 - _count);
+    }
+
+private:
+    std::vector<uint8_t>* _out;
+    uint64_t _buffer = 0;
+    int _count = 0;
+};
+
+constexpr uint16_t kLengthBase[29] = { 3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                       31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+constexpr uint8_t kLengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                       2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+constexpr uint16_t kDistanceBase[30] = { 1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+                                         33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+                                         1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+constexpr uint8_t kDistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                         6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+constexpr size_t kWindow = 32768;
+constexpr size_t kMaxMatch = 258;
+constexpr int kHashBits = 15;
+constexpr int kMaxChain = 48;
+
+void PutMatch(DeflateWriter& writer, size_t length, size_t distance) {
+    int code = 28;
+    while (kLengthBase[code] > length) --code;
+    writer.PutSymbol(257 + code);
+    writer.Put(static_cast<uint32_t>(length - kLengthBase[code]), kLengthExtra[code]);
+
+    int distanceCode = 29;
+    while (kDistanceBase[distanceCode] > distance) --distanceCode;
+    writer.PutCode(distanceCode, 5);
+    writer.Put(static_cast<uint32_t>(distance - kDistanceBase[distanceCode]), kDistanceExtra[distanceCode]);
+}
+
+// zlib stream of one fixed-Huffman block, greedy LZ77 over hash chains
+void Deflate(const std::vector<uint8_t>& data, std::vector<uint8_t>* out) {
+    out->push_back(0x78);
+    out->push_back(0x01);
+
+    DeflateWriter writer(out);
+    writer.Put(1, 1);  // final block
+    writer.Put(1, 2);  // fixed Huffman
+
+    std::vector<int32_t> head(size_t{ 1 } << kHashBits, -1);
+    std::vector<int32_t> previous(kWindow, -1);
+    auto hash = [&](size_t i) {
+        uint32_t value = data[i] | (data[i + 1] << 8) | (data[i + 2] << 16);
+        return (value * 2654435761u) >> (32 - kHashBits);
+    };
+    auto insert = [&](size_t i) {
+        uint32_t h = hash(i);
+        previous[i % kWindow] = head[h];
+        head[h] = static_cast<int32_t>(i);
+    };
+
+    size_t size = data.size();
+    size_t i = 0;
+    while (i < size) {
+        size_t bestLength = 0;
+        size_t bestDistance = 0;
+        if (i + 3 <= size) {
+            size_t limit = std::min(kMaxMatch, size - i);
+            int32_t candidate = head[hash(i)];
+            for (int chain = 0; candidate >= 0 && chain < kMaxChain; ++chain) {
+                size_t distance = i - static_cast<size_t>(candidate);
+                if (distance > kWindow) break;
+                const uint8_t* a = &data[candidate];
+                const uint8_t* b = &data[i];
+                if (a[bestLength] == b[bestLength]) {
+                    size_t length = 0;
+                    while (length < limit && a[length] == b[length]) ++length;
+                    if (length > bestLength) {
+                        bestLength = length;
+                        bestDistance = distance;
+                        if (length == limit) break;
+                    }
+                }
+                candidate = previous[candidate % kWindow];
+            }
+        }
+
+        if (bestLength >= 3) {
+            PutMatch(writer, bestLength, bestDistance);
+            for (size_t end = i + bestLength; i < end; ++i) {
+                if (i + 3 <= size) insert(i);
+            }
+        } else {
+            writer.PutSymbol(data[i]);
+            if (i + 3 <= size) insert(i);
+            ++i;
+        }
+    }
+    writer.PutSymbol(256);
+    writer.Flush();
+
+    PutU32(out, Adler32(data.data(), data.size()));
+}
+
+int Paeth(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = std::abs(p - a);
+    int pb = std::abs(p - b);
+    int pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) return a;
+    return pb <= pc ? b : c;
+}
+
+}  // namespace
+
+bool RgbaImage::HasAlpha() const {
+    for (size_t i = 3; i < pixels.size(); i += 4) {
+        if (pixels[i] != 0xFF) return true;
+    }
+    return false;
+}
+
+void EncodeJpeg(const RgbaImage& image, int quality, std::vector<uint8_t>* out) {
+    out->clear();
+    if (image.empty()) return;
+    quality = std::clamp(quality, 1, 100);
+    const JpegTables& tables = Tables();
+
+    // Planes padded to whole 16x16 MCUs by repeating the last row and column
+    size_t width = image.width;
+    size_t height = image.height;
+    size_t paddedWidth = (width + 15) / 16 * 16;
+    size_t paddedHeight = (height + 15) / 16 * 16;
+    std::vector<float> luma(paddedWidth * paddedHeight);
+    std::vector<float> blue(paddedWidth * paddedHeight);
+    std::vector<float> red(paddedWidth * paddedHeight);
+    for (size_t y = 0; y < paddedHeight; ++y) {
+        const uint8_t* row = &image.pixels[std::min(y, height - 1) * width * 4];
+        for (size_t x = 0; x < paddedWidth; ++x) {
+            const uint8_t* pixel = row + std::min(x, width - 1) * 4;
+            float r = pixel[0], g = pixel[1], b = pixel[2];
+            size_t index = y * paddedWidth + x;
+            luma[index] = 0.299f * r + 0.587f * g + 0.114f * b;
+            blue[index] = -0.168736f * r - 0.331264f * g + 0.5f * b + 128.0f;
+            red[index] = 0.5f * r - 0.418688f * g - 0.081312f * b + 128.0f;
+        }
+    }
+
+    // 4:2:0: chroma averaged over 2x2
+    size_t chromaWidth = paddedWidth / 2;
+    size_t chromaHeight = paddedHeight / 2;
+    std::vector<float> blueHalf(chromaWidth * chromaHeight);
+    std::vector<float> redHalf(chromaWidth * chromaHeight);
+    for (size_t y = 0; y < chromaHeight; ++y) {
+        for (size_t x = 0; x < chromaWidth; ++x) {
+            size_t top = 2 * y * paddedWidth + 2 * x;
+            size_t bottom = top + paddedWidth;
+            blueHalf[y * chromaWidth + x] = (blue[top] + blue[top + 1] + blue[bottom] + blue[bottom + 1]) * 0.25f;
+            redHalf[y * chromaWidth + x] = (red[top] + red[top + 1] + red[bottom] + red[bottom + 1]) * 0.25f;
+        }
+    }
+
+    uint8_t lumaQuant[64];
+    uint8_t chromaQuant[64];
+    ScaleQuant(kLumaQuant, quality, lumaQuant);
+    ScaleQuant(kChromaQuant, quality, chromaQuant);
+
+    out->reserve(width * height / 4 + 1024);
+    out->push_back(0xFF);
+    out->push_back(0xD8);
+
+    static constexpr uint8_t kJfif[14] = { 'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0 };
+    PutMarker(out, 0xE0, sizeof(kJfif));
+    out->insert(out->end(), kJfif, kJfif + sizeof(kJfif));
+
+    PutMarker(out, 0xDB, 2 * 65);
+    out->push_back(0);
+    out->insert(out->end(), lumaQuant, lumaQuant + 64);
+    out->push_back(1);
+    out->insert(out->end(), chromaQuant, chromaQuant + 64);
+
+    PutMarker(out, 0xC0, 15);
+    out->push_back(8);
+    PutU16(out, image.height);
+    PutU16(out, image.width);
+    out->push_back(3);
+    static constexpr uint8_t kComponents[9] = { 1, 0x22, 0, 2, 0x11, 1, 3, 0x11, 1 };
+    out->insert(out->end(), kComponents, kComponents + sizeof(kComponents));
+
+    PutHuffmanSegment(out, 0x00, kDcLumaBits, kDcValues, sizeof(kDcValues));
+    PutHuffmanSegment(out, 0x10, kAcLumaBits, kAcLumaValues, sizeof(kAcLumaValues));
+    PutHuffmanSegment(out, 0x01, kDcChromaBits, kDcValues, sizeof(kDcValues));
+    PutHuffmanSegment(out, 0x11, kAcChromaBits, kAcChromaValues, sizeof(kAcChromaValues));
+
+    PutMarker(out, 0xDA, 10);
+    static constexpr uint8_t kScan[10] = { 3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0 };
+    out->insert(out->end(), kScan, kScan + sizeof(kScan));
+
+    BitWriter writer(out);
+    int dcLuma = 0, dcBlue = 0, dcRed = 0;
+    float block[64];
+    for (size_t y = 0; y < paddedHeight; y += 16) {
+        for (size_t x = 0; x < paddedWidth; x += 16) {
+            for (size_t sub = 0; sub < 4; ++sub) {
+                LoadBlock(luma, paddedWidth, x + (sub & 1) * 8, y + (sub >> 1) * 8, block);
+                EncodeBlock(writer, block, lumaQuant, dcLuma, tables.dcLuma, tables.acLuma);
+            }
+            LoadBlock(blueHalf, chromaWidth, x / 2, y / 2, block);
+            EncodeBlock(writer, block, chromaQuant, dcBlue, tables.dcChroma, tables.acChroma);
+            LoadBlock(redHalf, chromaWidth, x / 2, y / 2, block);
+            EncodeBlock(writer, block, chromaQuant, dcRed, tables.dcChroma, tables.acChroma);
+        }
+    }
+    writer.Flush();
+
+    out->push_back(0xFF);
+    out->push_back(0xD9);
+}
+
+void EncodePng(const RgbaImage& image, std::vector<uint8_t>* out) {
+    out->clear();
+    if (image.empty()) return;
+
+    // Each row gets whichever filter leaves the smallest residuals
+    size_t stride = static_cast<size_t>(image.width) * 4;
+    std::vector<uint8_t> filtered;
+    filtered.reserve((stride + 1) * image.height);
+    std::vector<uint8_t> candidate(stride);
+    std::vector<uint8_t> best(stride);
+    std::vector<uint8_t> zeros(stride, 0);
+    for (size_t y = 0; y < image.height; ++y) {
+        const uint8_t* row = &image.pixels[y * stride];
+        const uint8_t* above = y > 0 ? row - stride : zeros.data();
+        uint64_t bestCost = UINT64_MAX;
+        uint8_t bestFilter = 0;
+        for (uint8_t filter = 0; filter < 5; ++filter) {
+            uint64_t cost = 0;
+            for (size_t i = 0; i < stride; ++i) {
+                int left = i >= 4 ? row[i - 4] : 0;
+                int upLeft = i >= 4 ? above[i - 4] : 0;
+                int predicted = 0;
+                switch (filter) {
+                case 1: predicted = left; break;
+                case 2: predicted = above[i]; break;
+                case 3: predicted = (left + above[i]) / 2; break;
+                case 4: predicted = Paeth(left, above[i], upLeft); break;
+                }
+                uint8_t value = static_cast<uint8_t>(row[i] - predicted);
+                candidate[i] = value;
+                cost += value < 128 ? value : 256 - value;
+            }
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestFilter = filter;
+                best.swap(candidate);
+            }
+        }
+        filtered.push_back(bestFilter);
+        filtered.insert(filtered.end(), best.begin(), best.end());
+    }
+
+    static constexpr uint8_t kSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    out->insert(out->end(), kSignature, kSignature + sizeof(kSignature));
+
+    std::vector<uint8_t> header;
+    PutU32(&header, image.width);
+    PutU32(&header, image.height);
+    static constexpr uint8_t kRgba8[5] = { 8, 6, 0, 0, 0 };  // depth, color type, no interlace
+    header.insert(header.end(), kRgba8, kRgba8 + sizeof(kRgba8));
+    PutChunk(out, "IHDR", header);
+
+    std::vector<uint8_t> compressed;
+    Deflate(filtered, &compressed);
+    PutChunk(out, "IDAT", compressed);
+    PutChunk(out, "IEND", {});
+}
+
+bool FitThumbnail(const RgbaImage& image, const ThumbnailBudget& budget, EncodedThumbnail* out) {
+    if (image.empty()) return false;
+    auto fits = [&](const std::vector<uint8_t>& bytes) {
+        return budget.maxBytes == 0 || bytes.size() <= budget.maxBytes;
+    };
+
+    if (image.HasAlpha()) {
+        out->format = ImageFormat::kPng;
+        out->quality = 0;
+        out->attempts = 1;
+        EncodePng(image, &out->bytes);
+        out->fits = fits(out->bytes);
+        return true;
+    }
+
+    out->format = ImageFormat::kJpeg;
+    int low = std::clamp(budget.minQuality, 1, 100);
+    int high = std::clamp(budget.maxQuality, low, 100);
+    int attempts = std::max(budget.maxAttempts, 1);
+
+    // Most artwork fits at the top quality; try that first
+    EncodeJpeg(image, high, &out->bytes);
+    out->quality = high;
+    out->attempts = 1;
+    out->fits = fits(out->bytes);
+    if (out->fits || out->attempts >= attempts || low == high) return true;
+
+    std::vector<uint8_t> trial;
+    EncodeJpeg(image, low, &trial);
+    ++out->attempts;
+    out->bytes.swap(trial);
+    out->quality = low;
+    out->fits = fits(out->bytes);
+    if (!out->fits) return true;
+
+    // low fits and high doesn't; size grows with quality, so bisect
+    while (out->attempts < attempts && high - low > 1) {
+        int middle = (low + high) / 2;
+        EncodeJpeg(image, middle, &trial);
+        ++out->attempts;
+        if (fits(trial)) {
+            low = middle;
+            out->bytes.swap(trial);
+            out->quality = middle;
+        } else {
+            high = middle;
+        }
+    }
+    return true;
+}
+
+}  // namespace audio_service_smtc
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace audio_service_smtc {
+
+// Decoded artwork: 8-bit RGBA, rows top to bottom, no padding.
+struct RgbaImage {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint8_t> pixels;
+
+    bool empty() const { return width == 0 || height == 0; }
+    // True if any pixel is not fully opaque
+    bool HasAlpha() const;
+};
+
+enum class ImageFormat {
+    kJpeg,
+    kPng,
+};
+
+// What the thumbnail handed to the backend may cost. SMTC copies the stream
+// into the shell on every track change, so it pays to keep it small.
+struct ThumbnailBudget {
+    size_t maxBytes = 64 * 1024;   // 0 turns re-encoding off
+    uint32_t maxEdge = 512;        // longest side the decoder scales down to
+    int minQuality = 40;
+    int maxQuality = 90;
+    int maxAttempts = 5;           // encodes the quality search may run
+};
+
+struct EncodedThumbnail {
+    std::vector<uint8_t> bytes;
+    ImageFormat format = ImageFormat::kJpeg;
+    int quality = 0;               // of the JPEG; 0 for PNG
+    int attempts = 0;              // encodes run
+    bool fits = false;             // within budget.maxBytes
+};
+
+// Baseline JFIF with 4:2:0 chroma and the standard Huffman tables. Alpha is
+// dropped. `quality` is 1..100 on the IJG scale.
+void EncodeJpeg(const RgbaImage& image, int quality, std::vector<uint8_t>* out);
+
+// Truecolor PNG with alpha, adaptive row filters and fixed-Huffman deflate.
+void EncodePng(const RgbaImage& image, std::vector<uint8_t>* out);
+
+// Encodes `image` as PNG if it has alpha and JPEG otherwise. For JPEG, finds
+// the highest quality within [minQuality, maxQuality] that fits maxBytes by
+// bisection, running at most maxAttempts encodes; if even minQuality is over,
+// that is what comes back. PNG has no quality to trade, so it is one encode
+// and may not fit. Returns false for an empty image.
+bool FitThumbnail(const RgbaImage& image, const ThumbnailBudget& budget, EncodedThumbnail* out);
+
+}  // namespace audio_service_smtc
@@ -0,0 +1,142 @@
+#include "timeline_publisher.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <utility>
+
+#include "event_dispatcher.h"
+#include "span_tracer.h"
+
+namespace audio_service_smtc {
+
+PlaybackState ParsePlaybackState(std::string_view status) {
+    if (status == "Playing") return PlaybackState::kPlaying;
+    if (status == "Paused") return PlaybackState::kPaused;
+    if (status == "Stopped") return PlaybackState::kStopped;
+    return PlaybackState::kClosed;
+}
+
+void TimelinePolicy::SetPlaybackState(PlaybackState state, int64_t now) {
+    if (state == _state) return;
+    // Freeze the position at the transition so pausing doesn't drift
+    _sample.position = PositionAt(now);
+    _state = state;
+    if (_state == PlaybackState::kPlaying) {
+        _estimator.Restart(_sample.position, _sample.rate, now);
+    }
+    _dirty = true;
+}
+
+void TimelinePolicy::SetTimeline(int64_t position, int64_t duration, double rate, int64_t now) {
+    if (duration != _sample.duration || rate != _sample.rate) {
+        _dirty = true;
+    }
+
+    if (_state != PlaybackState::kPlaying) {
+        if (std::llabs(position - _sample.position) > _options.position.seekThreshold) {
+            _dirty = true;
+        }
+    } else if (rate != _sample.rate) {
+        _estimator.Restart(position, rate, now);
+    } else if (_estimator.AddSample(position, now) == PositionEstimator::SampleKind::kSeek) {
+        _dirty = true;
+    }
+    _sample = { position, duration, rate };
+}
+
+void TimelinePolicy::NoteSurfaceActivity(int64_t now) {
+    _surfaceActiveUntil = now + _options.surfaceActiveWindow;
+}
+
+int64_t TimelinePolicy::NextPublishTime(int64_t now) const {
+    if (_dirty) return now;
+    if (_state != PlaybackState::kPlaying) return kNever;
+
+    int64_t interval = now < _surfaceActiveUntil ? _options.activeInterval : _options.idleInterval;
+    return _lastPublish + interval;
+}
+
+TimelineSnapshot TimelinePolicy::Publish(int64_t now) {
+    _dirty = false;
+    _lastPublish = now;
+
+    TimelineSnapshot snapshot = _sample;
+    snapshot.position = PositionAt(now);
+    return snapshot;
+}
+
+int64_t TimelinePolicy::PositionAt(int64_t now) const {
+    if (_state != PlaybackState::kPlaying) return _sample.position;
+
+    int64_t position = _estimator.PositionAt(now);
+    if (_sample.duration > 0 && position > _sample.duration) return _sample.duration;
+    return position < 0 ? 0 : position;
+}
+
+TimelinePublisher::TimelinePublisher(Commit commit, TimelinePolicy::Options options)
+    : _commit(std::move(commit)), _policy(options) {
+    _thread = std::thread(&TimelinePublisher::Run, this);
+}
+
+TimelinePublisher::~TimelinePublisher() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _cv.notify_all();
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+}
+
+void TimelinePublisher::SetPlaybackState(PlaybackState state) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _policy.SetPlaybackState(state, MonotonicMicros());
+    _cv.notify_all();
+}
+
+void TimelinePublisher::SetTimeline(int64_t position, int64_t duration, double rate) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _policy.SetTimeline(position, duration, rate, MonotonicMicros());
+    _cv.notify_all();
+}
+
+void TimelinePublisher::NoteSurfaceActivity() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _policy.NoteSurfaceActivity(MonotonicMicros());
+    _cv.notify_all();
+}
+
+uint64_t TimelinePublisher::Wakeups() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _wakeups;
+}
+
+void TimelinePublisher::Run() {
+    SetSpanThreadName("timeline publisher");
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_stopping) {
+        int64_t now = MonotonicMicros();
+        int64_t next = _policy.NextPublishTime(now);
+
+        if (next > now) {
+            if (next == TimelinePolicy::kNever) {
+                _cv.wait(lock);
+            } else {
+                _cv.wait_for(lock, std::chrono::microseconds(next - now));
+            }
+            ++_wakeups;
+            continue;
+        }
+
+        TimelineSnapshot snapshot = _policy.Publish(now);
+        lock.unlock();
+        {
+            SMTC_SPAN(span, "timeline", "publish");
+            _commit(snapshot);
+        }
+        lock.lock();
+    }
+}
+
+}  // namespace audio_service_smtc
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include "position_estimator.h"
+
+namespace audio_service_smtc {
+
+enum class PlaybackState {
+    kClosed,
+    kStopped,
+    kPaused,
+    kPlaying,
+};
+
+// Maps the status strings used on the method channel ("Playing", ...).
+PlaybackState ParsePlaybackState(std::string_view status);
+
+// Timeline as handed to the backend. Times are in microseconds.
+struct TimelineSnapshot {
+    int64_t position = 0;
+    int64_t duration = 0;
+    double rate = 1.0;
+};
+
+// Decides when the timeline has to be republished. It is a pure state
+// machine driven by explicit timestamps, so it behaves the same under a
+// virtual clock as under the real one.
+//
+// - Paused, stopped or closed: nothing is published periodically.
+// - Playing while a system surface is showing us: `activeInterval`.
+// - Playing otherwise: `idleInterval`.
+// - State, duration or rate changes and seeks publish once, immediately.
+//
+// While playing, the position comes from a PositionEstimator, so samples
+// that only correct for clock drift or jitter are blended in rather than
+// published as jumps.
+class TimelinePolicy {
+public:
+    struct Options {
+        int64_t activeInterval = 1000000;
+        int64_t idleInterval = 15000000;
+        // How long after a button press or seek the surface counts as shown
+        int64_t surfaceActiveWindow = 10000000;
+        // Drift and seek handling while playing; `seekThreshold` also
+        // applies to samples taken while paused
+        PositionEstimator::Options position;
+    };
+
+    static constexpr int64_t kNever = std::numeric_limits<int64_t>::max();
+
+    explicit TimelinePolicy(Options options) : _options(options), _estimator(options.position) {}
+    TimelinePolicy() : TimelinePolicy(Options{}) {}
+
+    void SetPlaybackState(PlaybackState state, int64_t now);
+    void SetTimeline(int64_t position, int64_t duration, double rate, int64_t now);
+    void NoteSurfaceActivity(int64_t now);
+
+    // Time of the next publish, `now` if one is due, or kNever.
+    int64_t NextPublishTime(int64_t now) const;
+
+    // Records a publish at `now` and returns the timeline to publish.
+    TimelineSnapshot Publish(int64_t now);
+
+    // Position estimated from the samples so far.
+    int64_t PositionAt(int64_t now) const;
+
+    const PositionEstimator& estimator() const { return _estimator; }
+
+private:
+    Options _options;
+    PositionEstimator _estimator;
+    PlaybackState _state = PlaybackState::kClosed;
+    // The position is only current while not playing
+    TimelineSnapshot _sample;
+    int64_t _lastPublish = 0;
+    int64_t _surfaceActiveUntil = 0;
+    bool _dirty = false;
+};
+
+// Runs a TimelinePolicy on its own thread, sleeping until the next publish
+// is due. While nothing is due the thread blocks without a timeout.
+class TimelinePublisher {
+public:
+    using Commit = std::function<void(const TimelineSnapshot& timeline)>;
+
+    TimelinePublisher(Commit commit, TimelinePolicy::Options options);
+    explicit TimelinePublisher(Commit commit) : TimelinePublisher(std::move(commit), TimelinePolicy::Options{}) {}
+    ~TimelinePublisher();
+
+    TimelinePublisher(const TimelinePublisher&) = delete;
+    TimelinePublisher& operator=(const TimelinePublisher&) = delete;
+
+    void SetPlaybackState(PlaybackState state);
+    void SetTimeline(int64_t position, int64_t duration, double rate);
+    void NoteSurfaceActivity();
+
+    // Number of times the thread woke up, for diagnostics
+    uint64_t Wakeups() const;
+
+private:
+    void Run();
+
+    Commit _commit;
+    TimelinePolicy _policy;
+    mutable std::mutex _mutex;
+    std::condition_variable _cv;
+    uint64_t _wakeups = 0;
+    bool _stopping = false;
+    std::thread _thread;
+};
+
+}  // namespace audio_service_smtc
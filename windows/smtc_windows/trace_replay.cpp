@@ -0,0 +1,119 @@
+#include "trace_replay.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "event_dispatcher.h"
+#include "update_pipeline.h"
+
+namespace audio_service_smtc {
+
+namespace {
+
+bool SameState(const PlayerState& a, const PlayerState& b) {
+    return a.status == b.status && a.metadata == b.metadata && a.enabledButtons == b.enabledButtons &&
+           a.timeline.position == b.timeline.position && a.timeline.duration == b.timeline.duration &&
+           a.timeline.rate == b.timeline.rate;
+}
+
+int64_t Percentile(std::vector<int64_t>& sorted, double fraction) {
+    if (sorted.empty()) return 0;
+    size_t index = static_cast<size_t>(fraction * static_cast<double>(sorted.size() - 1));
+    return sorted[index];
+}
+
+}  // namespace
+
+ReplayReport ReplayTrace(TraceReader& reader, const ReplayOptions& options) {
+    ReplayReport report;
+
+    std::mutex mutex;
+    PlayerStateStore replayed;
+    std::vector<int64_t> latencies;
+    std::deque<int64_t> submitTimes;   // of patches not yet committed
+    uint64_t carried = 0;              // patches committed so far
+
+    UpdatePipeline* pipelinePointer = nullptr;
+    UpdatePipeline pipeline([&](const PlayerStatePatch& patch) {
+        // Everything submitted before the pipeline took this patch is in it;
+        // the depth counts what arrived since
+        UpdatePipelineStats stats = pipelinePointer->Stats();
+        uint64_t covered = stats.submitted - stats.depth;
+
+        uint32_t changed = replayed.Apply(patch);
+        if (options.backendDelayMicros > 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(options.backendDelayMicros));
+        }
+
+        int64_t now = MonotonicMicros();
+        std::lock_guard<std::mutex> lock(mutex);
+        for (; carried < covered && !submitTimes.empty(); ++carried) {
+            latencies.push_back(now - submitTimes.front());
+            submitTimes.pop_front();
+        }
+        for (int bit = 0; bit < 4; ++bit) {
+            if (changed & (1u << bit)) ++report.fieldCommits[bit];
+        }
+    });
+    pipelinePointer = &pipeline;
+
+    PlayerStateStore recorded;
+    TraceRecord record;
+    int64_t start = MonotonicMicros();
+    int64_t firstTimestamp = -1;
+    while (reader.Next(&record)) {
+        switch (record.kind) {
+        case TraceKind::kCall:
+            ++report.calls;
+            if (!record.patch) break;
+            ++report.stateCalls;
+
+            if (options.realtime) {
+                if (firstTimestamp < 0) firstTimestamp = record.timestamp;
+                double speed = options.speed > 0 ? options.speed : 1.0;
+                int64_t due = start + static_cast<int64_t>((record.timestamp - firstTimestamp) / speed);
+                int64_t wait = due - MonotonicMicros();
+                if (wait > 0) std::this_thread::sleep_for(std::chrono::microseconds(wait));
+            }
+            if (record.patch->empty()) break;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                submitTimes.push_back(MonotonicMicros());
+            }
+            pipeline.Submit(*record.patch);
+            break;
+        case TraceKind::kEvent:
+            ++report.events;
+            break;
+        case TraceKind::kCommit:
+            ++report.recordedCommits;
+            recorded.Apply(*record.patch);
+            break;
+        }
+    }
+    pipeline.Flush();
+
+    report.wallMicros = MonotonicMicros() - start;
+    report.damaged = reader.damaged();
+    if (report.wallMicros > 0) {
+        report.callsPerSecond = static_cast<double>(report.calls) * 1e6 / static_cast<double>(report.wallMicros);
+    }
+
+    UpdatePipelineStats stats = pipeline.Stats();
+    report.commits = stats.committed;
+    report.collapsed = stats.collapsed;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::sort(latencies.begin(), latencies.end());
+    report.latencyP50 = Percentile(latencies, 0.5);
+    report.latencyP99 = Percentile(latencies, 0.99);
+    report.latencyMax = latencies.empty() ? 0 : latencies.back();
+    report.finalStateMatches = SameState(replayed.Committed(), recorded.Committed());
+    return report;
+}
+
+}  // namespace audio_service_smtc
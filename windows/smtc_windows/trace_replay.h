@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+#include "session_trace.h"
+
+namespace audio_service_smtc {
+
+struct ReplayOptions {
+    // Wait out the recorded gaps between calls, scaled by `speed`; otherwise
+    // submit as fast as possible
+    bool realtime = false;
+    double speed = 1.0;
+    // Time the fake backend spends on each commit, standing in for SMTC
+    int64_t backendDelayMicros = 0;
+};
+
+struct ReplayReport {
+    uint64_t calls = 0;
+    uint64_t stateCalls = 0;          // calls that carried a state patch
+    uint64_t events = 0;              // recorded, not replayed
+    uint64_t recordedCommits = 0;
+    uint64_t commits = 0;             // made by the replay
+    uint64_t collapsed = 0;           // patches merged into a later commit
+    uint64_t fieldCommits[4] = {};    // per StateField bit, in bit order
+    int64_t wallMicros = 0;
+    double callsPerSecond = 0;
+    // From a patch being submitted to the commit that carried it
+    int64_t latencyP50 = 0;
+    int64_t latencyP99 = 0;
+    int64_t latencyMax = 0;
+    // The replayed session ended in the state the recorded one did
+    bool finalStateMatches = false;
+    bool damaged = false;             // the trace ended in a damaged record
+};
+
+// Drives the portable core of the plugin (update pipeline and state store)
+// from a trace, against a fake backend. Runs on any platform.
+ReplayReport ReplayTrace(TraceReader& reader, const ReplayOptions& options);
+
+}  // namespace audio_service_smtc
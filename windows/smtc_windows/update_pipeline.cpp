@@ -0,0 +1,124 @@
+#include "update_pipeline.h"
+
+#include <utility>
+
+#include "span_tracer.h"
+
+namespace audio_service_smtc {
+
+bool UpdateQueue::Submit(const PlayerStatePatch& patch) {
+    if (patch.empty()) return false;
+
+    if (!_pending.empty()) {
+        ++_stats.collapsed;
+    }
+    _pending.Merge(patch);
+    ++_stats.submitted;
+    ++_stats.depth;
+    if (_stats.depth > _stats.highWater) {
+        _stats.highWater = _stats.depth;
+    }
+    return true;
+}
+
+bool UpdateQueue::Take(PlayerStatePatch* patch) {
+    if (_pending.empty()) return false;
+
+    *patch = std::move(_pending);
+    _pending = PlayerStatePatch();
+    _stats.depth = 0;
+    _stats.busy = true;
+    return true;
+}
+
+void UpdateQueue::Done() {
+    ++_stats.committed;
+    _stats.busy = false;
+}
+
+UpdatePipeline::UpdatePipeline(Commit commit, Options options)
+    : _commit(std::move(commit)), _options(std::move(options)) {
+    _thread = std::thread(&UpdatePipeline::Run, this);
+}
+
+UpdatePipeline::~UpdatePipeline() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _cv.notify_all();
+    _idle.notify_all();
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+}
+
+void UpdatePipeline::Submit(const PlayerStatePatch& patch) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_queue.Submit(patch)) return;
+    }
+    _cv.notify_one();
+}
+
+void UpdatePipeline::Flush() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _idle.wait(lock, [this] { return _stopping || _queue.Idle(); });
+}
+
+UpdatePipelineStats UpdatePipeline::Stats() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _queue.Stats();
+}
+
+void UpdatePipeline::SetIdleTimeout(std::chrono::milliseconds timeout) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _options.idleTimeout = timeout;
+}
+
+void UpdatePipeline::Run() {
+    SetSpanThreadName("update pipeline");
+    if (_options.onThreadStart) _options.onThreadStart();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    bool idleDue = false;  // a commit happened since onIdle last ran
+    while (true) {
+        auto ready = [this] { return _stopping || _queue.HasPending(); };
+        if (idleDue && _options.onIdle && _options.idleTimeout.count() > 0) {
+            if (!_cv.wait_for(lock, _options.idleTimeout, ready)) {
+                idleDue = false;
+                lock.unlock();
+                {
+                    SMTC_SPAN(span, "update", "idle");
+                    _options.onIdle();
+                }
+                lock.lock();
+                continue;
+            }
+        } else {
+            _cv.wait(lock, ready);
+        }
+        if (_stopping) break;
+
+        PlayerStatePatch patch;
+        _queue.Take(&patch);
+
+        lock.unlock();
+        {
+            SMTC_SPAN(span, "update", "commit");
+            _commit(patch);
+        }
+        lock.lock();
+
+        _queue.Done();
+        idleDue = true;
+        if (!_queue.HasPending()) {
+            _idle.notify_all();
+        }
+    }
+    lock.unlock();
+
+    if (_options.onThreadExit) _options.onThreadExit();
+}
+
+}  // namespace audio_service_smtc
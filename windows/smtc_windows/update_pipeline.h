@@ -0,0 +1,97 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "player_state.h"
+
+namespace audio_service_smtc {
+
+struct UpdatePipelineStats {
+    size_t depth = 0;          // submissions waiting for the backend
+    size_t highWater = 0;      // largest depth seen
+    uint64_t submitted = 0;
+    uint64_t committed = 0;    // backend commits made
+    uint64_t collapsed = 0;    // submissions folded into a newer one
+    bool busy = false;         // a commit is running
+};
+
+// The overload policy of UpdatePipeline without its thread: at most one
+// patch waits while the backend is busy. Newer submissions are merged into
+// it, so intermediate statuses and tracks are dropped, memory stays constant
+// however slow the backend gets, and the newest value of every field always
+// lands. Not synchronized.
+class UpdateQueue {
+public:
+    // False if the patch was empty and ignored
+    bool Submit(const PlayerStatePatch& patch);
+
+    // Starts a commit of the waiting patch; false if nothing waits
+    bool Take(PlayerStatePatch* patch);
+    // The commit started by Take() finished
+    void Done();
+
+    bool HasPending() const { return !_pending.empty(); }
+    bool Idle() const { return _pending.empty() && !_stats.busy; }
+    const UpdatePipelineStats& Stats() const { return _stats; }
+
+private:
+    PlayerStatePatch _pending;
+    UpdatePipelineStats _stats;
+};
+
+// Moves state commits off the caller's thread onto one backend thread,
+// queued by an UpdateQueue.
+class UpdatePipeline {
+public:
+    using Commit = std::function<void(const PlayerStatePatch& patch)>;
+
+    struct Options {
+        // Run on the backend thread, e.g. to join a COM apartment
+        std::function<void()> onThreadStart;
+        std::function<void()> onThreadExit;
+        // Run on the backend thread once nothing was submitted for
+        // `idleTimeout` after a commit; zero never calls it
+        std::function<void()> onIdle;
+        std::chrono::milliseconds idleTimeout{ 0 };
+    };
+
+    UpdatePipeline(Commit commit, Options options);
+    explicit UpdatePipeline(Commit commit) : UpdatePipeline(std::move(commit), Options{}) {}
+
+    // Stops after the commit in flight; anything still waiting is dropped
+    ~UpdatePipeline();
+
+    UpdatePipeline(const UpdatePipeline&) = delete;
+    UpdatePipeline& operator=(const UpdatePipeline&) = delete;
+
+    // Never blocks on the backend
+    void Submit(const PlayerStatePatch& patch);
+
+    // Blocks until everything submitted so far has been committed
+    void Flush();
+
+    UpdatePipelineStats Stats() const;
+
+    // Applies from the next commit on
+    void SetIdleTimeout(std::chrono::milliseconds timeout);
+
+private:
+    void Run();
+
+    Commit _commit;
+    Options _options;
+    mutable std::mutex _mutex;
+    std::condition_variable _cv;
+    std::condition_variable _idle;
+    UpdateQueue _queue;
+    bool _stopping = false;
+    std::thread _thread;
+};
+
+}  // namespace audio_service_smtc
@@ -0,0 +1,288 @@
+#include "utf16_transcode.h"
+
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#define SMTC_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SMTC_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SMTC_TARGET_AVX2
+#endif
+
+namespace audio_service_smtc {
+
+namespace {
+
+constexpr char16_t kReplacement = 0xFFFD;
+
+// Shorter ASCII runs, like the words between accented letters or the spaces
+// between CJK words, cost more in a vector pass than they save
+constexpr size_t kMinVectorRun = 16;
+
+// Whether the kMinVectorRun bytes at `in` are all ASCII, eight at a time
+bool StartsAsciiRun(const uint8_t* in) {
+    uint64_t low;
+    uint64_t high;
+    std::memcpy(&low, in, 8);
+    std::memcpy(&high, in + 8, 8);
+    return ((low | high) & 0x8080808080808080ULL) == 0;
+}
+
+// Copies the ASCII prefix of [in, in + size) and returns its length.
+size_t CopyAsciiScalar(const uint8_t* in, size_t size, char16_t* out) {
+    size_t i = 0;
+    while (i < size && in[i] < 0x80) {
+        out[i] = in[i];
+        ++i;
+    }
+    return i;
+}
+
+#ifdef SMTC_X86
+
+unsigned LowestBit(unsigned mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+size_t CopyAsciiSse2(const uint8_t* in, size_t size, char16_t* out) {
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        unsigned high = static_cast<unsigned>(_mm_movemask_epi8(bytes));
+        if (high != 0) {
+            return i + CopyAsciiScalar(in + i, LowestBit(high), out + i);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_unpacklo_epi8(bytes, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 8), _mm_unpackhi_epi8(bytes, zero));
+    }
+    return i + CopyAsciiScalar(in + i, size - i, out + i);
+}
+
+SMTC_TARGET_AVX2 size_t CopyAsciiAvx2(const uint8_t* in, size_t size, char16_t* out) {
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        unsigned high = static_cast<unsigned>(_mm256_movemask_epi8(bytes));
+        if (high != 0) {
+            return i + CopyAsciiScalar(in + i, LowestBit(high), out + i);
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+            _mm256_cvtepu8_epi16(_mm256_castsi256_si128(bytes)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + 16),
+            _mm256_cvtepu8_epi16(_mm256_extracti128_si256(bytes, 1)));
+    }
+    // Not every compiler emits this before calling non-VEX code, and the
+    // transition penalty would cost more than the whole tail
+    _mm256_zeroupper();
+    return i + CopyAsciiSse2(in + i, size - i, out + i);
+}
+
+// Decodes runs of three-byte sequences, which is what CJK text mostly is, up
+// to five per 16-byte load. Returns the bytes consumed and adds the units
+// written to `*units`; whatever follows the run, including overlong forms and
+// surrogates, is left to the scalar decoder.
+SMTC_TARGET_AVX2 size_t DecodeThreeByteRunAvx2(const uint8_t* in, size_t size, char16_t* out, size_t* units) {
+    const __m128i leads = _mm_setr_epi8(0, -1, 3, -1, 6, -1, 9, -1, 12, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i middles = _mm_setr_epi8(1, -1, 4, -1, 7, -1, 10, -1, 13, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i lasts = _mm_setr_epi8(2, -1, 5, -1, 8, -1, 11, -1, 14, -1, -1, -1, -1, -1, -1, -1);
+    size_t i = 0;
+    size_t written = 0;
+    // 16-byte loads and stores; the output holds a unit per input byte, so
+    // the spare stored units stay inside it
+    while (i + 16 <= size) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        unsigned lead = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(
+            _mm_and_si128(bytes, _mm_set1_epi8(static_cast<char>(0xF0))), _mm_set1_epi8(static_cast<char>(0xE0)))));
+        unsigned continuation = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(
+            _mm_and_si128(bytes, _mm_set1_epi8(static_cast<char>(0xC0))), _mm_set1_epi8(static_cast<char>(0x80)))));
+        // Whole sequences before the first byte out of the pattern
+        unsigned mismatch = ((lead ^ 0x1249) | (continuation ^ 0x6DB6)) & 0x7FFF;
+        unsigned count = mismatch == 0 ? 5 : LowestBit(mismatch) / 3;
+        if (count == 0) break;
+
+        __m128i high = _mm_and_si128(_mm_shuffle_epi8(bytes, leads), _mm_set1_epi16(0x0F));
+        __m128i middle = _mm_and_si128(_mm_shuffle_epi8(bytes, middles), _mm_set1_epi16(0x3F));
+        __m128i low = _mm_and_si128(_mm_shuffle_epi8(bytes, lasts), _mm_set1_epi16(0x3F));
+        __m128i codePoints = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(high, 12), _mm_slli_epi16(middle, 6)), low);
+
+        // Overlong forms fall below U+0800; surrogates are D800-DFFF
+        __m128i top = _mm_and_si128(codePoints, _mm_set1_epi16(static_cast<short>(0xF800)));
+        __m128i bad = _mm_or_si128(_mm_cmpeq_epi16(top, _mm_setzero_si128()),
+                                   _mm_cmpeq_epi16(top, _mm_set1_epi16(static_cast<short>(0xD800))));
+        unsigned badMask = static_cast<unsigned>(_mm_movemask_epi8(bad)) & ((1u << (2 * count)) - 1);
+        if (badMask != 0) {
+            count = LowestBit(badMask) / 2;
+            if (count == 0) break;
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + written), codePoints);
+        i += 3 * count;
+        written += count;
+        if (count < 5) break;
+    }
+    *units += written;
+    return i;
+}
+
+bool CpuHasAvx2() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuidex(info, 1, 0);
+    // The OS must save YMM registers as well
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+#endif  // SMTC_X86
+
+bool IsContinuation(uint8_t byte) {
+    return (byte & 0xC0) == 0x80;
+}
+
+// Decodes the multi-byte sequence at the start of [in, in + size). Returns
+// the bytes consumed, or 0 if the sequence is invalid.
+size_t DecodeSequence(const uint8_t* in, size_t size, uint32_t& codePoint) {
+    uint8_t lead = in[0];
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        if (size < 2 || !IsContinuation(in[1])) return 0;
+        codePoint = (static_cast<uint32_t>(lead & 0x1F) << 6) | (in[1] & 0x3F);
+        return 2;
+    }
+    if (lead >= 0xE0 && lead <= 0xEF) {
+        if (size < 3 || !IsContinuation(in[1]) || !IsContinuation(in[2])) return 0;
+        // Overlong forms and UTF-16 surrogates
+        if (lead == 0xE0 && in[1] < 0xA0) return 0;
+        if (lead == 0xED && in[1] > 0x9F) return 0;
+        codePoint = (static_cast<uint32_t>(lead & 0x0F) << 12) |
+                    (static_cast<uint32_t>(in[1] & 0x3F) << 6) | (in[2] & 0x3F);
+        return 3;
+    }
+    if (lead >= 0xF0 && lead <= 0xF4) {
+        if (size < 4 || !IsContinuation(in[1]) || !IsContinuation(in[2]) || !IsContinuation(in[3])) {
+            return 0;
+        }
+        // Overlong forms and code points above U+10FFFF
+        if (lead == 0xF0 && in[1] < 0x90) return 0;
+        if (lead == 0xF4 && in[1] > 0x8F) return 0;
+        codePoint = (static_cast<uint32_t>(lead & 0x07) << 18) |
+                    (static_cast<uint32_t>(in[1] & 0x3F) << 12) |
+                    (static_cast<uint32_t>(in[2] & 0x3F) << 6) | (in[3] & 0x3F);
+        return 4;
+    }
+    return 0;
+}
+
+using CopyAscii = size_t (*)(const uint8_t* in, size_t size, char16_t* out);
+
+CopyAscii SelectCopyAscii(SimdLevel level) {
+#ifdef SMTC_X86
+    switch (level) {
+    case SimdLevel::kAvx2:
+        return CopyAsciiAvx2;
+    case SimdLevel::kSse2:
+        return CopyAsciiSse2;
+    default:
+        break;
+    }
+#else
+    (void)level;
+#endif
+    return CopyAsciiScalar;
+}
+
+}  // namespace
+
+SimdLevel DetectSimdLevel() {
+#ifdef SMTC_X86
+    static const SimdLevel level = CpuHasAvx2() ? SimdLevel::kAvx2 : SimdLevel::kSse2;
+    return level;
+#else
+    return SimdLevel::kScalar;
+#endif
+}
+
+size_t TranscodeUtf8ToUtf16(std::string_view utf8, char16_t* out, bool* valid, SimdLevel level) {
+    const uint8_t* in = reinterpret_cast<const uint8_t*>(utf8.data());
+    const size_t size = utf8.size();
+    CopyAscii copyAscii = SelectCopyAscii(level);
+    *valid = true;
+
+    size_t i = 0;
+    size_t written = 0;
+    while (i < size) {
+        if (in[i] < 0x80) {
+            if (size - i >= kMinVectorRun && StartsAsciiRun(in + i)) {
+                // Vectorized until the next non-ASCII byte
+                size_t run = copyAscii(in + i, size - i, out + written);
+                i += run;
+                written += run;
+            } else {
+                do {
+                    out[written++] = in[i++];
+                } while (i < size && in[i] < 0x80);
+            }
+            continue;
+        }
+
+#ifdef SMTC_X86
+        // Not for a lone three-byte character, like a dash in Latin text
+        if (level == SimdLevel::kAvx2 && (in[i] & 0xF0) == 0xE0 && i + 3 < size && (in[i + 3] & 0xF0) == 0xE0) {
+            size_t run = DecodeThreeByteRunAvx2(in + i, size - i, out + written, &written);
+            if (run != 0) {
+                i += run;
+                continue;
+            }
+        }
+#endif
+
+        uint32_t codePoint;
+        size_t length = DecodeSequence(in + i, size - i, codePoint);
+        if (length == 0) {
+            out[written++] = kReplacement;
+            *valid = false;
+            ++i;
+            continue;
+        }
+        i += length;
+        if (codePoint >= 0x10000) {
+            codePoint -= 0x10000;
+            out[written++] = static_cast<char16_t>(0xD800 | (codePoint >> 10));
+            out[written++] = static_cast<char16_t>(0xDC00 | (codePoint & 0x3FF));
+        } else {
+            out[written++] = static_cast<char16_t>(codePoint);
+        }
+    }
+    return written;
+}
+
+bool Utf8ToUtf16(std::string_view utf8, std::u16string& out) {
+    out.resize(utf8.size());
+    bool valid = true;
+    out.resize(TranscodeUtf8ToUtf16(utf8, &out[0], &valid));
+    return valid;
+}
+
+}  // namespace audio_service_smtc
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "memory_budget.h"
+
+namespace audio_service_smtc {
+
+enum class SimdLevel {
+    kScalar,
+    kSse2,
+    kAvx2,
+};
+
+// Best level this CPU and build support; detected once.
+SimdLevel DetectSimdLevel();
+
+// Transcodes `utf8` into `out`, which must hold at least utf8.size() units.
+// Invalid or truncated sequences become U+FFFD, as with to_hstring, and
+// clear `*valid`. Returns the number of units written.
+size_t TranscodeUtf8ToUtf16(std::string_view utf8, char16_t* out, bool* valid,
+                            SimdLevel level = DetectSimdLevel());
+
+// Convenience form that reuses `out`'s storage. False if `utf8` was invalid.
+bool Utf8ToUtf16(std::string_view utf8, std::u16string& out);
+
+// Remembers the last few converted strings, so a field that didn't change
+// between updates is neither transcoded nor rebuilt. Value is whatever the
+// caller makes from the UTF-16 text (an hstring on Windows). Not thread-safe.
+// Keys and values are charged to the memory budget as caches.
+template <typename Value, size_t kEntries = 16>
+class Utf16Cache {
+public:
+    Utf16Cache() = default;
+    ~Utf16Cache() { MemoryBudget::Shared().Release(MemoryCategory::kCaches, _charged); }
+
+    Utf16Cache(const Utf16Cache&) = delete;
+    Utf16Cache& operator=(const Utf16Cache&) = delete;
+
+    // Returns the value for `utf8`, calling make(std::u16string_view) on a
+    // miss. The reference stays valid until the next Get.
+    template <typename Make>
+    const Value& Get(std::string_view utf8, Make make) {
+        Entry* victim = &_entries[0];
+        for (Entry& entry : _entries) {
+            // The compare is a length check and a memcmp; hashing the key
+            // would cost about as much as transcoding it
+            if (entry.used && entry.key == utf8) {
+                entry.lastUse = ++_clock;
+                ++_hits;
+                return entry.value;
+            }
+            if (!entry.used || entry.lastUse < victim->lastUse) victim = &entry;
+        }
+
+        ++_misses;
+        if (_buffer.size() < utf8.size()) _buffer.resize(utf8.size());
+        bool valid = true;
+        size_t length = TranscodeUtf8ToUtf16(utf8, _buffer.data(), &valid);
+
+        victim->value = make(std::u16string_view(_buffer.data(), length));
+        victim->key.assign(utf8.data(), utf8.size());
+        victim->lastUse = ++_clock;
+        victim->used = true;
+
+        // The value is taken to hold the UTF-16 text
+        size_t charged = victim->key.capacity() + length * sizeof(char16_t);
+        Account(victim->charged, charged);
+        victim->charged = charged;
+        Account(_bufferCharged, _buffer.capacity() * sizeof(char16_t));
+        _bufferCharged = _buffer.capacity() * sizeof(char16_t);
+        return victim->value;
+    }
+
+    uint64_t hits() const { return _hits; }
+    uint64_t misses() const { return _misses; }
+
+private:
+    struct Entry {
+        uint64_t lastUse = 0;
+        bool used = false;
+        std::string key;
+        Value value{};
+        size_t charged = 0;
+    };
+
+    void Account(size_t before, size_t after) {
+        if (after > before) {
+            MemoryBudget::Shared().Charge(MemoryCategory::kCaches, after - before);
+        } else {
+            MemoryBudget::Shared().Release(MemoryCategory::kCaches, before - after);
+        }
+        _charged = _charged + after - before;
+    }
+
+    std::array<Entry, kEntries> _entries;
+    std::vector<char16_t> _buffer;
+    size_t _bufferCharged = 0;
+    size_t _charged = 0;
+    uint64_t _clock = 0;
+    uint64_t _hits = 0;
+    uint64_t _misses = 0;
+};
+
+}  // namespace audio_service_smtc
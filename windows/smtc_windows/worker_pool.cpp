@@ -0,0 +1,202 @@
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "span_tracer.h"
+
+namespace audio_service_smtc {
+
+namespace {
+
+// Index of the pool slot the current thread runs in, if any.
+thread_local const WorkerPool* tCurrentPool = nullptr;
+thread_local size_t tCurrentSlot = 0;
+
+}  // namespace
+
+WorkerPool::WorkerPool(Options options)
+    : _options(std::move(options)),
+      _threadCount(std::clamp<size_t>(_options.threadCount, 1, kMaxThreads)) {}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _cv.notify_all();
+    // Running tasks finish; queued ones, like artwork fetches, don't start
+    DiscardQueued();
+    for (Slot& slot : _slots) {
+        if (slot.thread.joinable()) {
+            slot.thread.join();
+        }
+    }
+    // Whatever the last running tasks submitted
+    DiscardQueued();
+}
+
+void WorkerPool::DiscardQueued() {
+    std::vector<Task> discarded;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto& lane : _injected) {
+            for (Task& task : lane) discarded.push_back(std::move(task));
+            lane.clear();
+        }
+    }
+    for (Slot& slot : _slots) {
+        std::lock_guard<std::mutex> slotLock(slot.mutex);
+        for (auto& lane : slot.lanes) {
+            for (Task& task : lane) discarded.push_back(std::move(task));
+            lane.clear();
+        }
+    }
+    _pending.fetch_sub(discarded.size(), std::memory_order_relaxed);
+}
+
+void WorkerPool::Submit(TaskPriority priority, Task task) {
+    size_t lane = static_cast<size_t>(priority);
+    _pending.fetch_add(1, std::memory_order_relaxed);
+
+    if (tCurrentPool == this) {
+        // Tasks spawned by a worker stay local until someone steals them
+        Slot& slot = _slots[tCurrentSlot];
+        std::lock_guard<std::mutex> slotLock(slot.mutex);
+        slot.lanes[lane].push_back(std::move(task));
+    }
+    else {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _injected[lane].push_back(std::move(task));
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    WakeOrSpawnLocked();
+}
+
+void WorkerPool::SetThreadCount(size_t count) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _threadCount = std::clamp<size_t>(count, 1, kMaxThreads);
+    _cv.notify_all();
+    WakeOrSpawnLocked();
+}
+
+void WorkerPool::ReleaseIdleThreads() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++_releaseGeneration;
+    _cv.notify_all();
+}
+
+size_t WorkerPool::RunningThreads() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _running;
+}
+
+void WorkerPool::WakeOrSpawnLocked() {
+    if (_stopping || _pending.load(std::memory_order_relaxed) == 0) return;
+
+    if (_idle > 0) {
+        _cv.notify_one();
+        return;
+    }
+    if (_running >= _threadCount) return;
+
+    for (size_t i = 0; i < _threadCount; ++i) {
+        Slot& slot = _slots[i];
+        if (slot.running) continue;
+        // Reap a thread that spun down earlier
+        if (slot.thread.joinable()) {
+            slot.thread.join();
+        }
+        slot.running = true;
+        ++_running;
+        slot.thread = std::thread(&WorkerPool::WorkerLoop, this, i);
+        return;
+    }
+}
+
+bool WorkerPool::TryPop(Slot& slot, size_t lane, bool back, Task& task) {
+    std::lock_guard<std::mutex> lock(slot.mutex);
+    auto& queue = slot.lanes[lane];
+    if (queue.empty()) return false;
+    if (back) {
+        task = std::move(queue.back());
+        queue.pop_back();
+    } else {
+        task = std::move(queue.front());
+        queue.pop_front();
+    }
+    return true;
+}
+
+bool WorkerPool::TryTake(size_t index, Task& task) {
+    for (size_t lane = 0; lane < kLaneCount; ++lane) {
+        // Own work first (newest first), then the shared queue, then steal
+        // the oldest task of another worker.
+        if (TryPop(_slots[index], lane, true, task)) return true;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_injected[lane].empty()) {
+                task = std::move(_injected[lane].front());
+                _injected[lane].pop_front();
+                return true;
+            }
+        }
+        for (size_t offset = 1; offset < kMaxThreads; ++offset) {
+            if (TryPop(_slots[(index + offset) % kMaxThreads], lane, false, task)) return true;
+        }
+    }
+    return false;
+}
+
+void WorkerPool::WorkerLoop(size_t index) {
+    tCurrentPool = this;
+    tCurrentSlot = index;
+    SetSpanThreadName("worker pool");
+    if (_options.onThreadStart) _options.onThreadStart();
+
+    for (;;) {
+        Task task;
+        if (!_stopping.load() && TryTake(index, task)) {
+            _pending.fetch_sub(1, std::memory_order_relaxed);
+            task();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        uint64_t release = _releaseGeneration;
+        auto mustExit = [this, index, release] {
+            return _stopping || index >= _threadCount || _releaseGeneration != release;
+        };
+        bool exiting = mustExit();
+        if (!exiting) {
+            ++_idle;
+            bool woken = _cv.wait_for(lock, _options.idleTimeout, [this, &mustExit] {
+                return mustExit() || _pending.load(std::memory_order_relaxed) > 0;
+            });
+            --_idle;
+            exiting = !woken || mustExit();
+        }
+        // A task submitted after an idle release may have woken only us;
+        // run it rather than leave it without a thread
+        if (exiting && !_stopping && index < _threadCount && _pending.load(std::memory_order_relaxed) > 0) {
+            continue;
+        }
+        if (exiting) {
+            // Give up the slot under the same lock that decided to exit, so a
+            // concurrent Submit() spawns a replacement instead of relying on us
+            _slots[index].running = false;
+            --_running;
+            // Tasks left in our slot after the thread count dropped are
+            // stolen by a thread within the new count. Never our own slot:
+            // within the count we only get here with nothing pending.
+            WakeOrSpawnLocked();
+            break;
+        }
+    }
+
+    if (_options.onThreadExit) _options.onThreadExit();
+    tCurrentPool = nullptr;
+}
+
+}  // namespace audio_service_smtc
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace audio_service_smtc {
+
+// Lanes are served strictly in this order.
+enum class TaskPriority {
+    kCurrent = 0,      // Work for the track that is playing now
+    kPrefetch = 1,     // Work for tracks that may play next
+    kMaintenance = 2,  // Cache trimming and other housekeeping
+};
+
+// Where background work runs: a WorkerPool in the plugin, a SimExecutor
+// under the simulation harness.
+class TaskExecutor {
+public:
+    using Task = std::function<void()>;
+
+    virtual ~TaskExecutor() = default;
+
+    virtual void Submit(TaskPriority priority, Task task) = 0;
+};
+
+// Small work-stealing pool for native background work. Threads are started
+// on demand and exit after `idleTimeout` without work, so an idle pool owns
+// no threads at all.
+class WorkerPool : public TaskExecutor {
+public:
+    struct Options {
+        size_t threadCount = 2;
+        std::chrono::milliseconds idleTimeout{ 5000 };
+        // Run on every worker thread when it starts and before it exits
+        std::function<void()> onThreadStart;
+        std::function<void()> onThreadExit;
+    };
+
+    static constexpr size_t kMaxThreads = 16;
+
+    explicit WorkerPool(Options options);
+    WorkerPool() : WorkerPool(Options{}) {}
+    // Drops tasks that have not started and joins all threads
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void Submit(TaskPriority priority, Task task) override;
+
+    // Threads above the new count exit once they run out of work
+    void SetThreadCount(size_t count);
+
+    // Threads waiting for work exit now instead of at their idle timeout;
+    // new work starts them again
+    void ReleaseIdleThreads();
+
+    size_t PendingTasks() const { return _pending.load(std::memory_order_relaxed); }
+    size_t RunningThreads() const;
+
+private:
+    static constexpr size_t kLaneCount = 3;
+
+    struct Slot {
+        std::mutex mutex;
+        std::array<std::deque<Task>, kLaneCount> lanes;
+        std::thread thread;
+        bool running = false;
+    };
+
+    void WorkerLoop(size_t index);
+    bool TryTake(size_t index, Task& task);
+    bool TryPop(Slot& slot, size_t lane, bool back, Task& task);
+    void WakeOrSpawnLocked();
+    // Destroys every queued task outside the locks
+    void DiscardQueued();
+
+    Options _options;
+    std::array<Slot, kMaxThreads> _slots;
+    std::array<std::deque<Task>, kLaneCount> _injected;  // Guarded by _mutex
+    std::atomic<size_t> _pending{ 0 };
+
+    mutable std::mutex _mutex;
+    std::condition_variable _cv;
+    size_t _threadCount;
+    size_t _running = 0;
+    size_t _idle = 0;
+    std::atomic<bool> _stopping{ false };  // Set under _mutex, read without it
+    uint64_t _releaseGeneration = 0;
+};
+
+}  // namespace audio_service_smtc
@@ -0,0 +1,54 @@
+// Stand-in for the Flutter Windows embedder's flutter/encodable_value.h, so
+// code that decodes method channel arguments builds on Linux. Same variant
+// alternatives in the same order (minus CustomEncodableValue), same map and
+// list types, and the members the plugin uses. Tools only.
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace flutter {
+
+class EncodableValue;
+
+using EncodableList = std::vector<EncodableValue>;
+using EncodableMap = std::map<EncodableValue, EncodableValue>;
+
+namespace internal {
+using EncodableValueVariant = std::variant<std::monostate, bool, int32_t, int64_t, double, std::string,
+                                           std::vector<uint8_t>, std::vector<int32_t>, std::vector<int64_t>,
+                                           std::vector<double>, EncodableList, EncodableMap,
+                                           std::vector<float>>;
+}  // namespace internal
+
+class EncodableValue : public internal::EncodableValueVariant {
+public:
+    using super = internal::EncodableValueVariant;
+    using super::super;
+    using super::operator=;
+
+    EncodableValue() = default;
+    // Without this a string literal would pick the bool alternative
+    explicit EncodableValue(const char* string) : super(std::string(string)) {}
+    EncodableValue& operator=(const char* other) {
+        *this = std::string(other);
+        return *this;
+    }
+
+    bool IsNull() const { return std::holds_alternative<std::monostate>(*this); }
+
+    int64_t LongValue() const {
+        if (std::holds_alternative<int32_t>(*this)) return std::get<int32_t>(*this);
+        return std::get<int64_t>(*this);
+    }
+
+    friend bool operator<(const EncodableValue& lhs, const EncodableValue& rhs) {
+        return static_cast<const super&>(lhs) < static_cast<const super&>(rhs);
+    }
+};
+
+}  // namespace flutter
@@ -0,0 +1,29 @@
+// Stand-in for the Flutter Windows embedder's flutter/method_call.h: a method
+// name and its arguments. Tools only.
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace flutter {
+
+template <typename T>
+class MethodCall {
+public:
+    MethodCall(const std::string& method_name, std::unique_ptr<T> arguments)
+        : _methodName(method_name), _arguments(std::move(arguments)) {}
+
+    MethodCall(const MethodCall&) = delete;
+    MethodCall& operator=(const MethodCall&) = delete;
+
+    const std::string& method_name() const { return _methodName; }
+    const T* arguments() const { return _arguments.get(); }
+
+private:
+    std::string _methodName;
+    std::unique_ptr<T> _arguments;
+};
+
+}  // namespace flutter
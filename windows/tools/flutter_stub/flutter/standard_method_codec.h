@@ -0,0 +1,286 @@
+// Stand-in for the Flutter Windows embedder's flutter/standard_method_codec.h,
+// so tools can compare hand-written encodings with the codec's on Linux.
+// Encodes like the embedder's StandardCodecSerializer: type byte, sizes with
+// the 254/255 escapes, little-endian scalars, and padding from the start of
+// the message to the element size before float64 and non-empty typed list
+// payloads only. Encodes and decodes method calls and encodes success
+// envelopes, which is what a channel round trip needs. Tools only.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "encodable_value.h"
+#include "method_call.h"
+
+namespace flutter {
+
+class StandardMethodCodec {
+public:
+    static const StandardMethodCodec& GetInstance() {
+        static const StandardMethodCodec instance;
+        return instance;
+    }
+
+    std::unique_ptr<std::vector<uint8_t>> EncodeMethodCall(const MethodCall<EncodableValue>& method_call) const {
+        auto out = std::make_unique<std::vector<uint8_t>>();
+        WriteValue(EncodableValue(method_call.method_name()), out.get());
+        if (method_call.arguments()) {
+            WriteValue(*method_call.arguments(), out.get());
+        } else {
+            out->push_back(kNull);
+        }
+        return out;
+    }
+
+    // Null if the message is not a well-formed method call
+    std::unique_ptr<MethodCall<EncodableValue>> DecodeMethodCall(const uint8_t* message, size_t message_size) const {
+        Reader reader{ message, message_size, 0 };
+        EncodableValue name;
+        if (!ReadValue(&reader, &name)) return nullptr;
+        const std::string* method = std::get_if<std::string>(&name);
+        if (!method) return nullptr;
+        auto arguments = std::make_unique<EncodableValue>();
+        if (reader.offset < message_size && !ReadValue(&reader, arguments.get())) return nullptr;
+        return std::make_unique<MethodCall<EncodableValue>>(*method, std::move(arguments));
+    }
+
+    std::unique_ptr<std::vector<uint8_t>> EncodeSuccessEnvelope(const EncodableValue* result = nullptr) const {
+        auto out = std::make_unique<std::vector<uint8_t>>();
+        out->push_back(0);
+        if (result) {
+            WriteValue(*result, out.get());
+        } else {
+            out->push_back(kNull);
+        }
+        return out;
+    }
+
+private:
+    enum Type : uint8_t {
+        kNull = 0,
+        kTrue = 1,
+        kFalse = 2,
+        kInt32 = 3,
+        kInt64 = 4,
+        kFloat64 = 6,
+        kString = 7,
+        kUInt8List = 8,
+        kInt32List = 9,
+        kInt64List = 10,
+        kFloat64List = 11,
+        kList = 12,
+        kMap = 13,
+        kFloat32List = 14,
+    };
+
+    StandardMethodCodec() = default;
+
+    struct Reader {
+        const uint8_t* data;
+        size_t size;
+        size_t offset;
+
+        bool Read(void* out, size_t count) {
+            if (size - offset < count) return false;
+            std::memcpy(out, data + offset, count);
+            offset += count;
+            return true;
+        }
+
+        bool Align(size_t alignment) {
+            size_t mod = offset % alignment;
+            if (mod == 0) return true;
+            if (size - offset < alignment - mod) return false;
+            offset += alignment - mod;
+            return true;
+        }
+    };
+
+    static bool ReadSize(Reader* reader, size_t* size) {
+        uint8_t first;
+        if (!reader->Read(&first, 1)) return false;
+        if (first < 254) {
+            *size = first;
+        } else if (first == 254) {
+            uint16_t value;
+            if (!reader->Read(&value, sizeof(value))) return false;
+            *size = value;
+        } else {
+            uint32_t value;
+            if (!reader->Read(&value, sizeof(value))) return false;
+            *size = value;
+        }
+        return true;
+    }
+
+    template <typename T>
+    static bool ReadTypedList(Reader* reader, size_t alignment, EncodableValue* out) {
+        size_t count;
+        if (!ReadSize(reader, &count)) return false;
+        std::vector<T> list(count);
+        if (count != 0) {
+            if (alignment > 1 && !reader->Align(alignment)) return false;
+            if (!reader->Read(list.data(), count * sizeof(T))) return false;
+        }
+        *out = std::move(list);
+        return true;
+    }
+
+    static bool ReadValue(Reader* reader, EncodableValue* out) {
+        uint8_t type;
+        if (!reader->Read(&type, 1)) return false;
+        switch (type) {
+            case kNull:
+                *out = EncodableValue();
+                return true;
+            case kTrue:
+            case kFalse:
+                *out = type == kTrue;
+                return true;
+            case kInt32: {
+                int32_t value;
+                if (!reader->Read(&value, sizeof(value))) return false;
+                *out = value;
+                return true;
+            }
+            case kInt64: {
+                int64_t value;
+                if (!reader->Read(&value, sizeof(value))) return false;
+                *out = value;
+                return true;
+            }
+            case kFloat64: {
+                double value;
+                if (!reader->Align(8) || !reader->Read(&value, sizeof(value))) return false;
+                *out = value;
+                return true;
+            }
+            case kString: {
+                size_t size;
+                if (!ReadSize(reader, &size) || reader->size - reader->offset < size) return false;
+                *out = std::string(reinterpret_cast<const char*>(reader->data + reader->offset), size);
+                reader->offset += size;
+                return true;
+            }
+            case kUInt8List:
+                return ReadTypedList<uint8_t>(reader, 1, out);
+            case kInt32List:
+                return ReadTypedList<int32_t>(reader, 4, out);
+            case kInt64List:
+                return ReadTypedList<int64_t>(reader, 8, out);
+            case kFloat64List:
+                return ReadTypedList<double>(reader, 8, out);
+            case kFloat32List:
+                return ReadTypedList<float>(reader, 4, out);
+            case kList: {
+                size_t count;
+                if (!ReadSize(reader, &count)) return false;
+                EncodableList list(count);
+                for (EncodableValue& item : list) {
+                    if (!ReadValue(reader, &item)) return false;
+                }
+                *out = std::move(list);
+                return true;
+            }
+            case kMap: {
+                size_t count;
+                if (!ReadSize(reader, &count)) return false;
+                EncodableMap map;
+                for (size_t i = 0; i < count; ++i) {
+                    EncodableValue key;
+                    EncodableValue value;
+                    if (!ReadValue(reader, &key) || !ReadValue(reader, &value)) return false;
+                    map[std::move(key)] = std::move(value);
+                }
+                *out = std::move(map);
+                return true;
+            }
+            default:
+                return false;
+        }
+    }
+
+    template <typename T>
+    static void WriteBytes(const T* data, size_t count, std::vector<uint8_t>* out) {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+        out->insert(out->end(), bytes, bytes + count * sizeof(T));
+    }
+
+    static void WriteAlignment(size_t alignment, std::vector<uint8_t>* out) {
+        while (out->size() % alignment != 0) out->push_back(0);
+    }
+
+    static void WriteSize(size_t size, std::vector<uint8_t>* out) {
+        if (size < 254) {
+            out->push_back(static_cast<uint8_t>(size));
+        } else if (size <= 0xFFFF) {
+            out->push_back(254);
+            uint16_t value = static_cast<uint16_t>(size);
+            WriteBytes(&value, 1, out);
+        } else {
+            out->push_back(255);
+            uint32_t value = static_cast<uint32_t>(size);
+            WriteBytes(&value, 1, out);
+        }
+    }
+
+    template <typename T>
+    static void WriteTypedList(Type type, size_t alignment, const std::vector<T>& list, std::vector<uint8_t>* out) {
+        out->push_back(type);
+        WriteSize(list.size(), out);
+        if (list.empty()) return;
+        if (alignment > 1) WriteAlignment(alignment, out);
+        WriteBytes(list.data(), list.size(), out);
+    }
+
+    static void WriteValue(const EncodableValue& value, std::vector<uint8_t>* out) {
+        if (std::holds_alternative<std::monostate>(value)) {
+            out->push_back(kNull);
+        } else if (auto flag = std::get_if<bool>(&value)) {
+            out->push_back(*flag ? kTrue : kFalse);
+        } else if (auto int32 = std::get_if<int32_t>(&value)) {
+            out->push_back(kInt32);
+            WriteBytes(int32, 1, out);
+        } else if (auto int64 = std::get_if<int64_t>(&value)) {
+            out->push_back(kInt64);
+            WriteBytes(int64, 1, out);
+        } else if (auto number = std::get_if<double>(&value)) {
+            out->push_back(kFloat64);
+            WriteAlignment(8, out);
+            WriteBytes(number, 1, out);
+        } else if (auto string = std::get_if<std::string>(&value)) {
+            out->push_back(kString);
+            WriteSize(string->size(), out);
+            WriteBytes(string->data(), string->size(), out);
+        } else if (auto bytes = std::get_if<std::vector<uint8_t>>(&value)) {
+            WriteTypedList(kUInt8List, 1, *bytes, out);
+        } else if (auto int32s = std::get_if<std::vector<int32_t>>(&value)) {
+            WriteTypedList(kInt32List, 4, *int32s, out);
+        } else if (auto int64s = std::get_if<std::vector<int64_t>>(&value)) {
+            WriteTypedList(kInt64List, 8, *int64s, out);
+        } else if (auto doubles = std::get_if<std::vector<double>>(&value)) {
+            WriteTypedList(kFloat64List, 8, *doubles, out);
+        } else if (auto list = std::get_if<EncodableList>(&value)) {
+            out->push_back(kList);
+            WriteSize(list->size(), out);
+            for (const auto& item : *list) WriteValue(item, out);
+        } else if (auto map = std::get_if<EncodableMap>(&value)) {
+            out->push_back(kMap);
+            WriteSize(map->size(), out);
+            for (const auto& [key, item] : *map) {
+                WriteValue(key, out);
+                WriteValue(item, out);
+            }
+        } else if (auto floats = std::get_if<std::vector<float>>(&value)) {
+            WriteTypedList(kFloat32List, 4, *floats, out);
+        }
+    }
+};
+
+}  // namespace flutter
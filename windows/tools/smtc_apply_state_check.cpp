@@ -0,0 +1,206 @@
+// Checks that applyState reaches the backend as one transaction. A counting
+// MediaBackend stands in for SMTCHandlerImpl: it records every ApplyState
+// call and counts a display commit (DisplayUpdater.Update()) whenever the
+// metadata changed, as SMTCHandlerImpl does. In front of it, an
+// UpdatePipeline and a PlayerStateStore commit patches the way
+// SmtcWindows::CommitState does, and the patches come from the applyState
+// arguments Dart sends, decoded by DecodeStatePatch.
+// Checks that a track change sent as one applyState makes one backend call
+// and one display commit carrying status, metadata and buttons together,
+// where the per-field calls it replaces make two and briefly show the new
+// status over the old track; that resending unchanged metadata commits no
+// display update; and that a track without an album clears the old one.
+// Needs no Windows headers. Build it as C++17 with -Ismtc_windows,
+// -Itools/flutter_stub and -pthread, together with these sources from
+// smtc_windows/: update_pipeline, player_state, string_pool,
+// timeline_publisher, position_estimator, artwork_pipeline, artwork_store,
+// artwork_thumbnail, thumbnail_encoder, worker_pool, span_tracer,
+// event_dispatcher, memory_budget and native_log.
+//
+// Usage: smtc_apply_state_check
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "media_backend.h"
+#include "state_patch_args.h"
+#include "update_pipeline.h"
+
+using flutter::EncodableList;
+using flutter::EncodableMap;
+using flutter::EncodableValue;
+using namespace audio_service_smtc;
+
+namespace {
+
+int g_failures = 0;
+
+void Check(bool ok, const char* what) {
+    std::printf("%s  %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok) ++g_failures;
+}
+
+class CountingBackend final : public MediaBackend {
+public:
+    struct Call {
+        uint32_t changed;
+        PlaybackState status;
+        std::string title;
+        std::string album;
+        uint32_t enabledButtons;
+    };
+
+    bool IsReady() const override { return true; }
+
+    bool ApplyState(const PlayerState& state, uint32_t changed, const ArtworkImage&) override {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _calls.push_back(Call{ changed, state.status, state.metadata.title, state.metadata.album.str(),
+                               state.enabledButtons });
+        if (changed & kMetadataField) ++_displayCommits;
+        return true;
+    }
+
+    bool UpdateThumbnail(const ArtworkImage&) override { return true; }
+    bool UpdateTimeline(const TimelineSnapshot&) override { return true; }
+    void SetControlCallback(std::function<void(const std::string&)>) override {}
+    void SetPositionCallback(std::function<void(int64_t)>) override {}
+
+    std::vector<Call> Calls() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _calls;
+    }
+
+    int DisplayCommits() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _displayCommits;
+    }
+
+    void Reset() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _calls.clear();
+        _displayCommits = 0;
+    }
+
+private:
+    std::mutex _mutex;
+    std::vector<Call> _calls;
+    int _displayCommits = 0;
+};
+
+// SmtcWindows's commit path: queued, then diffed and handed to the backend
+// on the pipeline thread
+class Session {
+public:
+    explicit Session(CountingBackend& backend)
+        : _backend(backend), _pipeline([this](const PlayerStatePatch& patch) { Commit(patch); }) {}
+
+    // The plugin's applyState handler; Flush stands in for Dart awaiting it
+    bool ApplyState(const EncodableMap& arguments) {
+        PlayerStatePatch patch;
+        std::string error;
+        if (!DecodeStatePatch(arguments, &patch, &error)) return false;
+        _pipeline.Submit(patch);
+        _pipeline.Flush();
+        return true;
+    }
+
+    // The per-field calls applyState replaces
+    void UpdatePlaybackStatus(const std::string& status) {
+        PlayerStatePatch patch;
+        patch.status = ParsePlaybackState(status);
+        _pipeline.Submit(patch);
+        _pipeline.Flush();
+    }
+
+    void UpdateMetadata(const std::string& title, const std::string& artist, const std::string& album) {
+        PlayerStatePatch patch;
+        patch.metadata = MediaMetadata{ title, artist, album, {}, 215000000 };
+        _pipeline.Submit(patch);
+        _pipeline.Flush();
+    }
+
+private:
+    void Commit(const PlayerStatePatch& patch) {
+        uint32_t changed = _state.Apply(patch);
+        _backend.ApplyState(_state.Committed(), changed, ArtworkImage{});
+    }
+
+    CountingBackend& _backend;
+    PlayerStateStore _state;
+    UpdatePipeline _pipeline;
+};
+
+// What AudioServiceSmtcImpl sends for setMediaItem and setState in one turn
+EncodableMap TrackChange(const std::string& status, const std::string& title, const std::string& album) {
+    EncodableMap metadata;
+    metadata[EncodableValue("title")] = EncodableValue(title);
+    metadata[EncodableValue("artist")] = EncodableValue("Some Artist");
+    if (!album.empty()) metadata[EncodableValue("album")] = EncodableValue(album);
+    metadata[EncodableValue("duration")] = EncodableValue(int64_t{ 215000000 });
+
+    EncodableMap timeline;
+    timeline[EncodableValue("position")] = EncodableValue(int64_t{ 0 });
+    timeline[EncodableValue("rate")] = EncodableValue(1.0);
+
+    EncodableMap arguments;
+    arguments[EncodableValue("status")] = EncodableValue(status);
+    arguments[EncodableValue("metadata")] = EncodableValue(std::move(metadata));
+    arguments[EncodableValue("timeline")] = EncodableValue(std::move(timeline));
+    arguments[EncodableValue("enabledButtons")] =
+        EncodableValue(EncodableList{ EncodableValue("pause"), EncodableValue("next") });
+    return arguments;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        std::fprintf(stderr, "unknown option %s\n", argv[i]);
+        return 2;
+    }
+
+    CountingBackend backend;
+    Session session(backend);
+
+    // The first track, with the old per-field calls
+    session.UpdatePlaybackStatus("Playing");
+    session.UpdateMetadata("First", "Some Artist", "First Album");
+    backend.Reset();
+
+    session.UpdatePlaybackStatus("Paused");
+    session.UpdateMetadata("Second", "Some Artist", "Second Album");
+    std::vector<CountingBackend::Call> calls = backend.Calls();
+    std::printf("per-field calls: %zu backend calls, %d display commits\n", calls.size(), backend.DisplayCommits());
+    Check(calls.size() == 2 && calls[0].status == PlaybackState::kPaused && calls[0].title == "First",
+          "per-field calls show the new status over the old track first");
+    backend.Reset();
+
+    Check(session.ApplyState(TrackChange("Playing", "Third", "Third Album")), "applyState arguments decode");
+    calls = backend.Calls();
+    std::printf("applyState:      %zu backend calls, %d display commits\n", calls.size(), backend.DisplayCommits());
+    const uint32_t together = kStatusField | kMetadataField | kButtonsField;
+    Check(calls.size() == 1 && backend.DisplayCommits() == 1, "one applyState makes one display commit");
+    Check(calls.size() == 1 && (calls[0].changed & together) == together && calls[0].status == PlaybackState::kPlaying &&
+              calls[0].title == "Third" && calls[0].enabledButtons == (kPauseButton | kNextButton),
+          "status, metadata and buttons arrive in the same call");
+    backend.Reset();
+
+    // setState alone resends the current item
+    session.ApplyState(TrackChange("Paused", "Third", "Third Album"));
+    calls = backend.Calls();
+    Check(calls.size() == 1 && !(calls[0].changed & kMetadataField) && backend.DisplayCommits() == 0,
+          "unchanged metadata commits no display update");
+    backend.Reset();
+
+    session.ApplyState(TrackChange("Playing", "Fourth", ""));
+    calls = backend.Calls();
+    Check(calls.size() == 1 && calls[0].title == "Fourth" && calls[0].album.empty(),
+          "a track without an album clears the previous one");
+
+    std::printf("%s\n", g_failures == 0 ? "all checks passed" : "FAILED");
+    return g_failures == 0 ? 0 : 1;
+}
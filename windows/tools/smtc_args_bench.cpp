@@ -0,0 +1,396 @@
+// Compares decoding method channel arguments with the ArgSchema decoder
+// against the per-field lookups the plugins used before: a find() with a
+// temporary key for every field, and a copy of every string. Builds on Linux
+// against the stand-in EncodableValue in tools/flutter_stub, which has the
+// embedder's variant layout and map type. Both decoders are also checked to
+// agree, and to reject wrong types and missing required fields.
+// Build it as C++17 with -Ismtc_windows, -Itools/flutter_stub and -pthread,
+// together with these sources from smtc_windows/: player_state, string_pool,
+// timeline_publisher, position_estimator, span_tracer, event_dispatcher,
+// memory_budget and native_log.
+//
+// Usage: smtc_args_bench [--iterations=N]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "state_patch_args.h"
+
+using flutter::EncodableList;
+using flutter::EncodableMap;
+using flutter::EncodableValue;
+using namespace audio_service_smtc;
+
+namespace {
+
+int g_failures = 0;
+
+void Check(bool ok, const char* what) {
+    std::printf("%s  %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok) ++g_failures;
+}
+
+// What the plugin hands on; kept out of line so neither decoder is folded away
+volatile size_t g_sink = 0;
+
+__attribute__((noinline)) void ConsumeMetadata(const char* title, size_t titleLength, const char* artist,
+                                               size_t artistLength, const char* album, size_t albumLength,
+                                               int64_t duration, const char* artUrl, size_t artUrlLength) {
+    g_sink = g_sink + titleLength + artistLength + albumLength + artUrlLength + static_cast<size_t>(duration) +
+             static_cast<unsigned char>(title[0] ^ artist[0] ^ album[0] ^ artUrl[0]);
+}
+
+__attribute__((noinline)) void ConsumeTimeline(int64_t position, int64_t duration, double rate) {
+    g_sink = g_sink + static_cast<size_t>(position + duration) + static_cast<size_t>(rate * 100);
+}
+
+__attribute__((noinline)) void ConsumePatch(const PlayerStatePatch& patch) {
+    g_sink = g_sink + (patch.metadata ? patch.metadata->title.size() : 0) +
+             (patch.timeline ? static_cast<size_t>(patch.timeline->position) : 0);
+}
+
+// The plugins' updateMetadata before the schema decoder
+bool LegacyMetadata(const EncodableMap& arguments) {
+    std::string title;
+    std::string artist;
+    std::string album;
+    int64_t duration = 0;
+    std::string albumArtUrl;
+
+    auto title_it = arguments.find(EncodableValue("title"));
+    if (title_it != arguments.end() && std::holds_alternative<std::string>(title_it->second)) {
+        title = std::get<std::string>(title_it->second);
+    } else {
+        return false;
+    }
+    auto artist_it = arguments.find(EncodableValue("artist"));
+    if (artist_it != arguments.end() && std::holds_alternative<std::string>(artist_it->second)) {
+        artist = std::get<std::string>(artist_it->second);
+    }
+    auto album_it = arguments.find(EncodableValue("album"));
+    if (album_it != arguments.end() && std::holds_alternative<std::string>(album_it->second)) {
+        album = std::get<std::string>(album_it->second);
+    }
+    auto duration_it = arguments.find(EncodableValue("duration"));
+    if (duration_it != arguments.end() && std::holds_alternative<int64_t>(duration_it->second)) {
+        duration = std::get<int64_t>(duration_it->second);
+    }
+    auto art_it = arguments.find(EncodableValue("albumArtUrl"));
+    if (art_it != arguments.end() && std::holds_alternative<std::string>(art_it->second)) {
+        albumArtUrl = std::get<std::string>(art_it->second);
+    }
+
+    ConsumeMetadata(title.data(), title.size(), artist.data(), artist.size(), album.data(), album.size(),
+                    duration, albumArtUrl.data(), albumArtUrl.size());
+    return true;
+}
+
+bool SchemaMetadata(const EncodableMap& arguments) {
+    ArgValues<5> args;
+    std::string error;
+    if (!DecodeArgs(arguments, MetadataArgs::kSchema, &args, &error)) return false;
+
+    std::string_view title = args.String(MetadataArgs::kTitle);
+    std::string_view artist = args.String(MetadataArgs::kArtist);
+    std::string_view album = args.String(MetadataArgs::kAlbum);
+    std::string_view albumArtUrl = args.String(MetadataArgs::kAlbumArtUrl);
+    ConsumeMetadata(title.data(), title.size(), artist.data(), artist.size(), album.data(), album.size(),
+                    args.Integer(MetadataArgs::kDuration), albumArtUrl.data(), albumArtUrl.size());
+    return true;
+}
+
+// The plugins' updateTimeline before the schema decoder
+bool LegacyTimeline(const EncodableMap& arguments) {
+    int64_t position = 0;
+    int64_t duration = 0;
+    double rate = 1.0;
+
+    auto position_it = arguments.find(EncodableValue("position"));
+    if (position_it == arguments.end() || !std::holds_alternative<int64_t>(position_it->second)) {
+        return false;
+    }
+    position = std::get<int64_t>(position_it->second);
+    auto duration_it = arguments.find(EncodableValue("duration"));
+    if (duration_it != arguments.end() && std::holds_alternative<int64_t>(duration_it->second)) {
+        duration = std::get<int64_t>(duration_it->second);
+    }
+    auto rate_it = arguments.find(EncodableValue("rate"));
+    if (rate_it != arguments.end() && std::holds_alternative<double>(rate_it->second)) {
+        rate = std::get<double>(rate_it->second);
+    }
+
+    ConsumeTimeline(position, duration, rate);
+    return true;
+}
+
+bool SchemaTimeline(const EncodableMap& arguments) {
+    ArgValues<3> args;
+    std::string error;
+    if (!DecodeArgs(arguments, TimelineArgs::kSchema, &args, &error)) return false;
+
+    ConsumeTimeline(args.Integer(TimelineArgs::kPosition), args.Integer(TimelineArgs::kDuration),
+                    args.Number(TimelineArgs::kRate, 1.0));
+    return true;
+}
+
+// DecodeStatePatch before the schema decoder
+namespace legacy {
+
+const EncodableValue* Find(const EncodableMap& map, const char* key) {
+    auto it = map.find(EncodableValue(key));
+    return it == map.end() || it->second.IsNull() ? nullptr : &it->second;
+}
+
+bool IsInteger(const EncodableValue& value) {
+    return std::holds_alternative<int32_t>(value) || std::holds_alternative<int64_t>(value);
+}
+
+bool DecodeOptionalString(const EncodableMap& map, const char* key, std::string* out, bool* typeError) {
+    const auto* value = Find(map, key);
+    if (!value) return false;
+    const auto* text = std::get_if<std::string>(value);
+    if (!text) {
+        *typeError = true;
+        return false;
+    }
+    *out = *text;
+    return true;
+}
+
+bool DecodeOptionalString(const EncodableMap& map, const char* key, InternedString* out, bool* typeError) {
+    std::string text;
+    if (!DecodeOptionalString(map, key, &text, typeError)) return false;
+    *out = text;
+    return true;
+}
+
+bool DecodeStatePatch(const EncodableMap& arguments, PlayerStatePatch* patch, std::string* error) {
+    if (const auto* status = Find(arguments, "status")) {
+        const auto* name = std::get_if<std::string>(status);
+        if (!name) {
+            *error = "Status must be a string";
+            return false;
+        }
+        patch->status = ParsePlaybackState(name->c_str());
+    }
+
+    if (const auto* metadataValue = Find(arguments, "metadata")) {
+        const auto* metadata = std::get_if<EncodableMap>(metadataValue);
+        if (!metadata) {
+            *error = "Metadata must be a map";
+            return false;
+        }
+
+        MediaMetadata value;
+        bool typeError = false;
+        if (!DecodeOptionalString(*metadata, "title", &value.title, &typeError)) {
+            *error = "Title is required";
+            return false;
+        }
+        DecodeOptionalString(*metadata, "artist", &value.artist, &typeError);
+        DecodeOptionalString(*metadata, "album", &value.album, &typeError);
+        DecodeOptionalString(*metadata, "albumArtUrl", &value.artUrl, &typeError);
+        if (const auto* duration = Find(*metadata, "duration")) {
+            if (!IsInteger(*duration)) typeError = true;
+            else value.duration = duration->LongValue();
+        }
+        if (typeError) {
+            *error = "Metadata fields have the wrong type";
+            return false;
+        }
+        patch->metadata = value;
+    }
+
+    if (const auto* timelineValue = Find(arguments, "timeline")) {
+        const auto* timeline = std::get_if<EncodableMap>(timelineValue);
+        const auto* position = timeline ? Find(*timeline, "position") : nullptr;
+        if (!position || !IsInteger(*position)) {
+            *error = "Timeline position must be an integer";
+            return false;
+        }
+
+        TimelineSnapshot value;
+        value.position = position->LongValue();
+        if (const auto* duration = Find(*timeline, "duration")) {
+            if (IsInteger(*duration)) value.duration = duration->LongValue();
+        } else if (patch->metadata) {
+            value.duration = patch->metadata->duration;
+        }
+        if (const auto* rate = Find(*timeline, "rate")) {
+            if (const auto* rateValue = std::get_if<double>(rate)) value.rate = *rateValue;
+        }
+        patch->timeline = value;
+    }
+
+    if (const auto* buttonsValue = Find(arguments, "enabledButtons")) {
+        const auto* buttons = std::get_if<EncodableList>(buttonsValue);
+        if (!buttons) {
+            *error = "Enabled buttons must be a list";
+            return false;
+        }
+
+        uint32_t mask = 0;
+        for (const auto& button : *buttons) {
+            const auto* name = std::get_if<std::string>(&button);
+            if (!name) continue;
+            if (*name == "play") mask |= kPlayButton;
+            else if (*name == "pause") mask |= kPauseButton;
+            else if (*name == "next") mask |= kNextButton;
+            else if (*name == "previous") mask |= kPreviousButton;
+            else if (*name == "stop") mask |= kStopButton;
+        }
+        patch->enabledButtons = mask;
+    }
+    return true;
+}
+
+}  // namespace legacy
+
+bool LegacyStatePatch(const EncodableMap& arguments) {
+    PlayerStatePatch patch;
+    std::string error;
+    if (!legacy::DecodeStatePatch(arguments, &patch, &error)) return false;
+    ConsumePatch(patch);
+    return true;
+}
+
+bool SchemaStatePatch(const EncodableMap& arguments) {
+    PlayerStatePatch patch;
+    std::string error;
+    if (!DecodeStatePatch(arguments, &patch, &error)) return false;
+    ConsumePatch(patch);
+    return true;
+}
+
+// As the standard codec delivers them: large ints as int64
+EncodableMap MetadataArguments() {
+    EncodableMap map;
+    map[EncodableValue("title")] = EncodableValue("Everything in Its Right Place (Live)");
+    map[EncodableValue("artist")] = EncodableValue("Radiohead");
+    map[EncodableValue("album")] = EncodableValue("I Might Be Wrong: Live Recordings");
+    map[EncodableValue("duration")] = EncodableValue(int64_t{ 4 * 60 * 1000000LL + 21 * 1000000LL });
+    map[EncodableValue("albumArtUrl")] = EncodableValue("file:///C:/Users/someone/Music/Radiohead/cover.jpg");
+    return map;
+}
+
+EncodableMap TimelineArguments() {
+    EncodableMap map;
+    map[EncodableValue("position")] = EncodableValue(int64_t{ 93 * 1000000LL });
+    map[EncodableValue("duration")] = EncodableValue(int64_t{ 261 * 1000000LL });
+    map[EncodableValue("rate")] = EncodableValue(1.0);
+    return map;
+}
+
+EncodableMap StatePatchArguments() {
+    EncodableMap map;
+    map[EncodableValue("status")] = EncodableValue("Playing");
+    map[EncodableValue("metadata")] = EncodableValue(MetadataArguments());
+    map[EncodableValue("timeline")] = EncodableValue(TimelineArguments());
+    map[EncodableValue("enabledButtons")] =
+        EncodableValue(EncodableList{ EncodableValue("play"), EncodableValue("pause"), EncodableValue("next") });
+    return map;
+}
+
+template <typename Decode>
+double NanosPerCall(Decode decode, const EncodableMap& arguments, int iterations) {
+    // Best of a few runs, to keep scheduler noise out
+    double best = 1e30;
+    for (int run = 0; run < 5; ++run) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            if (!decode(arguments)) std::abort();
+        }
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count() / iterations);
+    }
+    return best;
+}
+
+template <typename Legacy, typename Schema>
+void Compare(const char* name, Legacy legacy, Schema schema, const EncodableMap& arguments, int iterations) {
+    double before = NanosPerCall(legacy, arguments, iterations);
+    double after = NanosPerCall(schema, arguments, iterations);
+    std::printf("%-16s per-field %7.1f ns   schema %7.1f ns   %.2fx\n", name, before, after, before / after);
+}
+
+void CheckAgreement() {
+    PlayerStatePatch legacyPatch, schemaPatch;
+    std::string legacyError, schemaError;
+    EncodableMap arguments = StatePatchArguments();
+    bool legacyOk = legacy::DecodeStatePatch(arguments, &legacyPatch, &legacyError);
+    bool schemaOk = DecodeStatePatch(arguments, &schemaPatch, &schemaError);
+    Check(legacyOk && schemaOk, "both decoders accept a full applyState");
+    const TimelineSnapshot& a = *legacyPatch.timeline;
+    const TimelineSnapshot& b = *schemaPatch.timeline;
+    Check(legacyPatch.status == schemaPatch.status && legacyPatch.metadata == schemaPatch.metadata &&
+              a.position == b.position && a.duration == b.duration && a.rate == b.rate &&
+              legacyPatch.enabledButtons == schemaPatch.enabledButtons,
+          "and decode the same patch");
+
+    // Small ints arrive as int32; the old per-field code dropped them
+    EncodableMap timeline;
+    timeline[EncodableValue("position")] = EncodableValue(int32_t{ 5000000 });
+    ArgValues<3> args;
+    std::string error;
+    Check(DecodeArgs(timeline, TimelineArgs::kSchema, &args, &error) &&
+              args.Integer(TimelineArgs::kPosition) == 5000000 && args.Number(TimelineArgs::kRate, 1.0) == 1.0,
+          "int32 integers are read, absent fields fall back");
+
+    EncodableMap wrongType = MetadataArguments();
+    wrongType[EncodableValue("artist")] = EncodableValue(int32_t{ 7 });
+    ArgValues<5> metadata;
+    Check(!DecodeArgs(wrongType, MetadataArgs::kSchema, &metadata, &error) && error == "Artist must be a string",
+          "a field of the wrong type is an error naming it");
+
+    EncodableMap missing = MetadataArguments();
+    missing.erase(EncodableValue("title"));
+    Check(!DecodeArgs(missing, MetadataArgs::kSchema, &metadata, &error) && error == "Title is required",
+          "a missing required field is an error");
+
+    EncodableMap nulled = MetadataArguments();
+    nulled[EncodableValue("album")] = EncodableValue();
+    nulled[EncodableValue("unknown")] = EncodableValue(true);
+    Check(DecodeArgs(nulled, MetadataArgs::kSchema, &metadata, &error) && !metadata.Has(MetadataArgs::kAlbum),
+          "null counts as absent and unknown keys are ignored");
+
+    EncodableMap nested = StatePatchArguments();
+    nested[EncodableValue("timeline")] = EncodableValue(EncodableMap{ { EncodableValue("rate"), EncodableValue(1.0) } });
+    PlayerStatePatch patch;
+    Check(!DecodeStatePatch(nested, &patch, &error) && error == "Position is required",
+          "nested maps are checked against their own schema");
+
+    EncodableMap source = MetadataArguments();
+    ArgValues<5> views;
+    DecodeArgs(source, MetadataArgs::kSchema, &views, &error);
+    const auto& stored = std::get<std::string>(source.at(EncodableValue("title")));
+    Check(views.String(MetadataArgs::kTitle).data() == stored.data(), "strings are views into the map");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int iterations = 200000;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--iterations=", 13) == 0) {
+            iterations = std::atoi(argv[i] + 13);
+        } else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    CheckAgreement();
+
+    Compare("updateMetadata", LegacyMetadata, SchemaMetadata, MetadataArguments(), iterations);
+    Compare("updateTimeline", LegacyTimeline, SchemaTimeline, TimelineArguments(), iterations);
+    Compare("applyState", LegacyStatePatch, SchemaStatePatch, StatePatchArguments(), iterations);
+
+    std::printf("%s\n", g_failures == 0 ? "all checks passed" : "FAILED");
+    return g_failures == 0 ? 0 : 1;
+}
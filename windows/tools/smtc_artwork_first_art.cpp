@@ -0,0 +1,288 @@
+// Measures time to first art: from a track change (ArtworkPipeline::Begin)
+// until the backend has any artwork to show for it. Two local cover files
+// carry the same full-size JPEG, one with an EXIF thumbnail in front and one
+// without; for the first the placeholder comes back from Begin itself, for
+// the second nothing shows until the full image has been read, decoded and
+// re-encoded to the thumbnail budget on the worker pool. Time to the full
+// image is reported for both.
+// The JPEGs are made by the plugin's own encoder, reads go through
+// LoadLocalArtwork and re-encoding through FitThumbnail. There is no JPEG
+// decoder outside Windows, so the stand-in for WIC scales the source pixels
+// down the way its scaler would but skips entropy decoding: full-image times
+// are a lower bound, placeholder times are not affected.
+// Build it as C++17 with -Ismtc_windows and -pthread, together with these
+// sources from smtc_windows/: artwork_pipeline, artwork_store,
+// artwork_thumbnail, thumbnail_encoder, worker_pool, span_tracer,
+// memory_budget, event_dispatcher and native_log.
+//
+// Usage: smtc_artwork_first_art [--tracks=N] [--edge=N] [--dir=DIR]
+//                               [--read-delay-us=N]
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "artwork_pipeline.h"
+#include "artwork_thumbnail.h"
+#include "thumbnail_encoder.h"
+#include "worker_pool.h"
+
+using namespace audio_service_smtc;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+int g_failures = 0;
+
+void Check(bool ok, const char* what) {
+    std::printf("%s  %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok) ++g_failures;
+}
+
+// Cover art the size a tagger embeds: smooth gradients with some grain
+RgbaImage MakeCover(uint32_t edge) {
+    RgbaImage image;
+    image.width = edge;
+    image.height = edge;
+    image.pixels.resize(static_cast<size_t>(edge) * edge * 4);
+    uint32_t seed = 2024;
+    for (uint32_t y = 0; y < edge; ++y) {
+        for (uint32_t x = 0; x < edge; ++x) {
+            seed = seed * 1664525 + 1013904223;
+            uint8_t* pixel = &image.pixels[(static_cast<size_t>(y) * edge + x) * 4];
+            int grain = static_cast<int>(seed >> 28) - 8;
+            pixel[0] = static_cast<uint8_t>(std::clamp(static_cast<int>(x * 255 / edge) + grain, 0, 255));
+            pixel[1] = static_cast<uint8_t>(std::clamp(static_cast<int>(y * 255 / edge) + grain, 0, 255));
+            pixel[2] = static_cast<uint8_t>(std::clamp(static_cast<int>((x + y) * 127 / edge) + grain, 0, 255));
+            pixel[3] = 255;
+        }
+    }
+    return image;
+}
+
+// Box filter, as WIC's fant scaler roughly is
+RgbaImage ScaleDown(const RgbaImage& source, uint32_t maxEdge) {
+    uint32_t longest = (std::max)(source.width, source.height);
+    if (longest <= maxEdge) return source;
+    RgbaImage image;
+    image.width = (std::max<uint32_t>)(1, static_cast<uint32_t>(uint64_t(source.width) * maxEdge / longest));
+    image.height = (std::max<uint32_t>)(1, static_cast<uint32_t>(uint64_t(source.height) * maxEdge / longest));
+    image.pixels.resize(static_cast<size_t>(image.width) * image.height * 4);
+    for (uint32_t y = 0; y < image.height; ++y) {
+        uint32_t y0 = y * source.height / image.height, y1 = (y + 1) * source.height / image.height;
+        for (uint32_t x = 0; x < image.width; ++x) {
+            uint32_t x0 = x * source.width / image.width, x1 = (x + 1) * source.width / image.width;
+            uint32_t sums[4] = {};
+            for (uint32_t sy = y0; sy < y1; ++sy) {
+                const uint8_t* row = &source.pixels[(static_cast<size_t>(sy) * source.width + x0) * 4];
+                for (uint32_t sx = x0; sx < x1; ++sx, row += 4) {
+                    for (int c = 0; c < 4; ++c) sums[c] += row[c];
+                }
+            }
+            uint32_t count = (y1 - y0) * (x1 - x0);
+            uint8_t* pixel = &image.pixels[(static_cast<size_t>(y) * image.width + x) * 4];
+            for (int c = 0; c < 4; ++c) pixel[c] = static_cast<uint8_t>(sums[c] / count);
+        }
+    }
+    return image;
+}
+
+void Put16(std::vector<uint8_t>& out, uint16_t value) {
+    out.push_back(static_cast<uint8_t>(value));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+}
+
+void Put32(std::vector<uint8_t>& out, uint32_t value) {
+    Put16(out, static_cast<uint16_t>(value));
+    Put16(out, static_cast<uint16_t>(value >> 16));
+}
+
+// `jpeg` with an APP1 EXIF segment after SOI whose IFD1 points at `thumbnail`,
+// laid out the way cameras and taggers write it
+std::vector<uint8_t> WithExifThumbnail(const std::vector<uint8_t>& jpeg, const std::vector<uint8_t>& thumbnail) {
+    std::vector<uint8_t> tiff = { 'I', 'I', 42, 0 };
+    Put32(tiff, 8);   // IFD0
+    Put16(tiff, 0);   // no entries
+    Put32(tiff, 14);  // IFD1
+    Put16(tiff, 2);
+    const uint32_t thumbnailOffset = 14 + 2 + 2 * 12 + 4;
+    Put16(tiff, 0x0201);
+    Put16(tiff, 4);  // LONG
+    Put32(tiff, 1);
+    Put32(tiff, thumbnailOffset);
+    Put16(tiff, 0x0202);
+    Put16(tiff, 4);
+    Put32(tiff, 1);
+    Put32(tiff, static_cast<uint32_t>(thumbnail.size()));
+    Put32(tiff, 0);  // no IFD2
+    tiff.insert(tiff.end(), thumbnail.begin(), thumbnail.end());
+
+    size_t segmentLength = 2 + 6 + tiff.size();
+    std::vector<uint8_t> out = { 0xFF, 0xD8, 0xFF, 0xE1, static_cast<uint8_t>(segmentLength >> 8),
+                                 static_cast<uint8_t>(segmentLength) };
+    const uint8_t exif[] = { 'E', 'x', 'i', 'f', 0, 0 };
+    out.insert(out.end(), exif, exif + sizeof(exif));
+    out.insert(out.end(), tiff.begin(), tiff.end());
+    out.insert(out.end(), jpeg.begin() + 2, jpeg.end());
+    return out;
+}
+
+bool WriteFile(const std::filesystem::path& path, const std::vector<uint8_t>& bytes) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    return static_cast<bool>(file);
+}
+
+double Micros(Clock::duration duration) {
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+double Percentile(std::vector<double> values, double fraction) {
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(fraction * static_cast<double>(values.size() - 1) + 0.5);
+    return values[index];
+}
+
+struct Report {
+    std::vector<double> firstArt;   // microseconds
+    std::vector<double> fullImage;
+    int placeholders = 0;
+    bool placeholderMatches = true;
+    bool fullFits = true;
+};
+
+// Changes track `tracks` times to the cover at `url`, each time with a fresh
+// pipeline so nothing is served from its cache
+Report Run(WorkerPool& pool, const std::string& url, int tracks, const ArtworkLoader& loader,
+           const ArtworkDecoder& decoder, const ThumbnailBudget& budget,
+           const std::vector<uint8_t>& expectedPlaceholder) {
+    Report report;
+    for (int track = 0; track < tracks; ++track) {
+        std::mutex mutex;
+        std::condition_variable done;
+        bool loaded = false;
+        Clock::time_point fullAt;
+        size_t fullBytes = 0;
+
+        ArtworkPipeline artwork(pool, loader, [&](uint64_t, const ArtworkImage& image) {
+            std::lock_guard<std::mutex> lock(mutex);
+            fullAt = Clock::now();
+            fullBytes = image.bytes->size();
+            loaded = true;
+            done.notify_one();
+        });
+        artwork.SetDecoder(decoder);
+        artwork.SetThumbnailBudget(budget);
+
+        Clock::time_point start = Clock::now();
+        ArtworkImage first = artwork.Begin(static_cast<uint64_t>(track) + 1, url);
+        Clock::time_point begun = Clock::now();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return loaded; });
+
+        if (!first.empty()) {
+            ++report.placeholders;
+            report.placeholderMatches = report.placeholderMatches && *first.bytes == expectedPlaceholder;
+        }
+        report.firstArt.push_back(Micros((first.empty() ? fullAt : begun) - start));
+        report.fullImage.push_back(Micros(fullAt - start));
+        report.fullFits = report.fullFits && fullBytes <= budget.maxBytes;
+    }
+    return report;
+}
+
+void Print(const char* name, const Report& report) {
+    std::printf("%-12s first art  p50 %9.1f us  p99 %9.1f us   full image  p50 %9.1f us  p99 %9.1f us\n", name,
+                Percentile(report.firstArt, 0.5), Percentile(report.firstArt, 0.99),
+                Percentile(report.fullImage, 0.5), Percentile(report.fullImage, 0.99));
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int tracks = 200;
+    uint32_t edge = 1200;
+    int readDelayUs = 0;
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "smtc_artwork_first_art";
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--tracks=", 9) == 0) {
+            tracks = std::atoi(argv[i] + 9);
+        } else if (std::strncmp(argv[i], "--edge=", 7) == 0) {
+            edge = static_cast<uint32_t>(std::atoi(argv[i] + 7));
+        } else if (std::strncmp(argv[i], "--dir=", 6) == 0) {
+            dir = argv[i] + 6;
+        } else if (std::strncmp(argv[i], "--read-delay-us=", 16) == 0) {
+            readDelayUs = std::atoi(argv[i] + 16);
+        } else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (tracks <= 0 || edge < 64) {
+        std::fprintf(stderr, "--tracks must be positive and --edge at least 64\n");
+        return 2;
+    }
+
+    RgbaImage cover = MakeCover(edge);
+    std::vector<uint8_t> full;
+    EncodeJpeg(cover, 92, &full);
+    std::vector<uint8_t> thumbnail;
+    EncodeJpeg(ScaleDown(cover, 160), 75, &thumbnail);
+    std::vector<uint8_t> withExif = WithExifThumbnail(full, thumbnail);
+
+    std::error_code error;
+    std::filesystem::create_directories(dir, error);
+    std::filesystem::path exifPath = dir / "cover-exif.jpg";
+    std::filesystem::path plainPath = dir / "cover-plain.jpg";
+    if (!WriteFile(exifPath, withExif) || !WriteFile(plainPath, full)) {
+        std::fprintf(stderr, "can't write to %s\n", dir.string().c_str());
+        return 2;
+    }
+    std::printf("cover %ux%u: %zu bytes, EXIF thumbnail %zu bytes\n", edge, edge, full.size(), thumbnail.size());
+
+    size_t offset = 0, length = 0;
+    Check(FindExifThumbnail(withExif.data(), withExif.size(), &offset, &length) && length == thumbnail.size(),
+          "the EXIF thumbnail is found in the tagged file");
+
+    // Reads from disk as the plugin does; the delay stands in for a cold
+    // cache or a network share
+    ArtworkLoader loader = [readDelayUs](const std::string& url, size_t maxBytes, std::vector<uint8_t>& out) {
+        if (readDelayUs > 0) std::this_thread::sleep_for(std::chrono::microseconds(readDelayUs));
+        return LoadLocalArtwork(url, maxBytes, out);
+    };
+    ArtworkDecoder decoder = [&cover](const std::vector<uint8_t>&, uint32_t maxEdge, RgbaImage& out) {
+        out = ScaleDown(cover, maxEdge);
+        return true;
+    };
+    ThumbnailBudget budget;
+
+    WorkerPool::Options options;
+    options.threadCount = 1;
+    WorkerPool pool(std::move(options));
+
+    Report exif = Run(pool, exifPath.string(), tracks, loader, decoder, budget, thumbnail);
+    Report plain = Run(pool, plainPath.string(), tracks, loader, decoder, budget, {});
+    Print("placeholder", exif);
+    Print("full decode", plain);
+
+    Check(exif.placeholders == tracks && exif.placeholderMatches, "every tagged track shows its EXIF thumbnail from Begin");
+    Check(plain.placeholders == 0, "an untagged track has no placeholder");
+    Check(exif.fullFits && plain.fullFits, "the full image is re-encoded to the thumbnail budget");
+    Check(Percentile(exif.firstArt, 0.5) < Percentile(plain.firstArt, 0.5),
+          "the placeholder shows before a full decode would");
+
+    std::filesystem::remove(exifPath, error);
+    std::filesystem::remove(plainPath, error);
+    std::printf("%s\n", g_failures == 0 ? "all checks passed" : "FAILED");
+    return g_failures == 0 ? 0 : 1;
+}
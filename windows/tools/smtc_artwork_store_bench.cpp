@@ -0,0 +1,532 @@
+// Checks the packed artwork store and compares it with keeping one file per
+// image. The checks cover lookups and validators, reopening, recovery from a
+// torn append and from a lost index, compaction while views are held and
+// appends carry on, and the artwork pipeline finding fetched images there
+// after a restart. The benchmark fills both layouts with the same
+// images and measures opening, lookups warm and cold, and disk usage.
+// Opening a file-per-entry cache means walking its directories, which such
+// a cache has to do to know its size before it can enforce a limit.
+// Linux only (st_blocks, posix_fadvise). Cold runs drop the page cache
+// through /proc/sys/vm/drop_caches when run as root, else they evict the
+// files' pages with posix_fadvise, which leaves directory entries cached.
+// Build it as C++17 with -Ismtc_windows and -pthread, together with these
+// sources from smtc_windows/: artwork_store, artwork_pipeline,
+// artwork_thumbnail, thumbnail_encoder, span_tracer, memory_budget,
+// event_dispatcher and native_log.
+//
+// Usage: smtc_artwork_store_bench [--entries=N,...] [--dir=DIR] [--lookups=N]
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "artwork_pipeline.h"
+#include "artwork_store.h"
+
+using audio_service_smtc::ArtworkImage;
+using audio_service_smtc::ArtworkPipeline;
+using audio_service_smtc::ArtworkStore;
+using audio_service_smtc::ArtworkStoreStats;
+using audio_service_smtc::HashBytes;
+using audio_service_smtc::StoredArtwork;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+int g_failures = 0;
+
+void Check(bool ok, const char* what) {
+    std::printf("%s  %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok) ++g_failures;
+}
+
+using Clock = std::chrono::steady_clock;
+
+double MicrosSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+std::string Key(size_t i) { return "https://cdn.example.com/covers/" + std::to_string(i) + "/600x600.jpg"; }
+
+// Thumbnails of 2 to 16 KB, each with its own contents
+std::vector<uint8_t> Image(size_t i) {
+    uint64_t state = HashBytes(&i, sizeof(i));
+    std::vector<uint8_t> bytes(2048 + state % (14 * 1024));
+    for (uint8_t& b : bytes) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        b = static_cast<uint8_t>(state >> 56);
+    }
+    return bytes;
+}
+
+bool Same(const StoredArtwork& stored, const std::vector<uint8_t>& bytes) {
+    return stored.size == bytes.size() && std::memcmp(stored.data, bytes.data(), bytes.size()) == 0;
+}
+
+uint64_t DiskUsage(const fs::path& root) {
+    uint64_t bytes = 0;
+    struct stat info;
+    if (::stat(root.c_str(), &info) == 0) bytes += static_cast<uint64_t>(info.st_blocks) * 512;
+    for (const auto& entry : fs::recursive_directory_iterator(root)) {
+        if (::stat(entry.path().c_str(), &info) == 0) bytes += static_cast<uint64_t>(info.st_blocks) * 512;
+    }
+    return bytes;
+}
+
+bool DropCaches(const fs::path& root) {
+    ::sync();
+    FILE* drop = std::fopen("/proc/sys/vm/drop_caches", "w");
+    if (drop) {
+        bool ok = std::fputs("3\n", drop) >= 0;
+        ok = std::fclose(drop) == 0 && ok;
+        if (ok) return true;
+    }
+    for (const auto& entry : fs::recursive_directory_iterator(root)) {
+        if (!entry.is_regular_file()) continue;
+        int fd = ::open(entry.path().c_str(), O_RDONLY);
+        if (fd < 0) continue;
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        ::close(fd);
+    }
+    return false;
+}
+
+void CheckBasics(const fs::path& dir) {
+    std::printf("basics\n");
+    fs::remove_all(dir);
+    auto store = ArtworkStore::Open(dir.u8string());
+    Check(store != nullptr, "a new store opens");
+    if (!store) return;
+
+    std::vector<uint8_t> a = Image(1), b = Image(2);
+    Check(store->Put(Key(1), 7, a.data(), a.size()) && store->Put(Key(2), 7, b.data(), b.size()), "images are stored");
+    Check(Same(store->Find(Key(1), 7), a) && Same(store->Find(Key(2), 7), b), "and found again byte for byte");
+    Check(store->Find(Key(1), 8).empty(), "a different validator misses");
+    Check(store->Find(Key(3), 7).empty(), "an unknown key misses");
+
+    StoredArtwork held = store->Find(Key(1), 7);
+    Check(store->Put(Key(1), 7, b.data(), b.size()) && Same(store->Find(Key(1), 7), b), "a put replaces");
+    Check(Same(held, a), "while a view of the old image stays valid");
+    store.reset();
+
+    store = ArtworkStore::Open(dir.u8string());
+    Check(store && Same(store->Find(Key(1), 7), b) && Same(store->Find(Key(2), 7), b),
+          "everything is there after reopening");
+    Check(store && store->Stats().recoveredRecords == 0, "without scanning the pack");
+
+    // Enough entries to grow the index a few times
+    for (size_t i = 10; i < 5000; ++i) {
+        std::vector<uint8_t> bytes(64, static_cast<uint8_t>(i));
+        store->Put(Key(i), 1, bytes.data(), bytes.size());
+    }
+    bool all = true;
+    for (size_t i = 10; i < 5000; i += 7) {
+        StoredArtwork stored = store->Find(Key(i), 1);
+        all = all && stored.size == 64 && stored.data[0] == static_cast<uint8_t>(i);
+    }
+    Check(all && store->Stats().entries == 4992, "the index grows as entries arrive");
+}
+
+fs::path PackFile(const fs::path& dir) {
+    for (const auto& entry : fs::directory_iterator(dir)) {
+        if (entry.path().extension() == ".pack") return entry.path();
+    }
+    return {};
+}
+
+void CheckRecovery(const fs::path& dir) {
+    std::printf("crash recovery\n");
+    fs::remove_all(dir);
+    {
+        auto store = ArtworkStore::Open(dir.u8string());
+        for (size_t i = 0; i < 20; ++i) {
+            std::vector<uint8_t> bytes = Image(i);
+            store->Put(Key(i), 0, bytes.data(), bytes.size());
+        }
+    }
+
+    // A crash halfway through an append: the record is cut short
+    fs::path pack = PackFile(dir);
+    uint64_t size = fs::file_size(pack);
+    {
+        auto store = ArtworkStore::Open(dir.u8string());
+        std::vector<uint8_t> bytes = Image(20);
+        store->Put(Key(20), 0, bytes.data(), bytes.size());
+    }
+    fs::resize_file(pack, size + 1000);
+    {
+        auto store = ArtworkStore::Open(dir.u8string());
+        ArtworkStoreStats stats = store->Stats();
+        Check(stats.droppedBytes == 1000 && stats.packBytes == size, "a torn append is cut off on open");
+        bool intact = store->Find(Key(20), 0).empty();
+        for (size_t i = 0; i < 20; ++i) intact = intact && Same(store->Find(Key(i), 0), Image(i));
+        Check(intact, "and everything before it is still there");
+
+        std::vector<uint8_t> bytes = Image(21);
+        Check(store->Put(Key(21), 0, bytes.data(), bytes.size()) && Same(store->Find(Key(21), 0), bytes),
+              "appends carry on where it was cut");
+    }
+
+    // Records the index never heard of: appended, then the index was lost
+    for (const auto& entry : fs::directory_iterator(dir)) {
+        if (entry.path().extension() == ".idx") fs::remove(entry.path());
+    }
+    {
+        auto store = ArtworkStore::Open(dir.u8string());
+        ArtworkStoreStats stats = store->Stats();
+        Check(stats.entries == 21 && stats.recoveredRecords == 21, "a lost index is rebuilt from the pack");
+        Check(Same(store->Find(Key(21), 0), Image(21)), "with the last append in it");
+    }
+
+    // A flipped byte in a payload fails its checksum
+    {
+        FILE* file = std::fopen(pack.c_str(), "r+b");
+        std::fseek(file, 32 + 40 + static_cast<long>(Key(0).size()) + 100, SEEK_SET);
+        int c = std::fgetc(file);
+        std::fseek(file, -1, SEEK_CUR);
+        std::fputc(c ^ 0xFF, file);
+        std::fclose(file);
+        auto store = ArtworkStore::Open(dir.u8string());
+        Check(store->Find(Key(0), 0).empty() && Same(store->Find(Key(1), 0), Image(1)),
+              "a corrupted image is a miss, not bad bytes");
+    }
+}
+
+void CheckCompaction(const fs::path& dir) {
+    std::printf("compaction\n");
+    fs::remove_all(dir);
+    ArtworkStore::Options options;
+    options.maxBytes = 4 * 1024 * 1024;
+    options.compactMinBytes = 256 * 1024;
+    auto store = ArtworkStore::Open(dir.u8string(), options);
+
+    for (size_t i = 0; i < 100; ++i) {
+        std::vector<uint8_t> bytes = Image(i);
+        store->Put(Key(i), 0, bytes.data(), bytes.size());
+    }
+    // Replaced twice over: two thirds of the pack is dead
+    for (int round = 0; round < 2; ++round) {
+        for (size_t i = 0; i < 100; ++i) {
+            std::vector<uint8_t> bytes = Image(i + 1000 * (round + 1));
+            store->Put(Key(i), 0, bytes.data(), bytes.size());
+        }
+    }
+    Check(store->NeedsCompaction(), "dead records make compaction due");
+    StoredArtwork held = store->Find(Key(5), 0);
+    uint64_t before = store->Stats().packBytes;
+
+    // Appends race the copy; all of them must survive it
+    std::atomic<bool> done{ false };
+    std::thread writer([&] {
+        for (size_t i = 200; i < 300; ++i) {
+            std::vector<uint8_t> bytes = Image(i);
+            store->Put(Key(i), 0, bytes.data(), bytes.size());
+        }
+        done = true;
+    });
+    bool compacted = store->Compact();
+    writer.join();
+
+    ArtworkStoreStats stats = store->Stats();
+    Check(compacted && stats.compactions == 1, "compaction runs");
+    Check(stats.packBytes < before, "and shrinks the pack");
+    bool all = true;
+    for (size_t i = 0; i < 100; ++i) all = all && Same(store->Find(Key(i), 0), Image(i + 2000));
+    for (size_t i = 200; i < 300; ++i) all = all && Same(store->Find(Key(i), 0), Image(i));
+    Check(all, "keeping the newest version of everything, and what was appended meanwhile");
+    Check(Same(held, Image(2005)), "a view taken before still reads the old pack");
+    Check(!store->NeedsCompaction(), "and it isn't due again");
+
+    size_t files = 0;
+    for (auto it = fs::directory_iterator(dir); it != fs::directory_iterator(); ++it) ++files;
+    Check(files == 3, "the old generation's files are gone");
+
+    // Past the size limit the least recently used go first
+    for (size_t i = 0; i < 100; ++i) store->Find(Key(i), 0);
+    for (size_t i = 300; i < 800 && !store->NeedsCompaction(); ++i) {
+        std::vector<uint8_t> bytes = Image(i);
+        store->Put(Key(i), 0, bytes.data(), bytes.size());
+    }
+    store->Compact();
+    stats = store->Stats();
+    Check(stats.liveBytes <= options.maxBytes / 4 * 3, "over the limit, it compacts to three quarters of it");
+    Check(!store->Find(Key(50), 0).empty() && store->Find(Key(250), 0).empty(),
+          "keeping recently used images over older ones");
+    store.reset();
+    store = ArtworkStore::Open(dir.u8string(), options);
+    Check(store && store->Stats().entries == stats.entries, "the compacted store reopens as it was left");
+}
+
+// Runs loads on the calling thread, so each Begin() has finished loading
+// when it returns
+class InlineExecutor : public audio_service_smtc::TaskExecutor {
+public:
+    void Submit(audio_service_smtc::TaskPriority, Task task) override { task(); }
+};
+
+void CheckPipeline(const fs::path& dir) {
+    std::printf("artwork pipeline\n");
+    fs::remove_all(dir);
+    InlineExecutor executor;
+    int fetches = 0;
+    auto fetch = [&](const std::string& url, size_t maxBytes, std::vector<uint8_t>& out) {
+        if (maxBytes != 0) return false;
+        ++fetches;
+        out = Image(url.size());
+        return true;
+    };
+    auto decode = [](const std::vector<uint8_t>&, uint32_t maxEdge, audio_service_smtc::RgbaImage& image) {
+        image.width = image.height = maxEdge;
+        image.pixels.assign(static_cast<size_t>(maxEdge) * maxEdge * 4, 255);
+        return true;
+    };
+    audio_service_smtc::ThumbnailBudget budget;
+    budget.maxBytes = 4 * 1024;
+    budget.maxEdge = 64;
+    std::string url = Key(1);
+    size_t shown = 0;
+
+    {
+        ArtworkPipeline artwork(executor, fetch, [&](uint64_t, const ArtworkImage& image) {
+            shown = image.bytes->size();
+        });
+        artwork.SetDecoder(decode);
+        artwork.SetThumbnailBudget(budget);
+        artwork.SetStore(ArtworkStore::Open(dir.u8string()));
+        artwork.Begin(1, url);
+    }
+    size_t encoded = shown;
+    Check(fetches == 1 && encoded > 0 && encoded <= budget.maxBytes, "a fetched image is re-encoded and shown");
+
+    // The next run: nothing in memory, the store has it
+    shown = 0;
+    {
+        ArtworkPipeline artwork(executor, fetch, [&](uint64_t, const ArtworkImage& image) {
+            shown = image.bytes->size();
+        });
+        std::shared_ptr<ArtworkStore> store = ArtworkStore::Open(dir.u8string());
+        artwork.SetDecoder(decode);
+        artwork.SetThumbnailBudget(budget);
+        artwork.SetStore(store);
+        artwork.Begin(1, url);
+        Check(fetches == 1 && shown == encoded, "after a restart it comes from the store, not the network");
+
+        // Encoded for another budget, so fetched and encoded again
+        ArtworkPipeline other(executor, fetch, [&](uint64_t, const ArtworkImage& image) {
+            shown = image.bytes->size();
+        });
+        budget.maxEdge = 32;
+        other.SetDecoder(decode);
+        other.SetThumbnailBudget(budget);
+        other.SetStore(ArtworkStore::Open(dir.u8string()));
+        other.Begin(1, url);
+        Check(fetches == 2, "a different thumbnail budget doesn't take the stored image");
+
+        uint64_t appends = store->Stats().appends;
+        artwork.Begin(2, "file:///music/album/cover.jpg");
+        Check(fetches == 3 && store->Stats().appends == appends, "local files are read where they are");
+    }
+}
+
+struct Latency {
+    double p50 = 0;
+    double p99 = 0;
+    double mean = 0;
+};
+
+template <typename Lookup>
+Latency Measure(size_t entries, size_t lookups, uint64_t seed, Lookup lookup) {
+    std::vector<double> times;
+    times.reserve(lookups);
+    for (size_t n = 0; n < lookups; ++n) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        size_t i = static_cast<size_t>((seed >> 33) % entries);
+        Clock::time_point start = Clock::now();
+        if (!lookup(i)) ++g_failures;
+        times.push_back(MicrosSince(start));
+    }
+    Latency latency;
+    for (double t : times) latency.mean += t;
+    latency.mean /= static_cast<double>(times.size());
+    std::sort(times.begin(), times.end());
+    latency.p50 = times[times.size() / 2];
+    latency.p99 = times[times.size() * 99 / 100];
+    return latency;
+}
+
+void PrintLatency(const char* what, const Latency& latency) {
+    std::printf("      %-28s p50 %7.1f us   p99 %7.1f us   mean %7.1f us\n", what, latency.p50, latency.p99,
+                latency.mean);
+}
+
+fs::path EntryPath(const fs::path& root, size_t i) {
+    // Fanned out over 256 directories, as disk caches usually are
+    char name[32];
+    uint64_t hash = HashBytes(Key(i).data(), Key(i).size());
+    std::snprintf(name, sizeof(name), "%02x/%016llx", static_cast<unsigned>(hash & 0xFF),
+                  static_cast<unsigned long long>(hash));
+    return root / name;
+}
+
+bool ReadFileEntry(const fs::path& root, size_t i, std::vector<uint8_t>& out) {
+    int fd = ::open(EntryPath(root, i).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat info;
+    bool ok = ::fstat(fd, &info) == 0;
+    if (ok) {
+        out.resize(static_cast<size_t>(info.st_size));
+        ok = ::read(fd, out.data(), out.size()) == static_cast<ssize_t>(out.size());
+    }
+    ::close(fd);
+    return ok;
+}
+
+void Bench(const fs::path& base, size_t entries, size_t lookups) {
+    std::printf("\n%zu entries\n", entries);
+    fs::path packed = base / "packed";
+    fs::path files = base / "files";
+    fs::remove_all(packed);
+    fs::remove_all(files);
+
+    ArtworkStore::Options options;
+    options.maxBytes = 0;
+    uint64_t payload = 0;
+    Clock::time_point start = Clock::now();
+    {
+        auto store = ArtworkStore::Open(packed.u8string(), options);
+        for (size_t i = 0; i < entries; ++i) {
+            std::vector<uint8_t> bytes = Image(i);
+            payload += bytes.size();
+            store->Put(Key(i), 0, bytes.data(), bytes.size());
+        }
+    }
+    double packedFill = MicrosSince(start);
+    start = Clock::now();
+    for (int dir = 0; dir < 256; ++dir) {
+        char name[4];
+        std::snprintf(name, sizeof(name), "%02x", dir);
+        fs::create_directories(files / name);
+    }
+    for (size_t i = 0; i < entries; ++i) {
+        std::vector<uint8_t> bytes = Image(i);
+        int fd = ::open(EntryPath(files, i).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0 || ::write(fd, bytes.data(), bytes.size()) != static_cast<ssize_t>(bytes.size())) ++g_failures;
+        if (fd >= 0) ::close(fd);
+    }
+    double filesFill = MicrosSince(start);
+    std::printf("      fill                         packed %8.0f ms   files %8.0f ms\n", packedFill / 1000,
+                filesFill / 1000);
+
+    uint64_t packedDisk = DiskUsage(packed);
+    uint64_t filesDisk = DiskUsage(files);
+    std::printf("      disk usage (payload %5.1f MB)  packed %8.1f MB   files %8.1f MB   (%.2fx)\n", payload / 1e6,
+                packedDisk / 1e6, filesDisk / 1e6, static_cast<double>(filesDisk) / packedDisk);
+
+    for (int cold = 1; cold >= 0; --cold) {
+        bool dropped = false;
+        if (cold) {
+            dropped = DropCaches(base);
+        } else {
+            // Every image read once, so nothing comes from disk
+            auto store = ArtworkStore::Open(packed.u8string(), options);
+            std::vector<uint8_t> buffer;
+            for (size_t i = 0; i < entries; ++i) {
+                if (store->Find(Key(i), 0).empty() || !ReadFileEntry(files, i, buffer)) ++g_failures;
+            }
+        }
+        std::printf("    %s\n", cold ? (dropped ? "cold (page cache dropped)" : "cold (file pages evicted)") : "warm");
+
+        start = Clock::now();
+        auto store = ArtworkStore::Open(packed.u8string(), options);
+        double packedOpen = MicrosSince(start);
+        start = Clock::now();
+        uint64_t walked = 0;
+        size_t walkedFiles = 0;
+        for (const auto& entry : fs::recursive_directory_iterator(files)) {
+            struct stat info;
+            if (entry.is_regular_file() && ::stat(entry.path().c_str(), &info) == 0) {
+                walked += static_cast<uint64_t>(info.st_size);
+                ++walkedFiles;
+            }
+        }
+        double filesOpen = MicrosSince(start);
+        if (walkedFiles != entries || walked != payload) ++g_failures;
+        std::printf("      open                         packed %8.2f ms   files %8.2f ms (directory walk)\n",
+                    packedOpen / 1000, filesOpen / 1000);
+
+        if (cold) DropCaches(base);
+        std::vector<uint8_t> buffer;
+        uint64_t seed = cold ? 11 : 12;
+        size_t count = cold ? std::min<size_t>(lookups, 2000) : lookups;
+        PrintLatency("packed, in place", Measure(entries, count, seed, [&](size_t i) {
+                         return !store->Find(Key(i), 0).empty();
+                     }));
+        if (cold) DropCaches(base);
+        PrintLatency("packed, copied out", Measure(entries, count, seed + 100, [&](size_t i) {
+                         StoredArtwork stored = store->Find(Key(i), 0);
+                         buffer.assign(stored.data, stored.data + stored.size);
+                         return !buffer.empty();
+                     }));
+        if (cold) DropCaches(base);
+        PrintLatency("files, open+fstat+read", Measure(entries, count, seed + 100, [&](size_t i) {
+                         return ReadFileEntry(files, i, buffer);
+                     }));
+        PrintLatency("packed, miss", Measure(entries, count, seed, [&](size_t i) {
+                         return store->Find(Key(i + entries), 0).empty();
+                     }));
+        PrintLatency("files, miss", Measure(entries, count, seed, [&](size_t i) {
+                         return !ReadFileEntry(files, i + entries, buffer);
+                     }));
+    }
+
+    fs::remove_all(packed);
+    fs::remove_all(files);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::vector<size_t> sizes = { 10000, 100000 };
+    fs::path dir = fs::temp_directory_path() / "smtc_artwork_store_bench";
+    size_t lookups = 20000;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--entries=", 10) == 0) {
+            sizes.clear();
+            for (const char* p = argv[i] + 10; *p;) {
+                char* end;
+                sizes.push_back(std::strtoull(p, &end, 10));
+                p = *end == ',' ? end + 1 : end;
+                if (end == p && *p) break;
+            }
+        } else if (std::strncmp(argv[i], "--dir=", 6) == 0) {
+            dir = argv[i] + 6;
+        } else if (std::strncmp(argv[i], "--lookups=", 10) == 0) {
+            lookups = std::max<size_t>(100, std::strtoull(argv[i] + 10, nullptr, 10));
+        } else {
+            std::fprintf(stderr, "usage: %s [--entries=N,...] [--dir=DIR] [--lookups=N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    CheckBasics(dir / "basics");
+    CheckRecovery(dir / "recovery");
+    CheckCompaction(dir / "compaction");
+    CheckPipeline(dir / "pipeline");
+    for (size_t entries : sizes) Bench(dir, entries, lookups);
+    fs::remove_all(dir);
+
+    std::printf("%s\n", g_failures == 0 ? "all checks passed" : "FAILED");
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,437 @@
+// Fault-injection test for BackendWatchdog. A session stands in for
+// SmtcWindows: commits record the shown state under a recovery mutex and
+// call the backend through the watchdog, and the rebuild builds a new
+// backend, moves the control callback over and replays the shown state, as
+// SmtcWindows::RebuildBackend does. The fake backend fails, throws or hangs
+// on request and can refuse to come back, like SMTC while Explorer
+// restarts. Checks recovery from each fault and reports how long it took,
+// that a hung call is rebuilt around while it is still blocked and is
+// counted once, that failed rebuilds back off up to the cap, that teardown
+// stops rebuilds before the handlers they install go away, and, with
+// several threads injecting random faults, that every fault is counted, the
+// newest state ends up shown and no stale backend is left alive.
+// Needs no Windows or Flutter headers. Build it as C++17 with -Ismtc_windows
+// and -pthread, together with these sources from smtc_windows/:
+// backend_watchdog, string_pool, span_tracer, event_dispatcher,
+// memory_budget and native_log.
+//
+// Usage: smtc_backend_watchdog_check [--threads=N] [--calls=N]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "backend_watchdog.h"
+#include "event_dispatcher.h"
+#include "media_backend.h"
+
+using namespace audio_service_smtc;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+int g_failures = 0;
+
+void Check(bool ok, const char* what) {
+    std::printf("%s  %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok) ++g_failures;
+}
+
+// xorshift64*, fixed seed so failures reproduce
+class Random {
+public:
+    explicit Random(uint64_t seed) : _state(seed) {}
+
+    uint64_t Next() {
+        _state ^= _state >> 12;
+        _state ^= _state << 25;
+        _state ^= _state >> 27;
+        return _state * 0x2545F4914F6CDD1DULL;
+    }
+
+private:
+    uint64_t _state;
+};
+
+constexpr int64_t kDeadline = 100000;
+constexpr int64_t kRetryInterval = 20000;
+constexpr int64_t kMaxRetryInterval = 160000;
+
+enum class Fault { kNone, kFail, kThrow, kHang };
+
+// Set by the calling thread for its next backend call, so concurrent
+// callers inject their own faults; the watchdog's replays run clean
+thread_local Fault t_fault = Fault::kNone;
+
+// Shared by every backend the session builds
+struct Faults {
+    std::atomic<int> refuseRebuilds{ 0 };
+    std::atomic<int64_t> hangMicros{ 10000000 };
+    std::mutex mutex;
+    std::condition_variable released;
+    bool release = false;
+
+    void Release() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            release = true;
+        }
+        released.notify_all();
+    }
+};
+
+class FaultyBackend final : public MediaBackend {
+public:
+    static std::atomic<int> alive;
+
+    explicit FaultyBackend(Faults& faults) : _faults(faults) {
+        alive.fetch_add(1);
+        int refuse = _faults.refuseRebuilds.load();
+        while (refuse > 0 && !_faults.refuseRebuilds.compare_exchange_weak(refuse, refuse - 1)) {
+        }
+        _ready = refuse <= 0;
+    }
+
+    ~FaultyBackend() override { alive.fetch_sub(1); }
+
+    bool IsReady() const override { return _ready; }
+
+    bool ApplyState(const PlayerState& state, uint32_t, const ArtworkImage&) override {
+        Fault fault = t_fault;
+        t_fault = Fault::kNone;
+        if (fault == Fault::kThrow) throw std::runtime_error("RPC server unavailable");
+        if (fault == Fault::kFail) return false;
+        if (fault == Fault::kHang) {
+            // Returns once released or timed out, as a blocked COM call
+            // finally does
+            std::unique_lock<std::mutex> lock(_faults.mutex);
+            _faults.released.wait_for(lock, std::chrono::microseconds(_faults.hangMicros.load()),
+                                      [this] { return _faults.release; });
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        _shown = state.metadata.title;
+        return true;
+    }
+
+    bool UpdateThumbnail(const ArtworkImage&) override { return true; }
+    bool UpdateTimeline(const TimelineSnapshot&) override { return true; }
+
+    void SetControlCallback(std::function<void(const std::string&)> callback) override {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _control = std::move(callback);
+    }
+
+    void SetPositionCallback(std::function<void(int64_t)>) override {}
+
+    std::string Shown() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _shown;
+    }
+
+    // A button press on this backend's overlay
+    void Press(const std::string& button) {
+        std::function<void(const std::string&)> control;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            control = _control;
+        }
+        if (control) control(button);
+    }
+
+private:
+    Faults& _faults;
+    bool _ready = true;
+    std::mutex _mutex;
+    std::string _shown;
+    std::function<void(const std::string&)> _control;
+};
+
+std::atomic<int> FaultyBackend::alive{ 0 };
+
+// SmtcWindows's commit and recovery paths
+class Session {
+public:
+    explicit Session(Faults& faults) : _faults(faults) {
+        _impl = std::make_shared<FaultyBackend>(_faults);
+        _impl->SetControlCallback(_controlHandler);
+        BackendWatchdog::Options options;
+        options.deadline = kDeadline;
+        options.retryInterval = kRetryInterval;
+        options.maxRetryInterval = kMaxRetryInterval;
+        _watchdog = std::make_unique<BackendWatchdog>([this] { return Rebuild(); }, std::move(options));
+    }
+
+    ~Session() { _watchdog.reset(); }
+
+    bool Commit(const std::string& title) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        PlayerState state;
+        state.status = PlaybackState::kPlaying;
+        state.metadata.title = title;
+        std::shared_ptr<FaultyBackend> impl;
+        {
+            std::lock_guard<std::mutex> recovery(_recoveryMutex);
+            _shownState = state;
+            impl = _impl;
+        }
+        return _watchdog->Run([&] { return impl->ApplyState(state, kStatusField | kMetadataField, ArtworkImage{}); });
+    }
+
+    std::shared_ptr<FaultyBackend> Current() {
+        std::lock_guard<std::mutex> recovery(_recoveryMutex);
+        return _impl;
+    }
+
+    std::vector<int64_t> RebuildAttempts() {
+        std::lock_guard<std::mutex> recovery(_recoveryMutex);
+        return _attempts;
+    }
+
+    int Presses() const { return _presses.load(); }
+
+    // ~SmtcWindows's first steps: forget the handler so no rebuild can
+    // install it again, stop the watchdog, then silence the backend
+    void Teardown() {
+        {
+            std::lock_guard<std::mutex> recovery(_recoveryMutex);
+            _controlHandler = nullptr;
+        }
+        _watchdog->Stop();
+        Current()->SetControlCallback(nullptr);
+    }
+
+    BackendWatchdog& watchdog() { return *_watchdog; }
+
+private:
+    bool Rebuild() {
+        {
+            std::lock_guard<std::mutex> recovery(_recoveryMutex);
+            _attempts.push_back(MonotonicMicros());
+        }
+        auto impl = std::make_shared<FaultyBackend>(_faults);
+        if (!impl->IsReady()) return false;
+
+        std::lock_guard<std::mutex> recovery(_recoveryMutex);
+        _impl->SetControlCallback(nullptr);
+        impl->SetControlCallback(_controlHandler);
+        bool replayed = impl->ApplyState(_shownState, kButtonsField | kStatusField | kMetadataField, ArtworkImage{});
+        _impl = impl;
+        return replayed;
+    }
+
+    Faults& _faults;
+    std::atomic<int> _presses{ 0 };
+    std::function<void(const std::string&)> _controlHandler = [this](const std::string&) { _presses.fetch_add(1); };
+    std::mutex _mutex;
+    std::mutex _recoveryMutex;
+    std::shared_ptr<FaultyBackend> _impl;
+    PlayerState _shownState;
+    std::vector<int64_t> _attempts;
+    std::unique_ptr<BackendWatchdog> _watchdog;
+};
+
+template <typename Predicate>
+bool WaitFor(Predicate done, double seconds) {
+    Clock::time_point give_up = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                                                   std::chrono::duration<double>(seconds));
+    while (!done()) {
+        if (Clock::now() > give_up) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+double Millis(int64_t micros) {
+    return static_cast<double>(micros) / 1000.0;
+}
+
+// Injects one fault into a commit and waits for the rebuild it causes
+bool RecoverFrom(Session& session, Fault fault, const std::string& title, uint64_t recoveries) {
+    t_fault = fault;
+    bool ok = session.Commit(title);
+    bool recovered = WaitFor([&] { return session.watchdog().Stats().recoveries == recoveries; }, 5);
+    return !ok && recovered && session.watchdog().Healthy() && session.Current()->Shown() == title;
+}
+
+void CheckFaults(Faults& faults) {
+    Session session(faults);
+    Check(session.Commit("First") && session.watchdog().Healthy(), "a clean call leaves the backend healthy");
+    std::shared_ptr<FaultyBackend> first = session.Current();
+
+    Check(RecoverFrom(session, Fault::kFail, "Second", 1), "a failed call is rebuilt and its state replayed");
+    std::printf("  failed call: recovered in %.2f ms\n", Millis(session.watchdog().Stats().lastRecoveryMicros));
+    Check(RecoverFrom(session, Fault::kThrow, "Third", 2), "a throwing call is rebuilt and its state replayed");
+    std::printf("  throwing call: recovered in %.2f ms\n", Millis(session.watchdog().Stats().lastRecoveryMicros));
+    WatchdogStats stats = session.watchdog().Stats();
+    Check(stats.failures == 2 && stats.stalls == 0, "each fault is counted once");
+
+    first->Press("play");
+    session.Current()->Press("play");
+    Check(session.Presses() == 1, "a replaced backend no longer delivers presses");
+    first.reset();
+    Check(FaultyBackend::alive.load() == 1, "replaced backends are released");
+}
+
+void CheckHang(Faults& faults) {
+    Session session(faults);
+    session.Commit("First");
+
+    std::atomic<bool> returned{ false };
+    std::atomic<bool> result{ true };
+    Clock::time_point started = Clock::now();
+    std::thread caller([&] {
+        t_fault = Fault::kHang;
+        result.store(session.Commit("Hung"));
+        returned.store(true);
+    });
+    bool recovered = WaitFor([&] { return session.watchdog().Stats().recoveries == 1; }, 5);
+    double shownAfter = std::chrono::duration<double, std::milli>(Clock::now() - started).count();
+    Check(recovered && !returned.load() && session.Current()->Shown() == "Hung",
+          "a hung call is rebuilt around while it is still blocked");
+    std::printf("  hung call: state shown again %.1f ms after the call began (deadline %.0f ms), "
+                "recovered %.2f ms after the stall\n",
+                shownAfter, Millis(kDeadline), Millis(session.watchdog().Stats().lastRecoveryMicros));
+    Check(FaultyBackend::alive.load() == 2, "the hung call keeps the old backend alive");
+
+    faults.Release();
+    caller.join();
+    WatchdogStats stats = session.watchdog().Stats();
+    Check(!result.load() && stats.stalls == 1 && stats.failures == 0 && stats.recoveries == 1,
+          "a call released after its deadline reports failure and is counted once");
+    Check(FaultyBackend::alive.load() == 1, "the old backend goes with the call that held it");
+    std::lock_guard<std::mutex> lock(faults.mutex);
+    faults.release = false;
+}
+
+void CheckBackoff(Faults& faults) {
+    Session session(faults);
+    session.Commit("First");
+
+    const int refusals = 5;
+    faults.refuseRebuilds.store(refusals);
+    Check(RecoverFrom(session, Fault::kFail, "Second", 1), "the backend recovers once rebuilds succeed again");
+
+    std::vector<int64_t> attempts = session.RebuildAttempts();
+    bool backsOff = attempts.size() == refusals + 1;
+    int64_t expected = kRetryInterval;
+    std::printf("  %zu rebuilds, waits between them:", attempts.size());
+    for (size_t i = 1; i < attempts.size(); ++i) {
+        int64_t gap = attempts[i] - attempts[i - 1];
+        std::printf(" %.0f", Millis(gap));
+        backsOff = backsOff && gap >= expected * 9 / 10 && gap < expected + kMaxRetryInterval;
+        expected = (std::min)(expected * 2, kMaxRetryInterval);
+    }
+    std::printf(" ms; recovered in %.1f ms\n", Millis(session.watchdog().Stats().lastRecoveryMicros));
+    Check(backsOff, "failed rebuilds back off, doubling up to the cap");
+    Check(session.watchdog().Stats().recoveries == 1, "only the successful rebuild counts as a recovery");
+}
+
+// Teardown while the watchdog is still retrying a rebuild
+void CheckTeardown(Faults& faults) {
+    Session session(faults);
+    session.Commit("First");
+    faults.refuseRebuilds.store(1000);
+    t_fault = Fault::kFail;
+    session.Commit("Second");
+    WaitFor([&] { return session.RebuildAttempts().size() >= 2; }, 5);
+
+    session.Teardown();
+    size_t attempts = session.RebuildAttempts().size();
+    faults.refuseRebuilds.store(0);
+    t_fault = Fault::kFail;
+    bool ran = !session.Commit("Third");
+    std::this_thread::sleep_for(std::chrono::microseconds(4 * kMaxRetryInterval));
+    Check(session.RebuildAttempts().size() == attempts && session.watchdog().Stats().recoveries == 0,
+          "a stopped watchdog rebuilds nothing");
+    Check(ran && session.watchdog().Stats().failures == 2, "calls still run and are counted once stopped");
+    session.Current()->Press("play");
+    Check(session.Presses() == 0, "no press is delivered after teardown");
+}
+
+// Several threads commit with random faults, some rebuilds refused
+void CheckStorm(Faults& faults, int threads, int calls) {
+    faults.hangMicros.store(3 * kDeadline);
+    Session session(faults);
+
+    std::atomic<uint64_t> injectedFailures{ 0 };
+    std::atomic<uint64_t> injectedHangs{ 0 };
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            Random random(static_cast<uint64_t>(t) + 1);
+            for (int i = 0; i < calls; ++i) {
+                uint64_t roll = random.Next() % 1000;
+                if (roll < 5) {
+                    t_fault = Fault::kFail;
+                    injectedFailures.fetch_add(1);
+                } else if (roll < 8) {
+                    t_fault = Fault::kThrow;
+                    injectedFailures.fetch_add(1);
+                } else if (roll < 9) {
+                    t_fault = Fault::kHang;
+                    injectedHangs.fetch_add(1);
+                } else if (roll < 10) {
+                    faults.refuseRebuilds.fetch_add(1);
+                }
+                session.Commit("t" + std::to_string(t) + "-" + std::to_string(i));
+                if (i % 16 == 0) std::this_thread::yield();
+            }
+        });
+    }
+    for (std::thread& worker : workers) worker.join();
+
+    bool settled = WaitFor([&] { return session.watchdog().Healthy(); }, 10);
+    WatchdogStats stats = session.watchdog().Stats();
+    std::printf("  %d threads x %d calls: %llu failures, %llu stalls, %llu recoveries, last in %.1f ms\n", threads,
+                calls, static_cast<unsigned long long>(stats.failures), static_cast<unsigned long long>(stats.stalls),
+                static_cast<unsigned long long>(stats.recoveries), Millis(stats.lastRecoveryMicros));
+    Check(settled && stats.recoveries > 0, "the backend is healthy after the storm");
+    Check(stats.calls == static_cast<uint64_t>(threads) * static_cast<uint64_t>(calls) &&
+              stats.failures == injectedFailures.load() && stats.stalls == injectedHangs.load(),
+          "every injected fault is counted once");
+
+    Check(session.Commit("Final") && session.Current()->Shown() == "Final", "a commit after the storm is shown");
+    Check(FaultyBackend::alive.load() == 1, "no stale backend is left alive");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int threads = 4;
+    int calls = 2000;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--threads=", 10) == 0) {
+            threads = std::atoi(argv[i] + 10);
+        } else if (std::strncmp(argv[i], "--calls=", 8) == 0) {
+            calls = std::atoi(argv[i] + 8);
+        } else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (threads <= 0 || calls <= 0) {
+        std::fprintf(stderr, "counts must be positive\n");
+        return 2;
+    }
+
+    Faults faults;
+    CheckFaults(faults);
+    CheckHang(faults);
+    CheckBackoff(faults);
+    CheckTeardown(faults);
+    CheckStorm(faults, threads, calls);
+
+    std::printf("%s\n", g_failures == 0 ? "all checks passed" : "FAILED");
+    return g_failures == 0 ? 0 : 1;
+}
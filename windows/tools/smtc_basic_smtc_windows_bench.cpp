@@ -0,0 +1,279 @@
+// Instantiates BasicSmtcWindows over a fake backend in the configuration
+// SingleThreadSmtcWindows uses (NoLock, NullLog) and in the default one
+// (MutexLock, AsyncLog), checks that both commit the way SmtcWindows does,
+// and measures what each costs per update next to the queued SmtcWindows
+// path. Checks that a backend that isn't ready fails Initialize, that a
+// commit hands the backend only what changed (status and metadata in one
+// ApplyState, timeline on its own, nothing for an unchanged track), that
+// local artwork is loaded inline and remote artwork is not, that button
+// presses reach the callback, and that a rejected call fails the update and
+// is logged by AsyncLog but not by NullLog.
+// Needs no Windows or Flutter headers. Build it as C++17 with -Ismtc_windows
+// and -pthread, together with these sources from smtc_windows/:
+// update_pipeline, player_state, string_pool, timeline_publisher,
+// position_estimator, artwork_pipeline, artwork_store, artwork_thumbnail,
+// thumbnail_encoder, worker_pool, span_tracer, event_dispatcher,
+// memory_budget and native_log.
+//
+// Usage: smtc_basic_smtc_windows_bench [--updates=N]
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <string>
+
+#include "basic_smtc_windows.h"
+#include "media_backend.h"
+#include "update_pipeline.h"
+
+using namespace audio_service_smtc;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+int g_failures = 0;
+
+void Check(bool ok, const char* what) {
+    std::printf("%s  %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok) ++g_failures;
+}
+
+constexpr const char* kUnavailableIdentity = "unavailable";
+
+// What the fake backend was last handed, shared with the test since
+// BasicSmtcWindows owns its backend
+struct BackendRecord {
+    int applyCalls = 0;
+    int timelineCalls = 0;
+    uint32_t lastChanged = 0;
+    PlaybackState status = PlaybackState::kClosed;
+    std::string title;
+    size_t artworkBytes = 0;
+    int64_t position = 0;
+    bool reject = false;
+    std::function<void(const std::string&)> control;
+};
+
+BackendRecord g_record;
+
+// Satisfies BasicSmtcWindows's Backend requirements with no base class, as
+// SMTCHandlerImpl does
+class FakeBackend final {
+public:
+    explicit FakeBackend(const std::string& identity) : _ready(identity != kUnavailableIdentity) {}
+
+    bool IsReady() const { return _ready; }
+
+    bool ApplyState(const PlayerState& state, uint32_t changed, const ArtworkImage& artwork) {
+        ++g_record.applyCalls;
+        g_record.lastChanged = changed;
+        g_record.status = state.status;
+        g_record.title = state.metadata.title;
+        g_record.artworkBytes = artwork.empty() ? 0 : artwork.bytes->size();
+        return !g_record.reject;
+    }
+
+    bool UpdateTimeline(const TimelineSnapshot& timeline) {
+        ++g_record.timelineCalls;
+        g_record.position = timeline.position;
+        return !g_record.reject;
+    }
+
+    void SetControlCallback(std::function<void(const std::string&)> callback) {
+        g_record.control = std::move(callback);
+    }
+
+    void SetPositionCallback(std::function<void(int64_t)>) {}
+
+private:
+    bool _ready;
+};
+
+// The same fake behind the virtual interface SmtcWindows calls
+class VirtualFakeBackend final : public MediaBackend {
+public:
+    bool IsReady() const override { return true; }
+
+    bool ApplyState(const PlayerState& state, uint32_t, const ArtworkImage&) override {
+        _status = state.status;
+        return true;
+    }
+
+    bool UpdateThumbnail(const ArtworkImage&) override { return true; }
+
+    bool UpdateTimeline(const TimelineSnapshot& timeline) override {
+        _position = timeline.position;
+        return true;
+    }
+
+    void SetControlCallback(std::function<void(const std::string&)>) override {}
+    void SetPositionCallback(std::function<void(int64_t)>) override {}
+
+private:
+    PlaybackState _status = PlaybackState::kClosed;
+    int64_t _position = 0;
+};
+
+using Minimal = BasicSmtcWindows<FakeBackend, NoLock, NullLog>;
+using Locked = BasicSmtcWindows<FakeBackend, MutexLock, AsyncLog>;
+
+// SmtcWindows's commit path: queued, then committed on the pipeline thread
+// under a mutex and a try/catch through the virtual backend
+class QueuedSession {
+public:
+    QueuedSession() : _pipeline([this](const PlayerStatePatch& patch) { Commit(patch); }) {}
+
+    bool ApplyState(const PlayerStatePatch& patch) {
+        _pipeline.Submit(patch);
+        return true;
+    }
+
+    void Flush() { _pipeline.Flush(); }
+
+private:
+    void Commit(const PlayerStatePatch& patch) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        try {
+            uint32_t changed = _state.Apply(patch);
+            const PlayerState& state = _state.Committed();
+            MediaBackend& backend = _backend;
+            if (changed & (kStatusField | kMetadataField | kButtonsField)) {
+                backend.ApplyState(state, changed, ArtworkImage{});
+            }
+            if (changed & kTimelineField) backend.UpdateTimeline(state.timeline);
+        }
+        catch (const std::exception&) {
+        }
+    }
+
+    std::mutex _mutex;
+    PlayerStateStore _state;
+    VirtualFakeBackend _backend;
+    UpdatePipeline _pipeline;
+};
+
+std::atomic<int> g_logged{ 0 };
+
+template <typename Session>
+void CheckCommits(const char* name, bool logs) {
+    std::printf("%s:\n", name);
+    g_record = BackendRecord{};
+    {
+        Session unavailable;
+        Check(!unavailable.Initialize(kUnavailableIdentity) && !unavailable.UpdatePlaybackStatus("Playing"),
+              "a backend that isn't ready fails Initialize and every update");
+    }
+
+    Session session;
+    Check(session.Initialize(), "Initialize builds the backend");
+    int presses = 0;
+    session.SetControlCallback([&presses](const std::string&) { ++presses; });
+
+    session.UpdatePlaybackStatus("Playing");
+    Check(g_record.applyCalls == 1 && g_record.lastChanged == kStatusField &&
+              g_record.status == PlaybackState::kPlaying,
+          "a status change is one ApplyState");
+
+    const char* artPath = "/tmp/smtc_basic_bench_art.png";
+    std::ofstream(artPath, std::ios::binary) << "not really a png";
+    session.UpdateMetadata("First", "Some Artist", "Some Album", 215000000, std::string("file://") + artPath);
+    Check(g_record.applyCalls == 2 && (g_record.lastChanged & kMetadataField) && g_record.title == "First" &&
+              g_record.artworkBytes == 16,
+          "local artwork is loaded inline with the track");
+    session.UpdateMetadata("Second", "Some Artist", "Some Album", 215000000, "https://example.com/art.png");
+    Check(g_record.title == "Second" && g_record.artworkBytes == 0, "remote artwork is not loaded");
+    session.UpdateMetadata("Second", "Some Artist", "Some Album", 215000000, "https://example.com/art.png");
+    Check(g_record.applyCalls == 3, "an unchanged track reaches no backend");
+
+    session.UpdateTimeline(42000000, 215000000, 1.0);
+    Check(g_record.applyCalls == 3 && g_record.timelineCalls == 1 && g_record.position == 42000000,
+          "a timeline change goes to UpdateTimeline alone");
+
+    if (g_record.control) g_record.control("play");
+    Check(presses == 1, "button presses reach the callback");
+
+    FlushLog();
+    int loggedBefore = g_logged.load();
+    g_record.reject = true;
+    bool rejected = !session.UpdatePlaybackStatus("Paused");
+    g_record.reject = false;
+    FlushLog();
+    Check(rejected && session.Committed().status == PlaybackState::kPaused,
+          "a rejected call fails the update but the state stays committed");
+    Check((g_logged.load() > loggedBefore) == logs, logs ? "AsyncLog logs the failure" : "NullLog logs nothing");
+    std::remove(artPath);
+}
+
+// Alternates status flips with timeline samples, so every update reaches
+// the backend
+template <typename Session>
+double Measure(Session& session, int updates) {
+    PlayerStatePatch play;
+    play.status = PlaybackState::kPlaying;
+    PlayerStatePatch pause;
+    pause.status = PlaybackState::kPaused;
+    PlayerStatePatch timeline;
+    timeline.timeline = TimelineSnapshot{ 0, 215000000, 1.0 };
+
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < updates; ++i) {
+        if (i % 2 == 0) {
+            session.ApplyState(i % 4 == 0 ? play : pause);
+        } else {
+            timeline.timeline->position = i;
+            session.ApplyState(timeline);
+        }
+    }
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / updates;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int updates = 2000000;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--updates=", 10) == 0) {
+            updates = std::atoi(argv[i] + 10);
+        } else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (updates <= 0) {
+        std::fprintf(stderr, "--updates must be positive\n");
+        return 2;
+    }
+
+    SetLogSink([](const LogRecord&) { g_logged.fetch_add(1); });
+    CheckCommits<Minimal>("NoLock, NullLog (SingleThreadSmtcWindows)", false);
+    CheckCommits<Locked>("MutexLock, AsyncLog", true);
+
+    std::printf("per update, %d updates:\n", updates);
+    Minimal minimal;
+    minimal.Initialize();
+    double minimalNanos = Measure(minimal, updates);
+    Locked locked;
+    locked.Initialize();
+    double lockedNanos = Measure(locked, updates);
+    // Submit only, then the time to drain what collapsed
+    QueuedSession queued;
+    Clock::time_point start = Clock::now();
+    double submitNanos = Measure(queued, updates);
+    queued.Flush();
+    double queuedNanos = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / updates;
+    std::printf("  NoLock, NullLog:     %.1f ns (%zu bytes)\n", minimalNanos, sizeof(Minimal));
+    std::printf("  MutexLock, AsyncLog: %.1f ns (%zu bytes)\n", lockedNanos, sizeof(Locked));
+    std::printf("  queued SmtcWindows:  %.1f ns to submit, %.1f ns including the drain\n", submitNanos, queuedNanos);
+    Check(minimalNanos <= lockedNanos * 1.1, "the minimal configuration costs no more than the locked one");
+    Check(sizeof(Minimal) < sizeof(Locked), "NoLock takes no space for a mutex");
+    SetLogSink(nullptr);
+
+    std::printf("%s\n", g_failures == 0 ? "all checks passed" : "FAILED");
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,323 @@
+// Compares a state update through the C ABI, as SmtcPlugin makes it through
+// dart:ffi, with the same update through the method channel. Two updates
+// are timed: the status and timeline of a setState, and a track change that
+// also carries metadata and buttons.
+// - C ABI: each string is copied into its own allocation, as the Dart
+//   bindings copy into an arena, then smtc_apply_state.
+// - Channel: the argument map is built and encoded as a method call, decoded
+//   again, run through the plugin's applyState handler (DecodeStatePatch,
+//   then ApplyState), and a success envelope is encoded for the reply.
+// - Channel with hops: the same, with the native half on a second thread
+//   that the caller waits on, as the platform thread answers Dart.
+// The Dart-side work is modelled in C++, so only the relative cost carries
+// over. Both paths run against the stand-in SmtcWindows of
+// smtc_windows_stub.cpp, which commits on the calling thread, and are
+// checked to commit the same state.
+// Needs no Windows headers. Build it as C++17 with -Ismtc_windows,
+// -Itools/flutter_stub and -pthread, together with tools/smtc_windows_stub.cpp
+// and the smtc_windows/ sources listed in smtc_c_api_check.c.
+//
+// Usage: smtc_c_api_bench [--iterations=N]
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <flutter/standard_method_codec.h>
+
+#include "smtc_session.h"
+#include "smtc_windows_stub.h"
+#include "state_patch_args.h"
+
+using flutter::EncodableList;
+using flutter::EncodableMap;
+using flutter::EncodableValue;
+using flutter::MethodCall;
+using flutter::StandardMethodCodec;
+using namespace audio_service_smtc;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+int g_failures = 0;
+
+void Check(bool ok, const char* what) {
+    std::printf("%s  %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok) ++g_failures;
+}
+
+// What the Dart side holds for one update
+struct Update {
+    bool withMetadata;
+    std::string status;
+    std::string title;
+    std::string artist;
+    std::string album;
+    std::string artUrl;
+    int64_t duration;
+    int64_t position;
+    double rate;
+    std::vector<std::string> buttons;
+};
+
+uint32_t ButtonMask(const std::vector<std::string>& buttons) {
+    uint32_t mask = 0;
+    for (const std::string& name : buttons) {
+        if (name == "play") mask |= SMTC_BUTTON_PLAY;
+        else if (name == "pause") mask |= SMTC_BUTTON_PAUSE;
+        else if (name == "next") mask |= SMTC_BUTTON_NEXT;
+        else if (name == "previous") mask |= SMTC_BUTTON_PREVIOUS;
+        else if (name == "stop") mask |= SMTC_BUTTON_STOP;
+    }
+    return mask;
+}
+
+// SmtcNativeBindings.applyState: strings copied out, patch filled, one call
+class FfiPath {
+public:
+    explicit FfiPath(SmtcSession* session) : _session(session) {}
+
+    bool Apply(const Update& update) {
+        SmtcStatePatch patch = {};
+        std::vector<char*> arena;
+        auto copy = [&arena](const std::string& text, const char** data, size_t* length) {
+            char* bytes = static_cast<char*>(std::malloc(text.size()));
+            std::memcpy(bytes, text.data(), text.size());
+            arena.push_back(bytes);
+            *data = bytes;
+            *length = text.size();
+        };
+
+        patch.fields = SMTC_FIELD_STATUS | SMTC_FIELD_TIMELINE;
+        patch.status = static_cast<int32_t>(ParsePlaybackState(update.status));
+        if (update.withMetadata) {
+            patch.fields |= SMTC_FIELD_METADATA | SMTC_FIELD_BUTTONS;
+            copy(update.title, &patch.title, &patch.title_length);
+            copy(update.artist, &patch.artist, &patch.artist_length);
+            copy(update.album, &patch.album, &patch.album_length);
+            copy(update.artUrl, &patch.art_url, &patch.art_url_length);
+            patch.enabled_buttons = ButtonMask(update.buttons);
+        }
+        patch.duration = update.duration;
+        patch.position = update.position;
+        patch.rate = update.rate;
+        bool ok = smtc_apply_state(_session, &patch) == 1;
+        for (char* bytes : arena) std::free(bytes);
+        return ok;
+    }
+
+private:
+    SmtcSession* _session;
+};
+
+// invokeMethod('applyState', {...}) on the Dart side
+std::unique_ptr<std::vector<uint8_t>> EncodeCall(const Update& update) {
+    EncodableMap arguments;
+    arguments[EncodableValue("status")] = EncodableValue(update.status);
+    if (update.withMetadata) {
+        EncodableMap metadata;
+        metadata[EncodableValue("title")] = EncodableValue(update.title);
+        metadata[EncodableValue("artist")] = EncodableValue(update.artist);
+        metadata[EncodableValue("album")] = EncodableValue(update.album);
+        metadata[EncodableValue("duration")] = EncodableValue(update.duration);
+        metadata[EncodableValue("albumArtUrl")] = EncodableValue(update.artUrl);
+        arguments[EncodableValue("metadata")] = EncodableValue(std::move(metadata));
+        EncodableList buttons;
+        for (const std::string& name : update.buttons) buttons.emplace_back(name);
+        arguments[EncodableValue("enabledButtons")] = EncodableValue(std::move(buttons));
+    }
+    EncodableMap timeline;
+    timeline[EncodableValue("position")] = EncodableValue(update.position);
+    timeline[EncodableValue("duration")] = EncodableValue(update.duration);
+    timeline[EncodableValue("rate")] = EncodableValue(update.rate);
+    arguments[EncodableValue("timeline")] = EncodableValue(std::move(timeline));
+
+    MethodCall<EncodableValue> call("applyState", std::make_unique<EncodableValue>(std::move(arguments)));
+    return StandardMethodCodec::GetInstance().EncodeMethodCall(call);
+}
+
+// The plugin's applyState handler, from message bytes to reply bytes
+std::unique_ptr<std::vector<uint8_t>> HandleCall(SmtcSession* session, const std::vector<uint8_t>& message) {
+    const StandardMethodCodec& codec = StandardMethodCodec::GetInstance();
+    auto call = codec.DecodeMethodCall(message.data(), message.size());
+    bool success = false;
+    if (call && call->method_name() == "applyState") {
+        if (const auto* arguments = std::get_if<EncodableMap>(call->arguments())) {
+            PlayerStatePatch patch;
+            std::string error;
+            success = DecodeStatePatch(*arguments, &patch, &error) && session->ApplyState(patch);
+        }
+    }
+    EncodableValue reply(success);
+    return codec.EncodeSuccessEnvelope(&reply);
+}
+
+bool ReplyIsTrue(const std::vector<uint8_t>& reply) {
+    return reply.size() == 2 && reply[0] == 0 && reply[1] == 1;
+}
+
+class ChannelPath {
+public:
+    explicit ChannelPath(SmtcSession* session) : _session(session) {}
+
+    bool Apply(const Update& update) {
+        auto message = EncodeCall(update);
+        return ReplyIsTrue(*HandleCall(_session, *message));
+    }
+
+private:
+    SmtcSession* _session;
+};
+
+// The native half on a platform thread; the caller blocks for the reply as
+// an awaited invokeMethod does
+class HoppingChannelPath {
+public:
+    explicit HoppingChannelPath(SmtcSession* session) : _session(session), _thread([this] { Run(); }) {}
+
+    ~HoppingChannelPath() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _cv.notify_all();
+        _thread.join();
+    }
+
+    bool Apply(const Update& update) {
+        auto message = EncodeCall(update);
+        std::unique_lock<std::mutex> lock(_mutex);
+        _message = std::move(message);
+        _cv.notify_all();
+        _cv.wait(lock, [this] { return _reply != nullptr; });
+        auto reply = std::move(_reply);
+        return ReplyIsTrue(*reply);
+    }
+
+private:
+    void Run() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        for (;;) {
+            _cv.wait(lock, [this] { return _message || _stopping; });
+            if (_stopping) return;
+            auto message = std::move(_message);
+            lock.unlock();
+            auto reply = HandleCall(_session, *message);
+            lock.lock();
+            _reply = std::move(reply);
+            _cv.notify_all();
+        }
+    }
+
+    SmtcSession* _session;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::unique_ptr<std::vector<uint8_t>> _message;
+    std::unique_ptr<std::vector<uint8_t>> _reply;
+    bool _stopping = false;
+    std::thread _thread;
+};
+
+Update PositionUpdate(int i) {
+    return Update{ false, i % 2 ? "Playing" : "Paused", {}, {}, {}, {}, 215000000, int64_t(i) * 1000, 1.0, {} };
+}
+
+Update TrackChange(int i) {
+    return Update{ true,
+                   "Playing",
+                   "Track " + std::to_string(i) + " (Extended Mix)",
+                   "Some Artist, Another Artist",
+                   "An Album Title (Deluxe Edition)",
+                   "https://example.com/art/" + std::to_string(i) + ".jpg",
+                   215000000,
+                   0,
+                   1.0,
+                   { "play", "pause", "next", "previous" } };
+}
+
+// Nanoseconds per update
+template <typename Path>
+double Time(Path& path, Update (*make)(int), int iterations, bool* allOk) {
+    std::vector<Update> updates;
+    for (int i = 0; i < 64; ++i) updates.push_back(make(i));
+    bool ok = true;
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < iterations; ++i) ok = path.Apply(updates[i & 63]) && ok;
+    double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    *allOk = *allOk && ok;
+    return elapsed / iterations;
+}
+
+bool SameRecord(SmtcSession* a, SmtcSession* b) {
+    SmtcStubRecord left;
+    SmtcStubRecord right;
+    smtc_stub_get_record(a, &left);
+    smtc_stub_get_record(b, &right);
+    return left.commits == right.commits && left.last_fields == right.last_fields && left.status == right.status &&
+           std::strcmp(left.title, right.title) == 0 && std::strcmp(left.artist, right.artist) == 0 &&
+           std::strcmp(left.album, right.album) == 0 && std::strcmp(left.art_url, right.art_url) == 0 &&
+           left.duration == right.duration && left.position == right.position && left.rate == right.rate &&
+           left.enabled_buttons == right.enabled_buttons;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int iterations = 200000;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--iterations=", 13) == 0) {
+            iterations = std::atoi(argv[i] + 13);
+        } else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (iterations <= 0) {
+        std::fprintf(stderr, "--iterations must be positive\n");
+        return 2;
+    }
+
+    // One session per path, so their records can be compared
+    std::unique_ptr<SmtcSession, void (*)(SmtcSession*)> ffiSession(smtc_create("bench", 5), smtc_destroy);
+    std::unique_ptr<SmtcSession, void (*)(SmtcSession*)> channelSession(smtc_create("bench", 5), smtc_destroy);
+    std::unique_ptr<SmtcSession, void (*)(SmtcSession*)> hopSession(smtc_create("bench", 5), smtc_destroy);
+    FfiPath ffi(ffiSession.get());
+    ChannelPath channel(channelSession.get());
+    HoppingChannelPath hopping(hopSession.get());
+
+    const int hopIterations = (std::max)(1, iterations / 10);
+    std::printf("%d updates per path (%d with hops), ns per update\n", iterations, hopIterations);
+    std::printf("  %-22s %12s %12s %16s\n", "", "C ABI", "channel", "channel + hops");
+
+    bool allOk = true;
+    bool same = true;
+    double ffiPosition = Time(ffi, PositionUpdate, iterations, &allOk);
+    double channelPosition = Time(channel, PositionUpdate, iterations, &allOk);
+    same = same && SameRecord(ffiSession.get(), channelSession.get());
+    double hopPosition = Time(hopping, PositionUpdate, hopIterations, &allOk);
+    std::printf("  %-22s %12.0f %12.0f %16.0f\n", "status + timeline", ffiPosition, channelPosition, hopPosition);
+
+    double ffiTrack = Time(ffi, TrackChange, iterations, &allOk);
+    double channelTrack = Time(channel, TrackChange, iterations, &allOk);
+    same = same && SameRecord(ffiSession.get(), channelSession.get());
+    double hopTrack = Time(hopping, TrackChange, hopIterations, &allOk);
+    std::printf("  %-22s %12.0f %12.0f %16.0f\n", "track change", ffiTrack, channelTrack, hopTrack);
+
+    Check(allOk, "every update is accepted on every path");
+    Check(same, "both paths commit the same state");
+    Check(ffiPosition * 2 < channelPosition && ffiTrack * 2 < channelTrack,
+          "the C ABI costs under half the channel's codec work alone");
+    Check(channelPosition < hopPosition && channelTrack < hopTrack, "the thread hops add to the channel's cost");
+
+    std::printf("%s\n", g_failures == 0 ? "all checks passed" : "FAILED");
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,307 @@
+/*
+ * Harness for the plugin's C ABI, written in C so smtc_c_api.h is checked
+ * the way dart:ffi and other foreign callers see it. Runs against the
+ * stand-in SmtcWindows of smtc_windows_stub.cpp, which records what each
+ * call committed and raises SMTC events on demand. Checks creation and its
+ * failure, NULL handling, status mapping, strings passed as pointer and
+ * length without a terminator, partial patches, both event delivery modes
+ * (callback and Dart port, with the latest-wins position mailbox), and
+ * swapping the event target while another thread raises events.
+ * Needs no Windows or Flutter headers. Compile this file as C99 and the rest
+ * as C++17, all with -Ismtc_windows and -pthread: tools/smtc_windows_stub.cpp
+ * and these sources from smtc_windows/: smtc_c_api, event_poster,
+ * artwork_pipeline, artwork_store, artwork_thumbnail, thumbnail_encoder,
+ * worker_pool, backend_watchdog, update_pipeline, player_state, string_pool,
+ * timeline_publisher, position_estimator, span_tracer, event_dispatcher,
+ * memory_budget and native_log.
+ *
+ * Usage: smtc_c_api_check [--swaps=N]
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "smtc_c_api.h"
+#include "smtc_windows_stub.h"
+
+static int g_failures = 0;
+
+static void Check(bool ok, const char* what) {
+    printf("%s  %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok) ++g_failures;
+}
+
+/* Events received through SmtcEventCallback */
+typedef struct Received {
+    int count;
+    int32_t event;
+    int64_t arg;
+    void* user;
+} Received;
+
+static void OnEvent(void* user, int32_t event, int64_t arg) {
+    Received* received = (Received*)user;
+    ++received->count;
+    received->event = event;
+    received->arg = arg;
+    received->user = user;
+}
+
+/* Prefix of Dart_CObject from dart_native_api.h, as the Dart VM reads it */
+typedef struct DartCObject {
+    int32_t type;
+    union {
+        int64_t as_int64;
+        void* padding[5];
+    } value;
+} DartCObject;
+
+enum { kDartCObjectInt64 = 3 };
+
+/* Stands in for Dart_PostCObject: records what reached the port */
+static atomic_int g_posted;
+static int64_t g_lastPort;
+static int64_t g_lastMessage;
+static int32_t g_lastType;
+
+static bool FakePostCObject(int64_t port, void* message) {
+    const DartCObject* object = (const DartCObject*)message;
+    g_lastPort = port;
+    g_lastType = object->type;
+    g_lastMessage = object->value.as_int64;
+    atomic_fetch_add(&g_posted, 1);
+    return true;
+}
+
+/* The ABI takes Dart_PostCObject as a data pointer, the way dart:ffi hands
+ * out NativeApi.postCObject; ISO C has no cast between the two */
+static void* PostCObjectAddress(void) {
+    bool (*function)(int64_t, void*) = FakePostCObject;
+    void* address;
+    memcpy(&address, &function, sizeof(address));
+    return address;
+}
+
+static int32_t EventOf(int64_t message) {
+    return (int32_t)(message >> 56);
+}
+
+static void CheckCreation(void) {
+    Check(smtc_create(SMTC_STUB_FAILING_IDENTITY, strlen(SMTC_STUB_FAILING_IDENTITY)) == NULL,
+          "smtc_create returns NULL when the controls can't be set up");
+
+    SmtcSession* session = smtc_create(NULL, 0);
+    Check(session != NULL, "smtc_create with no identity uses the default");
+    smtc_destroy(session);
+    smtc_destroy(NULL);
+}
+
+static void CheckNullHandling(void) {
+    SmtcStatePatch patch;
+    SmtcUpdateStats updates;
+    SmtcMemoryStats memory;
+    int64_t position = 0;
+    memset(&patch, 0, sizeof(patch));
+
+    bool allZero = smtc_update_status(NULL, SMTC_STATUS_PLAYING) == 0 &&
+                   smtc_update_metadata(NULL, "a", 1, NULL, 0, NULL, 0, 0, NULL, 0) == 0 &&
+                   smtc_update_timeline(NULL, 0, 0, 1.0) == 0 && smtc_apply_state(NULL, &patch) == 0 &&
+                   smtc_get_update_stats(NULL, &updates) == 0 && smtc_get_memory_stats(NULL, &memory) == 0 &&
+                   smtc_set_memory_limits(NULL, 0, 0, 0) == 0 && smtc_set_thumbnail_budget(NULL, 0, 0) == 0 &&
+                   smtc_prefetch_artwork(NULL, "a", 1) == 0 && smtc_take_position(NULL, &position) == 0;
+    smtc_set_event_callback(NULL, OnEvent, NULL);
+    smtc_set_event_port(NULL, NULL, 0);
+    Check(allZero, "every call on a NULL session returns 0");
+
+    SmtcSession* session = smtc_create("check", 5);
+    Check(smtc_apply_state(session, NULL) == 0 && smtc_get_update_stats(session, NULL) == 0 &&
+              smtc_get_memory_stats(session, NULL) == 0 && smtc_take_position(session, NULL) == 0 &&
+              smtc_update_metadata(session, NULL, 0, NULL, 0, NULL, 0, 0, NULL, 0) == 0 &&
+              smtc_set_memory_limits(session, 0, 0, -1) == 0,
+          "NULL or out-of-range arguments are rejected");
+    smtc_destroy(session);
+}
+
+static void CheckUpdates(void) {
+    SmtcSession* session = smtc_create("check", 5);
+    SmtcStubRecord record;
+
+    smtc_update_status(session, SMTC_STATUS_PAUSED);
+    smtc_stub_get_record(session, &record);
+    Check(record.status == SMTC_STATUS_PAUSED && record.last_fields == SMTC_FIELD_STATUS,
+          "smtc_update_status commits the status alone");
+    smtc_update_status(session, 42);
+    smtc_stub_get_record(session, &record);
+    Check(record.status == SMTC_STATUS_CLOSED, "an unknown status maps to closed");
+
+    /* Lengths, not terminators, end the strings; UTF-8 passes through */
+    const char buffer[] = "Title and more|Art\xc3\xafst|Album|file:///a.png";
+    smtc_update_metadata(session, buffer, 5, buffer + 15, 7, buffer + 23, 5, 180000000, buffer + 29, 13);
+    smtc_stub_get_record(session, &record);
+    Check(strcmp(record.title, "Title") == 0 && record.title_length == 5 &&
+              strcmp(record.artist, "Art\xc3\xafst") == 0 && strcmp(record.album, "Album") == 0 &&
+              strcmp(record.art_url, "file:///a.png") == 0 && record.duration == 180000000,
+          "strings are taken by pointer and byte length");
+
+    smtc_update_timeline(session, 5000000, 180000000, 1.5);
+    smtc_stub_get_record(session, &record);
+    Check(record.position == 5000000 && record.rate == 1.5 && record.last_fields == SMTC_FIELD_TIMELINE,
+          "smtc_update_timeline commits the timeline alone");
+
+    /* A patch touches only the groups it flags, in one commit */
+    uint64_t commits = record.commits;
+    SmtcStatePatch patch;
+    memset(&patch, 0, sizeof(patch));
+    patch.fields = SMTC_FIELD_STATUS | SMTC_FIELD_BUTTONS;
+    patch.status = SMTC_STATUS_PLAYING;
+    patch.enabled_buttons = SMTC_BUTTON_PAUSE | SMTC_BUTTON_NEXT;
+    patch.title = "ignored";
+    patch.title_length = 7;
+    Check(smtc_apply_state(session, &patch) == 1, "smtc_apply_state accepts a patch");
+    smtc_stub_get_record(session, &record);
+    Check(record.commits == commits + 1 && record.last_fields == (SMTC_FIELD_STATUS | SMTC_FIELD_BUTTONS) &&
+              record.status == SMTC_STATUS_PLAYING && record.enabled_buttons == (SMTC_BUTTON_PAUSE | SMTC_BUTTON_NEXT) &&
+              strcmp(record.title, "Title") == 0,
+          "a patch commits once and leaves unflagged groups alone");
+
+    SmtcUpdateStats stats;
+    Check(smtc_get_update_stats(session, &stats) == 1 && stats.committed == record.commits && stats.healthy == 1,
+          "smtc_get_update_stats reports the commits");
+    smtc_destroy(session);
+}
+
+static void CheckCallback(void) {
+    SmtcSession* session = smtc_create("check", 5);
+    Received received;
+    memset(&received, 0, sizeof(received));
+
+    smtc_set_event_callback(session, OnEvent, &received);
+    smtc_stub_press(session, "pause");
+    Check(received.count == 1 && received.event == SMTC_EVENT_PAUSE && received.arg == 0 &&
+              received.user == &received,
+          "a button press reaches the callback with its user pointer");
+    smtc_stub_press(session, "rewind");
+    Check(received.count == 1, "commands without an event code are not delivered");
+    smtc_stub_seek(session, 42000000);
+    Check(received.count == 2 && received.event == SMTC_EVENT_POSITION && received.arg == 42000000,
+          "a seek request carries its position");
+
+    smtc_set_event_callback(session, NULL, NULL);
+    Check(smtc_stub_press(session, "play") == 0 && received.count == 2, "a NULL callback stops events");
+    smtc_destroy(session);
+}
+
+static void CheckPort(void) {
+    SmtcSession* session = smtc_create("check", 5);
+    Received received;
+    memset(&received, 0, sizeof(received));
+    atomic_store(&g_posted, 0);
+
+    smtc_set_event_callback(session, OnEvent, &received);
+    smtc_set_event_port(session, PostCObjectAddress(), 77);
+    smtc_stub_press(session, "next");
+    Check(received.count == 0 && atomic_load(&g_posted) == 1 && g_lastPort == 77 &&
+              g_lastType == kDartCObjectInt64 && EventOf(g_lastMessage) == SMTC_EVENT_NEXT,
+          "a port replaces the callback and gets int64 messages");
+
+    /* A scrub wakes the port once; the mailbox keeps the newest position */
+    for (int64_t position = 1; position <= 100; ++position) smtc_stub_seek(session, position * 1000);
+    Check(atomic_load(&g_posted) == 2 && EventOf(g_lastMessage) == SMTC_EVENT_POSITION_PENDING,
+          "a burst of seeks posts one positionPending");
+    int64_t position = 0;
+    Check(smtc_take_position(session, &position) == 1 && position == 100000, "the newest position is taken");
+    Check(smtc_take_position(session, &position) == 0, "the mailbox is then empty");
+    smtc_stub_seek(session, 7);
+    Check(atomic_load(&g_posted) == 3, "the next seek wakes the port again");
+
+    smtc_set_event_port(session, NULL, 0);
+    Check(smtc_stub_press(session, "play") == 0 && smtc_take_position(session, &position) == 0,
+          "a NULL port stops events and drops the mailbox");
+    smtc_destroy(session);
+}
+
+/* Raises events until told to stop, like the SMTC event thread */
+typedef struct Raiser {
+    SmtcSession* session;
+    atomic_bool stop;
+    uint64_t raised;
+} Raiser;
+
+static void* RaiseEvents(void* argument) {
+    Raiser* raiser = (Raiser*)argument;
+    while (!atomic_load(&raiser->stop)) {
+        smtc_stub_press(raiser->session, "play");
+        smtc_stub_seek(raiser->session, (int64_t)raiser->raised);
+        ++raiser->raised;
+    }
+    return NULL;
+}
+
+static void CheckSwaps(int swaps) {
+    SmtcSession* session = smtc_create("check", 5);
+    Received received;
+    memset(&received, 0, sizeof(received));
+
+    Raiser raiser;
+    raiser.session = session;
+    atomic_init(&raiser.stop, false);
+    raiser.raised = 0;
+    pthread_t thread;
+    pthread_create(&thread, NULL, RaiseEvents, &raiser);
+
+    /* The callback is only ever called from the raising thread, so
+     * `received` needs no lock; the port targets in between make the
+     * session build and drop its sink under the raiser */
+    int64_t position;
+    for (int i = 0; i < swaps; ++i) {
+        switch (i % 3) {
+            case 0:
+                smtc_set_event_port(session, PostCObjectAddress(), 5);
+                break;
+            case 1:
+                smtc_take_position(session, &position);
+                smtc_set_event_callback(session, OnEvent, &received);
+                break;
+            default:
+                smtc_set_event_port(session, NULL, 0);
+                break;
+        }
+    }
+    atomic_store(&raiser.stop, true);
+    pthread_join(thread, NULL);
+    smtc_destroy(session);
+
+    printf("  %d swaps while %llu event pairs were raised\n", swaps, (unsigned long long)raiser.raised);
+    Check(raiser.raised > 0, "targets can be swapped while events are raised");
+}
+
+int main(int argc, char** argv) {
+    int swaps = 30000;
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--swaps=", 8) == 0) {
+            swaps = atoi(argv[i] + 8);
+        } else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (swaps <= 0) {
+        fprintf(stderr, "--swaps must be positive\n");
+        return 2;
+    }
+
+    CheckCreation();
+    CheckNullHandling();
+    CheckUpdates();
+    CheckCallback();
+    CheckPort();
+    CheckSwaps(swaps);
+
+    printf("%s\n", g_failures == 0 ? "all checks passed" : "FAILED");
+    return g_failures == 0 ? 0 : 1;
+}
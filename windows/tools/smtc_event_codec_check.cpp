@@ -0,0 +1,154 @@
+// Checks that EncodeEventEnvelope writes exactly the bytes
+// StandardMethodCodec::EncodeSuccessEnvelope writes for the event map the
+// plugin used to build ({type, controlType?, timestamp}), for control and
+// position events, over a spread of control names and timestamps. Dart
+// decodes these bytes with the standard codec, so any difference corrupts
+// every event after it.
+// Builds against the stand-in codec in tools/flutter_stub, which encodes the
+// way the embedder's StandardCodecSerializer does, or against the embedder's
+// own headers. Build it as C++17 with -Ismtc_windows, -Itools/flutter_stub
+// and -pthread, together with these sources from smtc_windows/:
+// event_dispatcher, span_tracer, memory_budget and native_log.
+//
+// Usage: smtc_event_codec_check [--iterations=N]
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <flutter/encodable_value.h>
+#include <flutter/standard_method_codec.h>
+
+#include "event_dispatcher.h"
+
+using flutter::EncodableMap;
+using flutter::EncodableValue;
+using namespace audio_service_smtc;
+
+namespace {
+
+int g_failures = 0;
+
+void Check(bool ok, const char* what) {
+    std::printf("%s  %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok) ++g_failures;
+}
+
+// xorshift64*, fixed seed so failures reproduce
+class Random {
+public:
+    uint64_t Next() {
+        _state ^= _state >> 12;
+        _state ^= _state << 25;
+        _state ^= _state >> 27;
+        return _state * 0x2545F4914F6CDD1DULL;
+    }
+
+private:
+    uint64_t _state = 0x9E3779B97F4A7C15ULL;
+};
+
+// The map SendEvent built before the event was encoded by hand
+std::vector<uint8_t> CodecBytes(const NativeEvent& event) {
+    EncodableMap args;
+    if (event.kind == NativeEventKind::kControl) {
+        args[EncodableValue("type")] = EncodableValue("control");
+        args[EncodableValue("controlType")] = EncodableValue(event.control);
+    } else {
+        args[EncodableValue("type")] = EncodableValue("positionPending");
+    }
+    args[EncodableValue("timestamp")] = EncodableValue(event.timestamp);
+    EncodableValue value(args);
+    return *flutter::StandardMethodCodec::GetInstance().EncodeSuccessEnvelope(&value);
+}
+
+void PrintFirstDifference(const std::vector<uint8_t>& ours, const std::vector<uint8_t>& codec) {
+    size_t at = 0;
+    while (at < ours.size() && at < codec.size() && ours[at] == codec[at]) ++at;
+    std::printf("      sizes %zu vs %zu, first difference at byte %zu\n", ours.size(), codec.size(), at);
+}
+
+// True if every event matched
+bool CompareAll(const std::vector<NativeEvent>& events) {
+    std::vector<uint8_t> ours;
+    for (const NativeEvent& event : events) {
+        EncodeEventEnvelope(event, &ours);
+        std::vector<uint8_t> codec = CodecBytes(event);
+        if (ours != codec) {
+            PrintFirstDifference(ours, codec);
+            return false;
+        }
+    }
+    return true;
+}
+
+NativeEvent Control(const std::string& name, int64_t timestamp) {
+    NativeEvent event;
+    event.kind = NativeEventKind::kControl;
+    event.control = name;
+    event.timestamp = timestamp;
+    return event;
+}
+
+NativeEvent Position(int64_t position, int64_t timestamp) {
+    NativeEvent event;
+    event.kind = NativeEventKind::kPosition;
+    event.position = position;
+    event.timestamp = timestamp;
+    return event;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int iterations = 20000;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--iterations=", 13) == 0) iterations = std::atoi(argv[i] + 13);
+    }
+
+    const int64_t now = MonotonicMicros();
+
+    // Every control name the handlers post, at the clock's current value
+    std::vector<NativeEvent> controls;
+    for (const char* name : { "play", "pause", "next", "previous", "stop" }) {
+        controls.push_back(Control(name, now));
+    }
+    Check(CompareAll(controls), "control events match the codec");
+
+    Check(CompareAll({ Position(0, now), Position(3'600'000'000, now) }), "position events match the codec");
+
+    // Timestamps whose bytes would be mistaken for padding or a size escape
+    std::vector<NativeEvent> edges;
+    for (int64_t timestamp : { int64_t(0), int64_t(-1), int64_t(1) << 62, INT64_MAX, INT64_MIN, int64_t(0xFE), int64_t(0xFF) }) {
+        edges.push_back(Control("pause", timestamp));
+        edges.push_back(Position(0, timestamp));
+    }
+    Check(CompareAll(edges), "edge timestamps match the codec");
+
+    // Names of every length up to past both size escapes, which shifts where
+    // the timestamp lands relative to an 8-byte boundary
+    std::vector<NativeEvent> lengths;
+    for (size_t length : { size_t(0), size_t(1), size_t(7), size_t(253), size_t(254), size_t(255), size_t(0xFFFF), size_t(0x10000) }) {
+        lengths.push_back(Control(std::string(length, 'x'), now));
+    }
+    for (size_t length = 0; length < 64; ++length) lengths.push_back(Control(std::string(length, 'y'), now));
+    Check(CompareAll(lengths), "control names of every length match the codec");
+
+    Random random;
+    std::vector<NativeEvent> mixed;
+    for (int i = 0; i < iterations; ++i) {
+        int64_t timestamp = static_cast<int64_t>(random.Next());
+        if (random.Next() % 2 == 0) {
+            mixed.push_back(Position(static_cast<int64_t>(random.Next() >> 20), timestamp));
+        } else {
+            mixed.push_back(Control(std::string(random.Next() % 40, static_cast<char>('a' + random.Next() % 26)), timestamp));
+        }
+    }
+    Check(CompareAll(mixed), "random events match the codec");
+
+    std::printf("%s\n", g_failures == 0 ? "all checks passed" : "FAILED");
+    return g_failures == 0 ? 0 : 1;
+}
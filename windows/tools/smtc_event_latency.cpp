@@ -0,0 +1,386 @@
+// Measures how long a media button press takes to reach Dart: presses are
+// injected where SMTC raises ButtonPressed and timed until the encoded event
+// reaches a fake BinaryMessenger. Everything between is the plugin's own code
+// (timeline publisher, position mailbox, event dispatcher and encoder) wired
+// the way SMTCHandlerImpl, SmtcWindows, smtc_c_api and the plugin wire it.
+// Needs no Windows or Flutter headers. Build it as C++17 with -Ismtc_windows
+// and -pthread, together with these sources from smtc_windows/:
+// event_dispatcher, timeline_publisher, position_estimator, update_pipeline,
+// player_state, string_pool, span_tracer, memory_budget and native_log.
+//
+// Scenarios, each run with the same presses:
+//   idle       nothing else going on
+//   metadata   threads submitting state updates to a slow backend
+//   positions  a seek bar being dragged, one position request after another
+//
+// Usage: smtc_event_latency [--scenario=all|idle|metadata|positions]
+//                           [--presses=N] [--interval-us=N]
+//                           [--load-threads=N] [--backend-delay-us=N]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "event_dispatcher.h"
+#include "player_state.h"
+#include "position_mailbox.h"
+#include "timeline_publisher.h"
+#include "update_pipeline.h"
+
+using audio_service_smtc::EncodeEventEnvelope;
+using audio_service_smtc::EventDispatcher;
+using audio_service_smtc::MediaMetadata;
+using audio_service_smtc::NativeEvent;
+using audio_service_smtc::PlaybackState;
+using audio_service_smtc::PlayerStatePatch;
+using audio_service_smtc::PlayerStateStore;
+using audio_service_smtc::PositionMailbox;
+using audio_service_smtc::TimelinePublisher;
+using audio_service_smtc::TimelineSnapshot;
+using audio_service_smtc::UpdatePipeline;
+
+namespace {
+
+// Event codes as in smtc_c_api.h
+constexpr int32_t kEventPlay = 1;
+constexpr int32_t kEventPause = 2;
+constexpr int32_t kEventNext = 3;
+constexpr int32_t kEventPrevious = 4;
+constexpr int32_t kEventStop = 5;
+constexpr int32_t kEventPosition = 6;
+
+enum class Button { kPlay, kPause, kNext, kPrevious, kStop };
+
+int64_t Nanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void SpinFor(int64_t micros) {
+    int64_t until = Nanos() + micros * 1000;
+    while (Nanos() < until) {}
+}
+
+// Stands in for SMTCHandlerImpl: the ButtonPressed and
+// PlaybackPositionChangeRequested handlers, minus WinRT
+class FakeBackend {
+public:
+    void SetControlCallback(std::function<void(const std::string&)> callback) {
+        std::lock_guard<std::mutex> lock(_callbackMutex);
+        _controlCallback = std::move(callback);
+    }
+
+    void SetPositionCallback(std::function<void(int64_t)> callback) {
+        std::lock_guard<std::mutex> lock(_callbackMutex);
+        _positionCallback = std::move(callback);
+    }
+
+    void Press(Button button) {
+        std::string command;
+        switch (button) {
+        case Button::kPlay:
+            command = "play";
+            break;
+        case Button::kPause:
+            command = "pause";
+            break;
+        case Button::kNext:
+            command = "next";
+            break;
+        case Button::kPrevious:
+            command = "previous";
+            break;
+        case Button::kStop:
+            command = "stop";
+            break;
+        }
+
+        std::lock_guard<std::mutex> lock(_callbackMutex);
+        if (_controlCallback) _controlCallback(command);
+    }
+
+    void RequestPosition(int64_t positionMicroseconds) {
+        std::lock_guard<std::mutex> lock(_callbackMutex);
+        if (_positionCallback) _positionCallback(positionMicroseconds);
+    }
+
+private:
+    std::function<void(const std::string&)> _controlCallback;
+    std::function<void(int64_t)> _positionCallback;
+    std::mutex _callbackMutex;
+};
+
+int32_t ControlEvent(const std::string& command) {
+    if (command == "play") return kEventPlay;
+    if (command == "pause") return kEventPause;
+    if (command == "next") return kEventNext;
+    if (command == "previous") return kEventPrevious;
+    if (command == "stop") return kEventStop;
+    return 0;
+}
+
+struct Options {
+    int presses = 20000;
+    int64_t intervalMicros = 200;
+    int loadThreads = 2;
+    int64_t backendDelayMicros = 200;
+};
+
+struct Report {
+    uint64_t presses = 0;
+    uint64_t delivered = 0;
+    bool inOrder = true;
+    uint64_t positionsRequested = 0;
+    uint64_t positionsDelivered = 0;
+    uint64_t stateCommits = 0;
+    std::vector<int64_t> latencies;   // nanoseconds, sorted
+};
+
+// The plugin and the stack under it for one run. The messenger is fake: it
+// checks each message is a control or position event and timestamps it.
+class Harness {
+public:
+    Harness(const Options& options, int presses)
+        : _timeline([](const TimelineSnapshot&) {}),
+          _pipeline([this, delay = options.backendDelayMicros](const PlayerStatePatch& patch) {
+              // The backend thread holds the session lock across the WinRT
+              // calls, as SmtcWindows::CommitState does
+              std::lock_guard<std::mutex> lock(_sessionMutex);
+              _state.Apply(patch);
+              SpinFor(delay);
+          }),
+          _dispatcher([this](const NativeEvent& event) { SendEvent(event); }),
+          _pressedAt(presses, 0),
+          _deliveredAt(presses, 0) {
+        _timeline.SetPlaybackState(PlaybackState::kPlaying);
+
+        // SmtcWindows wraps both callbacks so activity keeps the timeline hot
+        std::function<void(int32_t, int64_t)> onEvent = [this](int32_t event, int64_t arg) { OnSmtcEvent(event, arg); };
+        _backend.SetControlCallback([this, onEvent](const std::string& command) {
+            _timeline.NoteSurfaceActivity();
+            int32_t event = ControlEvent(command);
+            if (event != 0) onEvent(event, 0);
+        });
+        _backend.SetPositionCallback([this, onEvent](int64_t position) {
+            _timeline.NoteSurfaceActivity();
+            onEvent(kEventPosition, position);
+        });
+    }
+
+    ~Harness() {
+        _backend.SetControlCallback(nullptr);
+        _backend.SetPositionCallback(nullptr);
+    }
+
+    void Press(int index, Button button) {
+        _pressedAt[index] = Nanos();
+        _backend.Press(button);
+    }
+
+    FakeBackend& backend() { return _backend; }
+    UpdatePipeline& pipeline() { return _pipeline; }
+
+    void Finish(Report* report) {
+        _pipeline.Flush();
+        report->stateCommits = _pipeline.Stats().committed;
+        report->delivered = _delivered.load();
+        report->inOrder = _inOrder;
+        report->positionsDelivered = _positions.load();
+        for (uint64_t i = 0; i < report->delivered; ++i) {
+            report->latencies.push_back(_deliveredAt[i] - _pressedAt[i]);
+        }
+        std::sort(report->latencies.begin(), report->latencies.end());
+    }
+
+private:
+    // AudioServiceSmtcPlugin::OnSmtcEvent and what it calls
+    void OnSmtcEvent(int32_t event, int64_t arg) {
+        switch (event) {
+        case kEventPlay:
+            _dispatcher.PostControl("play");
+            break;
+        case kEventPause:
+            _dispatcher.PostControl("pause");
+            break;
+        case kEventNext:
+            _dispatcher.PostControl("next");
+            break;
+        case kEventPrevious:
+            _dispatcher.PostControl("previous");
+            break;
+        case kEventStop:
+            _dispatcher.PostControl("stop");
+            break;
+        case kEventPosition:
+            if (_mailbox.Post(arg)) _dispatcher.PostPosition(arg);
+            break;
+        }
+    }
+
+    // AudioServiceSmtcPlugin::SendEvent into the fake messenger
+    void SendEvent(const NativeEvent& event) {
+        EncodeEventEnvelope(event, &_buffer);
+        // The engine copies the message before handing it to the platform thread
+        std::vector<uint8_t> message(_buffer);
+        int64_t now = Nanos();
+
+        // Byte 2 is the map's size: three entries for a control event
+        if (message.size() > 2 && message[2] == 3) {
+            uint64_t index = _delivered.load(std::memory_order_relaxed);
+            if (index < _deliveredAt.size()) {
+                _deliveredAt[index] = now;
+                if (event.control != kExpected[index % 5]) _inOrder = false;
+                _delivered.store(index + 1, std::memory_order_release);
+            }
+        } else {
+            // Dart drains the mailbox when woken, which re-arms it
+            int64_t position;
+            if (_mailbox.Take(&position)) _positions.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    static constexpr const char* kExpected[5] = { "play", "pause", "next", "previous", "stop" };
+
+    FakeBackend _backend;
+    TimelinePublisher _timeline;
+    std::mutex _sessionMutex;
+    PlayerStateStore _state;
+    UpdatePipeline _pipeline;
+    PositionMailbox _mailbox;
+    EventDispatcher _dispatcher;
+    std::vector<uint8_t> _buffer;
+    std::vector<int64_t> _pressedAt;
+    std::vector<int64_t> _deliveredAt;
+    std::atomic<uint64_t> _delivered{ 0 };
+    std::atomic<uint64_t> _positions{ 0 };
+    bool _inOrder = true;
+};
+
+constexpr const char* Harness::kExpected[5];
+
+Report Run(const std::string& scenario, const Options& options) {
+    Report report;
+    Harness harness(options, options.presses);
+
+    std::atomic<bool> stop{ false };
+    std::vector<std::thread> load;
+    std::atomic<uint64_t> positionsRequested{ 0 };
+
+    if (scenario == "metadata") {
+        for (int t = 0; t < options.loadThreads; ++t) {
+            load.emplace_back([&, t] {
+                static const char* kArtists[] = { "Boards of Canada", "Aphex Twin", "Autechre" };
+                uint64_t n = 0;
+                while (!stop.load(std::memory_order_relaxed)) {
+                    PlayerStatePatch patch;
+                    patch.status = (n & 1) ? PlaybackState::kPaused : PlaybackState::kPlaying;
+                    patch.metadata = MediaMetadata{ "Track " + std::to_string(t * 1000000 + n), kArtists[n % 3],
+                                                    "Album", "", 240000000 };
+                    patch.timeline = TimelineSnapshot{ static_cast<int64_t>(n % 240) * 1000000, 240000000, 1.0 };
+                    harness.pipeline().Submit(patch);
+                    ++n;
+                    std::this_thread::yield();
+                }
+            });
+        }
+    } else if (scenario == "positions") {
+        load.emplace_back([&] {
+            int64_t position = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                harness.backend().RequestPosition(position);
+                position = (position + 16000) % 240000000;
+                positionsRequested.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    int64_t next = Nanos();
+    for (int i = 0; i < options.presses; ++i) {
+        next += options.intervalMicros * 1000;
+        while (Nanos() < next) std::this_thread::yield();
+        harness.Press(i, static_cast<Button>(i % 5));
+    }
+
+    stop = true;
+    for (std::thread& thread : load) thread.join();
+    report.presses = static_cast<uint64_t>(options.presses);
+    report.positionsRequested = positionsRequested.load();
+    harness.Finish(&report);
+    return report;
+}
+
+double Micros(const std::vector<int64_t>& sorted, double fraction) {
+    if (sorted.empty()) return 0;
+    size_t index = static_cast<size_t>(fraction * static_cast<double>(sorted.size() - 1));
+    return static_cast<double>(sorted[index]) / 1000.0;
+}
+
+void Print(const std::string& scenario, const Report& report) {
+    const std::vector<int64_t>& l = report.latencies;
+    std::printf("%-10s delivered %llu/%llu%s  p50 %.1f us  p90 %.1f us  p99 %.1f us  p99.9 %.1f us  max %.1f us\n",
+        scenario.c_str(), static_cast<unsigned long long>(report.delivered),
+        static_cast<unsigned long long>(report.presses), report.inOrder ? "" : " OUT OF ORDER",
+        Micros(l, 0.5), Micros(l, 0.9), Micros(l, 0.99), Micros(l, 0.999), Micros(l, 1.0));
+    if (report.positionsRequested > 0) {
+        std::printf("%-10s positions requested %llu, delivered %llu\n", "",
+            static_cast<unsigned long long>(report.positionsRequested),
+            static_cast<unsigned long long>(report.positionsDelivered));
+    }
+    if (scenario == "metadata") {
+        std::printf("%-10s state commits %llu\n", "", static_cast<unsigned long long>(report.stateCommits));
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    std::string scenario = "all";
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--scenario=", 11) == 0) {
+            scenario = argv[i] + 11;
+        } else if (std::strncmp(argv[i], "--presses=", 10) == 0) {
+            options.presses = std::atoi(argv[i] + 10);
+        } else if (std::strncmp(argv[i], "--interval-us=", 14) == 0) {
+            options.intervalMicros = std::atoll(argv[i] + 14);
+        } else if (std::strncmp(argv[i], "--load-threads=", 15) == 0) {
+            options.loadThreads = std::atoi(argv[i] + 15);
+        } else if (std::strncmp(argv[i], "--backend-delay-us=", 19) == 0) {
+            options.backendDelayMicros = std::atoll(argv[i] + 19);
+        } else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (options.presses <= 0) {
+        std::fprintf(stderr, "--presses must be positive\n");
+        return 2;
+    }
+
+    std::vector<std::string> scenarios;
+    if (scenario == "all") {
+        scenarios = { "idle", "metadata", "positions" };
+    } else if (scenario == "idle" || scenario == "metadata" || scenario == "positions") {
+        scenarios = { scenario };
+    } else {
+        std::fprintf(stderr, "unknown scenario %s\n", scenario.c_str());
+        return 2;
+    }
+
+    bool ok = true;
+    for (const std::string& name : scenarios) {
+        Report report = Run(name, options);
+        Print(name, report);
+        ok = ok && report.delivered == report.presses && report.inOrder;
+    }
+    return ok ? 0 : 1;
+}
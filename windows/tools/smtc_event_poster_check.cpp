@@ -0,0 +1,239 @@
+// Unit test for port event delivery. A stub EventPoster records what
+// PortEventSink would post to a Dart ReceivePort, and a fake
+// Dart_PostCObject checks what DartPortPoster hands the VM. Checks the
+// message encoding against the decoding SmtcEventCode.decode does in Dart,
+// that controls post one message each, that a burst of seek requests posts
+// a single positionPending and leaves the newest position to take, and,
+// with a control thread, a seek thread and a Dart-side drainer running
+// together, that no control is lost or reordered and the last seek lands.
+// Needs no Windows or Flutter headers. Build it as C++17 with -Ismtc_windows
+// and -pthread, together with these sources from smtc_windows/:
+// event_poster, span_tracer, event_dispatcher, memory_budget and native_log.
+//
+// Usage: smtc_event_poster_check [--posts=N]
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "event_poster.h"
+#include "smtc_c_api.h"
+
+using namespace audio_service_smtc;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+int g_failures = 0;
+
+void Check(bool ok, const char* what) {
+    std::printf("%s  %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok) ++g_failures;
+}
+
+// SmtcEventCode.decode in lib/src/smtc_ffi.dart
+int32_t DecodeEvent(int64_t message) {
+    return static_cast<int32_t>(message >> 56);
+}
+
+int64_t DecodeArg(int64_t message) {
+    return message & ((int64_t{ 1 } << 56) - 1);
+}
+
+// Records every message, from any thread
+class StubPoster final : public EventPoster {
+public:
+    bool Post(int64_t message) override {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _messages.push_back(message);
+        return true;
+    }
+
+    std::vector<int64_t> Messages() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _messages;
+    }
+
+private:
+    std::mutex _mutex;
+    std::vector<int64_t> _messages;
+};
+
+// Prefix of Dart_CObject from dart_native_api.h, as the VM reads it
+struct DartCObject {
+    int32_t type;
+    union {
+        int64_t asInt64;
+        void* padding[5];
+    } value;
+};
+
+constexpr int32_t kDartCObjectInt64 = 3;
+
+int64_t g_postedPort = 0;
+DartCObject g_posted = {};
+bool g_accept = true;
+
+bool FakePostCObject(int64_t port, void* message) {
+    g_postedPort = port;
+    std::memcpy(&g_posted, message, sizeof(g_posted));
+    return g_accept;
+}
+
+void CheckEncoding() {
+    const int64_t args[] = { 0, 1, 42000000, (int64_t{ 1 } << 56) - 1 };
+    const int32_t events[] = { SMTC_EVENT_PLAY, SMTC_EVENT_STOP, SMTC_EVENT_POSITION, SMTC_EVENT_POSITION_PENDING };
+    bool roundTrips = true;
+    for (int32_t event : events) {
+        for (int64_t arg : args) {
+            int64_t message = EncodePortEvent(event, arg);
+            roundTrips = roundTrips && message >= 0 && DecodeEvent(message) == event && DecodeArg(message) == arg;
+        }
+    }
+    Check(roundTrips, "event code and argument survive Dart's decoding");
+    Check(DecodeEvent(EncodePortEvent(SMTC_EVENT_PAUSE, int64_t{ 1 } << 56)) == SMTC_EVENT_PAUSE,
+          "an argument too wide for 56 bits never corrupts the event code");
+}
+
+void CheckDartPoster() {
+    DartPortPoster poster(&FakePostCObject, 1234);
+    g_accept = true;
+    bool posted = poster.Post(EncodePortEvent(SMTC_EVENT_NEXT, 0));
+    Check(posted && g_postedPort == 1234 && g_posted.type == kDartCObjectInt64 &&
+              DecodeEvent(g_posted.value.asInt64) == SMTC_EVENT_NEXT,
+          "DartPortPoster posts an int64 object to its port");
+    g_accept = false;
+    Check(!poster.Post(EncodePortEvent(SMTC_EVENT_NEXT, 0)), "a closed port is reported");
+    g_accept = true;
+}
+
+void CheckSink() {
+    auto owned = std::make_unique<StubPoster>();
+    StubPoster* poster = owned.get();
+    PortEventSink sink(std::move(owned));
+
+    sink.PostControl(SMTC_EVENT_PAUSE);
+    sink.PostControl(SMTC_EVENT_PLAY);
+    std::vector<int64_t> messages = poster->Messages();
+    Check(messages.size() == 2 && DecodeEvent(messages[0]) == SMTC_EVENT_PAUSE &&
+              DecodeEvent(messages[1]) == SMTC_EVENT_PLAY,
+          "each control posts one message, in order");
+
+    for (int64_t position = 1; position <= 1000; ++position) sink.PostPosition(position * 1000);
+    messages = poster->Messages();
+    Check(messages.size() == 3 && DecodeEvent(messages[2]) == SMTC_EVENT_POSITION_PENDING,
+          "a burst of seeks posts one positionPending");
+    int64_t position = 0;
+    Check(sink.TakePosition(&position) && position == 1000000, "the newest position is taken");
+    Check(!sink.TakePosition(&position), "then the mailbox is empty");
+    sink.PostPosition(5);
+    Check(poster->Messages().size() == 4, "the next seek wakes Dart again");
+}
+
+void CheckConcurrent(int posts) {
+    auto owned = std::make_unique<StubPoster>();
+    StubPoster* poster = owned.get();
+    PortEventSink sink(std::move(owned));
+
+    std::atomic<bool> seeksDone{ false };
+    std::atomic<uint64_t> taken{ 0 };
+    std::atomic<int64_t> lastTaken{ -1 };
+    std::atomic<bool> inOrder{ true };
+
+    // The Dart isolate: drains the mailbox whenever it looks
+    std::thread drainer([&] {
+        for (;;) {
+            bool finished = seeksDone.load();
+            int64_t position;
+            while (sink.TakePosition(&position)) {
+                if (position <= lastTaken.load()) inOrder.store(false);
+                lastTaken.store(position);
+                taken.fetch_add(1);
+            }
+            if (finished) return;
+            std::this_thread::yield();
+        }
+    });
+    std::thread controls([&] {
+        for (int i = 0; i < posts; ++i) {
+            sink.PostControl(i % 2 ? SMTC_EVENT_PLAY : SMTC_EVENT_PAUSE);
+            if (i % 64 == 0) std::this_thread::yield();
+        }
+    });
+    // Yields now and then so the threads interleave even on one core
+    std::thread seeks([&] {
+        for (int64_t i = 1; i <= posts; ++i) {
+            sink.PostPosition(i);
+            if (i % 16 == 0) std::this_thread::yield();
+        }
+        seeksDone.store(true);
+    });
+    controls.join();
+    seeks.join();
+    drainer.join();
+
+    std::vector<int64_t> messages = poster->Messages();
+    int controlCount = 0;
+    uint64_t pending = 0;
+    bool controlsInOrder = true;
+    for (int64_t message : messages) {
+        int32_t event = DecodeEvent(message);
+        if (event == SMTC_EVENT_POSITION_PENDING) {
+            ++pending;
+        } else {
+            int32_t expected = controlCount % 2 ? SMTC_EVENT_PLAY : SMTC_EVENT_PAUSE;
+            controlsInOrder = controlsInOrder && event == expected;
+            ++controlCount;
+        }
+    }
+    std::printf("  %d controls and %d seeks: %llu positionPending posted, %llu positions taken\n", posts, posts,
+                static_cast<unsigned long long>(pending), static_cast<unsigned long long>(taken.load()));
+    Check(controlCount == posts && controlsInOrder, "no control is lost or reordered");
+    Check(lastTaken.load() == posts && inOrder.load(), "seeks are taken in order and the last one lands");
+    Check(pending >= taken.load() && pending <= taken.load() + 1, "one positionPending per position taken");
+}
+
+void Measure(int posts) {
+    PortEventSink sink(std::make_unique<StubPoster>());
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < posts; ++i) sink.PostControl(SMTC_EVENT_PLAY);
+    double control = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / posts;
+    start = Clock::now();
+    for (int64_t i = 1; i <= posts; ++i) sink.PostPosition(i);
+    double position = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / posts;
+    std::printf("  per post: control %.0f ns, coalesced seek %.0f ns\n", control, position);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int posts = 200000;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--posts=", 8) == 0) {
+            posts = std::atoi(argv[i] + 8);
+        } else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (posts <= 0) {
+        std::fprintf(stderr, "--posts must be positive\n");
+        return 2;
+    }
+
+    CheckEncoding();
+    CheckDartPoster();
+    CheckSink();
+    CheckConcurrent(posts);
+    Measure(posts);
+
+    std::printf("%s\n", g_failures == 0 ? "all checks passed" : "FAILED");
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,377 @@
+// Checks the native memory accounting against the heap. Global operator
+// new/delete are replaced to count live heap bytes, and each subsystem is
+// driven on its own while the bytes it charged to MemoryBudget are compared
+// with what the heap actually grew by. Also checks that the artwork cache
+// keeps to its byte limit, that going over the budget trims it, that
+// artwork over the thumbnail budget is cached re-encoded, and that an idle
+// release frees cached buffers and worker threads.
+// Linux only (glibc's malloc_usable_size). Build it as C++17 with
+// -Ismtc_windows and -pthread, together with these sources from
+// smtc_windows/: memory_budget, artwork_pipeline, artwork_store,
+// artwork_thumbnail, thumbnail_encoder, worker_pool, update_pipeline,
+// player_state, string_pool, event_dispatcher, timeline_publisher,
+// position_estimator, utf16_transcode, span_tracer and native_log.
+//
+// Usage: smtc_memory_check
+
+#include <malloc.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "artwork_pipeline.h"
+#include "event_dispatcher.h"
+#include "memory_budget.h"
+#include "native_log.h"
+#include "string_pool.h"
+#include "update_pipeline.h"
+#include "utf16_transcode.h"
+#include "worker_pool.h"
+
+namespace {
+
+std::atomic<int64_t> g_heapBytes{ 0 };
+
+void* Allocate(size_t size) {
+    void* block = std::malloc(size == 0 ? 1 : size);
+    if (!block) throw std::bad_alloc();
+    g_heapBytes.fetch_add(static_cast<int64_t>(malloc_usable_size(block)), std::memory_order_relaxed);
+    return block;
+}
+
+void Free(void* block) {
+    if (!block) return;
+    g_heapBytes.fetch_sub(static_cast<int64_t>(malloc_usable_size(block)), std::memory_order_relaxed);
+    std::free(block);
+}
+
+}  // namespace
+
+void* operator new(size_t size) { return Allocate(size); }
+void* operator new[](size_t size) { return Allocate(size); }
+void operator delete(void* block) noexcept { Free(block); }
+void operator delete[](void* block) noexcept { Free(block); }
+void operator delete(void* block, size_t) noexcept { Free(block); }
+void operator delete[](void* block, size_t) noexcept { Free(block); }
+
+using audio_service_smtc::ArtworkImage;
+using audio_service_smtc::ArtworkPipeline;
+using audio_service_smtc::EventDispatcher;
+using audio_service_smtc::InternedString;
+using audio_service_smtc::MemoryBudget;
+using audio_service_smtc::MemoryCategory;
+using audio_service_smtc::NativeEvent;
+using audio_service_smtc::PlayerStatePatch;
+using audio_service_smtc::UpdatePipeline;
+using audio_service_smtc::WorkerPool;
+
+namespace {
+
+int g_failures = 0;
+
+void Check(bool ok, const char* what) {
+    std::printf("%s  %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok) ++g_failures;
+}
+
+int64_t Heap() { return g_heapBytes.load(std::memory_order_relaxed); }
+
+int64_t Charged(MemoryCategory category) {
+    return static_cast<int64_t>(MemoryBudget::Shared().Stats().byCategory[static_cast<size_t>(category)]);
+}
+
+int64_t Used() { return static_cast<int64_t>(MemoryBudget::Shared().Stats().used); }
+
+// Accounting is by capacity plus estimated node overhead, so it is held to
+// a tolerance rather than to the byte
+bool Close(int64_t charged, int64_t heap, double ratio, int64_t slack) {
+    int64_t diff = charged > heap ? charged - heap : heap - charged;
+    return diff <= static_cast<int64_t>(heap * ratio) + slack;
+}
+
+void Report(const char* what, int64_t charged, int64_t heap) {
+    std::printf("      %-10s charged %9lld B   heap %9lld B\n", what,
+                static_cast<long long>(charged), static_cast<long long>(heap));
+}
+
+bool WaitFor(const std::function<bool()>& done, std::chrono::milliseconds timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!done()) {
+        if (std::chrono::steady_clock::now() > deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    return true;
+}
+
+constexpr size_t kImageBytes = 200 * 1000;
+
+// Remote images of kImageBytes, so nothing is read from disk and no
+// placeholder is extracted
+bool FakeLoader(const std::string& url, size_t maxBytes, std::vector<uint8_t>& out) {
+    if (maxBytes != 0) return false;
+    out.assign(kImageBytes, static_cast<uint8_t>(url.size()));
+    return true;
+}
+
+// Loads `count` distinct images through the pipeline and waits for them
+void LoadImages(ArtworkPipeline& artwork, std::atomic<int>& loaded, uint64_t& generation, int first, int count) {
+    for (int i = first; i < first + count; ++i) {
+        int before = loaded.load();
+        artwork.Begin(++generation, "https://example.com/cover" + std::to_string(i) + ".jpg");
+        WaitFor([&] { return loaded.load() > before; }, std::chrono::seconds(5));
+    }
+}
+
+void CheckArtwork() {
+    std::printf("artwork pipeline\n");
+    WorkerPool::Options options;
+    options.threadCount = 1;
+    WorkerPool pool(std::move(options));
+    std::atomic<int> loaded{ 0 };
+    uint64_t generation = 0;
+    ArtworkPipeline artwork(pool, FakeLoader, [&](uint64_t, const ArtworkImage&) { ++loaded; });
+
+    // Warm up the worker thread and the pool's queues
+    LoadImages(artwork, loaded, generation, 100, 1);
+    artwork.Trim(SIZE_MAX);
+
+    int64_t heap = Heap();
+    int64_t charged = Charged(MemoryCategory::kArtwork) + Charged(MemoryCategory::kCaches);
+    LoadImages(artwork, loaded, generation, 0, 6);
+    int64_t heapGrowth = Heap() - heap;
+    int64_t chargedGrowth = Charged(MemoryCategory::kArtwork) + Charged(MemoryCategory::kCaches) - charged;
+    Report("6 images", chargedGrowth, heapGrowth);
+    Check(Close(chargedGrowth, heapGrowth, 0.02, 4096), "cached images are charged within 2%");
+    Check(artwork.CacheBytes() >= 6 * kImageBytes, "the cache holds all six");
+
+    artwork.SetCacheLimit(3 * kImageBytes);
+    Check(artwork.CacheBytes() <= 3 * kImageBytes, "lowering the cache limit trims right away");
+    LoadImages(artwork, loaded, generation, 6, 4);
+    Check(artwork.CacheBytes() <= 3 * kImageBytes, "the cache keeps to its byte limit as images arrive");
+    Check(artwork.CacheBytes() >= 2 * kImageBytes, "and still keeps what fits");
+    artwork.SetCacheLimit(0);
+
+    // Over the budget: the cache is trimmed oldest first until usage fits
+    LoadImages(artwork, loaded, generation, 10, 4);
+    uint64_t reclaims = MemoryBudget::Shared().Stats().reclaims;
+    heap = Heap();
+    size_t limit = static_cast<size_t>(Used()) - 3 * kImageBytes;
+    MemoryBudget::Shared().SetLimit(limit);
+    Check(static_cast<size_t>(Used()) <= limit, "setting a budget trims down to it");
+    Check(MemoryBudget::Shared().Stats().reclaims == reclaims + 1, "the trim is counted as a reclaim");
+    Check(heap - Heap() >= static_cast<int64_t>(3 * kImageBytes), "the trimmed bytes really left the heap");
+
+    LoadImages(artwork, loaded, generation, 20, 3);
+    Check(static_cast<size_t>(Used()) <= limit, "new images stay under the budget");
+    Check(artwork.CacheBytes() > 0, "the newest image is kept");
+    MemoryBudget::Shared().SetLimit(0);
+
+    // A buffer someone still shows is not counted as freed by a trim
+    ArtworkImage shown = artwork.Begin(++generation, "https://example.com/cover20.jpg");
+    size_t cached = artwork.CacheBytes();
+    size_t freed = artwork.Trim(SIZE_MAX);
+    Check(!shown.empty() && freed + kImageBytes / 2 < cached, "a trim doesn't count images still held");
+    Check(artwork.CacheBytes() == 0, "a full trim empties the cache");
+}
+
+// Stands in for the WIC decoder: an opaque noisy image the size it was asked
+// for, which no codec can squeeze much
+bool NoiseDecoder(const std::vector<uint8_t>&, uint32_t maxEdge, audio_service_smtc::RgbaImage& image) {
+    image.width = maxEdge;
+    image.height = maxEdge;
+    image.pixels.resize(static_cast<size_t>(maxEdge) * maxEdge * 4);
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < image.pixels.size(); ++i) {
+        seed = seed * 1664525 + 1013904223;
+        image.pixels[i] = i % 4 == 3 ? 255 : static_cast<uint8_t>(seed >> 24 | 0x80);
+    }
+    return true;
+}
+
+void CheckThumbnailBudget() {
+    std::printf("thumbnail budget\n");
+    WorkerPool::Options options;
+    options.threadCount = 1;
+    WorkerPool pool(std::move(options));
+    std::atomic<int> loaded{ 0 };
+    ArtworkImage last;
+    std::mutex lastMutex;
+    uint64_t generation = 0;
+    ArtworkPipeline artwork(pool, FakeLoader, [&](uint64_t, const ArtworkImage& image) {
+        std::lock_guard<std::mutex> lock(lastMutex);
+        last = image;
+        ++loaded;
+    });
+
+    LoadImages(artwork, loaded, generation, 0, 1);
+    Check(last.bytes->size() == kImageBytes, "without a decoder artwork is kept as loaded");
+
+    audio_service_smtc::ThumbnailBudget budget;
+    budget.maxBytes = 48 * 1024;
+    budget.maxEdge = 160;
+    artwork.SetDecoder(NoiseDecoder);
+    artwork.SetThumbnailBudget(budget);
+    LoadImages(artwork, loaded, generation, 1, 1);
+    Check(last.bytes->size() <= budget.maxBytes, "artwork over the budget is re-encoded to fit it");
+    Check(last.bytes->capacity() == last.bytes->size(), "without slack in the cached buffer");
+
+    budget.maxEdge = 1400;
+    artwork.SetThumbnailBudget(budget);
+    LoadImages(artwork, loaded, generation, 2, 1);
+    Check(last.bytes->size() == kImageBytes, "an encode that comes out larger is dropped");
+}
+
+void CheckStrings() {
+    std::printf("string pool\n");
+    // The pool is process-wide; one string first so its index exists
+    InternedString warm("warm-up");
+    int64_t heap = Heap();
+    int64_t charged = Charged(MemoryCategory::kStrings);
+
+    std::vector<InternedString> names;
+    names.reserve(5000);
+    int64_t vectorBytes = Heap() - heap;
+    for (int i = 0; i < 5000; ++i) {
+        names.emplace_back("Artist number " + std::to_string(i) + " and the long band name");
+    }
+    int64_t heapGrowth = Heap() - heap - vectorBytes;
+    int64_t chargedGrowth = Charged(MemoryCategory::kStrings) - charged;
+    Report("5000 names", chargedGrowth, heapGrowth);
+    Check(Close(chargedGrowth, heapGrowth, 0.02, 1024), "interned strings are charged within 2%");
+
+    names.clear();
+    names.shrink_to_fit();
+    int64_t left = Charged(MemoryCategory::kStrings) - charged;
+    int64_t heapLeft = Heap() - heap;
+    Report("released", left, heapLeft);
+    Check(Close(left, heapLeft, 0.02, 1024), "what the pool keeps after release is still accounted");
+}
+
+void CheckQueues() {
+    std::printf("event dispatcher\n");
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool open = false;
+    std::atomic<int> delivered{ 0 };
+    EventDispatcher dispatcher([&](const NativeEvent&) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&] { return open; });
+        ++delivered;
+    });
+
+    // The first post becomes the deliverer and blocks in the sink, so the
+    // rest queue up behind it
+    std::thread deliverer([&] { dispatcher.PostControl("play"); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    int64_t charged = Charged(MemoryCategory::kQueues);
+    for (int i = 0; i < 1000; ++i) dispatcher.PostControl("next");
+    int64_t queued = Charged(MemoryCategory::kQueues) - charged;
+    Report("1000 events", queued, 1000 * static_cast<int64_t>(sizeof(NativeEvent)));
+    Check(queued == 1000 * static_cast<int64_t>(sizeof(NativeEvent)), "queued events are charged");
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        open = true;
+    }
+    cv.notify_all();
+    deliverer.join();
+    Check(delivered.load() == 1001, "every event was delivered");
+    Check(Charged(MemoryCategory::kQueues) == 0, "delivered events are released");
+}
+
+void CheckUtf16Cache() {
+    std::printf("utf16 cache\n");
+    int64_t charged = Charged(MemoryCategory::kCaches);
+    {
+        audio_service_smtc::Utf16Cache<std::u16string> cache;
+        for (int i = 0; i < 64; ++i) {
+            cache.Get("Some track title that is long enough to allocate #" + std::to_string(i),
+                      [](std::u16string_view text) { return std::u16string(text); });
+        }
+        Check(Charged(MemoryCategory::kCaches) > charged, "converted strings are charged");
+    }
+    Check(Charged(MemoryCategory::kCaches) == charged, "and released with the cache");
+}
+
+void CheckLog() {
+    std::printf("native log\n");
+    audio_service_smtc::SetLogSink([](const audio_service_smtc::LogRecord&) {});
+    int64_t charged = Charged(MemoryCategory::kLog);
+    std::thread([] { SMTC_LOG_WARNING("memory check", "from a short-lived thread"); }).join();
+    Check(Charged(MemoryCategory::kLog) > charged, "a thread's log ring is charged");
+    audio_service_smtc::FlushLog();
+    audio_service_smtc::FlushLog();
+    Check(Charged(MemoryCategory::kLog) == charged, "and released once the thread is gone and drained");
+}
+
+void CheckIdleRelease() {
+    std::printf("idle release\n");
+    WorkerPool::Options options;
+    options.threadCount = 2;
+    options.idleTimeout = std::chrono::milliseconds(60000);
+    WorkerPool pool(std::move(options));
+    std::atomic<int> loaded{ 0 };
+    uint64_t generation = 0;
+    ArtworkPipeline artwork(pool, FakeLoader, [&](uint64_t, const ArtworkImage&) { ++loaded; });
+    LoadImages(artwork, loaded, generation, 0, 4);
+    Check(pool.RunningThreads() > 0, "workers are running after loading");
+
+    std::atomic<int> idleCalls{ 0 };
+    UpdatePipeline::Options updateOptions;
+    updateOptions.idleTimeout = std::chrono::milliseconds(50);
+    updateOptions.onIdle = [&] {
+        pool.ReleaseIdleThreads();
+        MemoryBudget::Shared().ReleaseIdle();
+        ++idleCalls;
+    };
+    UpdatePipeline updates([](const PlayerStatePatch&) {}, std::move(updateOptions));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    Check(idleCalls.load() == 0, "no idle release before the first commit");
+
+    int64_t heap = Heap();
+    uint64_t releases = MemoryBudget::Shared().Stats().idleReleases;
+    PlayerStatePatch patch;
+    patch.status = audio_service_smtc::PlaybackState::kStopped;
+    updates.Submit(patch);
+    Check(WaitFor([&] { return idleCalls.load() == 1; }, std::chrono::seconds(2)), "released once commits go quiet");
+    Check(MemoryBudget::Shared().Stats().idleReleases == releases + 1, "the release is counted");
+    Check(artwork.CacheBytes() == 0, "cached artwork is gone");
+    Check(heap - Heap() >= static_cast<int64_t>(4 * kImageBytes), "and its buffers left the heap");
+    Check(WaitFor([&] { return pool.RunningThreads() == 0; }, std::chrono::seconds(2)), "idle worker threads exited");
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    Check(idleCalls.load() == 1, "and it doesn't repeat without another commit");
+
+    LoadImages(artwork, loaded, generation, 10, 1);
+    Check(artwork.CacheBytes() > 0, "new work starts the workers again");
+}
+
+}  // namespace
+
+int main() {
+    CheckArtwork();
+    CheckThumbnailBudget();
+    CheckStrings();
+    CheckQueues();
+    CheckUtf16Cache();
+    CheckLog();
+    CheckIdleRelease();
+
+    audio_service_smtc::MemoryStats stats = MemoryBudget::Shared().Stats();
+    std::printf("peak %zu B, %llu reclaims, %llu B reclaimed, %llu idle releases\n", stats.peak,
+                static_cast<unsigned long long>(stats.reclaims),
+                static_cast<unsigned long long>(stats.reclaimedBytes),
+                static_cast<unsigned long long>(stats.idleReleases));
+    std::printf("%s\n", g_failures == 0 ? "all checks passed" : "FAILED");
+    return g_failures == 0 ? 0 : 1;
+}
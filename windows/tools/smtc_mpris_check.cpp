@@ -0,0 +1,347 @@
+// Checks MprisBackend against a private session dbus-daemon it starts, as an
+// MPRIS client would see it: one PropertiesChanged per commit, Position read
+// on demand, Seeked on jumps, and method calls reaching the callbacks.
+// Linux only. Build it as C++17 with -Ismtc_windows, -pthread and
+// `pkg-config --cflags --libs dbus-1`, together with these sources from
+// smtc_windows/: mpris_backend, event_dispatcher, player_state, string_pool,
+// timeline_publisher, position_estimator, utf16_transcode, span_tracer,
+// memory_budget and native_log.
+// dbus-daemon has to be on the PATH.
+//
+// Usage: smtc_mpris_check
+
+#include <dbus/dbus.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "event_dispatcher.h"
+#include "mpris_backend.h"
+
+using audio_service_smtc::MediaMetadata;
+using audio_service_smtc::MonotonicMicros;
+using audio_service_smtc::MprisBackend;
+using audio_service_smtc::PlaybackState;
+using audio_service_smtc::PlayerState;
+using audio_service_smtc::TimelineSnapshot;
+
+namespace {
+
+constexpr const char* kPath = "/org/mpris/MediaPlayer2";
+constexpr const char* kPlayer = "org.mpris.MediaPlayer2.Player";
+
+int g_failures = 0;
+
+void Check(bool ok, const char* what) {
+    std::printf("%s  %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok) ++g_failures;
+}
+
+// A dbus-daemon of our own, so the check never touches the desktop's bus
+class PrivateBus {
+public:
+    PrivateBus() {
+        std::FILE* out = popen("dbus-daemon --session --fork --print-address=1 --print-pid=1", "r");
+        if (!out) return;
+        char line[512];
+        if (std::fgets(line, sizeof(line), out)) {
+            _address = line;
+            while (!_address.empty() && (_address.back() == '\n' || _address.back() == '\r')) _address.pop_back();
+        }
+        if (std::fgets(line, sizeof(line), out)) _pid = std::atoi(line);
+        pclose(out);
+    }
+
+    ~PrivateBus() {
+        if (_pid > 0) kill(_pid, SIGTERM);
+    }
+
+    const std::string& address() const { return _address; }
+
+private:
+    std::string _address;
+    int _pid = 0;
+};
+
+struct Signal {
+    std::string member;
+    std::set<std::string> changed;   // PropertiesChanged keys
+    int64_t position = 0;            // Seeked argument
+};
+
+// The MPRIS client side: records the signals the backend emits
+class Client {
+public:
+    explicit Client(const std::string& address) {
+        DBusError error;
+        dbus_error_init(&error);
+        _connection = dbus_connection_open_private(address.c_str(), &error);
+        if (_connection) dbus_bus_register(_connection, &error);
+        if (dbus_error_is_set(&error)) {
+            std::fprintf(stderr, "client: %s\n", error.message);
+            dbus_error_free(&error);
+            return;
+        }
+        dbus_connection_set_exit_on_disconnect(_connection, FALSE);
+        dbus_bus_add_match(_connection, "type='signal',path='/org/mpris/MediaPlayer2'", &error);
+        dbus_connection_flush(_connection);
+    }
+
+    ~Client() {
+        if (_connection) {
+            dbus_connection_close(_connection);
+            dbus_connection_unref(_connection);
+        }
+    }
+
+    bool connected() const { return _connection != nullptr; }
+
+    // Every signal arriving within `millis`
+    std::vector<Signal> Collect(int millis) {
+        std::vector<Signal> signals;
+        int64_t until = MonotonicMicros() + millis * 1000;
+        for (int64_t now = MonotonicMicros(); now < until; now = MonotonicMicros()) {
+            dbus_connection_read_write(_connection, static_cast<int>((until - now) / 1000) + 1);
+            while (DBusMessage* message = dbus_connection_pop_message(_connection)) {
+                if (dbus_message_get_type(message) == DBUS_MESSAGE_TYPE_SIGNAL &&
+                    std::string(dbus_message_get_path(message) ? dbus_message_get_path(message) : "") == kPath) {
+                    signals.push_back(Parse(message));
+                }
+                dbus_message_unref(message);
+            }
+        }
+        return signals;
+    }
+
+    // Calls `method` and returns the reply, or null on an error reply
+    DBusMessage* Call(const std::string& bus, const char* interface, const char* method,
+                      int firstType = DBUS_TYPE_INVALID, ...) {
+        DBusMessage* call = dbus_message_new_method_call(bus.c_str(), kPath, interface, method);
+        if (firstType != DBUS_TYPE_INVALID) {
+            va_list args;
+            va_start(args, firstType);
+            dbus_message_append_args_valist(call, firstType, args);
+            va_end(args);
+        }
+        DBusError error;
+        dbus_error_init(&error);
+        DBusMessage* reply = dbus_connection_send_with_reply_and_block(_connection, call, 2000, &error);
+        dbus_message_unref(call);
+        if (dbus_error_is_set(&error)) {
+            _lastError = error.name;
+            dbus_error_free(&error);
+            return nullptr;
+        }
+        return reply;
+    }
+
+    int64_t GetPosition(const std::string& bus) {
+        const char* interface = kPlayer;
+        const char* name = "Position";
+        DBusMessage* reply = Call(bus, "org.freedesktop.DBus.Properties", "Get", DBUS_TYPE_STRING, &interface,
+                                  DBUS_TYPE_STRING, &name, DBUS_TYPE_INVALID);
+        if (!reply) return -1;
+        DBusMessageIter iter;
+        DBusMessageIter variant;
+        dbus_int64_t position = -1;
+        dbus_message_iter_init(reply, &iter);
+        dbus_message_iter_recurse(&iter, &variant);
+        if (dbus_message_iter_get_arg_type(&variant) == DBUS_TYPE_INT64) dbus_message_iter_get_basic(&variant, &position);
+        dbus_message_unref(reply);
+        return position;
+    }
+
+    // Number of entries in GetAll's reply for `interface`
+    int CountAll(const std::string& bus, const char* interface) {
+        DBusMessage* reply = Call(bus, "org.freedesktop.DBus.Properties", "GetAll", DBUS_TYPE_STRING, &interface,
+                                  DBUS_TYPE_INVALID);
+        if (!reply) return -1;
+        DBusMessageIter iter;
+        DBusMessageIter array;
+        dbus_message_iter_init(reply, &iter);
+        dbus_message_iter_recurse(&iter, &array);
+        int count = 0;
+        while (dbus_message_iter_get_arg_type(&array) == DBUS_TYPE_DICT_ENTRY) {
+            ++count;
+            dbus_message_iter_next(&array);
+        }
+        dbus_message_unref(reply);
+        return count;
+    }
+
+    const std::string& lastError() const { return _lastError; }
+
+private:
+    static Signal Parse(DBusMessage* message) {
+        Signal signal;
+        signal.member = dbus_message_get_member(message);
+        DBusMessageIter iter;
+        if (!dbus_message_iter_init(message, &iter)) return signal;
+        if (signal.member == "Seeked") {
+            dbus_int64_t position = 0;
+            dbus_message_iter_get_basic(&iter, &position);
+            signal.position = position;
+        } else if (signal.member == "PropertiesChanged") {
+            dbus_message_iter_next(&iter);
+            DBusMessageIter array;
+            dbus_message_iter_recurse(&iter, &array);
+            while (dbus_message_iter_get_arg_type(&array) == DBUS_TYPE_DICT_ENTRY) {
+                DBusMessageIter entry;
+                const char* key = nullptr;
+                dbus_message_iter_recurse(&array, &entry);
+                dbus_message_iter_get_basic(&entry, &key);
+                signal.changed.insert(key);
+                dbus_message_iter_next(&array);
+            }
+        }
+        return signal;
+    }
+
+    DBusConnection* _connection = nullptr;
+    std::string _lastError;
+};
+
+// Waits up to a second for `predicate`
+template <typename Predicate>
+bool WaitFor(Predicate predicate) {
+    for (int i = 0; i < 100; ++i) {
+        if (predicate()) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return predicate();
+}
+
+}  // namespace
+
+int main() {
+    PrivateBus bus;
+    if (bus.address().empty()) {
+        std::fprintf(stderr, "could not start dbus-daemon\n");
+        return 2;
+    }
+    Client client(bus.address());
+    if (!client.connected()) return 2;
+
+    MprisBackend backend("audio_service_smtc check", bus.address());
+    Check(backend.IsReady(), "backend connects to the private bus");
+    Check(backend.busName() == "org.mpris.MediaPlayer2.audio_service_smtc_check", "bus name is derived from the identity");
+    if (!backend.IsReady()) return 1;
+    const std::string& name = backend.busName();
+
+    std::mutex mutex;
+    std::vector<std::string> controls;
+    std::vector<int64_t> positions;
+    backend.SetControlCallback([&](const std::string& command) {
+        std::lock_guard<std::mutex> lock(mutex);
+        controls.push_back(command);
+    });
+    backend.SetPositionCallback([&](int64_t position) {
+        std::lock_guard<std::mutex> lock(mutex);
+        positions.push_back(position);
+    });
+
+    using namespace audio_service_smtc;
+    PlayerState state;
+    state.status = PlaybackState::kPlaying;
+    state.metadata = MediaMetadata{ "Roygbiv", "Boards of Canada", "Music Has the Right to Children", "/tmp/cover.jpg",
+                                    240000000 };
+    state.enabledButtons = kPlayButton | kPauseButton | kNextButton;
+    backend.ApplyState(state, kStatusField | kMetadataField | kButtonsField, ArtworkImage{});
+
+    std::vector<Signal> signals = client.Collect(300);
+    Check(signals.size() == 1 && signals[0].member == "PropertiesChanged",
+          "a commit of status, metadata and buttons emits one PropertiesChanged");
+    if (!signals.empty()) {
+        const std::set<std::string>& changed = signals[0].changed;
+        Check(changed.count("PlaybackStatus") && changed.count("Metadata") && changed.count("CanPlay") &&
+              changed.count("CanGoPrevious") && changed.count("CanSeek") && !changed.count("Position"),
+              "it carries every changed property and no Position");
+    }
+
+    backend.ApplyState(state, kStatusField | kButtonsField, ArtworkImage{});
+    Check(client.Collect(200).empty(), "a commit that changes nothing emits nothing");
+
+    backend.UpdateTimeline(TimelineSnapshot{ 10000000, 240000000, 1.0 });
+    signals = client.Collect(200);
+    Check(signals.size() == 1 && signals[0].member == "Seeked" && signals[0].position == 10000000,
+          "a timeline jump emits Seeked only");
+
+    int64_t first = client.GetPosition(name);
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    int64_t second = client.GetPosition(name);
+    Check(first >= 10000000 && second - first >= 250000 && second - first < 600000,
+          "Position is extrapolated on demand while playing");
+
+    backend.UpdateTimeline(TimelineSnapshot{ second, 240000000, 1.0 });
+    Check(client.Collect(200).empty(), "a timeline on course emits nothing");
+
+    backend.UpdateTimeline(TimelineSnapshot{ second, 240000000, 2.0 });
+    signals = client.Collect(200);
+    Check(signals.size() == 1 && signals[0].changed == std::set<std::string>{ "Rate" }, "a rate change emits Rate");
+
+    state.status = PlaybackState::kPaused;
+    backend.ApplyState(state, kStatusField, ArtworkImage{});
+    client.Collect(100);
+    first = client.GetPosition(name);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    Check(first > 0 && client.GetPosition(name) == first, "Position holds while paused");
+
+    DBusMessage* reply = client.Call(name, kPlayer, "Next");
+    if (reply) dbus_message_unref(reply);
+    reply = client.Call(name, kPlayer, "Previous");
+    if (reply) dbus_message_unref(reply);
+    reply = client.Call(name, kPlayer, "PlayPause");
+    if (reply) dbus_message_unref(reply);
+    Check(WaitFor([&] {
+        std::lock_guard<std::mutex> lock(mutex);
+        return controls == std::vector<std::string>{ "next", "play" };
+    }), "Next and PlayPause reach the control callback; disabled Previous does not");
+
+    const char* track = "/org/mpris/MediaPlayer2/track/1";
+    const char* stale = "/org/mpris/MediaPlayer2/track/0";
+    dbus_int64_t target = 5000000;
+    reply = client.Call(name, kPlayer, "SetPosition", DBUS_TYPE_OBJECT_PATH, &stale, DBUS_TYPE_INT64, &target,
+                        DBUS_TYPE_INVALID);
+    if (reply) dbus_message_unref(reply);
+    reply = client.Call(name, kPlayer, "SetPosition", DBUS_TYPE_OBJECT_PATH, &track, DBUS_TYPE_INT64, &target,
+                        DBUS_TYPE_INVALID);
+    if (reply) dbus_message_unref(reply);
+    Check(WaitFor([&] {
+        std::lock_guard<std::mutex> lock(mutex);
+        return positions == std::vector<int64_t>{ 5000000 };
+    }), "SetPosition for the current track reaches the position callback; a stale one does not");
+
+    Check(client.CountAll(name, kPlayer) == 12, "GetAll lists the player properties");
+    const char* interface = kPlayer;
+    const char* unknown = "Volume";
+    reply = client.Call(name, "org.freedesktop.DBus.Properties", "Get", DBUS_TYPE_STRING, &interface,
+                        DBUS_TYPE_STRING, &unknown, DBUS_TYPE_INVALID);
+    Check(!reply && client.lastError() == DBUS_ERROR_UNKNOWN_PROPERTY, "an unknown property is an error");
+    if (reply) dbus_message_unref(reply);
+
+    state.metadata.title = "bad \xff utf-8";
+    backend.ApplyState(state, kMetadataField, ArtworkImage{});
+    signals = client.Collect(200);
+    Check(signals.size() == 1 && signals[0].changed.count("Metadata"), "invalid UTF-8 is replaced, not refused");
+
+    {
+        MprisBackend second("audio_service_smtc check", bus.address());
+        Check(second.IsReady() && second.busName().rfind(name + ".instance", 0) == 0,
+              "a second instance gets an instance suffix");
+    }
+
+    backend.SetControlCallback(nullptr);
+    backend.SetPositionCallback(nullptr);
+    std::printf("%s\n", g_failures == 0 ? "all checks passed" : "some checks FAILED");
+    return g_failures == 0 ? 0 : 1;
+}
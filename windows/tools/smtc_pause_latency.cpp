@@ -0,0 +1,258 @@
+// Measures pause-press latency while position traffic saturates the event
+// path. Load threads post position events in bursts, together at twice the
+// rate the stand-in messenger can send them by default; meanwhile pause
+// presses are posted at a steady interval, and each press is timed from
+// posting until the messenger sends it, using the event's own timestamp as
+// Dart would. The same run goes
+// through the EventDispatcher and through a single queue in arrival order,
+// which is how both event kinds were sent before the dispatcher.
+// Needs no Windows or Flutter headers. Build it as C++17 with -Ismtc_windows
+// and -pthread, together with these sources from smtc_windows/:
+// event_dispatcher, span_tracer, memory_budget and native_log.
+//
+// Usage: smtc_pause_latency [--presses=N] [--interval-us=N] [--send-us=N]
+//                           [--load-threads=N] [--load-factor=N]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "event_dispatcher.h"
+
+using namespace audio_service_smtc;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+int g_failures = 0;
+
+void Check(bool ok, const char* what) {
+    std::printf("%s  %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok) ++g_failures;
+}
+
+// Busy for `micros`, as encoding and handing the message to the platform
+// thread would be
+void Spin(int micros) {
+    Clock::time_point end = Clock::now() + std::chrono::microseconds(micros);
+    while (Clock::now() < end) {
+    }
+}
+
+double Percentile(std::vector<double> values, double fraction) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(fraction * static_cast<double>(values.size() - 1) + 0.5);
+    return values[index];
+}
+
+// Stands in for BinaryMessenger::Send on the events channel
+class FakeMessenger {
+public:
+    explicit FakeMessenger(int sendMicros) : _sendMicros(sendMicros) {}
+
+    // Never called concurrently, by either event path
+    void Send(const NativeEvent& event) {
+        EncodeEventEnvelope(event, &_buffer);
+        if (!_flushing.load(std::memory_order_relaxed)) Spin(_sendMicros);
+        if (event.kind == NativeEventKind::kControl) {
+            _latencies.push_back(static_cast<double>(MonotonicMicros() - event.timestamp));
+            _controls.push_back(event.control);
+        } else {
+            ++_positions;
+        }
+    }
+
+    const std::vector<double>& Latencies() const { return _latencies; }
+    const std::vector<std::string>& Controls() const { return _controls; }
+    uint64_t Positions() const { return _positions; }
+
+    // Once the presses are in, a backlog is sent without the cost
+    void StartFlushing() { _flushing.store(true); }
+
+private:
+    int _sendMicros;
+    std::atomic<bool> _flushing{ false };
+    std::vector<uint8_t> _buffer;
+    std::vector<double> _latencies;  // microseconds
+    std::vector<std::string> _controls;
+    uint64_t _positions = 0;
+};
+
+// Both event kinds in one queue in arrival order, delivered by whichever
+// thread posts while no delivery runs, as the dispatcher delivers
+class ArrivalOrderQueue {
+public:
+    explicit ArrivalOrderQueue(std::function<void(const NativeEvent&)> sink) : _sink(std::move(sink)) {}
+
+    void PostControl(const std::string& control) {
+        NativeEvent event;
+        event.kind = NativeEventKind::kControl;
+        event.control = control;
+        event.timestamp = MonotonicMicros();
+        Post(std::move(event));
+    }
+
+    void PostPosition(int64_t position) {
+        NativeEvent event;
+        event.kind = NativeEventKind::kPosition;
+        event.position = position;
+        event.timestamp = MonotonicMicros();
+        Post(std::move(event));
+    }
+
+private:
+    void Post(NativeEvent event) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _queue.push_back(std::move(event));
+        if (_delivering) return;
+        _delivering = true;
+        while (!_queue.empty()) {
+            NativeEvent next = std::move(_queue.front());
+            _queue.pop_front();
+            lock.unlock();
+            _sink(next);
+            lock.lock();
+        }
+        _delivering = false;
+    }
+
+    std::function<void(const NativeEvent&)> _sink;
+    std::mutex _mutex;
+    std::deque<NativeEvent> _queue;
+    bool _delivering = false;
+};
+
+struct Options {
+    int presses = 500;
+    int intervalMicros = 2000;
+    int sendMicros = 20;
+    int loadThreads = 2;
+    int loadFactor = 2;  // positions posted per position the messenger can send
+};
+
+struct Result {
+    std::vector<double> latencies;
+    bool allDelivered = false;
+    bool inOrder = false;
+    uint64_t positionsPosted = 0;
+    uint64_t positionsSent = 0;
+};
+
+const char* const kControls[] = { "pause", "play" };
+
+template <typename Path>
+Result Run(const Options& options) {
+    FakeMessenger messenger(options.sendMicros);
+    Path path([&messenger](const NativeEvent& event) { messenger.Send(event); });
+
+    std::atomic<bool> stop{ false };
+    std::atomic<uint64_t> posted{ 0 };
+    // Bursts of positions, as SMTC raises them while the bar is dragged
+    constexpr int kBurst = 100;
+    const auto burstInterval = std::chrono::microseconds(
+        (std::max)(options.sendMicros, 1) * kBurst * options.loadThreads / options.loadFactor);
+    std::vector<std::thread> load;
+    for (int i = 0; i < options.loadThreads; ++i) {
+        load.emplace_back([&] {
+            int64_t position = 0;
+            Clock::time_point burst = Clock::now();
+            while (!stop.load(std::memory_order_relaxed)) {
+                for (int j = 0; j < kBurst; ++j) path.PostPosition(position += 1000);
+                posted.fetch_add(kBurst, std::memory_order_relaxed);
+                burst += burstInterval;
+                std::this_thread::sleep_until(burst);
+            }
+        });
+    }
+
+    // Pause and play alternate, like a user tapping the key
+    Clock::time_point next = Clock::now() + std::chrono::milliseconds(20);
+    for (int i = 0; i < options.presses; ++i) {
+        std::this_thread::sleep_until(next);
+        path.PostControl(kControls[i % 2]);
+        next += std::chrono::microseconds(options.intervalMicros);
+    }
+    // Let the last press through, then the arrival-order path's backlog
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    messenger.StartFlushing();
+    stop.store(true);
+    for (std::thread& thread : load) thread.join();
+    path.PostPosition(0);
+
+    Result result;
+    result.latencies = messenger.Latencies();
+    result.allDelivered = messenger.Controls().size() == static_cast<size_t>(options.presses);
+    result.inOrder = true;
+    for (size_t i = 0; i < messenger.Controls().size(); ++i) {
+        result.inOrder = result.inOrder && messenger.Controls()[i] == kControls[i % 2];
+    }
+    result.positionsPosted = posted.load();
+    result.positionsSent = messenger.Positions();
+    return result;
+}
+
+void Print(const char* name, const Result& result) {
+    std::printf("%-14s p50 %9.1f us  p90 %9.1f us  p99 %9.1f us  max %9.1f us   positions sent %llu of %llu\n",
+                name, Percentile(result.latencies, 0.5), Percentile(result.latencies, 0.9),
+                Percentile(result.latencies, 0.99), Percentile(result.latencies, 1.0),
+                static_cast<unsigned long long>(result.positionsSent),
+                static_cast<unsigned long long>(result.positionsPosted));
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--presses=", 10) == 0) {
+            options.presses = std::atoi(argv[i] + 10);
+        } else if (std::strncmp(argv[i], "--interval-us=", 14) == 0) {
+            options.intervalMicros = std::atoi(argv[i] + 14);
+        } else if (std::strncmp(argv[i], "--send-us=", 10) == 0) {
+            options.sendMicros = std::atoi(argv[i] + 10);
+        } else if (std::strncmp(argv[i], "--load-threads=", 15) == 0) {
+            options.loadThreads = std::atoi(argv[i] + 15);
+        } else if (std::strncmp(argv[i], "--load-factor=", 14) == 0) {
+            options.loadFactor = std::atoi(argv[i] + 14);
+        } else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (options.presses <= 0 || options.intervalMicros <= 0 || options.sendMicros < 0 || options.loadThreads <= 0 ||
+        options.loadFactor <= 0) {
+        std::fprintf(stderr, "counts must be positive\n");
+        return 2;
+    }
+
+    std::printf("%d presses every %d us, %d us per send, %d thread%s posting positions at %dx what can be sent\n",
+                options.presses, options.intervalMicros, options.sendMicros, options.loadThreads,
+                options.loadThreads == 1 ? "" : "s", options.loadFactor);
+    Result dispatcher = Run<EventDispatcher>(options);
+    Result arrival = Run<ArrivalOrderQueue>(options);
+    Print("dispatcher", dispatcher);
+    Print("arrival order", arrival);
+
+    Check(dispatcher.allDelivered && dispatcher.inOrder, "the dispatcher delivers every press, in order");
+    Check(dispatcher.positionsSent < dispatcher.positionsPosted, "the dispatcher coalesces positions it can't send");
+    // A press waits for at most the send in progress and its own
+    Check(Percentile(dispatcher.latencies, 0.5) < 4.0 * (options.sendMicros + 50),
+          "a press waits behind no more than the send in progress");
+    Check(Percentile(dispatcher.latencies, 0.99) < Percentile(arrival.latencies, 0.99),
+          "presses are delivered sooner than in arrival order");
+
+    std::printf("%s\n", g_failures == 0 ? "all checks passed" : "FAILED");
+    return g_failures == 0 ? 0 : 1;
+}
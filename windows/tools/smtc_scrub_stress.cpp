@@ -0,0 +1,302 @@
+// Stress test for the latest-wins seek path. A synthetic scrub posts
+// position requests at 1 kHz the way SMTC raises them while the seek bar is
+// dragged; each goes through the plugin's OnPositionChange (position
+// mailbox, then the event dispatcher when the mailbox was empty) to a
+// stand-in for the Dart side, which drains the mailbox one seek at a time
+// like AudioServiceSmtcImpl._drainSeeks, each seek taking a random while.
+// Checks that the position a scrub ends on is always the one the player
+// lands on, that positions are never taken out of order, and that no two
+// seeks are ever in flight. A second phase posts without pause against a
+// reader that never waits, for races in the mailbox itself.
+// Needs no Windows or Flutter headers. Build it as C++17 with -Ismtc_windows
+// and -pthread, together with these sources from smtc_windows/:
+// event_dispatcher, span_tracer, memory_budget and native_log.
+//
+// Usage: smtc_scrub_stress [--scrubs=N] [--scrub-ms=N] [--rate-hz=N]
+//                          [--max-seek-ms=N] [--burst=N]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "event_dispatcher.h"
+#include "position_mailbox.h"
+
+using namespace audio_service_smtc;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+int g_failures = 0;
+
+void Check(bool ok, const char* what) {
+    std::printf("%s  %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok) ++g_failures;
+}
+
+// xorshift64*, fixed seed so failures reproduce
+class Random {
+public:
+    explicit Random(uint64_t seed) : _state(seed) {}
+
+    uint64_t Next() {
+        _state ^= _state >> 12;
+        _state ^= _state << 25;
+        _state ^= _state >> 27;
+        return _state * 0x2545F4914F6CDD1DULL;
+    }
+
+private:
+    uint64_t _state;
+};
+
+// Positions carry the index of their request in the low bits, so the order
+// they are taken in can be checked
+constexpr int kIndexBits = 24;
+
+int64_t MakePosition(int64_t millis, int64_t index) {
+    return (millis << kIndexBits) | index;
+}
+
+int64_t IndexOf(int64_t position) {
+    return position & ((int64_t(1) << kIndexBits) - 1);
+}
+
+// The Dart isolate: woken by positionPending events, drains the mailbox
+class FakePlayer {
+public:
+    FakePlayer(PositionMailbox& mailbox, int maxSeekMillis)
+        : _mailbox(mailbox), _maxSeekMillis(maxSeekMillis), _thread([this] { Run(); }) {}
+
+    ~FakePlayer() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _cv.notify_all();
+        _thread.join();
+    }
+
+    // The event sink: a positionPending event arriving
+    void OnEvent(const NativeEvent&) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _pending = true;
+        ++_events;
+        _cv.notify_all();
+    }
+
+    // Waits until every woken drain has finished
+    void WaitIdle() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv.wait(lock, [this] { return !_pending && !_draining; });
+    }
+
+    int64_t LastSeek() const { return _lastSeek.load(); }
+    Clock::time_point LastSeekAt() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _lastSeekAt;
+    }
+    uint64_t Seeks() const { return _seeks.load(); }
+    uint64_t Events() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _events;
+    }
+    int MaxInFlight() const { return _maxInFlight.load(); }
+    bool InOrder() const { return _inOrder.load(); }
+
+private:
+    void Run() {
+        Random random(7);
+        std::unique_lock<std::mutex> lock(_mutex);
+        for (;;) {
+            _cv.wait(lock, [this] { return _pending || _stopping; });
+            if (_stopping) return;
+            _draining = true;
+            while (_pending) {
+                _pending = false;
+                lock.unlock();
+                int64_t position;
+                while (_mailbox.Take(&position)) Seek(position, random);
+                lock.lock();
+            }
+            _draining = false;
+            _cv.notify_all();
+        }
+    }
+
+    void Seek(int64_t position, Random& random) {
+        int inFlight = _inFlight.fetch_add(1) + 1;
+        int seen = _maxInFlight.load();
+        while (inFlight > seen && !_maxInFlight.compare_exchange_weak(seen, inFlight)) {
+        }
+        if (_lastSeek.load() >= 0 && IndexOf(position) <= IndexOf(_lastSeek.load())) _inOrder.store(false);
+
+        // The player seeks, then acknowledges with its next state update
+        int micros = static_cast<int>(random.Next() % (static_cast<uint64_t>(_maxSeekMillis) * 1000 + 1));
+        std::this_thread::sleep_for(std::chrono::microseconds(micros));
+        _lastSeek.store(position);
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _lastSeekAt = Clock::now();
+        }
+        _seeks.fetch_add(1);
+        _inFlight.fetch_sub(1);
+    }
+
+    PositionMailbox& _mailbox;
+    int _maxSeekMillis;
+    std::atomic<int64_t> _lastSeek{ -1 };
+    std::atomic<uint64_t> _seeks{ 0 };
+    std::atomic<int> _inFlight{ 0 };
+    std::atomic<int> _maxInFlight{ 0 };
+    std::atomic<bool> _inOrder{ true };
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    bool _pending = false;
+    bool _draining = false;
+    bool _stopping = false;
+    uint64_t _events = 0;
+    Clock::time_point _lastSeekAt;
+    std::thread _thread;
+};
+
+// The plugin between SMTC and Dart, as OnPositionChange wires it
+class FakePlugin {
+public:
+    explicit FakePlugin(int maxSeekMillis)
+        : player(mailbox, maxSeekMillis), dispatcher([this](const NativeEvent& event) { player.OnEvent(event); }) {}
+
+    void OnPositionChange(int64_t position) {
+        if (!mailbox.Post(position)) return;
+        dispatcher.PostPosition(position);
+    }
+
+    PositionMailbox mailbox;
+    FakePlayer player;
+    EventDispatcher dispatcher;
+};
+
+void RunScrubs(int scrubs, int scrubMillis, int rateHz, int maxSeekMillis) {
+    std::printf("scrubs: %d of %d ms at %d Hz, seeks up to %d ms\n", scrubs, scrubMillis, rateHz, maxSeekMillis);
+    FakePlugin plugin(maxSeekMillis);
+    Random random(11);
+    const auto interval = std::chrono::nanoseconds(1'000'000'000 / rateHz);
+
+    int64_t index = 0;
+    int64_t millis = 60'000;
+    uint64_t requests = 0;
+    int finalsLanded = 0;
+    std::vector<double> settleMillis;
+    Clock::time_point started = Clock::now();
+    for (int scrub = 0; scrub < scrubs; ++scrub) {
+        int64_t last = -1;
+        Clock::time_point next = Clock::now();
+        Clock::time_point end = next + std::chrono::milliseconds(scrubMillis);
+        while (next < end) {
+            // The thumb wanders back and forth under the pointer
+            millis = (std::max<int64_t>)(0, millis + static_cast<int64_t>(random.Next() % 2001) - 1000);
+            last = MakePosition(millis, ++index);
+            plugin.OnPositionChange(last);
+            ++requests;
+            next += interval;
+            std::this_thread::sleep_until(next);
+        }
+        // The button is released: whatever was posted last is where it ends
+        Clock::time_point released = Clock::now();
+        plugin.player.WaitIdle();
+        if (plugin.player.LastSeek() == last) ++finalsLanded;
+        settleMillis.push_back(std::chrono::duration<double, std::milli>(plugin.player.LastSeekAt() - released).count());
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - started).count();
+    std::sort(settleMillis.begin(), settleMillis.end());
+
+    std::printf("  %llu requests (%.0f Hz achieved), %llu wakeups, %llu seeks\n",
+                static_cast<unsigned long long>(requests), requests / seconds,
+                static_cast<unsigned long long>(plugin.player.Events()),
+                static_cast<unsigned long long>(plugin.player.Seeks()));
+    std::printf("  release to final seek done: p50 %.1f ms  max %.1f ms\n", settleMillis[settleMillis.size() / 2],
+                settleMillis.back());
+    Check(finalsLanded == scrubs, "every scrub ends on its final position");
+    Check(plugin.player.InOrder(), "positions are taken in the order they were posted");
+    Check(plugin.player.MaxInFlight() == 1, "at most one seek is in flight");
+    Check(plugin.player.Seeks() * 4 < requests, "a scrub collapses to a fraction of its requests");
+}
+
+void RunBurst(int64_t posts) {
+    std::printf("burst: %lld posts without pause\n", static_cast<long long>(posts));
+    PositionMailbox mailbox;
+    std::atomic<bool> done{ false };
+    int64_t lastTaken = -1;
+    bool inOrder = true;
+    uint64_t taken = 0;
+    std::thread reader([&] {
+        int64_t position;
+        for (;;) {
+            bool finished = done.load();
+            while (mailbox.Take(&position)) {
+                if (position <= lastTaken) inOrder = false;
+                lastTaken = position;
+                ++taken;
+            }
+            if (finished) return;
+        }
+    });
+    uint64_t wakes = 0;
+    for (int64_t i = 1; i <= posts; ++i) {
+        if (mailbox.Post(i)) ++wakes;
+    }
+    done.store(true);
+    reader.join();
+
+    std::printf("  %llu taken, %llu wakeups\n", static_cast<unsigned long long>(taken),
+                static_cast<unsigned long long>(wakes));
+    Check(lastTaken == posts, "the last position posted is the last taken");
+    Check(inOrder, "positions are taken in the order they were posted");
+    Check(wakes >= taken && wakes <= taken + 1, "one wakeup per position taken");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int scrubs = 20;
+    int scrubMillis = 500;
+    int rateHz = 1000;
+    int maxSeekMillis = 20;
+    int64_t burst = 2'000'000;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--scrubs=", 9) == 0) {
+            scrubs = std::atoi(argv[i] + 9);
+        } else if (std::strncmp(argv[i], "--scrub-ms=", 11) == 0) {
+            scrubMillis = std::atoi(argv[i] + 11);
+        } else if (std::strncmp(argv[i], "--rate-hz=", 10) == 0) {
+            rateHz = std::atoi(argv[i] + 10);
+        } else if (std::strncmp(argv[i], "--max-seek-ms=", 14) == 0) {
+            maxSeekMillis = std::atoi(argv[i] + 14);
+        } else if (std::strncmp(argv[i], "--burst=", 8) == 0) {
+            burst = std::atoll(argv[i] + 8);
+        } else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (scrubs <= 0 || scrubMillis <= 0 || rateHz <= 0 || maxSeekMillis <= 0 || burst <= 0 ||
+        burst >= (int64_t(1) << kIndexBits) * 64) {
+        std::fprintf(stderr, "counts must be positive\n");
+        return 2;
+    }
+
+    RunScrubs(scrubs, scrubMillis, rateHz, maxSeekMillis);
+    RunBurst(burst);
+
+    std::printf("%s\n", g_failures == 0 ? "all checks passed" : "FAILED");
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,234 @@
+// Runs the plugin core through scripted sessions on a virtual clock and
+// checks how it behaves: the executor itself, scrub coalescing, commits
+// collapsing behind a slow backend, recovery from Explorer restarts, and a
+// full listening session, which has to give the same report on every run.
+// Needs no Windows or Flutter headers and takes well under a second. Build
+// it as C++17 with -Ismtc_windows and -pthread, together with these sources
+// from smtc_windows/: session_sim, sim_executor, artwork_pipeline,
+// artwork_store, artwork_thumbnail, thumbnail_encoder, update_pipeline,
+// player_state, string_pool, timeline_publisher, position_estimator,
+// span_tracer, event_dispatcher, memory_budget and native_log.
+//
+// Usage: smtc_session_sim [--hours=N] [--seed=N] [--call-us=N]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "session_sim.h"
+#include "sim_executor.h"
+
+using audio_service_smtc::ListeningSessionOptions;
+using audio_service_smtc::SimAction;
+using audio_service_smtc::SimActionKind;
+using audio_service_smtc::SimExecutor;
+using audio_service_smtc::SimOptions;
+using audio_service_smtc::SimReport;
+using audio_service_smtc::SimScript;
+
+namespace {
+
+constexpr int64_t kSecond = 1000000;
+
+int g_failures = 0;
+
+void Check(bool ok, const char* what) {
+    std::printf("%s  %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok) ++g_failures;
+}
+
+unsigned long long U(uint64_t value) { return static_cast<unsigned long long>(value); }
+
+void Print(const SimReport& report) {
+    std::printf("      simulated %.1f h in %.1f ms, %llu tasks\n", report.simulatedMicros / 3.6e9,
+                report.wallMicros / 1e3, U(report.tasks));
+    std::printf("      wakeups   update %llu, timeline %llu, watchdog %llu\n", U(report.updateWakeups),
+                U(report.timelineWakeups), U(report.watchdogWakeups));
+    std::printf("      commits   %llu state (%llu submitted, %llu collapsed, high water %zu), "
+                "%llu timeline, %llu thumbnail, %llu failed\n",
+                U(report.stateCommits), U(report.submitted), U(report.collapsed), report.queueHighWater,
+                U(report.timelineCommits), U(report.thumbnailCommits), U(report.failedCalls));
+    std::printf("      changed   status %llu, metadata %llu, timeline %llu, buttons %llu\n",
+                U(report.fieldCommits[0]), U(report.fieldCommits[1]), U(report.fieldCommits[2]),
+                U(report.fieldCommits[3]));
+    std::printf("      session   %llu tracks, %llu artwork loads, %llu controls, %llu seeks (%llu delivered), "
+                "%llu dropped\n",
+                U(report.tracks), U(report.artworkLoads), U(report.controls), U(report.seeks),
+                U(report.seeksDelivered), U(report.droppedActions));
+    std::printf("      restarts  %llu, %llu recoveries, slowest %lld ms after the surface came back\n",
+                U(report.surfaceRestarts), U(report.recoveries),
+                static_cast<long long>(report.recoveryMax / 1000));
+    std::printf("      latency   p50 %lld us, p99 %lld us, max %lld us\n",
+                static_cast<long long>(report.latencyP50), static_cast<long long>(report.latencyP99),
+                static_cast<long long>(report.latencyMax));
+    std::printf("      memory    peak %zu B, %zu B at the end, %llu idle releases\n", report.memoryPeak,
+                report.memoryEnd, U(report.idleReleases));
+}
+
+// Everything but wall time
+bool Same(const SimReport& a, const SimReport& b) {
+    for (int bit = 0; bit < 4; ++bit) {
+        if (a.fieldCommits[bit] != b.fieldCommits[bit]) return false;
+    }
+    return a.simulatedMicros == b.simulatedMicros && a.tasks == b.tasks && a.updateWakeups == b.updateWakeups &&
+           a.timelineWakeups == b.timelineWakeups && a.watchdogWakeups == b.watchdogWakeups &&
+           a.tracks == b.tracks && a.submitted == b.submitted && a.collapsed == b.collapsed &&
+           a.queueHighWater == b.queueHighWater && a.stateCommits == b.stateCommits &&
+           a.timelineCommits == b.timelineCommits && a.thumbnailCommits == b.thumbnailCommits &&
+           a.artworkLoads == b.artworkLoads && a.failedCalls == b.failedCalls &&
+           a.surfaceRestarts == b.surfaceRestarts && a.recoveries == b.recoveries &&
+           a.recoveryMax == b.recoveryMax && a.controls == b.controls && a.seeks == b.seeks &&
+           a.seeksDelivered == b.seeksDelivered && a.droppedActions == b.droppedActions &&
+           a.latencyP50 == b.latencyP50 && a.latencyP99 == b.latencyP99 && a.latencyMax == b.latencyMax &&
+           a.memoryPeak == b.memoryPeak && a.memoryEnd == b.memoryEnd && a.idleReleases == b.idleReleases &&
+           a.finalStateMatches == b.finalStateMatches;
+}
+
+SimAction Action(int64_t at, SimActionKind kind, const char* control, int64_t value) {
+    SimAction action;
+    action.at = at;
+    action.kind = kind;
+    action.control = control;
+    action.value = value;
+    return action;
+}
+
+void CheckExecutor() {
+    std::printf("executor\n");
+    SimExecutor executor;
+    std::vector<int> order;
+    executor.PostAt(20, [&] { order.push_back(3); });
+    executor.PostAt(10, [&] { order.push_back(1); });
+    executor.PostAt(10, [&] { order.push_back(2); });
+    SimExecutor::TaskId cancelled = executor.PostAt(15, [&] { order.push_back(-1); });
+    executor.PostAt(30, [&] {
+        order.push_back(4);
+        executor.PostAfter(5, [&] { order.push_back(5); });
+        executor.PostAt(0, [&] { order.push_back(6); });  // in the past
+    });
+
+    Check(executor.Cancel(cancelled), "a queued task can be cancelled");
+    Check(!executor.Cancel(cancelled), "but only once");
+    executor.RunUntil(25);
+    Check(order == std::vector<int>{ 1, 2, 3 } && executor.Now() == 25,
+          "tasks run by due time, then posting order, and the clock stops where asked");
+    executor.RunUntilIdle();
+    Check(order == std::vector<int>{ 1, 2, 3, 4, 6, 5 } && executor.Now() == 35,
+          "tasks posted for the past run now, ahead of later ones");
+
+    executor.SetTaskDelay(100);
+    int64_t ranAt = 0;
+    executor.Submit(audio_service_smtc::TaskPriority::kCurrent, [&] { ranAt = executor.Now(); });
+    executor.RunUntilIdle();
+    Check(ranAt == 135, "background work takes the task delay");
+}
+
+void CheckScrub() {
+    std::printf("scrub\n");
+    SimScript script;
+    script.duration = 60 * kSecond;
+    for (int i = 0; i <= 40; ++i) {
+        script.actions.push_back(Action(10 * kSecond + i * 50000, SimActionKind::kSeek, "", i * 2 * kSecond));
+    }
+    SimOptions options;
+    options.slowCallEvery = 0;
+    SimReport report = SimulateSession(script, options);
+    Print(report);
+
+    Check(report.seeks == 41, "every seek reached the session");
+    // With a 300 us hop each way nothing piles up at 50 ms apart; the
+    // mailbox only merges seeks that arrive while Dart is being woken
+    Check(report.seeksDelivered > 0 && report.seeksDelivered <= report.seeks, "the mailbox hands seeks on");
+    Check(report.latencyMax < 10000, "each seek shows within 10 ms");
+    Check(report.finalStateMatches, "the backend ends on the player's state");
+}
+
+void CheckSlowBackend() {
+    std::printf("slow backend\n");
+    SimScript script;
+    script.duration = 120 * kSecond;
+    for (int i = 0; i < 10; ++i) {
+        script.actions.push_back(Action(20 * kSecond + i * 100000, SimActionKind::kControl, "next", 0));
+    }
+    SimOptions options;
+    options.callTime = 400000;
+    options.slowCallEvery = 0;
+    SimReport report = SimulateSession(script, options);
+    Print(report);
+
+    Check(report.tracks == 11, "every skip reached the player");
+    Check(report.collapsed > 0 && report.stateCommits < report.submitted,
+          "skips queued behind a slow commit are collapsed");
+    Check(report.queueHighWater > 1, "and the queue saw them waiting");
+    Check(report.finalStateMatches, "the last track is the one shown");
+}
+
+void CheckRestart() {
+    std::printf("explorer restart\n");
+    SimScript script;
+    script.duration = 300 * kSecond;
+    script.actions.push_back(Action(60 * kSecond, SimActionKind::kSurfaceRestart, "", 10 * kSecond));
+    script.actions.push_back(Action(63 * kSecond, SimActionKind::kControl, "next", 0));
+    script.actions.push_back(Action(120 * kSecond, SimActionKind::kControl, "next", 0));
+    SimOptions options;
+    options.slowCallEvery = 0;
+    SimReport report = SimulateSession(script, options);
+    Print(report);
+
+    Check(report.droppedActions == 1, "a press while the surface is gone goes nowhere");
+    Check(report.failedCalls > 0 && report.recoveries == 1, "the dead handler is noticed and rebuilt once");
+    // Retries 1, 2, 4 and 8 s apart; the surface is back within the last gap
+    Check(report.recoveryMax > 0 && report.recoveryMax <= options.watchdog.retryInterval * 8,
+          "backoff rebuilds it within one retry interval of the surface returning");
+    Check(report.controls == 1 && report.finalStateMatches, "presses after the rebuild work");
+}
+
+void CheckListeningSession(const ListeningSessionOptions& session, const SimOptions& options) {
+    std::printf("listening session, %.1f h\n", session.duration / 3.6e9);
+    SimScript script = ScriptListeningSession(session);
+    SimReport report = SimulateSession(script, options);
+    Print(report);
+    SimReport again = SimulateSession(script, options);
+
+    Check(Same(report, again), "a second run gives the same report");
+    Check(report.wallMicros < 2 * kSecond, "and takes under two seconds");
+    Check(report.finalStateMatches, "the backend ends on the player's state");
+    Check(report.surfaceRestarts == 0 || report.recoveries > 0, "Explorer restarts are recovered from");
+    Check(report.idleReleases > 0, "resources are released once stopped");
+    Check(report.memoryEnd < report.memoryPeak, "and memory drops below its high water");
+
+    // Without surface activity a playing session publishes every idle
+    // interval; presses, seeks and state changes add a few on top
+    int64_t floor = session.duration / options.timeline.idleInterval;
+    Check(report.timelineWakeups < static_cast<uint64_t>(floor) * 3, "timeline wakeups stay near one per idle interval");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    ListeningSessionOptions session;
+    SimOptions options;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--hours=", 8) == 0) {
+            session.duration = static_cast<int64_t>(std::atof(argv[i] + 8) * 3600 * kSecond);
+        } else if (std::strncmp(argv[i], "--seed=", 7) == 0) {
+            session.seed = std::strtoull(argv[i] + 7, nullptr, 10);
+        } else if (std::strncmp(argv[i], "--call-us=", 10) == 0) {
+            options.callTime = std::atoll(argv[i] + 10);
+        } else {
+            std::fprintf(stderr, "usage: %s [--hours=N] [--seed=N] [--call-us=N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    CheckExecutor();
+    CheckScrub();
+    CheckSlowBackend();
+    CheckRestart();
+    CheckListeningSession(session, options);
+
+    std::printf("%s\n", g_failures == 0 ? "all checks passed" : "FAILED");
+    return g_failures == 0 ? 0 : 1;
+}
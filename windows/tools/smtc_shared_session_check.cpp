@@ -0,0 +1,194 @@
+// Multi-engine test for SharedSession, the process-wide owner of the
+// backend session. Simulated engines attach and detach the way the plugins
+// do on initialize and teardown, each writing only while it drives, as
+// driven_session() allows. Checks creation by the first attachment and
+// destruction with the last, failed creation, driver order and promotion
+// (the listener runs once, for the oldest remaining attachment), and then
+// has threads churn attachments and write through whichever drives,
+// checking that no two sessions ever exist at once and that every session
+// built is destroyed.
+// Needs no Windows or Flutter headers. Build it as C++17 with -Ismtc_windows
+// and -pthread; shared_session.h is header-only.
+//
+// Usage: smtc_shared_session_check [--threads=N] [--rounds=N]
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "shared_session.h"
+
+using namespace audio_service_smtc;
+
+namespace {
+
+int g_failures = 0;
+
+void Check(bool ok, const char* what) {
+    std::printf("%s  %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok) ++g_failures;
+}
+
+// Counts live instances, as a second SMTC handler would be a bug
+class FakeSession {
+public:
+    static std::atomic<int> alive;
+    static std::atomic<int> maxAlive;
+    static std::atomic<uint64_t> built;
+
+    FakeSession() {
+        int now = alive.fetch_add(1) + 1;
+        int seen = maxAlive.load();
+        while (now > seen && !maxAlive.compare_exchange_weak(seen, now)) {
+        }
+        built.fetch_add(1);
+    }
+
+    ~FakeSession() { alive.fetch_sub(1); }
+
+    void Write(uint64_t engine) {
+        writes.fetch_add(1);
+        lastWriter.store(engine);
+    }
+
+    std::atomic<uint64_t> writes{ 0 };
+    std::atomic<uint64_t> lastWriter{ 0 };
+};
+
+std::atomic<int> FakeSession::alive{ 0 };
+std::atomic<int> FakeSession::maxAlive{ 0 };
+std::atomic<uint64_t> FakeSession::built{ 0 };
+
+using Registry = SharedSession<FakeSession>;
+
+std::shared_ptr<FakeSession> Create() {
+    return std::make_shared<FakeSession>();
+}
+
+// One Flutter engine's plugin instance
+struct Engine {
+    std::unique_ptr<Registry::Attachment> attachment;
+    std::atomic<int> promotions{ 0 };
+
+    void Attach(Registry& registry) {
+        attachment = registry.Attach(Create, [this](FakeSession&) { promotions.fetch_add(1); });
+    }
+
+    // Writes land only while this engine drives
+    bool Write() {
+        if (!attachment || !attachment->IsDriver()) return false;
+        attachment->session().Write(attachment->id());
+        return true;
+    }
+};
+
+void CheckLifetime() {
+    Registry registry;
+    {
+        Engine first;
+        first.Attach(registry);
+        Check(FakeSession::alive.load() == 1 && first.promotions.load() == 1,
+              "the first attachment builds the session and drives");
+
+        Engine second;
+        second.Attach(registry);
+        Engine third;
+        third.Attach(registry);
+        Check(FakeSession::built.load() == 1 && registry.Attachments() == 3,
+              "later attachments share the session");
+        Check(first.Write() && !second.Write() && !third.Write(), "only the driver writes");
+        Check(&first.attachment->session() == &third.attachment->session(), "every engine sees the same session");
+
+        // The middle engine going away changes nothing
+        second.attachment.reset();
+        Check(registry.DriverId() == first.attachment->id() && third.promotions.load() == 0,
+              "a detaching follower leaves the driver in place");
+
+        first.attachment.reset();
+        Check(third.promotions.load() == 1 && third.Write(), "the oldest remaining attachment is promoted");
+        Check(FakeSession::alive.load() == 1, "the session outlives its first engine");
+
+        third.attachment.reset();
+        Check(FakeSession::alive.load() == 0 && registry.Attachments() == 0 && registry.DriverId() == 0,
+              "the last detach destroys the session");
+    }
+
+    Engine again;
+    again.Attach(registry);
+    Check(FakeSession::alive.load() == 1 && FakeSession::built.load() == 2, "a later attach builds a new session");
+    again.attachment.reset();
+
+    auto failed = registry.Attach([] { return std::shared_ptr<FakeSession>(); });
+    Check(!failed && registry.Attachments() == 0, "failed creation attaches nothing");
+    Engine after;
+    after.Attach(registry);
+    Check(after.attachment && after.Write(), "an attach after a failed one succeeds");
+}
+
+void CheckChurn(int threads, int rounds) {
+    Registry registry;
+    const uint64_t builtBefore = FakeSession::built.load();
+    FakeSession::maxAlive.store(FakeSession::alive.load());
+
+    // A long-lived engine keeps the session up for part of the run
+    Engine anchor;
+    anchor.Attach(registry);
+
+    std::atomic<uint64_t> writes{ 0 };
+    std::atomic<uint64_t> promotions{ 0 };
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            for (int round = 0; round < rounds; ++round) {
+                Engine engine;
+                engine.Attach(registry);
+                for (int i = 0; i < 4; ++i) {
+                    if (engine.Write()) writes.fetch_add(1);
+                }
+                promotions.fetch_add(static_cast<uint64_t>(engine.promotions.load()));
+                engine.attachment.reset();
+                if (t == 0 && round == rounds / 2) anchor.attachment.reset();
+            }
+        });
+    }
+    for (std::thread& worker : workers) worker.join();
+
+    std::printf("  %d threads x %d attachments: %llu sessions built, %llu promotions, %llu writes landed\n", threads,
+                rounds, static_cast<unsigned long long>(FakeSession::built.load() - builtBefore),
+                static_cast<unsigned long long>(promotions.load() + anchor.promotions.load()),
+                static_cast<unsigned long long>(writes.load()));
+    Check(FakeSession::maxAlive.load() <= 1, "no two sessions ever exist at once");
+    Check(FakeSession::alive.load() == 0 && registry.Attachments() == 0, "every session built is destroyed");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int threads = 8;
+    int rounds = 20000;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--threads=", 10) == 0) {
+            threads = std::atoi(argv[i] + 10);
+        } else if (std::strncmp(argv[i], "--rounds=", 9) == 0) {
+            rounds = std::atoi(argv[i] + 9);
+        } else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (threads <= 0 || rounds <= 0) {
+        std::fprintf(stderr, "counts must be positive\n");
+        return 2;
+    }
+
+    CheckLifetime();
+    CheckChurn(threads, rounds);
+
+    std::printf("%s\n", g_failures == 0 ? "all checks passed" : "FAILED");
+    return g_failures == 0 ? 0 : 1;
+}
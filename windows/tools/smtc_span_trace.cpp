@@ -0,0 +1,557 @@
+// Checks the span recorder and both trace exporters: spans nest and keep
+// their labels and arguments, a ring keeps the newest spans once it wraps,
+// threads record while another dumps, contended locks show their wait, and
+// the Chrome JSON parses and the Perfetto protobuf decodes with properly
+// nested slices on every track. Also reports what a span costs with
+// recording off and on.
+//
+// Needs no Windows or Flutter headers. Build it as C++17 with -Ismtc_windows
+// and -pthread together with these sources from smtc_windows/: span_tracer,
+// native_log, memory_budget and event_dispatcher.
+//
+// Usage: smtc_span_trace [--out=DIR]
+// With --out, a sample trace is left in DIR as spans.json and
+// spans.perfetto-trace for opening in ui.perfetto.dev.
+
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "span_tracer.h"
+
+using namespace audio_service_smtc;
+
+namespace {
+
+int g_failures = 0;
+
+void Check(bool ok, const char* what) {
+    std::printf("%s  %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok) ++g_failures;
+}
+
+void Spin(std::chrono::microseconds time) {
+    auto until = std::chrono::steady_clock::now() + time;
+    while (std::chrono::steady_clock::now() < until) {}
+}
+
+const SpanThread* FindThread(const std::vector<SpanThread>& threads, const char* name) {
+    for (const SpanThread& thread : threads) {
+        if (thread.name == name) return &thread;
+    }
+    return nullptr;
+}
+
+bool Encloses(const SpanRecord& outer, const SpanRecord& inner) {
+    return outer.start <= inner.start && inner.start + inner.duration <= outer.start + outer.duration;
+}
+
+// Just enough of a JSON parser to tell whether the text is valid
+class JsonChecker {
+public:
+    explicit JsonChecker(const std::string& text) : _text(text) {}
+
+    bool Valid() {
+        SkipSpace();
+        if (!Value()) return false;
+        SkipSpace();
+        return _at == _text.size();
+    }
+
+private:
+    void SkipSpace() {
+        while (_at < _text.size() && std::strchr(" \t\r\n", _text[_at])) ++_at;
+    }
+
+    bool Literal(const char* word) {
+        size_t length = std::strlen(word);
+        if (_text.compare(_at, length, word) != 0) return false;
+        _at += length;
+        return true;
+    }
+
+    bool String() {
+        if (_text[_at] != '"') return false;
+        for (++_at; _at < _text.size(); ++_at) {
+            char c = _text[_at];
+            if (c == '"') {
+                ++_at;
+                return true;
+            }
+            if (static_cast<unsigned char>(c) < 0x20) return false;
+            if (c == '\\') {
+                ++_at;
+                if (_at >= _text.size()) return false;
+                if (_text[_at] == 'u') {
+                    for (int i = 0; i < 4; ++i) {
+                        if (++_at >= _text.size() || !std::isxdigit(static_cast<unsigned char>(_text[_at]))) return false;
+                    }
+                } else if (!std::strchr("\"\\/bfnrt", _text[_at])) {
+                    return false;
+                }
+            }
+        }
+        return false;
+    }
+
+    bool Number() {
+        size_t start = _at;
+        if (_text[_at] == '-') ++_at;
+        while (_at < _text.size() && std::isdigit(static_cast<unsigned char>(_text[_at]))) ++_at;
+        if (_at < _text.size() && _text[_at] == '.') {
+            ++_at;
+            while (_at < _text.size() && std::isdigit(static_cast<unsigned char>(_text[_at]))) ++_at;
+        }
+        return _at > start && std::isdigit(static_cast<unsigned char>(_text[_at - 1]));
+    }
+
+    template <typename Item>
+    bool Sequence(char close, Item item) {
+        ++_at;
+        SkipSpace();
+        if (_at < _text.size() && _text[_at] == close) {
+            ++_at;
+            return true;
+        }
+        while (_at < _text.size()) {
+            if (!item()) return false;
+            SkipSpace();
+            if (_at < _text.size() && _text[_at] == close) {
+                ++_at;
+                return true;
+            }
+            if (_at >= _text.size() || _text[_at] != ',') return false;
+            ++_at;
+            SkipSpace();
+        }
+        return false;
+    }
+
+    bool Value() {
+        if (_at >= _text.size()) return false;
+        switch (_text[_at]) {
+        case '{':
+            return Sequence('}', [this] {
+                if (!String()) return false;
+                SkipSpace();
+                if (_at >= _text.size() || _text[_at] != ':') return false;
+                ++_at;
+                SkipSpace();
+                return Value();
+            });
+        case '[':
+            return Sequence(']', [this] { return Value(); });
+        case '"':
+            return String();
+        case 't':
+            return Literal("true");
+        case 'f':
+            return Literal("false");
+        case 'n':
+            return Literal("null");
+        default:
+            return Number();
+        }
+    }
+
+    const std::string& _text;
+    size_t _at = 0;
+};
+
+// Reads protobuf fields off a byte range
+class ProtoReader {
+public:
+    ProtoReader(const std::string& bytes, size_t begin, size_t end) : _bytes(bytes), _at(begin), _end(end) {}
+
+    struct Field {
+        uint32_t number = 0;
+        uint32_t wireType = 0;
+        uint64_t value = 0;             // varint
+        size_t begin = 0, end = 0;      // length-delimited
+    };
+
+    bool Next(Field* field, bool* damaged) {
+        if (_at >= _end) return false;
+        uint64_t key;
+        if (!Varint(&key)) return Fail(damaged);
+        field->number = static_cast<uint32_t>(key >> 3);
+        field->wireType = static_cast<uint32_t>(key & 7);
+        if (field->wireType == 0) {
+            if (!Varint(&field->value)) return Fail(damaged);
+        } else if (field->wireType == 2) {
+            uint64_t length;
+            if (!Varint(&length) || length > _end - _at) return Fail(damaged);
+            field->begin = _at;
+            field->end = _at + static_cast<size_t>(length);
+            _at = field->end;
+        } else {
+            return Fail(damaged);
+        }
+        return true;
+    }
+
+private:
+    bool Varint(uint64_t* value) {
+        *value = 0;
+        for (int shift = 0; shift < 64 && _at < _end; shift += 7) {
+            uint8_t byte = static_cast<uint8_t>(_bytes[_at++]);
+            *value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return true;
+        }
+        return false;
+    }
+
+    bool Fail(bool* damaged) {
+        *damaged = true;
+        return false;
+    }
+
+    const std::string& _bytes;
+    size_t _at;
+    size_t _end;
+};
+
+// What a Perfetto trace says, per track
+struct PerfettoSummary {
+    bool damaged = false;
+    bool nested = true;         // every end closes a begin on its track, in time order
+    size_t threadTracks = 0;
+    size_t slices = 0;
+    std::map<uint64_t, std::string> threadNames;  // by track uuid
+    std::vector<std::string> names;               // slice names, in order
+};
+
+PerfettoSummary DecodePerfetto(const std::string& bytes) {
+    PerfettoSummary summary;
+    std::map<uint64_t, std::vector<uint64_t>> open;  // track -> begin timestamps
+    std::map<uint64_t, uint64_t> last;               // track -> last timestamp
+    ProtoReader trace(bytes, 0, bytes.size());
+    ProtoReader::Field packet;
+    while (trace.Next(&packet, &summary.damaged)) {
+        if (packet.number != 1 || packet.wireType != 2) {
+            summary.damaged = true;
+            break;
+        }
+        uint64_t timestamp = 0;
+        ProtoReader fields(bytes, packet.begin, packet.end);
+        ProtoReader::Field field;
+        while (fields.Next(&field, &summary.damaged)) {
+            if (field.number == 8) timestamp = field.value;
+            if (field.number == 60) {
+                uint64_t uuid = 0;
+                ProtoReader track(bytes, field.begin, field.end);
+                ProtoReader::Field item;
+                while (track.Next(&item, &summary.damaged)) {
+                    if (item.number == 1) uuid = item.value;
+                    if (item.number != 4) continue;
+                    ++summary.threadTracks;
+                    ProtoReader thread(bytes, item.begin, item.end);
+                    ProtoReader::Field detail;
+                    while (thread.Next(&detail, &summary.damaged)) {
+                        if (detail.number == 5) {
+                            summary.threadNames[uuid] = bytes.substr(detail.begin, detail.end - detail.begin);
+                        }
+                    }
+                }
+            }
+            if (field.number == 11) {
+                uint64_t type = 0, track = 0;
+                std::string name;
+                ProtoReader event(bytes, field.begin, field.end);
+                ProtoReader::Field item;
+                while (event.Next(&item, &summary.damaged)) {
+                    if (item.number == 9) type = item.value;
+                    if (item.number == 11) track = item.value;
+                    if (item.number == 23) name = bytes.substr(item.begin, item.end - item.begin);
+                }
+                if (last.count(track) && timestamp < last[track]) summary.nested = false;
+                last[track] = timestamp;
+                if (type == 1) {
+                    open[track].push_back(timestamp);
+                    summary.names.push_back(name);
+                    ++summary.slices;
+                } else if (type == 2) {
+                    if (open[track].empty() || open[track].back() > timestamp) summary.nested = false;
+                    if (!open[track].empty()) open[track].pop_back();
+                } else {
+                    summary.nested = false;
+                }
+            }
+        }
+    }
+    for (const auto& [track, begins] : open) {
+        if (!begins.empty()) summary.nested = false;
+    }
+    return summary;
+}
+
+void CheckNesting() {
+    StartSpans();
+    SetSpanThreadName("nesting");
+    {
+        SMTC_SPAN_LABELLED(call, "channel", "HandleMethodCall", "updateMetadata");
+        Spin(std::chrono::microseconds(50));
+        {
+            SMTC_SPAN(decode, "channel", "DecodeArgs");
+            decode.SetArg(5);
+            Spin(std::chrono::microseconds(20));
+        }
+        {
+            SMTC_SPAN(commit, "state", "CommitState");
+            Spin(std::chrono::microseconds(20));
+        }
+    }
+    {
+        // Cut to 24 bytes at a character boundary: "é" would straddle it
+        SMTC_SPAN_LABELLED(labelled, "channel", "HandleMethodCall", "abcdefghijklmnopqrstuvwé");
+    }
+    std::vector<SpanThread> threads = CollectSpans();
+    const SpanThread* thread = FindThread(threads, "nesting");
+
+    Check(thread && thread->spans.size() == 4, "every span is recorded once, on its thread");
+    if (!thread || thread->spans.size() != 4) return;
+    const std::vector<SpanRecord>& spans = thread->spans;
+    Check(std::strcmp(spans[0].site->name, "HandleMethodCall") == 0 && spans[0].label == "updateMetadata" &&
+              std::strcmp(spans[1].site->name, "DecodeArgs") == 0 &&
+              std::strcmp(spans[2].site->name, "CommitState") == 0,
+          "spans come out by start time, enclosing ones first");
+    Check(Encloses(spans[0], spans[1]) && Encloses(spans[0], spans[2]) && !Encloses(spans[1], spans[2]),
+          "inner spans lie within the span around them");
+    Check(spans[1].hasArg && spans[1].arg == 5 && !spans[0].hasArg && !spans[2].hasArg,
+          "arguments are kept, and only where set");
+    Check(spans[0].duration >= 90000, "durations are in nanoseconds");
+    Check(spans[3].label == "abcdefghijklmnopqrstuvw", "long labels are cut without splitting a character");
+}
+
+void CheckRecordingSwitch() {
+    StopSpans();
+    SetSpanThreadName("switch");
+    {
+        SMTC_SPAN(off, "test", "while off");
+    }
+    StartSpans();
+    {
+        SMTC_SPAN(on, "test", "while on");
+    }
+    std::vector<SpanThread> threads = CollectSpans();
+    const SpanThread* thread = FindThread(threads, "switch");
+    Check(thread && thread->spans.size() == 1 && std::strcmp(thread->spans[0].site->name, "while on") == 0,
+          "nothing is recorded while off");
+    Check(!FindThread(threads, "nesting"), "starting again discards what was recorded before");
+
+    StopSpans();
+    Check(!CollectSpans().empty(), "stopping keeps the spans for a dump");
+}
+
+void CheckWrap() {
+    StartSpans();
+    SetSpanThreadName("wrap");
+    for (int i = 0; i < 3000; ++i) {
+        SMTC_SPAN(span, "test", "wrap");
+        span.SetArg(i);
+    }
+    std::vector<SpanThread> threads = CollectSpans();
+    const SpanThread* thread = FindThread(threads, "wrap");
+    bool newest = thread && !thread->spans.empty() && thread->spans.back().arg == 2999;
+    bool contiguous = thread != nullptr;
+    if (thread) {
+        for (size_t i = 1; i < thread->spans.size(); ++i) {
+            if (thread->spans[i].arg != thread->spans[i - 1].arg + 1) contiguous = false;
+        }
+    }
+    std::printf("      ring keeps %zu of 3000 spans\n", thread ? thread->spans.size() : size_t{ 0 });
+    Check(newest && contiguous && thread->spans.size() < 3000, "a full ring keeps the newest spans, without gaps");
+}
+
+void CheckThreads() {
+    StartSpans();
+    constexpr int kThreads = 4;
+    static const char* const kNames[kThreads] = { "worker 0", "worker 1", "worker 2", "worker 3" };
+    std::atomic<bool> stop{ false };
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([t, &stop] {
+            SetSpanThreadName(kNames[t]);
+            for (int64_t i = 0; !stop.load(std::memory_order_relaxed); ++i) {
+                SMTC_SPAN(outer, "worker", "task");
+                outer.SetArg(i);
+                SMTC_SPAN_LABELLED(inner, "worker", "step", kNames[t]);
+            }
+        });
+    }
+
+    // Dump while they record: every span read must be whole
+    bool whole = true;
+    size_t dumps = 0;
+    auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(200);
+    while (std::chrono::steady_clock::now() < until) {
+        for (const SpanThread& thread : CollectSpans()) {
+            for (const SpanRecord& span : thread.spans) {
+                bool task = std::strcmp(span.site->name, "task") == 0;
+                bool step = std::strcmp(span.site->name, "step") == 0 && span.label == thread.name;
+                if ((!task && !step) || span.duration < 0 || task != span.hasArg) whole = false;
+            }
+        }
+        ++dumps;
+    }
+    stop = true;
+    for (std::thread& thread : threads) thread.join();
+
+    std::vector<SpanThread> after = CollectSpans();
+    bool all = true;
+    for (const char* name : kNames) {
+        if (!FindThread(after, name)) all = false;
+    }
+    std::printf("      %zu dumps taken while 4 threads recorded\n", dumps);
+    Check(whole, "spans read while being overwritten are never torn");
+    Check(all, "spans of exited threads are still dumped");
+}
+
+void CheckLockWait() {
+    StartSpans();
+    SetSpanThreadName("locker");
+    static constexpr SpanSite kWait{ "lock", "wait" };
+    std::mutex mutex;
+    {
+        auto lock = LockWithSpan(mutex, kWait, "uncontended");
+    }
+    std::atomic<bool> held{ false };
+    std::thread holder([&] {
+        std::lock_guard<std::mutex> lock(mutex);
+        held = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    });
+    while (!held) std::this_thread::yield();
+    {
+        auto lock = LockWithSpan(mutex, kWait, "contended");
+        Check(lock.owns_lock(), "the lock is taken either way");
+    }
+    holder.join();
+
+    std::vector<SpanThread> threads = CollectSpans();
+    const SpanThread* thread = FindThread(threads, "locker");
+    Check(thread && thread->spans.size() == 1 && thread->spans[0].label == "contended" &&
+              thread->spans[0].duration >= 10000000,
+          "only a lock that had to wait records a span, as long as the wait");
+}
+
+void CheckExport(const char* outDir) {
+    StartSpans();
+    SetSpanThreadName("export \"quoted\"\n");
+    {
+        SMTC_SPAN_LABELLED(call, "channel", "HandleMethodCall", "back\\slash\t\"");
+        SMTC_SPAN(inner, "backend", "Update");
+        inner.SetArg(-7);
+    }
+    std::thread other([] {
+        SetSpanThreadName("other");
+        for (int i = 0; i < 3; ++i) {
+            SMTC_SPAN(outer, "worker", "task");
+            SMTC_SPAN(inner, "artwork", "fetch");
+        }
+    });
+    other.join();
+    std::vector<SpanThread> threads = CollectSpans();
+
+    std::string json;
+    WriteChromeTrace(threads, &json);
+    size_t events = 0;
+    for (size_t at = json.find("\"ph\":\"X\""); at != std::string::npos; at = json.find("\"ph\":\"X\"", at + 1)) {
+        ++events;
+    }
+    Check(JsonChecker(json).Valid(), "the Chrome trace is valid JSON, odd labels included");
+    Check(events == 8, "with one complete event per span");
+
+    std::string proto;
+    WritePerfettoTrace(threads, &proto);
+    PerfettoSummary summary = DecodePerfetto(proto);
+    bool named = false;
+    for (const auto& [uuid, name] : summary.threadNames) {
+        if (name == "other") named = true;
+    }
+    Check(!summary.damaged, "the Perfetto trace decodes as protobuf");
+    Check(summary.slices == 8 && summary.threadTracks == 2 && named, "with a named track per thread and a slice per span");
+    Check(summary.nested, "slices begin and end in order and nest on every track");
+    Check(summary.names.size() == 8 && summary.names[0] == "HandleMethodCall" && summary.names[1] == "Update",
+          "enclosing slices begin first");
+
+    // Stack clamping: an inner span that outlasts the one around it
+    SpanSite outerSite{ "test", "outer" }, innerSite{ "test", "inner" };
+    SpanThread skewed;
+    skewed.id = 99;
+    skewed.spans.push_back({ &outerSite, 1000, 500, 0, false, {} });
+    skewed.spans.push_back({ &innerSite, 1200, 800, 0, false, {} });
+    skewed.spans.push_back({ &innerSite, 1500, 10, 0, false, {} });
+    std::string skewedProto;
+    WritePerfettoTrace({ skewed }, &skewedProto);
+    Check(DecodePerfetto(skewedProto).nested, "overlapping spans are clamped so slices still nest");
+
+    if (outDir) {
+        std::string base = outDir;
+        bool written = DumpSpans(base + "/spans.json") && DumpSpans(base + "/spans.perfetto-trace");
+        Check(written, "both formats are written out");
+    }
+    Check(SpanFormatForPath("a/spans.json") == SpanFormat::kChrome &&
+              SpanFormatForPath("spans.perfetto-trace") == SpanFormat::kPerfetto &&
+              SpanFormatForPath("json") == SpanFormat::kPerfetto,
+          "the format follows the file extension");
+}
+
+template <typename Body>
+double NanosPerIteration(Body body) {
+    constexpr int kIterations = 2000000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIterations; ++i) body(i);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / kIterations;
+}
+
+void MeasureOverhead() {
+    std::atomic<int64_t> sink{ 0 };
+    auto bare = [&](int i) { sink.fetch_add(i, std::memory_order_relaxed); };
+    auto spanned = [&](int i) {
+        SMTC_SPAN_LABELLED(span, "bench", "span", "updateTimeline");
+        sink.fetch_add(i, std::memory_order_relaxed);
+    };
+    StopSpans();
+    double base = NanosPerIteration(bare);
+    double off = NanosPerIteration(spanned);
+    StartSpans();
+    double on = NanosPerIteration(spanned);
+    StopSpans();
+    std::printf("      per span: %.1f ns off, %.1f ns on (loop body alone %.1f ns)\n", off - base, on - base, base);
+    // Relative, so it holds in sanitizer and debug builds too
+    Check(off - base < (on - base) / 10, "a span costs next to nothing while recording is off");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const char* outDir = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--out=", 6) == 0) {
+            outDir = argv[i] + 6;
+        } else {
+            std::fprintf(stderr, "usage: %s [--out=DIR]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    CheckNesting();
+    CheckRecordingSwitch();
+    CheckWrap();
+    CheckThreads();
+    CheckLockWait();
+    CheckExport(outDir);
+    MeasureOverhead();
+
+    std::printf("%s\n", g_failures == 0 ? "all checks passed" : "FAILED");
+    return g_failures == 0 ? 0 : 1;
+}
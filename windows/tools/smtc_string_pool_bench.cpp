@@ -0,0 +1,288 @@
+// Benchmark for interning artist and album in the StringPool. Holds a queue
+// of media items as MediaMetadata, whose artist and album are
+// InternedString handles, and as the same struct with plain std::string
+// fields, and drives each through the update path: decoded from the
+// plugin's strings (through MakeMetadata when interned), merged into the pending patch, taken, diffed into the
+// committed state and copied to the shown state, as UpdateQueue,
+// PlayerStateStore and SmtcWindows do. Reports the queue's footprint, the
+// allocations and time per update in album order and shuffled, and checks
+// that interned values read back intact, that each distinct string is
+// stored once, and that the pool gives its strings back with the queue.
+// Allocations are counted by replacing the global operator new.
+// Needs no Windows or Flutter headers. Build it as C++17 with -Ismtc_windows
+// and -pthread, together with these sources from smtc_windows/: string_pool,
+// player_state, timeline_publisher, position_estimator, span_tracer,
+// event_dispatcher, memory_budget and native_log.
+//
+// Usage: smtc_string_pool_bench [--items=N] [--artists=N] [--albums=N]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "player_state.h"
+#include "string_pool.h"
+
+using namespace audio_service_smtc;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+std::atomic<uint64_t> g_allocations{ 0 };
+std::atomic<int64_t> g_liveBytes{ 0 };
+
+// Each block carries its size ahead of it, so frees can be subtracted
+constexpr size_t kHeader = alignof(std::max_align_t);
+
+void* CountedAllocate(size_t size) {
+    void* block = std::malloc(size + kHeader);
+    if (!block) throw std::bad_alloc();
+    *static_cast<size_t*>(block) = size;
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    g_liveBytes.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed);
+    return static_cast<char*>(block) + kHeader;
+}
+
+void CountedFree(void* pointer) {
+    if (!pointer) return;
+    void* block = static_cast<char*>(pointer) - kHeader;
+    g_liveBytes.fetch_sub(static_cast<int64_t>(*static_cast<size_t*>(block)), std::memory_order_relaxed);
+    std::free(block);
+}
+
+}  // namespace
+
+void* operator new(size_t size) {
+    return CountedAllocate(size);
+}
+
+void* operator new[](size_t size) {
+    return CountedAllocate(size);
+}
+
+void operator delete(void* pointer) noexcept {
+    CountedFree(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    CountedFree(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    CountedFree(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    CountedFree(pointer);
+}
+
+namespace {
+
+int g_failures = 0;
+
+void Check(bool ok, const char* what) {
+    std::printf("%s  %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok) ++g_failures;
+}
+
+// xorshift64*, fixed seed so failures reproduce
+class Random {
+public:
+    explicit Random(uint64_t seed) : _state(seed) {}
+
+    uint64_t Next() {
+        _state ^= _state >> 12;
+        _state ^= _state << 25;
+        _state ^= _state >> 27;
+        return _state * 0x2545F4914F6CDD1DULL;
+    }
+
+private:
+    uint64_t _state;
+};
+
+// MediaMetadata as it was before interning
+struct PlainMetadata {
+    std::string title;
+    std::string artist;
+    std::string album;
+    std::string artUrl;
+    int64_t duration = 0;
+
+    bool operator==(const PlainMetadata& other) const {
+        return duration == other.duration && title == other.title && artist == other.artist &&
+               album == other.album && artUrl == other.artUrl;
+    }
+    bool operator!=(const PlainMetadata& other) const { return !(*this == other); }
+};
+
+// The strings a decoded applyState hands over
+struct Item {
+    std::string title;
+    std::string artist;
+    std::string album;
+    std::string artUrl;
+    int64_t duration;
+};
+
+// A library in album order: each album by one artist, tracks in sequence
+std::vector<Item> MakeItems(int items, int artists, int albums) {
+    std::vector<Item> queue;
+    queue.reserve(static_cast<size_t>(items));
+    int tracksPerAlbum = (std::max)(1, items / albums);
+    for (int i = 0; i < items; ++i) {
+        int album = (i / tracksPerAlbum) % albums;
+        int artist = album % artists;
+        queue.push_back(Item{
+            "Track " + std::to_string(i % tracksPerAlbum + 1) + " of album " + std::to_string(album),
+            "The Example Artist No. " + std::to_string(artist),
+            "Collected Recordings, Volume " + std::to_string(album),
+            "https://cdn.example.com/covers/" + std::to_string(album) + ".jpg",
+            180000000 + i % 60 * 1000000,
+        });
+    }
+    return queue;
+}
+
+// The plugin's decode: plain copies, or MakeMetadata's interning
+template <typename Metadata>
+Metadata Decode(const Item& item);
+
+template <>
+PlainMetadata Decode<PlainMetadata>(const Item& item) {
+    return PlainMetadata{ item.title, item.artist, item.album, item.artUrl, item.duration };
+}
+
+template <>
+MediaMetadata Decode<MediaMetadata>(const Item& item) {
+    return MakeMetadata(item.title, item.artist, item.album, item.artUrl, item.duration);
+}
+
+// PlayerStatePatch::Merge and PlayerStateStore::Apply, reduced to metadata
+template <typename Metadata>
+struct Pipeline {
+    std::optional<Metadata> pending;
+    Metadata committed;
+    Metadata shown;
+
+    void Update(const Item& item) {
+        std::optional<Metadata> decoded = Decode<Metadata>(item);
+        if (decoded) pending = decoded;
+        std::optional<Metadata> taken = std::move(pending);
+        pending.reset();
+        if (taken && *taken != committed) committed = *taken;
+        shown = committed;
+    }
+};
+
+struct UpdateCost {
+    double allocations;
+    double nanos;
+};
+
+template <typename Metadata>
+UpdateCost MeasureUpdates(const std::vector<Item>& items, const std::vector<size_t>& order) {
+    Pipeline<Metadata> pipeline;
+    // Warm the buffers and the pool
+    for (size_t i = 0; i < (std::min)(order.size(), size_t{ 1000 }); ++i) pipeline.Update(items[order[i]]);
+
+    uint64_t allocations = g_allocations.load();
+    Clock::time_point start = Clock::now();
+    for (size_t index : order) pipeline.Update(items[index]);
+    double nanos = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    double count = static_cast<double>(order.size());
+    return UpdateCost{ static_cast<double>(g_allocations.load() - allocations) / count, nanos / count };
+}
+
+template <typename Metadata>
+int64_t QueueBytes(const std::vector<Item>& items, std::vector<Metadata>& queue) {
+    int64_t before = g_liveBytes.load();
+    queue.reserve(items.size());
+    for (const Item& item : items) {
+        queue.push_back(Decode<Metadata>(item));
+    }
+    return g_liveBytes.load() - before;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int items = 50000;
+    int artists = 2000;
+    int albums = 4000;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--items=", 8) == 0) {
+            items = std::atoi(argv[i] + 8);
+        } else if (std::strncmp(argv[i], "--artists=", 10) == 0) {
+            artists = std::atoi(argv[i] + 10);
+        } else if (std::strncmp(argv[i], "--albums=", 9) == 0) {
+            albums = std::atoi(argv[i] + 9);
+        } else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (items <= 0 || artists <= 0 || albums < artists) {
+        std::fprintf(stderr, "counts must be positive and --albums at least --artists\n");
+        return 2;
+    }
+
+    std::vector<Item> source = MakeItems(items, artists, albums);
+    std::printf("%d items, %d artists, %d albums\n", items, artists, albums);
+
+    std::vector<PlainMetadata> plain;
+    int64_t plainBytes = QueueBytes(source, plain);
+    size_t stringsBefore = StringPool::Shared().Stats().strings;
+    std::vector<MediaMetadata> interned;
+    int64_t internedBytes = QueueBytes(source, interned);
+    StringPoolStats pool = StringPool::Shared().Stats();
+    std::printf("queue footprint: std::string %.1f MB (%.0f B/item), interned %.1f MB (%.0f B/item), "
+                "pool arena %zu KB\n",
+                plainBytes / 1e6, static_cast<double>(plainBytes) / items, internedBytes / 1e6,
+                static_cast<double>(internedBytes) / items, pool.arenaBytes / 1024);
+
+    bool intact = true;
+    for (size_t i = 0; i < source.size(); ++i) {
+        intact = intact && interned[i].artist.view() == source[i].artist && interned[i].album.view() == source[i].album;
+    }
+    Check(intact, "interned values read back intact");
+    Check(pool.strings - stringsBefore == static_cast<size_t>((std::min)(albums, items) + (std::min)(artists, items)),
+          "each distinct artist and album is stored once");
+    Check(internedBytes < plainBytes, "the interned queue is smaller");
+
+    std::vector<size_t> order(source.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::vector<size_t> shuffled = order;
+    Random random(11);
+    for (size_t i = shuffled.size() - 1; i > 0; --i) std::swap(shuffled[i], shuffled[random.Next() % (i + 1)]);
+
+    std::printf("per update (decode, merge, commit, shown copy):\n");
+    UpdateCost plainInOrder = MeasureUpdates<PlainMetadata>(source, order);
+    UpdateCost internedInOrder = MeasureUpdates<MediaMetadata>(source, order);
+    UpdateCost plainShuffled = MeasureUpdates<PlainMetadata>(source, shuffled);
+    UpdateCost internedShuffled = MeasureUpdates<MediaMetadata>(source, shuffled);
+    std::printf("  album order: std::string %.2f allocations, %.0f ns; interned %.2f allocations, %.0f ns\n",
+                plainInOrder.allocations, plainInOrder.nanos, internedInOrder.allocations, internedInOrder.nanos);
+    std::printf("  shuffled:    std::string %.2f allocations, %.0f ns; interned %.2f allocations, %.0f ns\n",
+                plainShuffled.allocations, plainShuffled.nanos, internedShuffled.allocations, internedShuffled.nanos);
+    Check(internedInOrder.allocations < plainInOrder.allocations &&
+              internedShuffled.allocations < plainShuffled.allocations,
+          "interning saves allocations per update");
+
+    interned.clear();
+    interned.shrink_to_fit();
+    // MakeMetadata keeps the last artist and album alive
+    Check(StringPool::Shared().Stats().strings <= stringsBefore + 2, "the pool gives strings back with the queue");
+
+    std::printf("%s\n", g_failures == 0 ? "all checks passed" : "FAILED");
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,275 @@
+// Measures the thumbnail encoder on synthetic artwork: a photo-like
+// gradient with grain, flat graphic art, and a logo with transparency, each
+// at a few sizes. Prints bytes out and encode time per JPEG quality, then
+// what FitThumbnail settles on under a few budgets and how many encodes it
+// took. With --write, every encoded file also lands in DIR so a real decoder
+// can check it. Build it as C++17 with -Ismtc_windows, together with
+// smtc_windows/thumbnail_encoder.
+//
+// Usage: smtc_thumbnail_bench [--write=DIR] [--repeat=N]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "thumbnail_encoder.h"
+
+using namespace audio_service_smtc;
+
+namespace {
+
+int g_failures = 0;
+std::string g_writeDir;
+int g_repeat = 5;
+
+void Check(bool ok, const char* what) {
+    std::printf("%s  %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok) ++g_failures;
+}
+
+// Reproducible grain, independent of the platform's rand()
+uint32_t Next(uint32_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+uint8_t Clamp(double value) {
+    return static_cast<uint8_t>(std::min(255.0, std::max(0.0, value)));
+}
+
+RgbaImage Blank(uint32_t width, uint32_t height) {
+    RgbaImage image;
+    image.width = width;
+    image.height = height;
+    image.pixels.assign(static_cast<size_t>(width) * height * 4, 255);
+    return image;
+}
+
+// Smooth lighting over a few soft blobs, with sensor-like noise
+RgbaImage Photo(uint32_t width, uint32_t height) {
+    RgbaImage image = Blank(width, height);
+    uint32_t seed = 0x9e3779b9u;
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            double u = static_cast<double>(x) / width;
+            double v = static_cast<double>(y) / height;
+            double blob = std::exp(-((u - 0.35) * (u - 0.35) + (v - 0.4) * (v - 0.4)) * 12.0);
+            double sky = 1.0 - v;
+            double grain = static_cast<int>(Next(&seed) % 25) - 12;
+            uint8_t* p = &image.pixels[(static_cast<size_t>(y) * width + x) * 4];
+            p[0] = Clamp(60 + 150 * blob + 30 * sky + grain);
+            p[1] = Clamp(40 + 90 * blob + 80 * sky + grain);
+            p[2] = Clamp(70 + 40 * blob + 140 * sky * (0.6 + 0.4 * std::sin(u * 9.0)) + grain);
+        }
+    }
+    return image;
+}
+
+// Album-cover graphics: flat fills, stripes and a hard-edged disc
+RgbaImage Graphic(uint32_t edge) {
+    RgbaImage image = Blank(edge, edge);
+    for (uint32_t y = 0; y < edge; ++y) {
+        for (uint32_t x = 0; x < edge; ++x) {
+            uint8_t* p = &image.pixels[(static_cast<size_t>(y) * edge + x) * 4];
+            int64_t dx = static_cast<int64_t>(x) - edge / 2;
+            int64_t dy = static_cast<int64_t>(y) - edge / 2;
+            bool disc = dx * dx + dy * dy < static_cast<int64_t>(edge) * edge / 9;
+            bool stripe = (y * 8 / edge) % 2 == 0;
+            p[0] = disc ? 230 : (stripe ? 20 : 245);
+            p[1] = disc ? 60 : (stripe ? 30 : 200);
+            p[2] = disc ? 40 : (stripe ? 90 : 40);
+        }
+    }
+    return image;
+}
+
+// A round badge on a transparent background with an anti-aliased rim
+RgbaImage Logo(uint32_t edge) {
+    RgbaImage image = Blank(edge, edge);
+    double radius = edge * 0.42;
+    for (uint32_t y = 0; y < edge; ++y) {
+        for (uint32_t x = 0; x < edge; ++x) {
+            uint8_t* p = &image.pixels[(static_cast<size_t>(y) * edge + x) * 4];
+            double dx = x + 0.5 - edge / 2.0;
+            double dy = y + 0.5 - edge / 2.0;
+            double distance = std::sqrt(dx * dx + dy * dy);
+            bool ring = std::fabs(distance - radius * 0.7) < edge * 0.04;
+            p[0] = ring ? 255 : 30;
+            p[1] = ring ? 255 : 120;
+            p[2] = ring ? 255 : 220;
+            p[3] = Clamp((radius - distance + 0.5) * 255.0);
+        }
+    }
+    return image;
+}
+
+struct Sample {
+    const char* name;
+    RgbaImage image;
+};
+
+void Write(const std::string& name, const std::vector<uint8_t>& bytes) {
+    if (g_writeDir.empty()) return;
+    std::string path = g_writeDir + "/" + name;
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        std::fprintf(stderr, "cannot write %s\n", path.c_str());
+        ++g_failures;
+        return;
+    }
+    std::fwrite(bytes.data(), 1, bytes.size(), file);
+    std::fclose(file);
+}
+
+// Best of g_repeat, in microseconds
+template <typename Encode>
+double Time(Encode encode) {
+    double best = 1e30;
+    for (int i = 0; i < g_repeat; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        encode();
+        std::chrono::duration<double, std::micro> took = std::chrono::steady_clock::now() - start;
+        best = std::min(best, took.count());
+    }
+    return best;
+}
+
+bool IsJpeg(const std::vector<uint8_t>& bytes) {
+    return bytes.size() > 4 && bytes[0] == 0xFF && bytes[1] == 0xD8 && bytes[bytes.size() - 2] == 0xFF &&
+           bytes.back() == 0xD9;
+}
+
+bool IsPng(const std::vector<uint8_t>& bytes) {
+    static const uint8_t kSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    return bytes.size() > 8 && std::memcmp(bytes.data(), kSignature, 8) == 0;
+}
+
+void BenchEncoders(const std::vector<Sample>& samples) {
+    static const int kQualities[] = { 40, 60, 75, 90 };
+    std::printf("%-14s %6s %10s %10s\n", "image", "codec", "bytes", "encode us");
+    bool jpegOk = true;
+    bool pngOk = true;
+    bool monotonic = true;
+    for (const Sample& sample : samples) {
+        size_t raw = sample.image.pixels.size();
+        size_t previous = 0;
+        std::vector<uint8_t> out;
+        for (int quality : kQualities) {
+            double us = Time([&] { EncodeJpeg(sample.image, quality, &out); });
+            std::printf("%-14s   q%-3d %10zu %10.0f\n", sample.name, quality, out.size(), us);
+            jpegOk = jpegOk && IsJpeg(out) && out.size() < raw;
+            monotonic = monotonic && out.size() >= previous;
+            previous = out.size();
+            Write(std::string(sample.name) + "_q" + std::to_string(quality) + ".jpg", out);
+        }
+        double us = Time([&] { EncodePng(sample.image, &out); });
+        std::printf("%-14s %6s %10zu %10.0f   (raw %zu)\n", sample.name, "png", out.size(), us, raw);
+        pngOk = pngOk && IsPng(out);
+        Write(std::string(sample.name) + ".png", out);
+    }
+    Check(jpegOk, "every JPEG is framed SOI..EOI and smaller than the raw pixels");
+    Check(monotonic, "JPEG size grows with quality");
+    Check(pngOk, "every PNG starts with the signature");
+}
+
+void BenchFit(const std::vector<Sample>& samples) {
+    static const size_t kBudgets[] = { 8 * 1024, 24 * 1024, 64 * 1024 };
+    std::printf("\n%-14s %8s %6s %8s %10s %8s %10s\n", "image", "budget", "codec", "quality", "bytes", "encodes",
+                "fit us");
+    bool withinAttempts = true;
+    bool fitsWhenPossible = true;
+    bool alphaKept = true;
+    for (const Sample& sample : samples) {
+        for (size_t maxBytes : kBudgets) {
+            ThumbnailBudget budget;
+            budget.maxBytes = maxBytes;
+            EncodedThumbnail result;
+            double us = Time([&] { FitThumbnail(sample.image, budget, &result); });
+            bool png = result.format == ImageFormat::kPng;
+            std::printf("%-14s %7zuK %6s %8d %10zu %8d %10.0f%s\n", sample.name, maxBytes / 1024,
+                        png ? "png" : "jpeg", result.quality, result.bytes.size(), result.attempts, us,
+                        result.fits ? "" : "   over");
+            withinAttempts = withinAttempts && result.attempts <= budget.maxAttempts;
+            alphaKept = alphaKept && png == sample.image.HasAlpha();
+            if (!png && !result.fits) {
+                // Only allowed when even the lowest quality is over
+                std::vector<uint8_t> floor;
+                EncodeJpeg(sample.image, budget.minQuality, &floor);
+                fitsWhenPossible = fitsWhenPossible && floor.size() > maxBytes;
+            }
+            if (!png && result.fits && result.quality < budget.maxQuality) {
+                // The search should not leave much quality on the table
+                std::vector<uint8_t> better;
+                EncodeJpeg(sample.image, std::min(budget.maxQuality, result.quality + 12), &better);
+                fitsWhenPossible = fitsWhenPossible && better.size() > maxBytes;
+            }
+        }
+    }
+    Check(withinAttempts, "the quality search stays within maxAttempts encodes");
+    Check(fitsWhenPossible, "JPEG fits whenever minQuality does, within a few steps of the best quality");
+    Check(alphaKept, "images with transparency stay PNG, opaque ones become JPEG");
+}
+
+void CheckEdges() {
+    EncodedThumbnail result;
+    Check(!FitThumbnail(RgbaImage{}, ThumbnailBudget{}, &result), "an empty image is refused");
+
+    // Sizes that are not a multiple of the 16-pixel MCU
+    RgbaImage odd = Photo(37, 23);
+    std::vector<uint8_t> out;
+    EncodeJpeg(odd, 75, &out);
+    bool jpeg = IsJpeg(out);
+    Write("odd_37x23.jpg", out);
+    EncodePng(odd, &out);
+    Write("odd_37x23.png", out);
+    RgbaImage pixel = Blank(1, 1);
+    EncodeJpeg(pixel, 75, &out);
+    jpeg = jpeg && IsJpeg(out);
+    Write("pixel_1.jpg", out);
+    EncodePng(pixel, &out);
+    Write("pixel_1.png", out);
+    Check(jpeg && IsPng(out), "odd and single-pixel sizes encode");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--write=", 8) == 0) {
+            g_writeDir = argv[i] + 8;
+        } else if (std::strncmp(argv[i], "--repeat=", 9) == 0) {
+            g_repeat = std::max(1, std::atoi(argv[i] + 9));
+        } else {
+            std::fprintf(stderr, "usage: %s [--write=DIR] [--repeat=N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::vector<Sample> samples;
+    samples.push_back({ "photo_256", Photo(256, 256) });
+    samples.push_back({ "photo_512", Photo(512, 512) });
+    samples.push_back({ "graphic_256", Graphic(256) });
+    samples.push_back({ "graphic_512", Graphic(512) });
+    samples.push_back({ "logo_256", Logo(256) });
+    samples.push_back({ "logo_512", Logo(512) });
+    if (!g_writeDir.empty()) {
+        // The source pixels, so a decoder can compare against them
+        for (const Sample& sample : samples) {
+            Write(std::string(sample.name) + ".rgba", sample.image.pixels);
+        }
+    }
+
+    BenchEncoders(samples);
+    BenchFit(samples);
+    CheckEdges();
+
+    std::printf("%s\n", g_failures == 0 ? "all checks passed" : "FAILED");
+    return g_failures == 0 ? 0 : 1;
+}
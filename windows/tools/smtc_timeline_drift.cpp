@@ -0,0 +1,386 @@
+// Drives TimelinePolicy with synthetic players whose clock drifts against
+// ours and checks the position it would publish against the true one. The
+// player reports its position every so often, late by a jittery delivery
+// delay and rounded to its own granularity; the surface is read every 100 ms.
+// Each run is compared with plain extrapolation at the nominal rate from the
+// last sample, which is what the timeline did before it estimated drift.
+//
+//   sweep     steady drift at a range of sample intervals: error once five
+//             samples are in, visible jumps, and the longest interval that
+//             keeps the error in budget
+//   settle    how many samples the estimate needs to get there
+//   wander    drift that moves with temperature
+//   session   seeks, pauses and late samples: every seek found, no false
+//             ones, never backwards
+//
+// Needs no Windows or Flutter headers. Build it as C++17 with -Ismtc_windows
+// together with these sources from smtc_windows/: position_estimator and
+// timeline_publisher, plus event_dispatcher, memory_budget, native_log and
+// span_tracer for the clock and instrumentation.
+//
+// Usage: smtc_timeline_drift [--minutes=N] [--seed=N] [--budget-ms=N]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "position_estimator.h"
+#include "timeline_publisher.h"
+
+using namespace audio_service_smtc;
+
+namespace {
+
+constexpr int64_t kSecond = 1000000;
+constexpr int64_t kMillisecond = 1000;
+constexpr int64_t kTick = 100 * kMillisecond;
+constexpr double kPi = 3.14159265358979323846;
+// A step against the true motion larger than this between two reads shows
+constexpr int64_t kVisibleJump = 40 * kMillisecond;
+
+int g_failures = 0;
+int64_t g_minutes = 60;
+uint32_t g_seed = 0x2545f491u;
+int64_t g_budget = 50 * kMillisecond;
+
+void Check(bool ok, const char* what) {
+    std::printf("%s  %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok) ++g_failures;
+}
+
+// Reproducible randomness, independent of the platform's rand()
+struct Random {
+    uint32_t state;
+
+    uint32_t Next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+    double Uniform() { return Next() / 4294967296.0; }
+    int64_t Between(int64_t low, int64_t high) { return low + static_cast<int64_t>(Uniform() * (high - low)); }
+};
+
+struct Scenario {
+    double drift = 0.0;            // device clock against ours
+    double wander = 0.0;           // amplitude of a slow swing around it
+    int64_t interval = 10 * kSecond;
+    int64_t latency = 5 * kMillisecond;        // fixed part of the delivery delay
+    int64_t jitter = 20 * kMillisecond;        // plus up to this much
+    double lateFraction = 0.0;                 // samples held up much longer
+    int64_t quantum = 10 * kMillisecond;       // the player's position granularity
+    int64_t seekEvery = 0;                     // mean time between seeks, or none
+    int64_t pauseEvery = 0;                    // mean time between pauses, or none
+    int64_t length = 60 * 60 * kSecond;
+    int64_t warmup = 0;                        // samples before errors count
+};
+
+struct Errors {
+    std::vector<int64_t> values;
+    int64_t jumps = 0;
+    int64_t backwards = 0;
+
+    int64_t Percentile(double p) {
+        if (values.empty()) return 0;
+        std::sort(values.begin(), values.end());
+        return values[std::min(values.size() - 1, static_cast<size_t>(p * values.size()))];
+    }
+};
+
+struct Result {
+    Errors estimated;
+    Errors nominal;
+    int64_t samples = 0;
+    int64_t seeks = 0;
+    int64_t seeksFound = 0;         // true seeks published at once
+    int64_t falseSeeks = 0;         // immediate publishes with no seek behind them
+    int64_t nominalFalseSeeks = 0;  // what the old threshold would have called a seek
+    double finalDrift = 0.0;
+    // Samples taken before the last read that was over budget
+    int64_t lastOverBudgetSample = 0;
+};
+
+// The old timeline: the last sample, carried on at the nominal rate
+struct NominalExtrapolation {
+    int64_t position = 0;
+    int64_t at = 0;
+    bool playing = false;
+
+    int64_t At(int64_t now) const { return playing ? position + (now - at) : position; }
+};
+
+Result Run(const Scenario& scenario, uint32_t seed) {
+    Random random{ seed };
+    TimelinePolicy policy;
+    NominalExtrapolation nominal;
+    Result result;
+
+    double truth = 30.0 * kSecond;
+    bool playing = true;
+    int64_t nextSample = scenario.interval;
+    int64_t nextSeek = scenario.seekEvery ? random.Between(scenario.seekEvery / 2, scenario.seekEvery * 3 / 2) : -1;
+    int64_t nextPause = scenario.pauseEvery ? random.Between(scenario.pauseEvery / 2, scenario.pauseEvery * 3 / 2) : -1;
+    int64_t resumeAt = -1;
+
+    policy.SetPlaybackState(PlaybackState::kPlaying, 0);
+    nominal.playing = true;
+
+    // What the player would report now, as it reaches us
+    auto report = [&](int64_t now, bool seek) {
+        int64_t delay = scenario.latency + random.Between(0, scenario.jitter + 1);
+        if (random.Uniform() < scenario.lateFraction) delay += random.Between(100, 300) * kMillisecond;
+        double position = truth - (playing ? delay * (1.0 + scenario.drift) : 0);
+        int64_t reported = static_cast<int64_t>(position) / scenario.quantum * scenario.quantum;
+        ++result.samples;
+        policy.SetTimeline(reported, 0, 1.0, now);
+        bool immediate = policy.NextPublishTime(now) == now;
+        if (immediate) policy.Publish(now);
+        if (playing && !seek && std::llabs(reported - nominal.At(now)) > kSecond) ++result.nominalFalseSeeks;
+        nominal.position = reported;
+        nominal.at = now;
+        return immediate;
+    };
+
+    // Playback starts with a sample, published with the state change
+    report(0, true);
+    policy.Publish(0);
+
+    int64_t lastShown = policy.PositionAt(0);
+    int64_t lastNominal = nominal.At(0);
+    double lastTruth = truth;
+    bool seekedSinceRead = true;
+    for (int64_t now = 0; now <= scenario.length; now += kTick / 10) {
+        if (now > 0 && playing) {
+            double drift = scenario.drift + scenario.wander * std::sin(now * 2 * kPi / (600.0 * kSecond));
+            truth += (kTick / 10) * (1.0 + drift);
+        }
+
+        if (nextSeek >= 0 && now >= nextSeek && playing) {
+            double to = static_cast<double>(random.Between(0, 3600) * kSecond);
+            // Seeks are at least a few seconds; smaller moves blend in as drift
+            if (std::fabs(to - truth) < 3 * kSecond) to += 5 * kSecond;
+            truth = to;
+            ++result.seeks;
+            // The player's state update after a seek carries the new position
+            if (report(now, true)) ++result.seeksFound;
+            seekedSinceRead = true;
+            nextSeek = now + random.Between(scenario.seekEvery / 2, scenario.seekEvery * 3 / 2);
+            nextSample = now + scenario.interval;
+            continue;
+        }
+        if (nextPause >= 0 && now >= nextPause && playing) {
+            playing = false;
+            policy.SetPlaybackState(PlaybackState::kPaused, now);
+            report(now, false);  // publishes for the state change
+            nominal.playing = false;
+            resumeAt = now + random.Between(2, 30) * kSecond;
+            nextPause = -1;
+            continue;
+        }
+        if (resumeAt >= 0 && now >= resumeAt) {
+            playing = true;
+            policy.SetPlaybackState(PlaybackState::kPlaying, now);
+            report(now, false);
+            nominal.playing = true;
+            resumeAt = -1;
+            nextPause = now + random.Between(scenario.pauseEvery / 2, scenario.pauseEvery * 3 / 2);
+            nextSample = now + scenario.interval;
+            seekedSinceRead = true;
+            continue;
+        }
+        if (playing && now >= nextSample) {
+            if (report(now, false)) ++result.falseSeeks;
+            // Players report on their own schedule, not a precise one
+            nextSample = now + scenario.interval + random.Between(-scenario.interval / 10, scenario.interval / 10 + 1);
+        }
+
+        if (now % kTick != 0 || !playing || result.samples <= scenario.warmup) continue;
+        int64_t shown = policy.PositionAt(now);
+        int64_t extrapolated = nominal.At(now);
+        int64_t actual = static_cast<int64_t>(truth);
+        result.estimated.values.push_back(std::llabs(shown - actual));
+        result.nominal.values.push_back(std::llabs(extrapolated - actual));
+        if (std::llabs(shown - actual) > g_budget) result.lastOverBudgetSample = result.samples;
+        if (!seekedSinceRead) {
+            int64_t motion = static_cast<int64_t>(truth - lastTruth);
+            if (std::llabs((shown - lastShown) - motion) > kVisibleJump) ++result.estimated.jumps;
+            if (std::llabs((extrapolated - lastNominal) - motion) > kVisibleJump) ++result.nominal.jumps;
+            if (shown < lastShown) ++result.estimated.backwards;
+            if (extrapolated < lastNominal) ++result.nominal.backwards;
+        }
+        lastShown = shown;
+        lastNominal = extrapolated;
+        lastTruth = truth;
+        seekedSinceRead = false;
+    }
+    result.finalDrift = policy.estimator().Drift();
+    return result;
+}
+
+void Sweep() {
+    static const double kDrifts[] = { 0.0, 0.0001, 0.001, 0.005 };
+    static const int64_t kIntervals[] = { 1, 2, 5, 10, 15, 30, 60, 120, 300 };
+    std::printf("%-8s %9s | %8s %8s %8s %6s | %8s %8s %8s %6s\n", "drift", "interval", "est p50", "est p99",
+                "est max", "jumps", "nom p50", "nom p99", "nom max", "jumps");
+
+    bool neverWorse = true;
+    bool noJumps = true;
+    bool neverBackwards = true;
+    for (double drift : kDrifts) {
+        int64_t longestEstimated = 0;
+        int64_t longestNominal = 0;
+        for (int64_t seconds : kIntervals) {
+            Scenario scenario;
+            scenario.drift = drift;
+            scenario.interval = seconds * kSecond;
+            scenario.length = g_minutes * 60 * kSecond;
+            scenario.warmup = 5;
+            Result result = Run(scenario, g_seed);
+            int64_t estimatedP99 = result.estimated.Percentile(0.99);
+            int64_t nominalP99 = result.nominal.Percentile(0.99);
+            std::printf("%6.2f%% %8llds | %6.1fms %6.1fms %6.1fms %6lld | %6.1fms %6.1fms %6.1fms %6lld\n",
+                        drift * 100, static_cast<long long>(seconds), result.estimated.Percentile(0.5) / 1e3,
+                        estimatedP99 / 1e3, result.estimated.Percentile(1.0) / 1e3,
+                        static_cast<long long>(result.estimated.jumps), result.nominal.Percentile(0.5) / 1e3,
+                        nominalP99 / 1e3, result.nominal.Percentile(1.0) / 1e3,
+                        static_cast<long long>(result.nominal.jumps));
+            if (estimatedP99 <= g_budget) longestEstimated = std::max(longestEstimated, seconds);
+            if (nominalP99 <= g_budget) longestNominal = std::max(longestNominal, seconds);
+            // Jitter alone can leave either a few ms ahead at short intervals
+            neverWorse = neverWorse && estimatedP99 <= nominalP99 + 5 * kMillisecond;
+            noJumps = noJumps && result.estimated.jumps == 0;
+            neverBackwards = neverBackwards && result.estimated.backwards == 0;
+        }
+        auto perHour = [](int64_t seconds) { return seconds ? 3600 / seconds : 0; };
+        std::printf("  %.2f%% drift, p99 within %lldms: every %llds estimated (%lld samples/h), every %llds "
+                    "nominal (%lld samples/h)\n\n",
+                    drift * 100, static_cast<long long>(g_budget / kMillisecond),
+                    static_cast<long long>(longestEstimated), static_cast<long long>(perHour(longestEstimated)),
+                    static_cast<long long>(longestNominal), static_cast<long long>(perHour(longestNominal)));
+    }
+    Check(neverWorse, "the estimate's p99 error is never worse than extrapolating at the nominal rate");
+    Check(noJumps, "the estimated position never jumps visibly without a seek");
+    Check(neverBackwards, "the estimated position never runs backwards while playing");
+}
+
+void Settle() {
+    static const double kDrifts[] = { 0.001, 0.005, 0.01 };
+    static const int64_t kIntervals[] = { 5, 15, 30 };
+    std::printf("%-8s %9s %16s %12s\n", "drift", "interval", "samples to p99", "estimated");
+    bool settles = true;
+    bool accurate = true;
+    for (double drift : kDrifts) {
+        for (int64_t seconds : kIntervals) {
+            Scenario scenario;
+            scenario.drift = drift;
+            scenario.interval = seconds * kSecond;
+            scenario.length = std::max<int64_t>(40, 30 * seconds) * kSecond;
+            Result result = Run(scenario, g_seed ^ static_cast<uint32_t>(seconds));
+            std::printf("%6.2f%% %8llds %16lld %11.3f%%\n", drift * 100, static_cast<long long>(seconds),
+                        static_cast<long long>(result.lastOverBudgetSample), result.finalDrift * 100);
+            settles = settles && result.lastOverBudgetSample <= 6;
+            accurate = accurate && std::fabs(result.finalDrift - drift) < 0.1 * drift + 0.0002;
+        }
+    }
+    Check(settles, "the error stays within budget after at most 6 samples");
+    Check(accurate, "the drift estimate ends within 10% of the real drift");
+}
+
+void Wander() {
+    Scenario scenario;
+    scenario.drift = 0.002;
+    scenario.wander = 0.001;
+    scenario.interval = 15 * kSecond;
+    scenario.length = g_minutes * 60 * kSecond;
+    Result result = Run(scenario, g_seed + 1);
+    std::printf("0.2%% +-0.1%% over 10 min, every 15s: estimated p99 %.1fms max %.1fms, nominal p99 %.1fms max "
+                "%.1fms\n",
+                result.estimated.Percentile(0.99) / 1e3, result.estimated.Percentile(1.0) / 1e3,
+                result.nominal.Percentile(0.99) / 1e3, result.nominal.Percentile(1.0) / 1e3);
+    Check(result.estimated.Percentile(0.99) <= g_budget, "a wandering drift is followed within budget");
+    Check(result.estimated.jumps == 0 && result.estimated.backwards == 0, "and without jumps or reversals");
+}
+
+void Session() {
+    Scenario scenario;
+    scenario.drift = 0.003;
+    scenario.interval = 10 * kSecond;
+    scenario.jitter = 30 * kMillisecond;
+    scenario.lateFraction = 0.03;
+    scenario.seekEvery = 3 * 60 * kSecond;
+    scenario.pauseEvery = 5 * 60 * kSecond;
+    scenario.length = g_minutes * 60 * kSecond;
+    Result result = Run(scenario, g_seed + 2);
+    std::printf("session: %lld samples, %lld seeks, %lld found, %lld false (nominal threshold %lld), "
+                "estimated p99 %.1fms, nominal p99 %.1fms, %lld/%lld jumps\n",
+                static_cast<long long>(result.samples), static_cast<long long>(result.seeks),
+                static_cast<long long>(result.seeksFound), static_cast<long long>(result.falseSeeks),
+                static_cast<long long>(result.nominalFalseSeeks), result.estimated.Percentile(0.99) / 1e3,
+                result.nominal.Percentile(0.99) / 1e3, static_cast<long long>(result.estimated.jumps),
+                static_cast<long long>(result.nominal.jumps));
+    Check(result.seeks > 0 && result.seeksFound == result.seeks, "every seek is published at once");
+    Check(result.falseSeeks == 0, "late samples and drift are never taken for seeks");
+    Check(result.estimated.backwards == 0, "the position never runs backwards between seeks");
+}
+
+void Estimator() {
+    // Seeks a little past the drift allowance still count as seeks
+    PositionEstimator::Options options;
+    PositionEstimator estimator(options);
+    estimator.Restart(0, 1.0, 0);
+    estimator.AddSample(0, 0);
+    bool found = estimator.AddSample(10 * kSecond + options.seekThreshold + 200 * kMillisecond, 10 * kSecond) ==
+                 PositionEstimator::SampleKind::kSeek;
+    Check(found, "a jump just past the threshold and the drift allowance is a seek");
+
+    // At double speed the position moves twice as fast, drift included
+    estimator.Restart(0, 2.0, 0);
+    for (int64_t t = 0; t <= 60 * kSecond; t += 5 * kSecond) {
+        estimator.AddSample(static_cast<int64_t>(2.0 * 1.004 * t), t);
+    }
+    int64_t ahead = estimator.PositionAt(70 * kSecond) - static_cast<int64_t>(2.0 * 1.004 * 70 * kSecond);
+    Check(std::llabs(ahead) < 5 * kMillisecond, "drift is estimated at rates other than 1");
+
+    // A far-off correction back is spread out rather than stalling playback
+    estimator.Restart(0, 1.0, 0);
+    estimator.AddSample(0, 0);
+    estimator.AddSample(kSecond - 900 * kMillisecond, kSecond);
+    int64_t previous = estimator.PositionAt(kSecond);
+    bool advancing = true;
+    for (int64_t t = kSecond + kTick; t < 5 * kSecond; t += kTick) {
+        int64_t position = estimator.PositionAt(t);
+        advancing = advancing && position - previous >= kTick / 2 - 1;
+        previous = position;
+    }
+    Check(advancing, "pulling back never slows below half speed");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--minutes=", 10) == 0) {
+            g_minutes = std::max<int64_t>(1, std::atoll(argv[i] + 10));
+        } else if (std::strncmp(argv[i], "--seed=", 7) == 0) {
+            g_seed = static_cast<uint32_t>(std::strtoul(argv[i] + 7, nullptr, 10)) | 1u;
+        } else if (std::strncmp(argv[i], "--budget-ms=", 12) == 0) {
+            g_budget = std::max<int64_t>(1, std::atoll(argv[i] + 12)) * kMillisecond;
+        } else {
+            std::fprintf(stderr, "usage: %s [--minutes=N] [--seed=N] [--budget-ms=N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    Sweep();
+    Settle();
+    Wander();
+    Session();
+    Estimator();
+
+    std::printf("%s\n", g_failures == 0 ? "all checks passed" : "FAILED");
+    return g_failures == 0 ? 0 : 1;
+}
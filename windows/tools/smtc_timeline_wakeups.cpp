@@ -0,0 +1,207 @@
+// Counts the timeline publisher's wakeups per hour of simulated playback.
+// TimelinePublisher::Run is replayed on a virtual clock around the same
+// TimelinePolicy: the thread sleeps until the policy's next publish time or
+// until an input (state change, position sample, button press) notifies
+// it, and every return from the wait counts as a wakeup, as in Wakeups().
+// Each scenario covers one hour; a publisher on a fixed 1 s cadence, as the
+// timeline would need without the policy, is the baseline. Runs in well
+// under a second since nothing sleeps.
+// Needs no Windows or Flutter headers. Build it as C++17 with -Ismtc_windows
+// and -pthread, together with these sources from smtc_windows/:
+// timeline_publisher, position_estimator, span_tracer, event_dispatcher,
+// memory_budget and native_log.
+//
+// Usage: smtc_timeline_wakeups [--hours=N]
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+
+#include "timeline_publisher.h"
+
+using namespace audio_service_smtc;
+
+namespace {
+
+int g_failures = 0;
+
+void Check(bool ok, const char* what) {
+    std::printf("%s  %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok) ++g_failures;
+}
+
+constexpr int64_t kSecond = 1000000;
+constexpr int64_t kMinute = 60 * kSecond;
+constexpr int64_t kHour = 60 * kMinute;
+
+struct Counts {
+    uint64_t timerWakeups = 0;  // woke because a publish was due
+    uint64_t inputWakeups = 0;  // woke because an input notified it
+    uint64_t publishes = 0;
+};
+
+// Inputs at virtual times, applied in order; several at one time are
+// applied under one notification
+class Script {
+public:
+    using Input = std::function<void(TimelinePolicy&, int64_t now)>;
+
+    void At(int64_t time, Input input) { _inputs.emplace(time, std::move(input)); }
+
+    void State(int64_t time, PlaybackState state) {
+        At(time, [state](TimelinePolicy& policy, int64_t now) { policy.SetPlaybackState(state, now); });
+    }
+
+    // What Dart sends with every state update: where the player is
+    void Sample(int64_t time, int64_t position, int64_t duration) {
+        At(time, [position, duration](TimelinePolicy& policy, int64_t now) {
+            policy.SetTimeline(position, duration, 1.0, now);
+        });
+    }
+
+    void Press(int64_t time) {
+        At(time, [](TimelinePolicy& policy, int64_t now) { policy.NoteSurfaceActivity(now); });
+    }
+
+    // Runs Run()'s loop from 0 to `end`
+    Counts Play(int64_t end) const {
+        TimelinePolicy policy;
+        Counts counts;
+        auto input = _inputs.begin();
+        int64_t now = 0;
+        while (now < end) {
+            int64_t next = policy.NextPublishTime(now);
+            if (next <= now) {
+                policy.Publish(now);
+                ++counts.publishes;
+                continue;
+            }
+
+            // Blocks until the publish is due or an input arrives
+            int64_t inputAt = input == _inputs.end() ? TimelinePolicy::kNever : input->first;
+            if (inputAt == TimelinePolicy::kNever && next == TimelinePolicy::kNever) break;
+            if (inputAt <= next) {
+                now = inputAt;
+                if (now >= end) break;
+                while (input != _inputs.end() && input->first == now) {
+                    input->second(policy, now);
+                    ++input;
+                }
+                ++counts.inputWakeups;
+            } else {
+                now = next;
+                if (now >= end) break;
+                ++counts.timerWakeups;
+            }
+        }
+        return counts;
+    }
+
+private:
+    std::multimap<int64_t, Input> _inputs;
+};
+
+// Tracks of `trackLength` played back to back from time 0, with the
+// samples a player sends on each track change
+void PlayTracks(Script& script, int64_t from, int64_t to, int64_t trackLength) {
+    for (int64_t start = from; start < to; start += trackLength) {
+        script.Sample(start, 0, trackLength);
+        script.State(start, PlaybackState::kPlaying);
+    }
+}
+
+void Print(const char* name, const Counts& counts, int hours) {
+    std::printf("  %-30s %8.0f wakeups/h (%6.0f timer, %6.0f input)  %8.0f publishes/h\n", name,
+                double(counts.timerWakeups + counts.inputWakeups) / hours, double(counts.timerWakeups) / hours,
+                double(counts.inputWakeups) / hours, double(counts.publishes) / hours);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int hours = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--hours=", 8) == 0) {
+            hours = std::atoi(argv[i] + 8);
+        } else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (hours <= 0) {
+        std::fprintf(stderr, "--hours must be positive\n");
+        return 2;
+    }
+    const int64_t end = hours * kHour;
+    const int64_t track = 4 * kMinute;
+
+    std::printf("per hour of simulated time\n");
+
+    // A fixed 1 s cadence wakes for every tick whatever the state
+    Counts fixed;
+    fixed.timerWakeups = fixed.publishes = static_cast<uint64_t>(end / kSecond);
+    Print("fixed 1 s cadence", fixed, hours);
+
+    Script hidden;
+    PlayTracks(hidden, 0, end, track);
+    Counts hiddenCounts = hidden.Play(end);
+    Print("playing, flyout hidden", hiddenCounts, hours);
+
+    // Something shows the flyout all along, e.g. a button press every 5 s
+    Script shown;
+    PlayTracks(shown, 0, end, track);
+    for (int64_t t = 0; t < end; t += 5 * kSecond) shown.Press(t);
+    Counts shownCounts = shown.Play(end);
+    Print("playing, flyout shown", shownCounts, hours);
+
+    // The player confirms its position every second, in step with the clock
+    Script reporting;
+    PlayTracks(reporting, 0, end, track);
+    for (int64_t t = kSecond; t < end; t += kSecond) {
+        if (t % track != 0) reporting.Sample(t, t % track, track);
+    }
+    Counts reportingCounts = reporting.Play(end);
+    Print("playing, position every 1 s", reportingCounts, hours);
+
+    Script paused;
+    paused.Sample(0, 90 * kSecond, track);
+    paused.State(0, PlaybackState::kPaused);
+    Counts pausedCounts = paused.Play(end);
+    Print("paused", pausedCounts, hours);
+
+    Script stopped;
+    stopped.State(0, PlaybackState::kStopped);
+    Counts stoppedCounts = stopped.Play(end);
+    Print("stopped", stoppedCounts, hours);
+
+    // 40 minutes of tracks with a few looks at the flyout and two seeks,
+    // then a 20 minute pause
+    Script mixed;
+    const int64_t pauseAt = end * 2 / 3;
+    PlayTracks(mixed, 0, pauseAt, track);
+    for (int64_t look : { 5 * kMinute, 17 * kMinute, 31 * kMinute }) {
+        for (int64_t t = look; t < look + 20 * kSecond; t += 5 * kSecond) mixed.Press(t);
+    }
+    mixed.Sample(10 * kMinute, 10 * kMinute % track + 90 * kSecond, track);
+    mixed.Sample(25 * kMinute, 25 * kMinute % track + 90 * kSecond, track);
+    mixed.State(pauseAt, PlaybackState::kPaused);
+    Counts mixedCounts = mixed.Play(end);
+    Print("mixed: tracks, looks, pause", mixedCounts, hours);
+
+    const uint64_t hiddenCadence = static_cast<uint64_t>(end / TimelinePolicy::Options{}.idleInterval);
+    Check(hiddenCounts.timerWakeups <= hiddenCadence + 1, "hidden playback wakes at the idle interval");
+    Check(shownCounts.timerWakeups <= static_cast<uint64_t>(end / kSecond),
+          "a shown flyout wakes no more than once a second");
+    Check(reportingCounts.publishes <= hiddenCounts.publishes + 1,
+          "position samples that match the clock publish nothing");
+    Check(pausedCounts.timerWakeups == 0 && pausedCounts.publishes <= 1, "paused publishes once and never wakes");
+    Check(stoppedCounts.timerWakeups == 0 && stoppedCounts.publishes <= 1, "stopped publishes once and never wakes");
+    Check(mixedCounts.timerWakeups + mixedCounts.inputWakeups < fixed.timerWakeups / 4,
+          "mixed use wakes a fraction as often as a fixed cadence");
+
+    std::printf("%s\n", g_failures == 0 ? "all checks passed" : "FAILED");
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+// Replays a session trace recorded with AUDIO_SERVICE_SMTC_TRACE set and
+// reports how the plugin core handled it. Needs no Windows or Flutter
+// headers. Build it as C++17 with -Ismtc_windows and -pthread, together
+// with these sources from smtc_windows/: trace_replay, session_trace,
+// update_pipeline, player_state, string_pool, timeline_publisher,
+// position_estimator, span_tracer, event_dispatcher, memory_budget and
+// native_log.
+//
+// Usage: smtc_trace_replay TRACE [--realtime] [--speed=X] [--backend-delay-us=N]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "trace_replay.h"
+
+using audio_service_smtc::ReplayOptions;
+using audio_service_smtc::ReplayReport;
+using audio_service_smtc::TraceReader;
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s TRACE [--realtime] [--speed=X] [--backend-delay-us=N]\n", argv[0]);
+        return 2;
+    }
+
+    ReplayOptions options;
+    for (int i = 2; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--realtime") == 0) {
+            options.realtime = true;
+        } else if (std::strncmp(argv[i], "--speed=", 8) == 0) {
+            options.speed = std::atof(argv[i] + 8);
+        } else if (std::strncmp(argv[i], "--backend-delay-us=", 19) == 0) {
+            options.backendDelayMicros = std::atoll(argv[i] + 19);
+        } else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    auto reader = TraceReader::Open(argv[1]);
+    if (!reader) {
+        std::fprintf(stderr, "%s is not a session trace\n", argv[1]);
+        return 1;
+    }
+
+    ReplayReport report = audio_service_smtc::ReplayTrace(*reader, options);
+    std::printf("calls          %llu (%llu with state)\n",
+        static_cast<unsigned long long>(report.calls), static_cast<unsigned long long>(report.stateCalls));
+    std::printf("events         %llu\n", static_cast<unsigned long long>(report.events));
+    std::printf("commits        %llu replayed, %llu recorded, %llu patches collapsed\n",
+        static_cast<unsigned long long>(report.commits), static_cast<unsigned long long>(report.recordedCommits),
+        static_cast<unsigned long long>(report.collapsed));
+    std::printf("changed        status %llu, metadata %llu, timeline %llu, buttons %llu\n",
+        static_cast<unsigned long long>(report.fieldCommits[0]), static_cast<unsigned long long>(report.fieldCommits[1]),
+        static_cast<unsigned long long>(report.fieldCommits[2]), static_cast<unsigned long long>(report.fieldCommits[3]));
+    std::printf("wall time      %.3f s, %.0f calls/s\n", report.wallMicros / 1e6, report.callsPerSecond);
+    std::printf("latency        p50 %lld us, p99 %lld us, max %lld us\n",
+        static_cast<long long>(report.latencyP50), static_cast<long long>(report.latencyP99),
+        static_cast<long long>(report.latencyMax));
+    std::printf("final state    %s\n", report.finalStateMatches ? "matches recording" : "DIFFERS from recording");
+    if (report.damaged) std::printf("trace ends in a damaged record\n");
+    return report.finalStateMatches ? 0 : 1;
+}
@@ -0,0 +1,323 @@
+// Round-trip check for session traces. Records a short synthetic session
+// with TraceRecorder: calls as the plugin traces them, control and position
+// events, and the commits a PlayerStateStore makes from the calls. Reads it
+// back with TraceReader and checks every record matches what was recorded,
+// with timestamps that never go backwards. Replays it and checks the counts
+// and that the replay ends in the state the session did. Does the same with
+// the committed fixture, so traces recorded by earlier builds stay readable,
+// and checks that a trace cut short mid-record reads up to the cut and is
+// reported as damaged.
+// Needs no Windows or Flutter headers. Build it as C++17 with -Ismtc_windows
+// and -pthread, together with these sources from smtc_windows/:
+// trace_replay, session_trace, update_pipeline, player_state, string_pool,
+// timeline_publisher, position_estimator, span_tracer, event_dispatcher,
+// memory_budget and native_log. Run it from windows/, or pass --fixture.
+//
+// Usage: smtc_trace_roundtrip_check [--fixture=PATH] [--write-fixture=PATH]
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "session_trace.h"
+#include "trace_replay.h"
+
+using namespace audio_service_smtc;
+
+namespace {
+
+int g_failures = 0;
+
+void Check(bool ok, const char* what) {
+    std::printf("%s  %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok) ++g_failures;
+}
+
+bool SameTimeline(const std::optional<TimelineSnapshot>& a, const std::optional<TimelineSnapshot>& b) {
+    if (a.has_value() != b.has_value()) return false;
+    return !a || (a->position == b->position && a->duration == b->duration && a->rate == b->rate);
+}
+
+bool SamePatch(const std::optional<PlayerStatePatch>& a, const std::optional<PlayerStatePatch>& b) {
+    if (a.has_value() != b.has_value()) return false;
+    return !a || (a->status == b->status && a->metadata == b->metadata && SameTimeline(a->timeline, b->timeline) &&
+                  a->enabledButtons == b->enabledButtons);
+}
+
+// Timestamps aside, which differ from run to run
+bool SameRecord(const TraceRecord& a, const TraceRecord& b) {
+    return a.kind == b.kind && a.name == b.name && a.text == b.text && a.value == b.value &&
+           SamePatch(a.patch, b.patch) && a.changed == b.changed;
+}
+
+bool SameState(const PlayerState& a, const PlayerState& b) {
+    return a.status == b.status && a.metadata == b.metadata && a.enabledButtons == b.enabledButtons &&
+           SameTimeline(a.timeline, b.timeline);
+}
+
+// Records through the recorder and keeps what it recorded, in file order.
+// Commits are made inline rather than on a pipeline thread, so the order is
+// known.
+class Session {
+public:
+    explicit Session(TraceRecorder& recorder) : _recorder(recorder) {}
+
+    // A call that changes no state
+    void Call(const char* method) {
+        _recorder.RecordCall(method, nullptr);
+        TraceRecord call;
+        call.kind = TraceKind::kCall;
+        call.name = method;
+        _expected.push_back(call);
+    }
+
+    void Call(const char* method, const PlayerStatePatch& patch) {
+        _recorder.RecordCall(method, &patch);
+        TraceRecord call;
+        call.kind = TraceKind::kCall;
+        call.name = method;
+        call.patch = patch;
+        _expected.push_back(call);
+        if (patch.empty()) return;
+
+        uint32_t changed = _store.Apply(patch);
+        _recorder.RecordCommit(patch, changed);
+        TraceRecord commit;
+        commit.kind = TraceKind::kCommit;
+        commit.patch = patch;
+        commit.changed = changed;
+        _expected.push_back(commit);
+    }
+
+    void Event(const char* name, const char* text, int64_t value) {
+        _recorder.RecordEvent(name, text, value);
+        TraceRecord event;
+        event.kind = TraceKind::kEvent;
+        event.name = name;
+        event.text = text;
+        event.value = value;
+        _expected.push_back(event);
+    }
+
+    const std::vector<TraceRecord>& expected() const { return _expected; }
+    const PlayerState& state() const { return _store.Committed(); }
+
+private:
+    TraceRecorder& _recorder;
+    PlayerStateStore _store;
+    std::vector<TraceRecord> _expected;
+};
+
+PlayerStatePatch Track(int track) {
+    PlayerStatePatch patch;
+    patch.status = PlaybackState::kPlaying;
+    patch.metadata = MakeMetadata("Track " + std::to_string(track), "Some Artist",
+                                  track < 2 ? "First Album" : "Second Album",
+                                  "https://example.com/art/" + std::to_string(track) + ".jpg", 180000000);
+    patch.timeline = TimelineSnapshot{ 0, 180000000, 1.0 };
+    return patch;
+}
+
+PlayerStatePatch Timeline(int64_t position, double rate = 1.0) {
+    PlayerStatePatch patch;
+    patch.timeline = TimelineSnapshot{ position, 180000000, rate };
+    return patch;
+}
+
+PlayerStatePatch Status(PlaybackState status) {
+    PlayerStatePatch patch;
+    patch.status = status;
+    return patch;
+}
+
+// Three tracks, with a pause, a seek, a rate change, the buttons narrowed
+// for the last track and a repeated track that commits nothing new
+void RecordSession(Session& session) {
+    session.Call("initialize");
+    PlayerStatePatch buttons;
+    buttons.enabledButtons = kAllButtons;
+    session.Call("applyState", buttons);
+    for (int track = 0; track < 3; ++track) {
+        session.Call("applyState", Track(track));
+        for (int second = 1; second <= 3; ++second) {
+            session.Call("updateTimeline", Timeline(second * 1000000));
+            session.Event("position", "", second * 1000000);
+        }
+        if (track == 0) {
+            session.Event("control", "pause", 0);
+            session.Call("updatePlaybackStatus", Status(PlaybackState::kPaused));
+            session.Event("control", "play", 0);
+            session.Call("updatePlaybackStatus", Status(PlaybackState::kPlaying));
+        }
+        if (track == 1) {
+            session.Call("updateTimeline", Timeline(90000000, 1.5));
+            session.Call("applyState", Track(track));
+        }
+        if (track < 2) session.Event("control", "next", 0);
+    }
+    buttons.enabledButtons = kPlayButton | kPauseButton | kPreviousButton;
+    session.Call("applyState", buttons);
+    session.Call("updatePlaybackStatus", Status(PlaybackState::kStopped));
+    session.Call("dispose");
+}
+
+std::vector<TraceRecord> ReadAll(const std::string& path, bool* damaged, bool* ordered) {
+    std::vector<TraceRecord> records;
+    *damaged = true;
+    *ordered = true;
+    auto reader = TraceReader::Open(path);
+    if (!reader) return records;
+    TraceRecord record;
+    while (reader->Next(&record)) {
+        if (!records.empty() && record.timestamp < records.back().timestamp) *ordered = false;
+        records.push_back(record);
+    }
+    *damaged = reader->damaged();
+    return records;
+}
+
+bool AllMatch(const std::vector<TraceRecord>& read, const std::vector<TraceRecord>& expected) {
+    if (read.size() != expected.size()) return false;
+    for (size_t i = 0; i < read.size(); ++i) {
+        if (!SameRecord(read[i], expected[i])) return false;
+    }
+    return true;
+}
+
+struct Counts {
+    uint64_t calls = 0;
+    uint64_t stateCalls = 0;
+    uint64_t events = 0;
+    uint64_t commits = 0;
+};
+
+Counts Count(const std::vector<TraceRecord>& records) {
+    Counts counts;
+    for (const TraceRecord& record : records) {
+        if (record.kind == TraceKind::kCall) {
+            ++counts.calls;
+            if (record.patch) ++counts.stateCalls;
+        }
+        if (record.kind == TraceKind::kEvent) ++counts.events;
+        if (record.kind == TraceKind::kCommit) ++counts.commits;
+    }
+    return counts;
+}
+
+// Replays the trace at `path` and checks it against `expected`
+void CheckReplay(const std::string& path, const std::vector<TraceRecord>& expected) {
+    auto reader = TraceReader::Open(path);
+    if (!reader) {
+        Check(false, "the trace opens for replay");
+        return;
+    }
+    ReplayReport report = ReplayTrace(*reader, ReplayOptions{});
+    Counts counts = Count(expected);
+    std::printf("  replayed %llu calls (%llu with state), %llu events, %llu recorded commits, "
+                "%llu replayed commits\n",
+                static_cast<unsigned long long>(report.calls), static_cast<unsigned long long>(report.stateCalls),
+                static_cast<unsigned long long>(report.events),
+                static_cast<unsigned long long>(report.recordedCommits),
+                static_cast<unsigned long long>(report.commits));
+    Check(report.calls == counts.calls && report.stateCalls == counts.stateCalls && report.events == counts.events &&
+              report.recordedCommits == counts.commits && !report.damaged,
+          "the replay sees every call, event and commit");
+    Check(report.commits >= 1 && report.commits <= counts.commits, "the replay commits at most once per state call");
+    Check(report.finalStateMatches, "the replay ends in the recorded state");
+}
+
+// The state the recorded commits leave behind
+PlayerState CommittedState(const std::vector<TraceRecord>& records) {
+    PlayerStateStore store;
+    for (const TraceRecord& record : records) {
+        if (record.kind == TraceKind::kCommit) store.Apply(*record.patch);
+    }
+    return store.Committed();
+}
+
+void CheckTruncated(const std::string& path, size_t records) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    std::vector<char> bytes;
+    if (file) {
+        char buffer[4096];
+        size_t read;
+        while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) bytes.insert(bytes.end(), buffer, buffer + read);
+        std::fclose(file);
+    }
+    // Three bytes short of the end lands inside the last record
+    std::string cut = path + ".cut";
+    file = std::fopen(cut.c_str(), "wb");
+    if (!file || bytes.size() < 3) {
+        if (file) std::fclose(file);
+        Check(false, "a cut trace can be written");
+        return;
+    }
+    std::fwrite(bytes.data(), 1, bytes.size() - 3, file);
+    std::fclose(file);
+
+    bool damaged;
+    bool ordered;
+    std::vector<TraceRecord> read = ReadAll(cut, &damaged, &ordered);
+    Check(damaged && read.size() == records - 1, "a trace cut mid-record reads up to the cut and reports damage");
+    std::remove(cut.c_str());
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::string fixture = "tools/testdata/session.smtctrace";
+    std::string writeFixture;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--fixture=", 10) == 0) {
+            fixture = argv[i] + 10;
+        } else if (std::strncmp(argv[i], "--write-fixture=", 16) == 0) {
+            writeFixture = argv[i] + 16;
+        } else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    std::string path = writeFixture.empty() ? "/tmp/smtc_trace_roundtrip.smtctrace" : writeFixture;
+    std::vector<TraceRecord> expected;
+    PlayerState sessionState;
+    {
+        auto recorder = TraceRecorder::Open(path);
+        if (!recorder) {
+            std::fprintf(stderr, "cannot create %s\n", path.c_str());
+            return 1;
+        }
+        Session session(*recorder);
+        RecordSession(session);
+        expected = session.expected();
+        sessionState = session.state();
+    }
+    if (!writeFixture.empty()) {
+        std::printf("wrote %zu records to %s\n", expected.size(), writeFixture.c_str());
+        return 0;
+    }
+
+    std::printf("recorded session: %zu records\n", expected.size());
+    bool damaged;
+    bool ordered;
+    std::vector<TraceRecord> read = ReadAll(path, &damaged, &ordered);
+    Check(!damaged, "the trace reads back undamaged");
+    Check(AllMatch(read, expected), "every call, event and commit reads back as recorded");
+    Check(ordered, "timestamps never go backwards");
+    Check(SameState(CommittedState(read), sessionState), "the recorded commits add up to the session's state");
+    CheckReplay(path, expected);
+    CheckTruncated(path, expected.size());
+    std::remove(path.c_str());
+
+    std::printf("fixture %s:\n", fixture.c_str());
+    std::vector<TraceRecord> stored = ReadAll(fixture, &damaged, &ordered);
+    Check(!damaged && AllMatch(stored, expected) && ordered, "the fixture reads back as today's recorder writes it");
+    Check(SameState(CommittedState(stored), sessionState), "the fixture's commits add up to the session's state");
+    CheckReplay(fixture, expected);
+
+    std::printf("%s\n", g_failures == 0 ? "all checks passed" : "FAILED");
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,222 @@
+// Latency-injection stress test for UpdatePipeline. The backend stands in
+// for a DisplayUpdater.Update() that stalls while Explorer is busy: every
+// commit sleeps a random 100-400 ms by default. Meanwhile a platform thread
+// submits a stream of patches (status flips, track changes, timeline
+// samples) as fast as a player emits them, and a second thread polls
+// Stats() as getStats does. Checks that Submit never waits for the backend,
+// that every submission either starts or merges into the one waiting patch
+// (so memory stays bounded however far the backend falls behind, while the
+// depth counter climbs into the thousands), that values only ever move
+// forward, and that the newest status, track and position all land once the
+// stream stops.
+// Needs no Windows or Flutter headers. Build it as C++17 with -Ismtc_windows
+// and -pthread, together with these sources from smtc_windows/:
+// update_pipeline, player_state, string_pool, timeline_publisher,
+// position_estimator, span_tracer, event_dispatcher, memory_budget and
+// native_log.
+//
+// Usage: smtc_update_pipeline_stress [--submissions=N] [--interval-us=N]
+//                                    [--min-ms=N] [--max-ms=N]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "update_pipeline.h"
+
+using namespace audio_service_smtc;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+int g_failures = 0;
+
+void Check(bool ok, const char* what) {
+    std::printf("%s  %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok) ++g_failures;
+}
+
+// xorshift64*, fixed seed so failures reproduce
+class Random {
+public:
+    explicit Random(uint64_t seed) : _state(seed) {}
+
+    uint64_t Next() {
+        _state ^= _state >> 12;
+        _state ^= _state << 25;
+        _state ^= _state >> 27;
+        return _state * 0x2545F4914F6CDD1DULL;
+    }
+
+private:
+    uint64_t _state;
+};
+
+double Percentile(std::vector<double> values, double fraction) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(fraction * static_cast<double>(values.size() - 1) + 0.5);
+    return values[index];
+}
+
+std::string TrackTitle(int track) {
+    return "Track " + std::to_string(track);
+}
+
+// Applies commits to a state store after an injected stall, checking that
+// the track number and position never go backwards
+class SlowBackend {
+public:
+    SlowBackend(int minMillis, int maxMillis) : _minMillis(minMillis), _maxMillis(maxMillis), _random(5) {}
+
+    // Runs on the pipeline thread only
+    void Commit(const PlayerStatePatch& patch) {
+        int span = _maxMillis - _minMillis;
+        int millis = _minMillis + static_cast<int>(_random.Next() % static_cast<uint64_t>(span + 1));
+        std::this_thread::sleep_for(std::chrono::milliseconds(millis));
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _store.Apply(patch);
+        const PlayerState& state = _store.Committed();
+        int track = state.metadata.title.empty() ? -1 : std::atoi(state.metadata.title.c_str() + 6);
+        if (track < _lastTrack || state.timeline.position < _lastPosition) _forward = false;
+        _lastTrack = track;
+        _lastPosition = state.timeline.position;
+    }
+
+    PlayerState Committed() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _store.Committed();
+    }
+
+    bool OnlyForward() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _forward;
+    }
+
+private:
+    int _minMillis;
+    int _maxMillis;
+    Random _random;
+    std::mutex _mutex;
+    PlayerStateStore _store;
+    int _lastTrack = -1;
+    int64_t _lastPosition = -1;
+    bool _forward = true;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int submissions = 20000;
+    int intervalMicros = 75;
+    int minMillis = 100;
+    int maxMillis = 400;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--submissions=", 14) == 0) {
+            submissions = std::atoi(argv[i] + 14);
+        } else if (std::strncmp(argv[i], "--interval-us=", 14) == 0) {
+            intervalMicros = std::atoi(argv[i] + 14);
+        } else if (std::strncmp(argv[i], "--min-ms=", 9) == 0) {
+            minMillis = std::atoi(argv[i] + 9);
+        } else if (std::strncmp(argv[i], "--max-ms=", 9) == 0) {
+            maxMillis = std::atoi(argv[i] + 9);
+        } else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (submissions <= 0 || intervalMicros < 0 || minMillis < 0 || maxMillis < minMillis) {
+        std::fprintf(stderr, "counts must be positive and --max-ms at least --min-ms\n");
+        return 2;
+    }
+
+    std::printf("%d submissions every %d us, backend stalls %d-%d ms per commit\n", submissions, intervalMicros,
+                minMillis, maxMillis);
+    SlowBackend backend(minMillis, maxMillis);
+    UpdatePipeline pipeline([&backend](const PlayerStatePatch& patch) { backend.Commit(patch); });
+
+    // getStats from Dart, polled while the backend is stalled
+    std::atomic<bool> done{ false };
+    std::atomic<size_t> deepest{ 0 };
+    std::atomic<uint64_t> polls{ 0 };
+    std::thread poller([&] {
+        while (!done.load()) {
+            UpdatePipelineStats stats = pipeline.Stats();
+            deepest.store((std::max)(deepest.load(), stats.depth));
+            polls.fetch_add(1);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+
+    // A player: timeline samples, a status flip every 50 and a new track
+    // every 500 submissions
+    std::vector<double> submitMicros;
+    submitMicros.reserve(static_cast<size_t>(submissions));
+    int track = 0;
+    bool playing = true;
+    int64_t position = 0;
+    Clock::time_point started = Clock::now();
+    Clock::time_point next = started;
+    for (int i = 0; i < submissions; ++i) {
+        PlayerStatePatch patch;
+        if (i % 500 == 0) {
+            ++track;
+            patch.metadata = MediaMetadata{ TrackTitle(track), "Some Artist", "Some Album", {}, 215000000 };
+        }
+        if (i % 50 == 0) {
+            playing = !playing;
+            patch.status = playing ? PlaybackState::kPlaying : PlaybackState::kPaused;
+        }
+        position += 1000;
+        patch.timeline = TimelineSnapshot{ position, 215000000, 1.0 };
+
+        Clock::time_point before = Clock::now();
+        pipeline.Submit(patch);
+        submitMicros.push_back(std::chrono::duration<double, std::micro>(Clock::now() - before).count());
+
+        next += std::chrono::microseconds(intervalMicros);
+        std::this_thread::sleep_until(next);
+    }
+    double submitSeconds = std::chrono::duration<double>(Clock::now() - started).count();
+
+    pipeline.Flush();
+    double drainSeconds = std::chrono::duration<double>(Clock::now() - started).count() - submitSeconds;
+    done.store(true);
+    poller.join();
+
+    UpdatePipelineStats stats = pipeline.Stats();
+    PlayerState committed = backend.Committed();
+    std::printf("  submitted in %.2f s, drained %.2f s later\n", submitSeconds, drainSeconds);
+    std::printf("  Submit: p50 %.1f us  p99 %.1f us  max %.1f us\n", Percentile(submitMicros, 0.5),
+                Percentile(submitMicros, 0.99), Percentile(submitMicros, 1.0));
+    std::printf("  %llu submitted, %llu commits, %llu collapsed, up to %zu submissions in the waiting patch "
+                "(%zu seen over %llu polls)\n",
+                static_cast<unsigned long long>(stats.submitted), static_cast<unsigned long long>(stats.committed),
+                static_cast<unsigned long long>(stats.collapsed), stats.highWater, deepest.load(),
+                static_cast<unsigned long long>(polls.load()));
+
+    // The smallest stall is far longer than any Submit may take
+    Check(Percentile(submitMicros, 1.0) < minMillis * 1000.0 / 2, "Submit never waits for a stalled commit");
+    // Each submission either started the waiting patch or merged into it, so
+    // one patch waits while another commits, however deep the backlog
+    Check(stats.submitted == stats.committed + stats.collapsed && stats.depth == 0,
+          "at most one patch ever waits");
+    Check(stats.committed < stats.submitted / 100, "submissions collapse while the backend is stalled");
+    Check(backend.OnlyForward(), "no older track or position lands after a newer one");
+    Check(committed.metadata.title == TrackTitle(track) &&
+              committed.status == (playing ? PlaybackState::kPlaying : PlaybackState::kPaused) &&
+              committed.timeline.position == position,
+          "the newest status, track and position land");
+
+    std::printf("%s\n", g_failures == 0 ? "all checks passed" : "FAILED");
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,305 @@
+// Benchmark and check for the UTF-8 to UTF-16 transcoder. Measures ASCII,
+// Latin-1 and CJK titles at every SIMD level this CPU supports against the
+// scalar decoder plus a fresh allocation (what to_hstring costs), and a
+// Utf16Cache hit, and checks that no level is slower than scalar on any of
+// them. Checks every level against a reference encoder on random
+// text mixing one- to four-byte sequences, and on the same text with
+// corrupted bytes checks that every level flags it, agrees with the others
+// and emits only well-formed UTF-16.
+// Needs no Windows or Flutter headers. Build it as C++17 with -Ismtc_windows,
+// together with these sources from smtc_windows/: utf16_transcode and
+// memory_budget.
+//
+// Usage: smtc_utf16_transcode_bench [--iterations=N] [--strings=N]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "utf16_transcode.h"
+
+using namespace audio_service_smtc;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+int g_failures = 0;
+
+void Check(bool ok, const char* what) {
+    std::printf("%s  %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok) ++g_failures;
+}
+
+// xorshift64*, fixed seed so failures reproduce
+class Random {
+public:
+    explicit Random(uint64_t seed) : _state(seed) {}
+
+    uint64_t Next() {
+        _state ^= _state >> 12;
+        _state ^= _state << 25;
+        _state ^= _state >> 27;
+        return _state * 0x2545F4914F6CDD1DULL;
+    }
+
+    uint32_t Below(uint32_t bound) { return static_cast<uint32_t>(Next() % bound); }
+
+private:
+    uint64_t _state;
+};
+
+const char* LevelName(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::kSse2:
+        return "SSE2";
+    case SimdLevel::kAvx2:
+        return "AVX2";
+    default:
+        return "scalar";
+    }
+}
+
+void AppendUtf8(uint32_t codePoint, std::string& out) {
+    if (codePoint < 0x80) {
+        out += static_cast<char>(codePoint);
+    } else if (codePoint < 0x800) {
+        out += static_cast<char>(0xC0 | (codePoint >> 6));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else if (codePoint < 0x10000) {
+        out += static_cast<char>(0xE0 | (codePoint >> 12));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (codePoint >> 18));
+        out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+}
+
+void AppendUtf16(uint32_t codePoint, std::u16string& out) {
+    if (codePoint < 0x10000) {
+        out += static_cast<char16_t>(codePoint);
+    } else {
+        codePoint -= 0x10000;
+        out += static_cast<char16_t>(0xD800 | (codePoint >> 10));
+        out += static_cast<char16_t>(0xDC00 | (codePoint & 0x3FF));
+    }
+}
+
+// Runs of one script, like real titles, so the vector paths get used
+uint32_t RandomCodePoint(Random& random, int script) {
+    switch (script) {
+    case 0:
+        return 0x20 + random.Below(0x5F);
+    case 1:
+        return 0xA0 + random.Below(0x760);
+    case 2: {
+        uint32_t codePoint = 0x800 + random.Below(0xF800);
+        return codePoint >= 0xD800 && codePoint < 0xE000 ? 0x4E00 + random.Below(0x5200) : codePoint;
+    }
+    default:
+        return 0x10000 + random.Below(0x100000);
+    }
+}
+
+bool WellFormed(const char16_t* units, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        if (units[i] >= 0xD800 && units[i] < 0xDC00) {
+            if (i + 1 == length || units[i + 1] < 0xDC00 || units[i + 1] >= 0xE000) return false;
+            ++i;
+        } else if (units[i] >= 0xDC00 && units[i] < 0xE000) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<SimdLevel> Levels() {
+    std::vector<SimdLevel> levels{ SimdLevel::kScalar };
+    if (DetectSimdLevel() != SimdLevel::kScalar) levels.push_back(SimdLevel::kSse2);
+    if (DetectSimdLevel() == SimdLevel::kAvx2) levels.push_back(SimdLevel::kAvx2);
+    return levels;
+}
+
+void CheckRandom(int strings) {
+    Random random(7);
+    bool matches = true;
+    bool corruptFlagged = true;
+    bool levelsAgree = true;
+    bool wellFormed = true;
+    std::vector<char16_t> out;
+    std::vector<char16_t> first;
+    for (int s = 0; s < strings; ++s) {
+        std::string utf8;
+        std::u16string expected;
+        int runs = 1 + static_cast<int>(random.Below(6));
+        for (int r = 0; r < runs; ++r) {
+            int script = static_cast<int>(random.Below(4));
+            int count = 1 + static_cast<int>(random.Below(40));
+            for (int i = 0; i < count; ++i) {
+                uint32_t codePoint = RandomCodePoint(random, script);
+                AppendUtf8(codePoint, utf8);
+                AppendUtf16(codePoint, expected);
+            }
+        }
+
+        out.assign(utf8.size() + 64, u'\0');
+        for (SimdLevel level : Levels()) {
+            bool valid = false;
+            size_t length = TranscodeUtf8ToUtf16(utf8, out.data(), &valid, level);
+            matches = matches && valid && std::u16string_view(out.data(), length) == expected;
+        }
+
+        // Bytes that never appear in UTF-8 (overlong leads, leads past
+        // U+10FFFF), landing mid-sequence as often as not
+        std::string corrupt = utf8;
+        static const char kBad[] = { '\xC0', '\xC1', '\xF5', '\xF8', '\xFF' };
+        corrupt[random.Below(static_cast<uint32_t>(corrupt.size()))] = kBad[random.Below(sizeof(kBad))];
+        first.clear();
+        for (SimdLevel level : Levels()) {
+            bool valid = true;
+            size_t length = TranscodeUtf8ToUtf16(corrupt, out.data(), &valid, level);
+            corruptFlagged = corruptFlagged && !valid;
+            wellFormed = wellFormed && WellFormed(out.data(), length);
+            if (level == SimdLevel::kScalar) {
+                first.assign(out.begin(), out.begin() + static_cast<std::ptrdiff_t>(length));
+            } else {
+                levelsAgree = levelsAgree && std::u16string_view(out.data(), length) ==
+                                                 std::u16string_view(first.data(), first.size());
+            }
+        }
+    }
+    std::printf("%d random strings at", strings);
+    for (SimdLevel level : Levels()) std::printf(" %s", LevelName(level));
+    std::printf("\n");
+    Check(matches, "valid text matches the reference encoder at every level");
+    Check(corruptFlagged, "corrupted text is flagged at every level");
+    Check(levelsAgree, "every level replaces corruption the same way");
+    Check(wellFormed, "the output is always well-formed UTF-16");
+}
+
+struct Sample {
+    const char* name;
+    std::string utf8;
+};
+
+std::vector<Sample> Samples() {
+    return {
+        { "ASCII", "Bohemian Rhapsody (Remastered 2011) - Queen - A Night at the Op" },
+        { "Latin-1", "Les Misérables: À la volonté du peuple (Édition spéciale) — Chœur" },
+        { "CJK with spaces", "千と千尋の神隠し あの夏へ 久石譲 オリジナル サウンドトラック 第一 集" },
+        { "CJK without spaces", "千と千尋の神隠しあの夏へ久石譲オリジナルサウンドトラック第一集より" },
+    };
+}
+
+// Keeps the compiler from dropping the conversions
+uint64_t g_checksum = 0;
+
+template <typename Convert>
+double NanosPerString(int iterations, Convert convert) {
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < iterations; ++i) g_checksum += convert();
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations;
+}
+
+// Each figure is the fastest of several rounds, taken in turn, so a busy
+// machine slows every variant alike or leaves the best round clean
+constexpr int kRounds = 25;
+
+void Measure(int iterations) {
+    std::printf("per string, fastest of %d rounds of %d iterations:\n", kRounds, iterations / kRounds);
+    bool asciiFaster = true;
+    bool neverSlower = true;
+    std::vector<SimdLevel> levels = Levels();
+    for (const Sample& sample : Samples()) {
+        std::string_view utf8 = sample.utf8;
+        std::vector<char16_t> buffer(utf8.size());
+        Utf16Cache<std::u16string> cache;
+        auto make = [](std::u16string_view text) { return std::u16string(text); };
+        cache.Get(utf8, make);
+
+        double baseline = 1e30;
+        std::vector<double> nanos(levels.size(), 1e30);
+        double hit = 1e30;
+        for (int round = 0; round < kRounds; ++round) {
+            // to_hstring's shape: decode one by one into a new allocation
+            baseline = (std::min)(baseline, NanosPerString(iterations / kRounds, [utf8] {
+                std::u16string fresh(utf8.size(), u'\0');
+                bool valid;
+                return TranscodeUtf8ToUtf16(utf8, &fresh[0], &valid, SimdLevel::kScalar);
+            }));
+            for (size_t l = 0; l < levels.size(); ++l) {
+                nanos[l] = (std::min)(nanos[l], NanosPerString(iterations / kRounds, [&] {
+                    bool valid;
+                    return TranscodeUtf8ToUtf16(utf8, buffer.data(), &valid, levels[l]);
+                }));
+            }
+            hit = (std::min)(hit, NanosPerString(iterations / kRounds, [&] { return cache.Get(utf8, make).size(); }));
+        }
+
+        std::printf("  %-18s %3zu B: scalar + allocation %5.1f ns", sample.name, utf8.size(), baseline);
+        double best = baseline;
+        for (size_t l = 0; l < levels.size(); ++l) {
+            std::printf(", %s %5.1f ns", LevelName(levels[l]), nanos[l]);
+            if (levels[l] == DetectSimdLevel()) best = nanos[l];
+            // Levels[0] is scalar. Where a level runs the same code as
+            // scalar, rounds still differ by up to a tenth on a busy machine
+            neverSlower = neverSlower && nanos[l] <= nanos[0] * 1.15;
+        }
+        std::printf(", cache hit %4.1f ns\n", hit);
+        if (std::strcmp(sample.name, "ASCII") == 0) asciiFaster = best < baseline;
+    }
+    Check(DetectSimdLevel() == SimdLevel::kScalar || asciiFaster,
+          "ASCII transcodes faster at the best level than scalar with an allocation");
+    Check(neverSlower, "no SIMD level is slower than scalar on any sample");
+}
+
+void CheckCache() {
+    Utf16Cache<std::u16string> cache;
+    auto make = [](std::u16string_view text) { return std::u16string(text); };
+    std::vector<Sample> samples = Samples();
+    // A track's title, artist and album resent with every update
+    for (int update = 0; update < 1000; ++update) {
+        for (size_t field = 0; field < 3; ++field) cache.Get(samples[field].utf8, make);
+    }
+    Check(cache.misses() == 3 && cache.hits() == 2997, "unchanged fields are transcoded once");
+    std::u16string expected;
+    Utf8ToUtf16(samples[3].utf8, expected);
+    Check(cache.Get(samples[3].utf8, make) == expected, "a cached value holds the transcoded text");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int iterations = 1000000;
+    int strings = 20000;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--iterations=", 13) == 0) {
+            iterations = std::atoi(argv[i] + 13);
+        } else if (std::strncmp(argv[i], "--strings=", 10) == 0) {
+            strings = std::atoi(argv[i] + 10);
+        } else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (iterations < kRounds || strings <= 0) {
+        std::fprintf(stderr, "counts must be positive and --iterations at least %d\n", kRounds);
+        return 2;
+    }
+
+    std::printf("best SIMD level: %s\n", LevelName(DetectSimdLevel()));
+    CheckRandom(strings);
+    CheckCache();
+    Measure(iterations);
+
+    std::printf("%s\n", g_failures == 0 ? "all checks passed" : "FAILED");
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,177 @@
+// Stand-in for smtc_windows.cpp, so the C ABI in smtc_c_api.cpp builds and
+// runs on Linux. Same class and header; instead of the WinRT handler, the
+// update pipeline and the artwork workers, a patch is committed on the
+// calling thread into a record that smtc_windows_stub.h exposes. Tools only.
+// Build it with -Ismtc_windows, together with the sources SmtcWindows's
+// members need (see smtc_c_api_check.c).
+
+#include "smtc_windows_stub.h"
+
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string_view>
+
+#include "smtc_session.h"
+
+using audio_service_smtc::MemoryStats;
+using audio_service_smtc::PlayerStatePatch;
+using audio_service_smtc::UpdatePipelineStats;
+using audio_service_smtc::WatchdogStats;
+
+namespace {
+
+// SmtcWindows's private members belong to the real implementation, so the
+// stand-in keeps its own state per instance
+struct StubState {
+    SmtcStubRecord record = {};
+    std::function<void(const std::string&)> controlHandler;
+    std::function<void(int64_t)> positionHandler;
+};
+
+std::mutex g_mutex;
+std::map<const SmtcWindows*, StubState> g_states;
+
+void CopyField(std::string_view value, char* out, size_t capacity) {
+    std::snprintf(out, capacity, "%.*s", static_cast<int>(value.size()), value.data());
+}
+
+}  // namespace
+
+SmtcWindows::SmtcWindows() : _artworkGeneration(0), _initialized(false) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_states[this];
+}
+
+SmtcWindows::~SmtcWindows() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_states.erase(this);
+}
+
+bool SmtcWindows::Initialize(const std::string& identity) {
+    if (identity == SMTC_STUB_FAILING_IDENTITY) return false;
+    _identity = identity;
+    _initialized = true;
+    return true;
+}
+
+bool SmtcWindows::UpdatePlaybackStatus(const std::string& status) {
+    PlayerStatePatch patch;
+    patch.status = audio_service_smtc::ParsePlaybackState(status.c_str());
+    return ApplyState(patch);
+}
+
+bool SmtcWindows::UpdateMetadata(const std::string& title, const std::string& artist, const std::string& album,
+                                 int64_t duration, const std::string& albumArtUrl) {
+    PlayerStatePatch patch;
+    patch.metadata = audio_service_smtc::MakeMetadata(title, artist, album, albumArtUrl, duration);
+    return ApplyState(patch);
+}
+
+bool SmtcWindows::UpdateTimeline(int64_t position, int64_t duration, double rate) {
+    PlayerStatePatch patch;
+    patch.timeline = audio_service_smtc::TimelineSnapshot{ position, duration, rate };
+    return ApplyState(patch);
+}
+
+bool SmtcWindows::ApplyState(const PlayerStatePatch& patch) {
+    if (!_initialized) return false;
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    SmtcStubRecord& record = g_states[this].record;
+    record.last_fields = 0;
+    if (patch.status) {
+        record.last_fields |= SMTC_FIELD_STATUS;
+        record.status = static_cast<int32_t>(*patch.status);
+    }
+    if (patch.metadata) {
+        record.last_fields |= SMTC_FIELD_METADATA;
+        CopyField(patch.metadata->title, record.title, sizeof(record.title));
+        record.title_length = patch.metadata->title.size();
+        CopyField(patch.metadata->artist.view(), record.artist, sizeof(record.artist));
+        CopyField(patch.metadata->album.view(), record.album, sizeof(record.album));
+        CopyField(patch.metadata->artUrl, record.art_url, sizeof(record.art_url));
+        record.duration = patch.metadata->duration;
+    }
+    if (patch.timeline) {
+        record.last_fields |= SMTC_FIELD_TIMELINE;
+        record.position = patch.timeline->position;
+        record.duration = patch.timeline->duration;
+        record.rate = patch.timeline->rate;
+    }
+    if (patch.enabledButtons) {
+        record.last_fields |= SMTC_FIELD_BUTTONS;
+        record.enabled_buttons = *patch.enabledButtons;
+    }
+    ++record.commits;
+    return true;
+}
+
+UpdatePipelineStats SmtcWindows::GetUpdateStats() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    UpdatePipelineStats stats;
+    stats.submitted = stats.committed = g_states[this].record.commits;
+    return stats;
+}
+
+WatchdogStats SmtcWindows::GetWatchdogStats() {
+    WatchdogStats stats;
+    stats.healthy = _initialized;
+    return stats;
+}
+
+void SmtcWindows::SetControlCallback(std::function<void(const std::string&)> callback) {
+    if (!_initialized) return;
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_states[this].controlHandler = std::move(callback);
+}
+
+void SmtcWindows::SetPositionCallback(std::function<void(int64_t)> callback) {
+    if (!_initialized) return;
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_states[this].positionHandler = std::move(callback);
+}
+
+void SmtcWindows::SetWorkerThreadCount(size_t) {}
+
+void SmtcWindows::SetMemoryLimits(size_t, size_t, std::chrono::milliseconds) {}
+
+void SmtcWindows::SetThumbnailBudget(size_t, uint32_t) {}
+
+void SmtcWindows::PrefetchArtwork(const std::string&) {}
+
+MemoryStats SmtcWindows::GetMemoryStats() {
+    return MemoryStats{};
+}
+
+int32_t smtc_stub_get_record(SmtcSession* session, SmtcStubRecord* record) {
+    if (!session || !record) return 0;
+    std::lock_guard<std::mutex> lock(g_mutex);
+    *record = g_states[session].record;
+    return 1;
+}
+
+int32_t smtc_stub_press(SmtcSession* session, const char* command) {
+    if (!session || !command) return 0;
+    // Called outside the lock, as SMTC calls back from its own thread
+    std::function<void(const std::string&)> handler;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        handler = g_states[session].controlHandler;
+    }
+    if (!handler) return 0;
+    handler(command);
+    return 1;
+}
+
+int32_t smtc_stub_seek(SmtcSession* session, int64_t position) {
+    if (!session) return 0;
+    std::function<void(int64_t)> handler;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        handler = g_states[session].positionHandler;
+    }
+    if (!handler) return 0;
+    handler(position);
+    return 1;
+}
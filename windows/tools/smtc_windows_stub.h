@@ -0,0 +1,51 @@
+#ifndef AUDIO_SERVICE_SMTC_WINDOWS_STUB_H_
+#define AUDIO_SERVICE_SMTC_WINDOWS_STUB_H_
+
+/*
+ * Hooks into the stand-in SmtcWindows of smtc_windows_stub.cpp, which lets
+ * smtc_c_api.cpp build on Linux. The stand-in commits patches synchronously
+ * into a record instead of a backend, and raises SMTC events on demand.
+ * Tools only; usable from C.
+ */
+
+#include <stdint.h>
+
+#include "smtc_c_api.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* Initialize fails for this identity, as when SMTC is unavailable. */
+#define SMTC_STUB_FAILING_IDENTITY "stub-unavailable"
+
+/* What the session shows: every group as last committed. */
+typedef struct SmtcStubRecord {
+    uint64_t commits;         /* ApplyState calls accepted */
+    uint32_t last_fields;     /* SMTC_FIELD_* groups in the latest commit */
+    int32_t status;
+    char title[64];
+    size_t title_length;
+    char artist[64];
+    char album[64];
+    char art_url[128];
+    int64_t duration;
+    int64_t position;
+    double rate;
+    uint32_t enabled_buttons;
+} SmtcStubRecord;
+
+/* Fills `record`; returns 0 if either argument is NULL. */
+int32_t smtc_stub_get_record(SmtcSession* session, SmtcStubRecord* record);
+
+/* Raises a button press; returns 1 if a control callback received it. */
+int32_t smtc_stub_press(SmtcSession* session, const char* command);
+
+/* Raises a seek request; returns 1 if a position callback received it. */
+int32_t smtc_stub_seek(SmtcSession* session, int64_t position);
+
+#if defined(__cplusplus)
+}  // extern "C"
+#endif
+
+#endif  // AUDIO_SERVICE_SMTC_WINDOWS_STUB_H_
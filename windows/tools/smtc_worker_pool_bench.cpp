@@ -0,0 +1,385 @@
+// Measures what scheduling a task on the worker pool costs and checks its
+// priority lanes. Overhead is timed for tasks submitted from outside the
+// pool and from inside a task, against starting a thread per task as ad-hoc
+// background work would. The priority checks flood the prefetch lane with
+// busy tasks and time how long a task for the current track then waits
+// before it starts, with the flood queued in the shared queue and in a
+// worker's own deque; maintenance has to wait for the flood. The artwork
+// pipeline is run the same way: a queue's worth of prefetches must not hold
+// up the full image of the track that starts. Also checks that a task
+// submitted while idle threads are being released still runs, and that
+// teardown drops queued tasks instead of running them.
+// Needs no Windows or Flutter headers. Build it as C++17 with -Ismtc_windows
+// and -pthread, together with these sources from smtc_windows/: worker_pool,
+// artwork_pipeline, artwork_store, artwork_thumbnail, thumbnail_encoder,
+// span_tracer, memory_budget, event_dispatcher and native_log.
+//
+// Usage: smtc_worker_pool_bench [--tasks=N] [--flood=N] [--task-us=N]
+//                               [--trials=N]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "artwork_pipeline.h"
+#include "worker_pool.h"
+
+using namespace audio_service_smtc;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+int g_failures = 0;
+
+void Check(bool ok, const char* what) {
+    std::printf("%s  %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok) ++g_failures;
+}
+
+double Micros(Clock::duration duration) {
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+double Percentile(std::vector<double> values, double fraction) {
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(fraction * static_cast<double>(values.size() - 1) + 0.5);
+    return values[index];
+}
+
+// Busy for `micros`, like a decode or resize would be
+void Spin(int micros) {
+    Clock::time_point end = Clock::now() + std::chrono::microseconds(micros);
+    while (Clock::now() < end) {
+    }
+}
+
+// Counts down to zero and wakes whoever waits for it
+class Latch {
+public:
+    explicit Latch(size_t count) : _count(count) {}
+
+    void CountDown() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (--_count == 0) _cv.notify_all();
+    }
+    void Wait() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv.wait(lock, [this] { return _count == 0; });
+    }
+    bool WaitFor(std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return _cv.wait_for(lock, timeout, [this] { return _count == 0; });
+    }
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    size_t _count;
+};
+
+WorkerPool::Options PoolOptions(size_t threads) {
+    WorkerPool::Options options;
+    options.threadCount = threads;
+    return options;
+}
+
+// Nanoseconds per empty task, submitted from this thread
+double ExternalSubmit(size_t threads, int tasks) {
+    WorkerPool pool(PoolOptions(threads));
+    Latch done(static_cast<size_t>(tasks));
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < tasks; ++i) {
+        pool.Submit(TaskPriority::kCurrent, [&done] { done.CountDown(); });
+    }
+    done.Wait();
+    return Micros(Clock::now() - start) * 1000.0 / tasks;
+}
+
+// Nanoseconds per empty task, submitted by a task into its worker's deque
+double LocalSubmit(size_t threads, int tasks) {
+    WorkerPool pool(PoolOptions(threads));
+    Latch done(static_cast<size_t>(tasks));
+    Clock::time_point start = Clock::now();
+    pool.Submit(TaskPriority::kCurrent, [&] {
+        for (int i = 0; i < tasks; ++i) {
+            pool.Submit(TaskPriority::kCurrent, [&done] { done.CountDown(); });
+        }
+    });
+    done.Wait();
+    return Micros(Clock::now() - start) * 1000.0 / tasks;
+}
+
+// Nanoseconds per empty task run on a thread of its own
+double ThreadPerTask(int tasks) {
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < tasks; ++i) {
+        std::thread thread([] {});
+        thread.join();
+    }
+    return Micros(Clock::now() - start) * 1000.0 / tasks;
+}
+
+struct FloodResult {
+    std::vector<double> waits;    // current task, submit to start, microseconds
+    int maxOvertaken = 0;         // prefetch tasks started after it was submitted
+    bool maintenanceWaited = true;
+};
+
+// Queues `flood` prefetch tasks and some maintenance, then a current-track
+// task; from inside a worker if `local`
+FloodResult PrefetchFlood(size_t threads, int flood, int taskMicros, int trials, bool local) {
+    FloodResult result;
+    for (int trial = 0; trial < trials; ++trial) {
+        WorkerPool pool(PoolOptions(threads));
+        std::atomic<int> prefetchStarted{ 0 };
+        std::atomic<bool> currentStarted{ false };
+        Latch done(static_cast<size_t>(flood) + 4 + 1);
+
+        auto queueFlood = [&] {
+            for (int i = 0; i < flood; ++i) {
+                pool.Submit(TaskPriority::kPrefetch, [&] {
+                    prefetchStarted.fetch_add(1);
+                    // The rest of the flood is pointless once the check is done
+                    if (!currentStarted.load()) Spin(taskMicros);
+                    done.CountDown();
+                });
+            }
+            for (int i = 0; i < 4; ++i) {
+                pool.Submit(TaskPriority::kMaintenance, [&] {
+                    // Workers that found the prefetch lane empty may still be
+                    // finishing its last tasks
+                    if (prefetchStarted.load() + static_cast<int>(threads) < flood) {
+                        result.maintenanceWaited = false;
+                    }
+                    done.CountDown();
+                });
+            }
+        };
+        if (local) {
+            Latch queued(1);
+            pool.Submit(TaskPriority::kPrefetch, [&] {
+                queueFlood();
+                queued.CountDown();
+                Spin(taskMicros);
+            });
+            queued.Wait();
+        } else {
+            queueFlood();
+        }
+        // Let the workers get into the flood
+        std::this_thread::sleep_for(std::chrono::microseconds(taskMicros * 3));
+
+        int startedAtSubmit = prefetchStarted.load();
+        Clock::time_point submitted = Clock::now();
+        pool.Submit(TaskPriority::kCurrent, [&, startedAtSubmit, submitted] {
+            result.waits.push_back(Micros(Clock::now() - submitted));
+            result.maxOvertaken = (std::max)(result.maxOvertaken, prefetchStarted.load() - startedAtSubmit);
+            currentStarted.store(true);
+            done.CountDown();
+        });
+        done.Wait();
+    }
+    return result;
+}
+
+// Remote artwork whose fetch takes `delayMicros`
+class SlowLoader {
+public:
+    explicit SlowLoader(int delayMicros) : _delayMicros(delayMicros) {}
+
+    bool operator()(const std::string& url, size_t maxBytes, std::vector<uint8_t>& out) {
+        if (maxBytes != 0) return false;
+        std::this_thread::sleep_for(std::chrono::microseconds(_delayMicros));
+        out.assign(4096, static_cast<uint8_t>(url.size()));
+        _loads.fetch_add(1);
+        return true;
+    }
+
+    int Loads() const { return _loads.load(); }
+
+private:
+    int _delayMicros;
+    std::atomic<int> _loads{ 0 };
+};
+
+void CheckArtworkPrefetch(int flood, int taskMicros) {
+    std::printf("artwork prefetch\n");
+    WorkerPool pool(PoolOptions(1));
+    SlowLoader loader(taskMicros);
+    std::mutex mutex;
+    std::condition_variable committed;
+    uint64_t lastGeneration = 0;
+    Clock::time_point lastCommit;
+    ArtworkPipeline artwork(
+        pool,
+        [&loader](const std::string& url, size_t maxBytes, std::vector<uint8_t>& out) {
+            return loader(url, maxBytes, out);
+        },
+        [&](uint64_t generation, const ArtworkImage&) {
+            std::lock_guard<std::mutex> lock(mutex);
+            lastGeneration = generation;
+            lastCommit = Clock::now();
+            committed.notify_all();
+        });
+
+    // A queue's worth of upcoming tracks, then the user skips to a new one
+    for (int i = 0; i < flood; ++i) artwork.Prefetch("https://art.example/queue/" + std::to_string(i));
+    Clock::time_point start = Clock::now();
+    artwork.Begin(1, "https://art.example/now-playing");
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        committed.wait(lock, [&] { return lastGeneration == 1; });
+    }
+    double wait = Micros(lastCommit - start);
+    std::printf("  current artwork behind %d prefetches: %.0f us (%d fetches of %d us ran first)\n", flood, wait,
+                loader.Loads() - 1, taskMicros);
+    Check(loader.Loads() <= 3, "the current track's artwork is fetched ahead of the prefetches");
+
+    while (pool.PendingTasks() > 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    // Let the last task finish, not just start
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    int loads = loader.Loads();
+    std::string next = "https://art.example/queue/" + std::to_string(flood - 1);
+    ArtworkImage shown = artwork.Begin(2, next);
+    Check(!shown.empty() && !shown.placeholder, "a prefetched track starts with its full artwork");
+    artwork.Prefetch(next);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    Check(loader.Loads() == loads, "cached artwork isn't fetched again");
+}
+
+}  // namespace
+
+// A task submitted right after ReleaseIdleThreads(), before the idle worker
+// has woken to exit, must still find a thread
+void CheckSubmitAfterRelease(int trials) {
+    WorkerPool pool(PoolOptions(1));
+    int stranded = 0;
+    for (int trial = 0; trial < trials; ++trial) {
+        Latch warm(1);
+        pool.Submit(TaskPriority::kCurrent, [&warm] { warm.CountDown(); });
+        warm.Wait();
+        // Let the worker go back to waiting
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        Latch ran(1);
+        pool.ReleaseIdleThreads();
+        pool.Submit(TaskPriority::kCurrent, [&ran] { ran.CountDown(); });
+        if (!ran.WaitFor(std::chrono::milliseconds(1000))) {
+            ++stranded;
+            // Unstick it so the latch outlives the task
+            pool.Submit(TaskPriority::kCurrent, [] {});
+            ran.Wait();
+        }
+    }
+    std::printf("submit right after an idle release: %d of %d tasks stranded\n", stranded, trials);
+    Check(stranded == 0, "a task submitted during an idle release still runs");
+}
+
+// Teardown runs the tasks in flight and drops the queued ones
+void CheckShutdown(int queued) {
+    std::atomic<bool> release{ false };
+    std::atomic<int> ran{ 0 };
+    Latch started(1);
+    Clock::time_point begun;
+    std::thread releaser;
+    {
+        WorkerPool pool(PoolOptions(1));
+        pool.Submit(TaskPriority::kCurrent, [&] {
+            started.CountDown();
+            while (!release.load()) std::this_thread::yield();
+        });
+        // Each queued task stands in for a network fetch
+        for (int i = 0; i < queued; ++i) {
+            pool.Submit(TaskPriority::kPrefetch, [&ran] {
+                ran.fetch_add(1);
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            });
+        }
+        started.Wait();
+        // The task in flight finishes during teardown
+        releaser = std::thread([&release] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            release.store(true);
+        });
+        begun = Clock::now();
+    }
+    Clock::time_point destroyed = Clock::now();
+    releaser.join();
+    std::printf("teardown with %d queued 10 ms fetches: %.1f ms, %d of them ran\n", queued,
+                std::chrono::duration<double, std::milli>(destroyed - begun).count(), ran.load());
+    Check(ran.load() == 0, "teardown drops tasks that have not started");
+}
+
+int main(int argc, char** argv) {
+    int tasks = 200000;
+    int flood = 2000;
+    int taskMicros = 100;
+    int trials = 20;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--tasks=", 8) == 0) {
+            tasks = std::atoi(argv[i] + 8);
+        } else if (std::strncmp(argv[i], "--flood=", 8) == 0) {
+            flood = std::atoi(argv[i] + 8);
+        } else if (std::strncmp(argv[i], "--task-us=", 10) == 0) {
+            taskMicros = std::atoi(argv[i] + 10);
+        } else if (std::strncmp(argv[i], "--trials=", 9) == 0) {
+            trials = std::atoi(argv[i] + 9);
+        } else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (tasks <= 0 || flood <= 0 || taskMicros <= 0 || trials <= 0) {
+        std::fprintf(stderr, "counts must be positive\n");
+        return 2;
+    }
+
+    std::printf("scheduling overhead, empty tasks, ns per task\n");
+    for (size_t threads : { 1, 2, 4 }) {
+        std::printf("  %zu thread%s  submitted from outside %7.0f   from a task %7.0f\n", threads,
+                    threads == 1 ? " " : "s", ExternalSubmit(threads, tasks), LocalSubmit(threads, tasks));
+    }
+    double perThread = ThreadPerTask((std::min)(tasks, 5000));
+    std::printf("  a thread per task %7.0f\n", perThread);
+    Check(ExternalSubmit(2, tasks) < perThread, "pooled tasks cost less than a thread each");
+
+    {
+        WorkerPool::Options options = PoolOptions(4);
+        options.idleTimeout = std::chrono::milliseconds(50);
+        WorkerPool pool(std::move(options));
+        Latch done(64);
+        for (int i = 0; i < 64; ++i) pool.Submit(TaskPriority::kCurrent, [&done] { done.CountDown(); });
+        done.Wait();
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        Check(pool.RunningThreads() == 0, "an idle pool spins all threads down");
+    }
+
+    std::printf("prefetch flood: %d tasks of %d us, current task submit-to-start\n", flood, taskMicros);
+    for (bool local : { false, true }) {
+        for (size_t threads : { 1, 2 }) {
+            FloodResult result = PrefetchFlood(threads, flood, taskMicros, trials, local);
+            std::printf("  %-13s %zu thread%s  p50 %7.1f us  p99 %7.1f us  max %7.1f us  prefetches overtaking %d\n",
+                        local ? "worker deque" : "shared queue", threads, threads == 1 ? " " : "s",
+                        Percentile(result.waits, 0.5), Percentile(result.waits, 0.99),
+                        Percentile(result.waits, 1.0), result.maxOvertaken);
+            // Only workers already past the current lane may start another
+            Check(result.maxOvertaken <= static_cast<int>(threads), "the current task starts ahead of the flood");
+            Check(result.maintenanceWaited, "maintenance waits for the prefetch lane");
+        }
+    }
+
+    CheckArtworkPrefetch(100, 2000);
+    CheckSubmitAfterRelease(200);
+    CheckShutdown(100);
+
+    std::printf("%s\n", g_failures == 0 ? "all checks passed" : "FAILED");
+    return g_failures == 0 ? 0 : 1;
+}